@@ -37,7 +37,7 @@ public class Allegro : ModuleRules
 		PrivateDependencyModuleNames.AddRange(
 			new string[]
 			{
-				"CoreUObject", "Projects", "Slate", "SlateCore", "Chaos", "PhysicsCore", "Landscape", "RHI", "DeveloperSettings", 
+				"CoreUObject", "Projects", "Slate", "SlateCore", "Chaos", "PhysicsCore", "Landscape", "RHI", "DeveloperSettings", "Json", 
 				// ... add private dependencies that you statically link with here ...	
 			}
 			);
@@ -24,6 +24,11 @@
 #include "Framework/Notifications/NotificationManager.h"
 #include "IContentBrowserSingleton.h"
 #include "DerivedDataCacheInterface.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+#include "Misc/SecureHash.h"
+#include "UObject/Package.h"
+#include "Animation/AnimData/IAnimationDataModel.h"
 #endif
 
 
@@ -59,6 +64,12 @@ int32 GAllegro_NumTransitionGeneratedThisFrame = 0;
 
 ALLEGRO_AUTO_CVAR_DEBUG(bool, DisableTransitionGeneration, false, "", ECVF_Default);
 
+#if WITH_EDITOR
+bool GAllegro_SequenceBakeDDC = true;
+FAutoConsoleVariableRef CVar_SequenceBakeDDC(TEXT("allegro.SequenceBakeDDC"), GAllegro_SequenceBakeDDC, TEXT("if true baked frames of sequences are cached in DDC, a build only samples the sequences whose content or dependencies changed"), ECVF_Default);
+#endif
+ALLEGRO_AUTO_CVAR_DEBUG(bool, RecordTransitions, false, "record keys of the transitions generated at runtime, use UAllegroAnimCollection::AddRecordedTransitions to make them prebaked", ECVF_Default);
+
 namespace Utils
 {
 	//extract component space reference pose and its inverse from bone container
@@ -456,8 +467,7 @@ void UAllegroAnimCollection::GetResourceSizeEx(FResourceSizeEx& CumulativeResour
 {
 	Super::GetResourceSizeEx(CumulativeResourceSize);
 	//#TODO 
-	auto MatrixSize = bHighPrecision ? sizeof(float[3][4]) : sizeof(uint16[3][4]);
-	CumulativeResourceSize.AddDedicatedVideoMemoryBytes(TotalFrameCount * RenderBoneCount * MatrixSize);
+	CumulativeResourceSize.AddDedicatedVideoMemoryBytes(TotalFrameCount * RenderBoneCount * GetRenderMatrixSize());
 }
 
 
@@ -480,6 +490,9 @@ void UAllegroAnimCollection::Serialize(FArchive& Ar)
 				MeshDef.SerializeCooked(Ar);
 			}
 		}
+
+		if (!bIsServerOnly && Ar.CustomVer(FAllegroObjectVersion::GUID) >= FAllegroObjectVersion::CookedAnimationPayload)
+			SerializeCookedAnimationData(Ar);
 	}
 }
 
@@ -651,6 +664,48 @@ void UAllegroAnimCollection::AddAnimationUnique(const FAssetData& InAssetData)
 	}
 }
 
+void UAllegroAnimCollection::AddRecordedTransitions()
+{
+	int NumAdded = 0;
+	for (const FTransitionKey& Key : RecordedTransitions)
+	{
+		if (!Sequences.IsValidIndex(Key.FromSI) || !Sequences.IsValidIndex(Key.ToSI) || !Sequences[Key.ToSI].Sequence)
+			continue;
+
+		const FAllegroSequenceDef& ToSeq = Sequences[Key.ToSI];
+		FAllegroTransitionBakeDef Def;
+		Def.From = Sequences[Key.FromSI].Sequence;
+		Def.To = ToSeq.Sequence;
+		//middle of the frame so that float truncation gives back the same key
+		Def.Duration = (Key.FrameCount + 0.5f) / ToSeq.SampleFrequencyFloat;
+		Def.ToStartAt = (Key.ToFI + 0.5f) / ToSeq.SampleFrequencyFloat;
+		Def.BlendOption = Key.BlendOption;
+		Def.bFromLoops = Key.bFromLoops;
+		Def.bToLoops = Key.bToLoops;
+		Def.FromFrame = Key.FromFI;
+
+		const bool bExist = PrebakedTransitions.ContainsByPredicate([&](const FAllegroTransitionBakeDef& Other) {
+			return Other.From == Def.From && Other.To == Def.To && Other.FromFrame == Def.FromFrame && Other.BlendOption == Def.BlendOption && Other.bFromLoops == Def.bFromLoops && Other.bToLoops == Def.bToLoops
+				&& FMath::IsNearlyEqual(Other.Duration, Def.Duration) && FMath::IsNearlyEqual(Other.ToStartAt, Def.ToStartAt);
+		});
+
+		if (!bExist)
+		{
+			PrebakedTransitions.Add(Def);
+			NumAdded++;
+		}
+	}
+
+	UE_LOG(LogAllegro, Log, TEXT("%s: %d of %d recorded transitions added to PrebakedTransitions"), *GetName(), NumAdded, RecordedTransitions.Num());
+	RecordedTransitions.Reset();
+
+	if (NumAdded)
+	{
+		MarkPackageDirty();
+		bNeedRebuild = true;
+	}
+}
+
 FString UAllegroAnimCollection::GetSkeletonTagValue() const
 {
 	return Skeleton ? FString::Printf(TEXT("%s'%s'"), *Skeleton->GetClass()->GetPathName(), *Skeleton->GetPathName()) : FString();
@@ -714,18 +769,37 @@ void UAllegroAnimCollection::DestroyBuildData()
 
 	for(FAllegroSequenceDef& SeqDef : Sequences)
 	{
-		SeqDef.AnimationFrameIndex = SeqDef.AnimationFrameCount = 0;
+		SeqDef.AnimationFrameIndex = SeqDef.AnimationFrameCount = SeqDef.StoredFrameCount = 0;
 		SeqDef.SampleFrequencyFloat = SeqDef.SequenceLength = 0;
 		SeqDef.Notifies.Empty();
+		SeqDef.StoredFrameRemap.Empty();
 	}
+
+	StreamingStates.Empty();
+	FrameToSequence.Empty();
+	StreamingSourceRemap.Empty();
+	StreamingSource.Empty();
+	StreamingSourceData = nullptr;
+	StreamingPageTable.Empty();
+	PendingResidency.Empty();
+	ResidentSequences.Empty();
+	StreamingComponents.Empty();
+	StreamingPoolAllocator.Empty();
+	bStreamingPageTableDirty = bStreamingPoolOverflowReported = false;
+
 	for (FAllegroMeshDef& MeshDef : Meshes)
 	{
 		MeshDef.MeshData = nullptr;
 		MeshDef.OwningBounds.Empty();
+		MeshDef.BoundsView = TArrayView<FBoxCenterExtentFloat>();
 		MeshDef.MaxBBox = FBoxMinMaxFloat(ForceInit);
 		MeshDef.CompactPhysicsAsset = FAllegroCompactPhysicsAsset();
 	}
 
+	//nothing points into the payload anymore
+	if (CookedAnimationPayload.IsLocked())
+		CookedAnimationPayload.Unlock();
+
 	CachedTransforms.Empty();
 	SkeletonBoneIndexTo_CachedTransforms.Empty();
 	BonesToCache_Indices.Empty();
@@ -738,7 +812,8 @@ void UAllegroAnimCollection::DestroyBuildData()
 	AnimationBoneContainer = FBoneContainer();
 
 	TotalFrameCount = FrameCountSequences = RenderBoneCount = AnimationBoneCount = TotalAnimationBufferSize = TotalMeshBonesBufferSize = 0;
-	NumTransitionFrameAllocated = 0;
+	AnimationBufferMaxError = AnimationBufferAvgError = 0;
+	NumTransitionFrameAllocated = NumPrebakedTransitionFrame = NumPrebakedTransition = 0;
 
 	MeshesBBox = FBoxCenterExtentFloat(ForceInit);
 
@@ -902,7 +977,9 @@ void UAllegroAnimCollection::PostDuplicate(bool bDuplicateForPIE)
 void UAllegroAnimCollection::InitSkeletonData()
 {
 	{
-		this->TransitionsHashTable.Clear(FMath::RoundUpToPowerOfTwo(this->Sequences.Num() * 3));
+		//a bucket per two possible transitions. runtime transitions take at least 3 frames, InitPrebakedTransitions resizes it once prebaked ones are known
+		const int MaxNumTransition = FMath::Min(0xFFff, this->MaxTransitionPose / 3);
+		this->TransitionsHashTable.Clear(FMath::RoundUpToPowerOfTwo(FMath::Max(64, MaxNumTransition / 2)));
 		if(this->MaxTransitionPose > 0)
 		{
 			this->TransitionPoseAllocator.Init(this->MaxTransitionPose);
@@ -995,18 +1072,19 @@ void UAllegroAnimCollection::InitSkeletonData()
 
 }
 
-void UAllegroAnimCollection::CachePose(int PoseIndex, const TArrayView<FTransform>& PoseComponentSpace)
+void UAllegroAnimCollection::CachePose(int PoseIndex, const TArrayView<FTransform>& PoseComponentSpace, TArrayView<FBoxMinMaxFloat> OutMaxBounds)
 {
-	CachePoseBounds(PoseIndex, PoseComponentSpace);
+	CachePoseBounds(PoseIndex, PoseComponentSpace, OutMaxBounds);
 	CachePoseBones(PoseIndex, PoseComponentSpace);
 }
 
-void UAllegroAnimCollection::CachePoseBounds(int PoseIndex, const TArrayView<FTransform>& PoseComponentSpace)
+void UAllegroAnimCollection::CachePoseBounds(int PoseIndex, const TArrayView<FTransform>& PoseComponentSpace, TArrayView<FBoxMinMaxFloat> OutMaxBounds)
 {
 	check(PoseIndex < this->FrameCountSequences);
 	//generate and cache bounds
-	for (FAllegroMeshDef& MeshDef : this->Meshes)
+	for (int MeshDefIndex = 0; MeshDefIndex < this->Meshes.Num(); MeshDefIndex++)
 	{
+		FAllegroMeshDef& MeshDef = this->Meshes[MeshDefIndex];
 		if (MeshDef.Mesh && MeshDef.OwningBoundMeshIndex == -1)	//check if has mesh and needs bound
 		{
 			FBox3f Box;
@@ -1022,7 +1100,7 @@ void UAllegroAnimCollection::CachePoseBounds(int PoseIndex, const TArrayView<FTr
 			check(Box.IsValid);
 
 			FBoxCenterExtentFloat BoundCE(Box.ExpandBy(MeshDef.BoundExtent));
-			MeshDef.MaxBBox.Add(BoundCE);
+			OutMaxBounds[MeshDefIndex].Add(BoundCE);
 			if (MeshDef.OwningBounds.Num())
 				MeshDef.OwningBounds[PoseIndex] = BoundCE;
 
@@ -1100,6 +1178,8 @@ bool UAllegroAnimCollection::BuildData()
 
 	if (FApp::CanEverRender())
 	{
+		InitImpostorFrames();
+
 		ENQUEUE_RENDER_COMMAND(InitAnimationBuffer)([this](FRHICommandListImmediate& RHICmdList) {
 			this->AnimationBuffer->InitResource(RHICmdList);
 			this->InitMeshDataResources(RHICmdList);
@@ -1142,6 +1222,24 @@ bool UAllegroAnimCollection::BuildAnimationData()
 	this->InitSkeletonData();
 	
 	const FReferenceSkeleton& ReferenceSkelton = this->Skeleton->GetReferenceSkeleton();
+
+	//probes for measuring animation buffer encoding error, center and corners of the meshes bounds
+	{
+		FBox3f ProbeBox(ForceInit);
+		for (const FAllegroMeshDef& MeshDef : this->Meshes)
+		{
+			if (MeshDef.Mesh)
+				ProbeBox += FBox3f(MeshDef.Mesh->GetImportedBounds().GetBox());
+		}
+
+		this->BakeErrorProbes.Reset();
+		if (ProbeBox.IsValid)
+		{
+			this->BakeErrorProbes.Add(ProbeBox.GetCenter());
+			for (int i = 0; i < 8; i++)
+				this->BakeErrorProbes.Add(FVector3f((i & 1) ? ProbeBox.Max.X : ProbeBox.Min.X, (i & 2) ? ProbeBox.Max.Y : ProbeBox.Min.Y, (i & 4) ? ProbeBox.Max.Z : ProbeBox.Min.Z));
+		}
+	}
 	
 	int FrameCounter = 1;
 	//for each sequence 
@@ -1163,28 +1261,12 @@ bool UAllegroAnimCollection::BuildAnimationData()
 	}
 
 	this->FrameCountSequences = FrameCounter;
-	this->TotalFrameCount = this->FrameCountSequences + this->MaxTransitionPose + (this->MaxDynamicPose * 2);
+	InitPrebakedTransitions();
+	this->TotalFrameCount = this->FrameCountSequences + this->NumPrebakedTransitionFrame + this->MaxTransitionPose + (this->MaxDynamicPose * 2);
 	this->RenderBoneCount = this->RenderRequiredBones.Num(); //ReferenceSkelton.GetNum();
 	this->TotalAnimationBufferSize = this->RenderBoneCount * this->TotalFrameCount * this->GetRenderMatrixSize();
 	//LexToString(FUnitConversion::QuantizeUnitsToBestFit((this->RenderBoneCount * this->PoseCount * this->GetRenderMatrixSize()), EUnit::Bytes));
 
-	this->AnimationBuffer = MakeUnique<FAllegroAnimationBuffer>();
-	this->AnimationBuffer->InitBuffer(this->RenderBoneCount * this->TotalFrameCount, this->bHighPrecision, true);
-
-	//reserve bounds
-	{
-		for (FAllegroMeshDef& MeshDef : this->Meshes)
-		{
-			MeshDef.MaxBBox = FBoxMinMaxFloat(ForceInit);
-			MeshDef.OwningBounds.Empty();
-
-			if (!this->bDontGenerateBounds && MeshDef.Mesh && !this->Meshes.IsValidIndex(MeshDef.OwningBoundMeshIndex))
-			{
-				MeshDef.OwningBounds.SetNumUninitialized(this->FrameCountSequences);
-			}
-		}
-	}
-
 	//reserve cached transforms
 	{
 		this->CachedTransforms.Init(FTransform3f::Identity, this->TotalFrameCount * this->BonesToCache_Indices.Num());
@@ -1196,14 +1278,36 @@ bool UAllegroAnimCollection::BuildAnimationData()
 		}
 	}
 
-	//0 index is identity data (default pose)
-	CachePose(0, this->RefPoseComponentSpace);
+	const bool bCookedData = LoadCookedAnimationData();
+	if (!bCookedData)
+		BakeAnimationData();
 
-	//build animation sequences
-	ParallelFor(Sequences.Num(), [this](int SI) {
-		this->BuildSequence(SI);
+	//report encoding error so that format can be chosen per collection
+	{
+		this->AnimationBufferMaxError = this->AnimationBufferAvgError = 0;
+		int NumSequence = 0;
+		int WorstSequence = -1;
+		for (int SI = 0; SI < Sequences.Num(); SI++)
+		{
+			if (!Sequences[SI].Sequence)
+				continue;
 
-	}, GGenerateSingleThread ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None);
+			NumSequence++;
+			this->AnimationBufferAvgError += Sequences[SI].BakeError;
+			if (WorstSequence == -1 || Sequences[SI].BakeError > this->AnimationBufferMaxError)
+			{
+				this->AnimationBufferMaxError = Sequences[SI].BakeError;
+				WorstSequence = SI;
+			}
+		}
+
+		if (NumSequence)
+		{
+			this->AnimationBufferAvgError /= NumSequence;
+			UE_LOG(LogAllegro, Log, TEXT("%s animation buffer %s (HighPrecision:%d) %d bytes, MaxError:%fcm (%s) AvgError:%fcm"), *GetName(), *UEnum::GetValueAsString(this->AnimationBufferFormat), this->bHighPrecision, this->TotalAnimationBufferSize,
+				this->AnimationBufferMaxError, *GetNameSafe(Sequences[WorstSequence].Sequence), this->AnimationBufferAvgError);
+		}
+	}
 
 
 	{
@@ -1214,11 +1318,13 @@ bool UAllegroAnimCollection::BuildAnimationData()
 		{
 			if(MeshDef.Mesh)
 			{
-				MeshDef.BoundsView = MeshDef.OwningBounds;
+				if (!bCookedData) //cooked bounds are viewed in the payload already
+					MeshDef.BoundsView = MeshDef.OwningBounds;
 				if (this->Meshes.IsValidIndex(MeshDef.OwningBoundMeshIndex)) //get from other MeshDef if its not independent
 				{
-					MeshDef.BoundsView = this->Meshes[MeshDef.OwningBoundMeshIndex].OwningBounds;
-					MeshDef.MaxBBox = this->Meshes[MeshDef.OwningBoundMeshIndex].MaxBBox;
+					FAllegroMeshDef& OwnerDef = this->Meshes[MeshDef.OwningBoundMeshIndex];
+					MeshDef.BoundsView = bCookedData ? OwnerDef.BoundsView : TArrayView<FBoxCenterExtentFloat>(OwnerDef.OwningBounds);
+					MeshDef.MaxBBox = OwnerDef.MaxBBox;
 				}
 
 				MaxPossibleBound.Add(MeshDef.MaxBBox);
@@ -1232,20 +1338,282 @@ bool UAllegroAnimCollection::BuildAnimationData()
 	return true;
 }
 
-void UAllegroAnimCollection::BuildSequence(int SequenceIndex)
+void UAllegroAnimCollection::BakeAnimationData()
+{
+	this->AnimationBuffer = MakeUnique<FAllegroAnimationBuffer>();
+	this->AnimationBuffer->InitBuffer(this->RenderBoneCount * this->TotalFrameCount, this->bHighPrecision, this->AnimationBufferFormat, true);
+
+	//reserve bounds
+	{
+		for (FAllegroMeshDef& MeshDef : this->Meshes)
+		{
+			MeshDef.MaxBBox = FBoxMinMaxFloat(ForceInit);
+			MeshDef.OwningBounds.Empty();
+
+			if (!this->bDontGenerateBounds && MeshDef.Mesh && !this->Meshes.IsValidIndex(MeshDef.OwningBoundMeshIndex))
+			{
+				MeshDef.OwningBounds.SetNumUninitialized(this->FrameCountSequences);
+			}
+		}
+	}
+
+	//max bounds of each pose source, merged once sequences are done. [0] is the ref pose, [SI + 1] is sequence SI
+	const int NumMeshDef = this->Meshes.Num();
+	TArray<FBoxMinMaxFloat> SourceMaxBounds;
+	SourceMaxBounds.Init(FBoxMinMaxFloat(ForceInit), (Sequences.Num() + 1) * NumMeshDef);
+
+	//0 index is identity data (default pose)
+	CachePose(0, this->RefPoseComponentSpace, TArrayView<FBoxMinMaxFloat>(SourceMaxBounds.GetData(), NumMeshDef));
+
+#if WITH_EDITOR
+	this->SequenceBakeContextHash = GAllegro_SequenceBakeDDC ? CalcSequenceBakeContextHash() : FString();
+#endif
+
+	//build animation sequences
+	std::atomic<int> NumSampledSequence = 0;
+	ParallelFor(Sequences.Num(), [this, &SourceMaxBounds, &NumSampledSequence, NumMeshDef](int SI) {
+		if (this->BuildSequence(SI, TArrayView<FBoxMinMaxFloat>(SourceMaxBounds.GetData() + (SI + 1) * NumMeshDef, NumMeshDef)))
+			NumSampledSequence++;
+
+	}, GGenerateSingleThread ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None);
+
+	UE_LOG(LogAllegro, Log, TEXT("%s %d of %d sequences sampled, rest taken from DDC"), *GetName(), NumSampledSequence.load(), Sequences.Num());
+
+	for (int SourceIndex = 0; SourceIndex <= Sequences.Num(); SourceIndex++)
+	{
+		for (int MeshDefIndex = 0; MeshDefIndex < NumMeshDef; MeshDefIndex++)
+			this->Meshes[MeshDefIndex].MaxBBox.Add(SourceMaxBounds[SourceIndex * NumMeshDef + MeshDefIndex]);
+	}
+
+	CompactSequenceFrames();
+	BuildPrebakedTransitions();
+}
+
+static FArchive& operator<<(FArchive& Ar, UAllegroAnimCollection::FCookedAnimationData::FSection& Section)
+{
+	return Ar << Section.Offset << Section.Size;
+}
+
+void UAllegroAnimCollection::FCookedAnimationData::Serialize(FArchive& Ar)
+{
+	Ar << bValid;
+	if (!bValid)
+		return;
+
+	Ar << FrameCountSequences << TotalFrameCount << RenderBoneCount << NumCachedBone << NumPrebakedTransitionFrame << RenderMatrixSize;
+	Ar << StoredFrameCounts << BakeErrors;
+
+	int NumMaxBBox = MaxBBoxes.Num();
+	Ar << NumMaxBBox;
+	if (Ar.IsLoading())
+		MaxBBoxes.SetNum(NumMaxBBox);
+	for (FBoxMinMaxFloat& Box : MaxBBoxes)
+		Ar << Box.GetMin() << Box.GetMax();
+
+	Ar << FrameRemap << FrameRemapShift << StreamingPoolFrames << StreamingSourceRemap << TotalAnimationBufferSize;
+	Ar << AnimationBuffer << CachedTransforms << StreamingSource << OwningBounds;
+}
+
+void UAllegroAnimCollection::SerializeCookedAnimationData(FArchive& Ar)
+{
+#if WITH_EDITOR
+	if (Ar.IsSaving())
+		BuildCookedAnimationData();
+#endif
+
+	CookedAnimationData.Serialize(Ar);
+	if (CookedAnimationData.bValid)
+		CookedAnimationPayload.Serialize(Ar, this);
+}
+
+bool UAllegroAnimCollection::LoadCookedAnimationData()
+{
+	const FCookedAnimationData& Cooked = this->CookedAnimationData;
+	if (!Cooked.bValid)
+		return false;
+
+	const int NumCachedFrame = this->FrameCountSequences + this->NumPrebakedTransitionFrame;
+	const int64 PayloadSize = this->CookedAnimationPayload.GetBulkDataSize();
+	auto IsSectionValid = [PayloadSize](const FCookedAnimationData::FSection& Section) {
+		return Section.Offset % FCookedAnimationData::SectionAlignment == 0 && static_cast<int64>(Section.Offset) + Section.Size <= PayloadSize;
+	};
+
+	bool bMatch = Cooked.FrameCountSequences == this->FrameCountSequences && Cooked.TotalFrameCount == this->TotalFrameCount && Cooked.RenderBoneCount == this->RenderBoneCount
+		&& Cooked.NumCachedBone == this->BonesToCache_Indices.Num() && Cooked.NumPrebakedTransitionFrame == this->NumPrebakedTransitionFrame && Cooked.RenderMatrixSize == GetRenderMatrixSize()
+		&& Cooked.StoredFrameCounts.Num() == this->Sequences.Num() && Cooked.BakeErrors.Num() == this->Sequences.Num() && Cooked.MaxBBoxes.Num() == this->Meshes.Num() && Cooked.OwningBounds.Num() == this->Meshes.Num()
+		&& (Cooked.StreamingPoolFrames == 0 || Cooked.StreamingSourceRemap.Num() == this->FrameCountSequences)
+		&& IsSectionValid(Cooked.AnimationBuffer) && Cooked.AnimationBuffer.Size > 0 && IsSectionValid(Cooked.StreamingSource)
+		&& IsSectionValid(Cooked.CachedTransforms) && Cooked.CachedTransforms.Size == static_cast<uint32>(NumCachedFrame * this->BonesToCache_Indices.Num() * this->CachedTransforms.GetTypeSize());
+
+	for (const FCookedAnimationData::FSection& Section : Cooked.OwningBounds)
+		bMatch &= IsSectionValid(Section) && (Section.Size == 0 || Section.Size == this->FrameCountSequences * sizeof(FBoxCenterExtentFloat));
+
+	if (!bMatch)
+	{
+		UE_LOG(LogAllegro, Warning, TEXT("%s: cooked animation data doesn't match the collection, sequences will be sampled."), *GetName());
+		return false;
+	}
+
+	//payload stays locked until DestroyBuildData, bounds and streamed frames are read from it in place
+	uint8* Payload = static_cast<uint8*>(this->CookedAnimationPayload.Lock(LOCK_READ_ONLY));
+	if (!Payload)
+	{
+		this->CookedAnimationPayload.Unlock();
+		return false;
+	}
+
+	for (int SequenceIndex = 0; SequenceIndex < this->Sequences.Num(); SequenceIndex++)
+	{
+		this->Sequences[SequenceIndex].StoredFrameCount = Cooked.StoredFrameCounts[SequenceIndex];
+		this->Sequences[SequenceIndex].BakeError = Cooked.BakeErrors[SequenceIndex];
+	}
+
+	for (int MeshDefIndex = 0; MeshDefIndex < this->Meshes.Num(); MeshDefIndex++)
+	{
+		FAllegroMeshDef& MeshDef = this->Meshes[MeshDefIndex];
+		const FCookedAnimationData::FSection& Section = Cooked.OwningBounds[MeshDefIndex];
+		MeshDef.MaxBBox = Cooked.MaxBBoxes[MeshDefIndex];
+		MeshDef.OwningBounds.Empty();
+		MeshDef.BoundsView = TArrayView<FBoxCenterExtentFloat>(reinterpret_cast<FBoxCenterExtentFloat*>(Payload + Section.Offset), Section.Size / sizeof(FBoxCenterExtentFloat));
+	}
+
+	//bone cache must stay writable, runtime transitions fill their frames after the baked ones
+	FMemory::Memcpy(this->CachedTransforms.GetData(), Payload + Cooked.CachedTransforms.Offset, Cooked.CachedTransforms.Size);
+
+	this->AnimationBuffer = MakeUnique<FAllegroAnimationBuffer>();
+	this->AnimationBuffer->InitExternal(Payload + Cooked.AnimationBuffer.Offset, Cooked.AnimationBuffer.Size, this->bHighPrecision, this->AnimationBufferFormat);
+	this->AnimationBuffer->FrameRemap = Cooked.FrameRemap;
+	this->AnimationBuffer->FrameRemapShift = Cooked.FrameRemapShift;
+
+	if (Cooked.StreamingPoolFrames > 0)
+	{
+		this->StreamingSourceRemap = Cooked.StreamingSourceRemap;
+		this->StreamingSourceData = Payload + Cooked.StreamingSource.Offset;
+		InitStreamingStates(Cooked.StreamingPoolFrames);
+	}
+
+	this->TotalAnimationBufferSize = Cooked.TotalAnimationBufferSize;
+
+	UE_LOG(LogAllegro, Log, TEXT("%s baked animations taken from cooked payload, %lld bytes (MemoryMapped:%d)"), *GetName(), PayloadSize, this->CookedAnimationPayload.IsDataMemoryMapped());
+	return true;
+}
+
+#if WITH_EDITOR
+void UAllegroAnimCollection::BuildCookedAnimationData()
+{
+	FCookedAnimationData& Cooked = this->CookedAnimationData;
+	Cooked = FCookedAnimationData();
+	this->CookedAnimationPayload.RemoveBulkData();
+
+	if (!this->bIsBuilt)
+		return;
+
+	//CPU copy is released after GPU upload, only kept when we can't render (cook commandlet)
+	if (this->bNeedRebuild || !this->AnimationBuffer->Transforms)
+	{
+		UE_LOG(LogAllegro, Warning, TEXT("%s: build data is not available for cooking, sequences will be sampled at load."), *GetName());
+		return;
+	}
+
+	const FAllegroAnimationBuffer& Buffer = *this->AnimationBuffer;
+	Cooked.FrameCountSequences = this->FrameCountSequences;
+	Cooked.TotalFrameCount = this->TotalFrameCount;
+	Cooked.RenderBoneCount = this->RenderBoneCount;
+	Cooked.NumCachedBone = this->BonesToCache_Indices.Num();
+	Cooked.NumPrebakedTransitionFrame = this->NumPrebakedTransitionFrame;
+	Cooked.RenderMatrixSize = GetRenderMatrixSize();
+
+	for (const FAllegroSequenceDef& SequenceStruct : this->Sequences)
+	{
+		Cooked.StoredFrameCounts.Add(SequenceStruct.StoredFrameCount);
+		Cooked.BakeErrors.Add(SequenceStruct.BakeError);
+	}
+
+	for (const FAllegroMeshDef& MeshDef : this->Meshes)
+		Cooked.MaxBBoxes.Add(MeshDef.MaxBBox);
+
+	if (IsSequenceStreamingEnabled())
+	{
+		Cooked.StreamingPoolFrames = this->FrameCountSequences - 1 - Buffer.FrameRemapShift; //see InitStreamingStates
+		Cooked.StreamingSourceRemap = this->StreamingSourceRemap;
+	}
+	else
+	{
+		Cooked.FrameRemap = Buffer.FrameRemap;
+	}
+	Cooked.FrameRemapShift = Buffer.FrameRemapShift;
+	Cooked.TotalAnimationBufferSize = this->TotalAnimationBufferSize;
+
+	uint32 PayloadSize = 0;
+	auto AddSection = [&PayloadSize](FCookedAnimationData::FSection& Section, SIZE_T Size) {
+		Section.Offset = Align(PayloadSize, FCookedAnimationData::SectionAlignment);
+		Section.Size = static_cast<uint32>(Size);
+		PayloadSize = Section.Offset + Section.Size;
+	};
+
+	const int NumCachedFrame = this->FrameCountSequences + this->NumPrebakedTransitionFrame;
+	AddSection(Cooked.AnimationBuffer, Buffer.Transforms->Num() * Buffer.Transforms->GetStride());
+	AddSection(Cooked.CachedTransforms, NumCachedFrame * this->BonesToCache_Indices.Num() * this->CachedTransforms.GetTypeSize());
+	AddSection(Cooked.StreamingSource, this->StreamingSource.Num());
+	Cooked.OwningBounds.SetNum(this->Meshes.Num());
+	for (int MeshDefIndex = 0; MeshDefIndex < this->Meshes.Num(); MeshDefIndex++)
+		AddSection(Cooked.OwningBounds[MeshDefIndex], this->Meshes[MeshDefIndex].OwningBounds.Num() * sizeof(FBoxCenterExtentFloat));
+
+	this->CookedAnimationPayload.Lock(LOCK_READ_WRITE);
+	uint8* Payload = static_cast<uint8*>(this->CookedAnimationPayload.Realloc(PayloadSize));
+	FMemory::Memzero(Payload, PayloadSize); //padding between sections
+	FMemory::Memcpy(Payload + Cooked.AnimationBuffer.Offset, Buffer.Transforms->GetDataPointer(), Cooked.AnimationBuffer.Size);
+	FMemory::Memcpy(Payload + Cooked.CachedTransforms.Offset, this->CachedTransforms.GetData(), Cooked.CachedTransforms.Size);
+	FMemory::Memcpy(Payload + Cooked.StreamingSource.Offset, this->StreamingSource.GetData(), Cooked.StreamingSource.Size);
+	for (int MeshDefIndex = 0; MeshDefIndex < this->Meshes.Num(); MeshDefIndex++)
+		FMemory::Memcpy(Payload + Cooked.OwningBounds[MeshDefIndex].Offset, this->Meshes[MeshDefIndex].OwningBounds.GetData(), Cooked.OwningBounds[MeshDefIndex].Size);
+	this->CookedAnimationPayload.Unlock();
+
+	//payload goes to its own file so that it can be memory mapped
+	this->CookedAnimationPayload.SetBulkDataFlags(BULKDATA_Force_NOT_InlinePayload | BULKDATA_MemoryMappedPayload);
+	Cooked.bValid = true;
+}
+#endif
+
+bool UAllegroAnimCollection::BuildSequence(int SequenceIndex, TArrayView<FBoxMinMaxFloat> OutMaxBounds)
 {
 	FMemMark MemMarker(FMemStack::Get());	//animation structures use FMemMemStack so we need marker
 
 	FAllegroSequenceDef& SequenceStruct = this->Sequences[SequenceIndex];
 	UAnimSequenceBase* AnimSequence = SequenceStruct.Sequence;
 	if (!AnimSequence)
-		return;
+		return false;
+
+#if WITH_EDITOR
+	//baked frames don't depend on where the sequence lands in the buffer, adding or removing other sequences only moves them
+	FString DDCKey;
+	if (!this->SequenceBakeContextHash.IsEmpty())
+	{
+		DDCKey = GetDDCKeyForSequence(SequenceIndex);
+		TArray<uint8> DDCData;
+		if (GetDerivedDataCacheRef().GetSynchronous(*DDCKey, DDCData, this->GetPathName()))
+		{
+			FMemoryReader DDCReader(DDCData);
+			if (SerializeSequenceBake(DDCReader, SequenceIndex, OutMaxBounds) && !DDCReader.IsError())
+				return false;
+
+			//partially read data is overwritten by sampling
+			for (FBoxMinMaxFloat& MaxBound : OutMaxBounds)
+				MaxBound = FBoxMinMaxFloat(ForceInit);
+		}
+	}
+#endif
 
 	TransformArrayAnimStack PoseComponentSpace;
 	PoseComponentSpace.SetNumUninitialized(this->AnimationBoneContainer.GetCompactPoseNumBones());
 
-	FMatrix3x4* RenderMatricesFloat = this->bHighPrecision ? this->AnimationBuffer->GetDataPointerHP() : nullptr;
-	FMatrix3x4Half* RenderMatricesHalf = !this->bHighPrecision ? this->AnimationBuffer->GetDataPointerLP() : nullptr;
+	TArray<FMatrix3x4, TMemStackAllocator<>> RenderMatrices;
+	RenderMatrices.SetNumUninitialized(this->RenderBoneCount);
+	TArray<FMatrix3x4, TMemStackAllocator<>> LastStoredMatrices;
+	LastStoredMatrices.SetNumUninitialized(this->RenderBoneCount);
+	SequenceStruct.BakeError = 0;
+	SequenceStruct.StoredFrameCount = 0;
+	SequenceStruct.StoredFrameRemap.SetNumUninitialized(SequenceStruct.AnimationFrameCount);
 
 	FCompactPose CompactPose;
 	CompactPose.SetBoneContainer(&this->AnimationBoneContainer);
@@ -1260,22 +1628,42 @@ void UAllegroAnimCollection::BuildSequence(int SequenceIndex)
 	for (int SeqFrameIndex = 0; SeqFrameIndex < SequenceStruct.AnimationFrameCount; SeqFrameIndex++)
 	{
 		const double SampleTime = SeqFrameIndex * FrameTime;
-		const int AnimBufferFrameIndex = SequenceStruct.AnimationFrameIndex + SeqFrameIndex;
+		const int AnimFrameIndex = SequenceStruct.AnimationFrameIndex + SeqFrameIndex;
 
 		//CompactPose.ResetToRefPose();
 		AnimSequence->GetAnimationPose(poseData, FAnimExtractContext(SampleTime, this->bExtractRootMotion));
 		Utils::LocalPoseToComponent(CompactPose, PoseComponentSpace.GetData());
-		CachePose(AnimBufferFrameIndex, PoseComponentSpace);
+		//bounds and cached bones are kept for every frame, they are cheap compared to render matrices
+		CachePose(AnimFrameIndex, PoseComponentSpace, OutMaxBounds);
 
-		if(this->bHighPrecision)
-		{
-			CalcRenderMatrices(PoseComponentSpace, RenderMatricesFloat + (AnimBufferFrameIndex * this->RenderBoneCount));
-		}
-		else
+		CalcRenderMatrices(PoseComponentSpace, RenderMatrices.GetData());
+
+		//compared against the last stored frame (not the previous one) so that error doesn't accumulate over slow motions
+		const bool bStore = SequenceStruct.StoredFrameCount == 0 || this->FrameReductionTolerance <= 0
+			|| CalcPoseDistance(RenderMatrices.GetData(), LastStoredMatrices.GetData(), this->FrameReductionTolerance) > this->FrameReductionTolerance;
+		if (bStore)
 		{
-			CalcRenderMatrices(PoseComponentSpace, RenderMatricesHalf + (AnimBufferFrameIndex * this->RenderBoneCount));
+			//stored frames are packed at the beginning of the sequence range, CompactSequenceFrames moves them to their final place
+			const float Error = WriteRenderMatrices(SequenceStruct.AnimationFrameIndex + SequenceStruct.StoredFrameCount, RenderMatrices.GetData());
+			SequenceStruct.BakeError = FMath::Max(SequenceStruct.BakeError, Error);
+			SequenceStruct.StoredFrameCount++;
+			FMemory::Memcpy(LastStoredMatrices.GetData(), RenderMatrices.GetData(), this->RenderBoneCount * sizeof(FMatrix3x4));
 		}
+
+		SequenceStruct.StoredFrameRemap[SeqFrameIndex] = SequenceStruct.StoredFrameCount - 1;
+	}
+
+#if WITH_EDITOR
+	if (!DDCKey.IsEmpty())
+	{
+		TArray<uint8> DDCData;
+		FMemoryWriter DDCWriter(DDCData);
+		SerializeSequenceBake(DDCWriter, SequenceIndex, OutMaxBounds);
+		GetDerivedDataCacheRef().Put(*DDCKey, DDCData, this->GetPathName());
 	}
+#endif
+
+	return true;
 }
 
 void UAllegroAnimCollection::BuildMeshData()
@@ -1484,16 +1872,367 @@ void UAllegroAnimCollection::CalcRenderMatrices(const TArrayView<FTransform> Pos
 	}
 }
 
-void UAllegroAnimCollection::CalcRenderMatrices(const TArrayView<FTransform> PoseComponentSpace, FMatrix3x4Half* OutMatrices) const
+static FVector3f AllegroTransformByRenderMatrix(const FMatrix3x4& M, const FVector3f& P)
 {
-	for (int i = 0; i < RenderRequiredBones.Num(); i++)
+	return FVector3f(M.M[0][0] * P.X + M.M[0][1] * P.Y + M.M[0][2] * P.Z + M.M[0][3],
+		M.M[1][0] * P.X + M.M[1][1] * P.Y + M.M[1][2] * P.Z + M.M[1][3],
+		M.M[2][0] * P.X + M.M[2][1] * P.Y + M.M[2][2] * P.Z + M.M[2][3]);
+}
+
+float UAllegroAnimCollection::WriteRenderMatrices(int BufferFrameIndex, const FMatrix3x4* RenderMatrices)
+{
+	const EAllegroAnimBufferFormat Format = this->AnimationBuffer->Format;
+	const uint32 VectorsPerBone = AllegroAnimBufferVectorsPerBone(Format);
+	const uint32 BoneOffset = BufferFrameIndex * this->RenderBoneCount;
+
+	TArray<FVector4f, TMemStackAllocator<>> Encoded;
+	Encoded.SetNumUninitialized(this->RenderBoneCount * VectorsPerBone);
+	for (int i = 0; i < this->RenderBoneCount; i++)
+		AllegroEncodeBone(Format, RenderMatrices[i], &Encoded[i * VectorsPerBone]);
+
+	this->AnimationBuffer->SetBones(BoneOffset, this->RenderBoneCount, Encoded.GetData());
+
+	if (Format == EAllegroAnimBufferFormat::Matrix3x4 && this->AnimationBuffer->bHighPrecision)
+		return 0; //lossless
+
+	//read back what GPU will see and compare
+	float MaxErrorSq = 0;
+	FVector4f Stored[3];
+	for (int i = 0; i < this->RenderBoneCount; i++)
 	{
-		FBoneIndexType CompactBoneIdx = RenderRequiredBones[i];
-		FMatrix44f BoneMatrix = static_cast<FTransform3f>(PoseComponentSpace[CompactBoneIdx]).ToMatrixWithScale();
-		FMatrix3x4 FloatMatrix;
-		AllegroSetMatrix3x4Transpose(FloatMatrix, this->RefPoseInverse[CompactBoneIdx] * BoneMatrix);
-		OutMatrices[i] = FloatMatrix;
+		this->AnimationBuffer->GetBone(BoneOffset + i, Stored);
+		const FMatrix3x4 Decoded = AllegroDecodeBone(Format, Stored);
+		for (const FVector3f& Probe : this->BakeErrorProbes)
+		{
+			const float ErrorSq = FVector3f::DistSquared(AllegroTransformByRenderMatrix(RenderMatrices[i], Probe), AllegroTransformByRenderMatrix(Decoded, Probe));
+			MaxErrorSq = FMath::Max(MaxErrorSq, ErrorSq);
+		}
+	}
+
+	return FMath::Sqrt(MaxErrorSq);
+}
+
+float UAllegroAnimCollection::CalcPoseDistance(const FMatrix3x4* RenderMatricesA, const FMatrix3x4* RenderMatricesB, float EarlyOutDistance) const
+{
+	const float EarlyOutDistanceSq = EarlyOutDistance * EarlyOutDistance;
+	float MaxDistSq = 0;
+	for (int i = 0; i < this->RenderBoneCount; i++)
+	{
+		for (const FVector3f& Probe : this->BakeErrorProbes)
+		{
+			const float DistSq = FVector3f::DistSquared(AllegroTransformByRenderMatrix(RenderMatricesA[i], Probe), AllegroTransformByRenderMatrix(RenderMatricesB[i], Probe));
+			MaxDistSq = FMath::Max(MaxDistSq, DistSq);
+		}
+
+		if (MaxDistSq > EarlyOutDistanceSq)
+			break;
 	}
+
+	return FMath::Sqrt(MaxDistSq);
+}
+
+void UAllegroAnimCollection::CompactSequenceFrames()
+{
+	TArray<uint32>& FrameRemap = this->AnimationBuffer->FrameRemap;
+	FrameRemap.SetNumUninitialized(this->FrameCountSequences);
+	FrameRemap[0] = 0; //ref pose
+
+	const SIZE_T FrameBytes = static_cast<SIZE_T>(this->RenderBoneCount) * GetRenderMatrixSize();
+	uint8* BufferData = static_cast<uint8*>(this->AnimationBuffer->Transforms->GetDataPointer());
+	int BufferFrameCounter = 1;
+
+	for (FAllegroSequenceDef& SequenceStruct : this->Sequences)
+	{
+		if (!SequenceStruct.Sequence)
+			continue;
+
+		check(SequenceStruct.StoredFrameRemap.Num() == SequenceStruct.AnimationFrameCount);
+		//sequences are in ascending order and never move forward, so source is never overwritten before its read
+		if (BufferFrameCounter != SequenceStruct.AnimationFrameIndex)
+			FMemory::Memmove(BufferData + BufferFrameCounter * FrameBytes, BufferData + SequenceStruct.AnimationFrameIndex * FrameBytes, SequenceStruct.StoredFrameCount * FrameBytes);
+
+		for (int SeqFrameIndex = 0; SeqFrameIndex < SequenceStruct.AnimationFrameCount; SeqFrameIndex++)
+			FrameRemap[SequenceStruct.AnimationFrameIndex + SeqFrameIndex] = BufferFrameCounter + SequenceStruct.StoredFrameRemap[SeqFrameIndex];
+
+		BufferFrameCounter += SequenceStruct.StoredFrameCount;
+		SequenceStruct.StoredFrameRemap.Empty();
+	}
+
+	if (this->StreamingPoolFrames > 0 && this->StreamingPoolFrames < BufferFrameCounter - 1)
+	{
+		InitSequenceStreaming(BufferFrameCounter);
+		return;
+	}
+
+	const int NumReduced = this->FrameCountSequences - BufferFrameCounter;
+	if (NumReduced == 0)
+	{
+		FrameRemap.Empty();
+		return;
+	}
+
+	this->AnimationBuffer->FrameRemapShift = NumReduced;
+	this->AnimationBuffer->ResizeBuffer((this->TotalFrameCount - NumReduced) * this->RenderBoneCount, BufferFrameCounter * this->RenderBoneCount);
+	this->TotalAnimationBufferSize = (this->TotalFrameCount - NumReduced) * this->RenderBoneCount * this->GetRenderMatrixSize() + FrameRemap.Num() * FrameRemap.GetTypeSize();
+
+	UE_LOG(LogAllegro, Log, TEXT("%s %d of %d sequence frames stored, the rest reuse a stored frame (FrameReductionTolerance:%fcm)"), *GetName(), BufferFrameCounter, this->FrameCountSequences, this->FrameReductionTolerance);
+}
+
+void UAllegroAnimCollection::InitSequenceStreaming(int NumStoredFrame)
+{
+	const TArray<uint32>& FrameRemap = this->AnimationBuffer->FrameRemap;
+	const SIZE_T FrameBytes = static_cast<SIZE_T>(this->RenderBoneCount) * GetRenderMatrixSize();
+	const uint8* BufferData = static_cast<const uint8*>(this->AnimationBuffer->Transforms->GetDataPointer());
+
+	//a sequence bigger than the pool could never be resident
+	int PoolFrames = this->StreamingPoolFrames;
+	for (const FAllegroSequenceDef& SequenceStruct : this->Sequences)
+		PoolFrames = FMath::Max(PoolFrames, SequenceStruct.StoredFrameCount);
+
+	//frame 0 (reference pose) stays in the buffer, its the fallback of non resident sequences
+	this->StreamingSource.SetNumUninitialized((NumStoredFrame - 1) * FrameBytes);
+	FMemory::Memcpy(this->StreamingSource.GetData(), BufferData + FrameBytes, this->StreamingSource.Num());
+	this->StreamingSourceData = this->StreamingSource.GetData();
+
+	this->StreamingSourceRemap.SetNumZeroed(this->FrameCountSequences);
+	for (const FAllegroSequenceDef& SequenceStruct : this->Sequences)
+	{
+		if (!SequenceStruct.Sequence)
+			continue;
+
+		for (int FrameIndex = SequenceStruct.AnimationFrameIndex; FrameIndex < SequenceStruct.AnimationFrameIndex + SequenceStruct.AnimationFrameCount; FrameIndex++)
+			this->StreamingSourceRemap[FrameIndex] = FrameRemap[FrameIndex] - 1;
+	}
+
+	InitStreamingStates(PoolFrames);
+
+	const int NumBufferFrame = 1 + PoolFrames + (this->TotalFrameCount - this->FrameCountSequences);
+	this->AnimationBuffer->ResizeBuffer(NumBufferFrame * this->RenderBoneCount, this->RenderBoneCount);
+	this->TotalAnimationBufferSize = NumBufferFrame * this->RenderBoneCount * this->GetRenderMatrixSize() + FrameRemap.Num() * FrameRemap.GetTypeSize();
+
+	UE_LOG(LogAllegro, Log, TEXT("%s sequence streaming, %d of %d stored frames can be resident. %d bytes in system memory"), *GetName(), PoolFrames, NumStoredFrame - 1, this->StreamingSource.Num());
+}
+
+void UAllegroAnimCollection::InitStreamingStates(int PoolFrames)
+{
+	this->StreamingStates.SetNum(this->Sequences.Num());
+	this->FrameToSequence.SetNumZeroed(this->FrameCountSequences);
+	for (int SequenceIndex = 0; SequenceIndex < this->Sequences.Num(); SequenceIndex++)
+	{
+		const FAllegroSequenceDef& SequenceStruct = this->Sequences[SequenceIndex];
+		if (!SequenceStruct.Sequence)
+			continue;
+
+		this->StreamingStates[SequenceIndex].SourceFrame = this->StreamingSourceRemap[SequenceStruct.AnimationFrameIndex];
+		for (int SeqFrameIndex = 0; SeqFrameIndex < SequenceStruct.AnimationFrameCount; SeqFrameIndex++)
+			this->FrameToSequence[SequenceStruct.AnimationFrameIndex + SeqFrameIndex] = static_cast<uint16>(SequenceIndex);
+	}
+
+	//nothing is resident until requested
+	TArray<uint32>& FrameRemap = this->AnimationBuffer->FrameRemap;
+	FrameRemap.Init(0, this->FrameCountSequences);
+	this->StreamingPageTable = FrameRemap;
+	this->StreamingPoolAllocator.Init(PoolFrames);
+
+	this->AnimationBuffer->bDynamicFrameRemap = true;
+	this->AnimationBuffer->FrameRemapShift = this->FrameCountSequences - 1 - PoolFrames;
+}
+
+void UAllegroAnimCollection::UpdateSequencePageTable(int SequenceIndex)
+{
+	const FAllegroSequenceDef& SequenceStruct = this->Sequences[SequenceIndex];
+	const FSequenceStreamingState& State = this->StreamingStates[SequenceIndex];
+	for (int SeqFrameIndex = 0; SeqFrameIndex < SequenceStruct.AnimationFrameCount; SeqFrameIndex++)
+	{
+		const int FrameIndex = SequenceStruct.AnimationFrameIndex + SeqFrameIndex;
+		this->StreamingPageTable[FrameIndex] = State.PoolOffset == -1 ? 0 : 1 + State.PoolOffset + this->StreamingSourceRemap[FrameIndex] - State.SourceFrame;
+	}
+
+	this->bStreamingPageTableDirty = true;
+}
+
+void UAllegroAnimCollection::EvictSequence(int SequenceIndex)
+{
+	FSequenceStreamingState& State = this->StreamingStates[SequenceIndex];
+	check(State.PoolOffset != -1);
+	this->StreamingPoolAllocator.Free(State.PoolOffset, this->Sequences[SequenceIndex].StoredFrameCount);
+	State.PoolOffset = -1;
+	this->ResidentSequences.RemoveSingleSwap(SequenceIndex, false);
+	UpdateSequencePageTable(SequenceIndex);
+
+	INC_DWORD_STAT(STAT_ALLEGRO_NumEvictedSequence);
+}
+
+void UAllegroAnimCollection::UpdateSequenceStreaming()
+{
+	check(IsInGameThread());
+
+	if (!IsSequenceStreamingEnabled())
+		return;
+
+	ALLEGRO_SCOPE_CYCLE_COUNTER(UAllegroAnimCollection_UpdateSequenceStreaming);
+
+	//components may tick less often than they are drawn, what they show must not be evicted in between
+	for (auto It = this->StreamingComponents.CreateIterator(); It; ++It)
+	{
+		const UAllegroComponent* Comp = It->Get();
+		if (!Comp || Comp->AnimCollection != this || !Comp->IsRegistered())
+		{
+			It.RemoveCurrent();
+			continue;
+		}
+
+		if (Comp->WasRecentlyRendered())
+		{
+			for (uint16 SequenceIndex : Comp->RequestedSequences)
+			{
+				if (this->StreamingStates.IsValidIndex(SequenceIndex))
+					RequestSequenceResidency(SequenceIndex);
+			}
+		}
+	}
+
+	const uint32 FrameCounter = static_cast<uint32>(GFrameCounter);
+	const SIZE_T FrameBytes = static_cast<SIZE_T>(this->RenderBoneCount) * GetRenderMatrixSize();
+	const int VectorsPerFrame = this->RenderBoneCount * this->AnimationBuffer->GetVectorsPerBone();
+
+	for (int SequenceIndex : this->PendingResidency)
+	{
+		FSequenceStreamingState& State = this->StreamingStates[SequenceIndex];
+		const int NumFrame = this->Sequences[SequenceIndex].StoredFrameCount;
+
+		int PoolOffset = this->StreamingPoolAllocator.Alloc(NumFrame);
+		while (PoolOffset == -1)
+		{
+			//least recently requested goes first. those requested in the previous frame are still used for motion vectors
+			int Victim = -1;
+			for (int ResidentIndex : this->ResidentSequences)
+			{
+				const uint32 LastRequest = this->StreamingStates[ResidentIndex].LastRequestFrame;
+				if (FrameCounter - LastRequest > 1 && (Victim == -1 || LastRequest < this->StreamingStates[Victim].LastRequestFrame))
+					Victim = ResidentIndex;
+			}
+
+			if (Victim == -1)
+				break;
+
+			EvictSequence(Victim);
+			PoolOffset = this->StreamingPoolAllocator.Alloc(NumFrame);
+		}
+
+		if (PoolOffset == -1)
+		{
+			if (!this->bStreamingPoolOverflowReported)
+			{
+				UE_LOG(LogAllegro, Warning, TEXT("%s: StreamingPoolFrames is too small for the sequences being played, some show the reference pose."), *GetName());
+				this->bStreamingPoolOverflowReported = true;
+			}
+			continue;
+		}
+
+		State.PoolOffset = PoolOffset;
+		this->ResidentSequences.Add(SequenceIndex);
+		UpdateSequencePageTable(SequenceIndex);
+		INC_DWORD_STAT(STAT_ALLEGRO_NumStreamedInSequence);
+
+		//uploaded as float4 like other poses, typed UAV takes care of half conversion
+		const int ScatterIdx = this->CurrentUpload.StreamScatterData.AddUninitialized(NumFrame);
+		for (int i = 0; i < NumFrame; i++)
+			this->CurrentUpload.StreamScatterData[ScatterIdx + i] = static_cast<uint32>(1 + PoolOffset + i);
+
+		const int NumVector = NumFrame * VectorsPerFrame;
+		FVector4f* Dst = &this->CurrentUpload.StreamPoseData[this->CurrentUpload.StreamPoseData.AddUninitialized(NumVector)];
+		const uint8* Src = this->StreamingSourceData + State.SourceFrame * FrameBytes;
+		if (this->bHighPrecision)
+		{
+			FMemory::Memcpy(Dst, Src, NumVector * sizeof(FVector4f));
+		}
+		else
+		{
+			for (int i = 0; i < NumVector; i++)
+				Dst[i] = FVector4f(FLinearColor(reinterpret_cast<const FFloat16Color*>(Src)[i]));
+		}
+	}
+
+	this->PendingResidency.Reset();
+
+	if (this->bStreamingPageTableDirty)
+	{
+		this->CurrentUpload.PageTable = this->StreamingPageTable;
+		this->bStreamingPageTableDirty = false;
+	}
+}
+
+void AllegroEncodeBone(EAllegroAnimBufferFormat Format, const FMatrix3x4& RenderMatrix, FVector4f* Out)
+{
+	if (Format == EAllegroAnimBufferFormat::Matrix3x4)
+	{
+		FMemory::Memcpy(Out, &RenderMatrix, sizeof(FMatrix3x4));
+		return;
+	}
+
+	//render matrix is transposed, back to row vector convention
+	FMatrix44f Mat = FMatrix44f::Identity;
+	for (int R = 0; R < 3; R++)
+		for (int C = 0; C < 4; C++)
+			Mat.M[C][R] = RenderMatrix.M[R][C];
+
+	const FTransform3f Transform(Mat);
+	FQuat4f Q = Transform.GetRotation();
+	Q.Normalize();
+	if (Q.W < 0) //keep W positive, helps dual quaternion blending
+		Q = FQuat4f(-Q.X, -Q.Y, -Q.Z, -Q.W);
+
+	const FVector3f T = Transform.GetTranslation();
+	Out[0] = FVector4f(Q.X, Q.Y, Q.Z, Q.W);
+
+	if (Format == EAllegroAnimBufferFormat::QuatTranslation)
+	{
+		const FVector3f S = Transform.GetScale3D();
+		Out[1] = FVector4f(T.X, T.Y, T.Z, (S.X + S.Y + S.Z) / 3.0f);
+	}
+	else
+	{
+		//dual part = 0.5 * T * Q
+		const FVector3f QV(Q.X, Q.Y, Q.Z);
+		const FVector3f DV = 0.5f * (Q.W * T + FVector3f::CrossProduct(T, QV));
+		Out[1] = FVector4f(DV.X, DV.Y, DV.Z, -0.5f * FVector3f::DotProduct(T, QV));
+	}
+}
+
+FMatrix3x4 AllegroDecodeBone(EAllegroAnimBufferFormat Format, const FVector4f* In)
+{
+	FMatrix3x4 Out;
+	if (Format == EAllegroAnimBufferFormat::Matrix3x4)
+	{
+		FMemory::Memcpy(&Out, In, sizeof(FMatrix3x4));
+		return Out;
+	}
+
+	FVector4f Q = In[0];
+	FVector3f T;
+	float S = 1;
+	const float QLen = FMath::Max(FMath::Sqrt(Q.X * Q.X + Q.Y * Q.Y + Q.Z * Q.Z + Q.W * Q.W), UE_SMALL_NUMBER);
+	Q /= QLen;
+
+	if (Format == EAllegroAnimBufferFormat::QuatTranslation)
+	{
+		T = FVector3f(In[1].X, In[1].Y, In[1].Z);
+		S = In[1].W;
+	}
+	else
+	{
+		const FVector4f D = In[1] / QLen;
+		const FVector3f QV(Q.X, Q.Y, Q.Z);
+		const FVector3f DV(D.X, D.Y, D.Z);
+		T = 2.0f * (Q.W * DV - D.W * QV + FVector3f::CrossProduct(QV, DV));
+	}
+
+	const float X = Q.X, Y = Q.Y, Z = Q.Z, W = Q.W;
+	Out.M[0][0] = (1 - 2 * (Y * Y + Z * Z)) * S;	Out.M[0][1] = 2 * (X * Y - W * Z) * S;			Out.M[0][2] = 2 * (X * Z + W * Y) * S;			Out.M[0][3] = T.X;
+	Out.M[1][0] = 2 * (X * Y + W * Z) * S;			Out.M[1][1] = (1 - 2 * (X * X + Z * Z)) * S;	Out.M[1][2] = 2 * (Y * Z - W * X) * S;			Out.M[1][3] = T.Y;
+	Out.M[2][0] = 2 * (X * Z - W * Y) * S;			Out.M[2][1] = 2 * (Y * Z + W * X) * S;			Out.M[2][2] = (1 - 2 * (X * X + Y * Y)) * S;	Out.M[2][3] = T.Z;
+	return Out;
 }
 // 
 // void UAllegroAnimCollection::CalcRenderMatrices(const TArrayView<FTransform> PoseComponentSpace, FMatrix44f* OutMatrices) const
@@ -1508,7 +2247,7 @@ void UAllegroAnimCollection::CalcRenderMatrices(const TArrayView<FTransform> Pos
 
 uint32 UAllegroAnimCollection::GetRenderMatrixSize() const
 {
-	return bHighPrecision ? sizeof(FMatrix3x4) : sizeof(FMatrix3x4Half);
+	return AllegroAnimBufferVectorsPerBone(AnimationBufferFormat) * (bHighPrecision ? sizeof(FVector4f) : sizeof(FFloat16Color));
 }
 
 void UAllegroAnimCollection::EnqueueReleaseResources()
@@ -1538,6 +2277,98 @@ FString UAllegroAnimCollection::GetDDCKeyFoMeshBoneIndex(const FAllegroMeshDef&
 
 	return FDerivedDataCacheInterface::BuildCacheKey(TEXT("ALLEGRO"), TEXT("4"), SBuilder.GetData());
 }
+
+FString UAllegroAnimCollection::CalcSequenceBakeContextHash() const
+{
+	auto AppendAsset = [](TStringBuilder<2048>& SB, const UObject* Asset) {
+		if (Asset)
+			SB.Appendf(TEXT("_%s_%s"), *Asset->GetPathName(), *LexToString(Asset->GetPackage()->GetSavedHash()));
+		else
+			SB.Append(TEXT("_None"));
+	};
+	auto ArrayHash = [](const auto& Array) {
+		return FFnv::MemFnv32(Array.GetData(), Array.Num() * Array.GetTypeSize());
+	};
+
+	TStringBuilder<2048> SBuilder;
+	AppendAsset(SBuilder, this->Skeleton);
+	if (this->Skeleton)
+		SBuilder.Appendf(TEXT("_%s"), *this->Skeleton->GetGuid().ToString());
+	AppendAsset(SBuilder, this->RefPoseOverrideMesh);
+	SBuilder.Appendf(TEXT("_%u_%u_%u_%u"), ArrayHash(this->RenderRequiredBones), ArrayHash(this->BonesToCache_Indices), ArrayHash(this->RefPoseInverse), ArrayHash(this->BakeErrorProbes));
+	SBuilder.Appendf(TEXT("_%d_%d_%d_%d_%d_%f"), (int)this->AnimationBufferFormat, this->bHighPrecision, this->bExtractRootMotion, this->bDisableRetargeting, this->bDontGenerateBounds, this->FrameReductionTolerance);
+
+	for (int MeshDefIndex = 0; MeshDefIndex < this->Meshes.Num(); MeshDefIndex++)
+	{
+		const FAllegroMeshDef& MeshDef = this->Meshes[MeshDefIndex];
+		SBuilder.Appendf(TEXT("_M%d_%d_%s"), MeshDefIndex, MeshDef.OwningBoundMeshIndex, *MeshDef.BoundExtent.ToString());
+		AppendAsset(SBuilder, MeshDef.Mesh);
+		if (MeshDef.Mesh)
+		{
+			SBuilder.Appendf(TEXT("_%s"), *MeshDef.Mesh->GetBounds().ToString());
+			AppendAsset(SBuilder, MeshDef.Mesh->GetPhysicsAsset());
+		}
+	}
+
+	return FSHA1::HashBuffer(SBuilder.GetData(), SBuilder.Len() * sizeof(TCHAR)).ToString();
+}
+
+FString UAllegroAnimCollection::GetDDCKeyForSequence(int SequenceIndex) const
+{
+	const FAllegroSequenceDef& SequenceStruct = this->Sequences[SequenceIndex];
+	const UAnimSequenceBase* AnimSequence = SequenceStruct.Sequence;
+
+	TStringBuilder<800> SBuilder;
+	SBuilder.Appendf(TEXT("_%s_%s_%s_%d_%d"), *this->SequenceBakeContextHash, *AnimSequence->GetPathName(), *LexToString(AnimSequence->GetPackage()->GetSavedHash()), SequenceStruct.SampleFrequency, SequenceStruct.AnimationFrameCount);
+	if (const UAnimSequence* AsSequence = Cast<UAnimSequence>(AnimSequence))
+		SBuilder.Appendf(TEXT("_%s"), *AsSequence->GetDataModelInterface()->GenerateGuid().ToString());
+
+	return FDerivedDataCacheInterface::BuildCacheKey(TEXT("ALLEGRO_SEQ"), TEXT("2"), SBuilder.GetData());
+}
+
+bool UAllegroAnimCollection::SerializeSequenceBake(FArchive& Ar, int SequenceIndex, TArrayView<FBoxMinMaxFloat> MaxBounds)
+{
+	FAllegroSequenceDef& SequenceStruct = this->Sequences[SequenceIndex];
+	const int FrameStart = SequenceStruct.AnimationFrameIndex;
+	const int FrameCount = SequenceStruct.AnimationFrameCount;
+
+	//header, must match what we are about to fill
+	int Header[] = { FrameCount, this->RenderBoneCount, this->BonesToCache_Indices.Num(), this->Meshes.Num(), (int)GetRenderMatrixSize() };
+	for (int& Value : Header)
+	{
+		int Stored = Value;
+		Ar << Stored;
+		if (Ar.IsError() || Stored != Value)
+			return false;
+	}
+
+	Ar << SequenceStruct.BakeError;
+	Ar << SequenceStruct.StoredFrameCount;
+	Ar << SequenceStruct.StoredFrameRemap;
+	if (Ar.IsError() || SequenceStruct.StoredFrameCount <= 0 || SequenceStruct.StoredFrameCount > FrameCount || SequenceStruct.StoredFrameRemap.Num() != FrameCount)
+		return false;
+
+	for (int MeshDefIndex = 0; MeshDefIndex < this->Meshes.Num(); MeshDefIndex++)
+	{
+		FAllegroMeshDef& MeshDef = this->Meshes[MeshDefIndex];
+		Ar << MaxBounds[MeshDefIndex].GetMin();
+		Ar << MaxBounds[MeshDefIndex].GetMax();
+		if (MeshDef.OwningBounds.Num())
+			Ar.Serialize(&MeshDef.OwningBounds[FrameStart], FrameCount * MeshDef.OwningBounds.GetTypeSize());
+	}
+
+	if (this->BonesToCache_Indices.Num())
+	{
+		const int NumCached = this->BonesToCache_Indices.Num();
+		Ar.Serialize(&this->CachedTransforms[FrameStart * NumCached], FrameCount * NumCached * this->CachedTransforms.GetTypeSize());
+	}
+
+	const SIZE_T FrameBytes = (SIZE_T)this->RenderBoneCount * GetRenderMatrixSize();
+	uint8* BufferData = (uint8*)this->AnimationBuffer->Transforms->GetDataPointer();
+	Ar.Serialize(BufferData + FrameStart * FrameBytes, SequenceStruct.StoredFrameCount * FrameBytes);
+
+	return !Ar.IsError();
+}
 #endif
 
 int UAllegroAnimCollection::CalcFrameIndex(const FAllegroSequenceDef& SequenceStruct, float SequencePlayTime) const
@@ -1588,24 +2419,29 @@ void UAllegroAnimCollection::RemoveAllUnusedTransitions()
 
 
 
+int UAllegroAnimCollection::FindTransition(const FTransitionKey& Key) const
+{
+	const uint32 KeyHash = Key.GetKeyHash();
+	for (uint32 TransitionIndex = this->TransitionsHashTable.First(KeyHash); this->TransitionsHashTable.IsValid(TransitionIndex); TransitionIndex = this->TransitionsHashTable.Next(TransitionIndex))
+	{
+		if (this->Transitions[TransitionIndex].KeysEqual(Key))
+			return static_cast<int>(TransitionIndex);
+	}
+	return -1;
+}
+
 TPair<int, UAllegroAnimCollection::ETransitionResult> UAllegroAnimCollection::FindOrCreateTransition(const FTransitionKey& Key, bool bIgonreTransitionGeneration)
 {
 	check(IsInGameThread());
 
 	ALLEGRO_SCOPE_CYCLE_COUNTER(UAllegroAnimCollection_FindOrCreateTransition);
 
-	const uint32 KeyHash = Key.GetKeyHash();
-	
-	for (uint32 TransitionIndex = this->TransitionsHashTable.First(KeyHash); this->TransitionsHashTable.IsValid(TransitionIndex); TransitionIndex = this->TransitionsHashTable.Next(TransitionIndex))
+	const int ExistingIndex = FindTransition(Key);
+	if (ExistingIndex != -1)
 	{
-		FTransition& Trn = this->Transitions[TransitionIndex];
-		if (Trn.KeysEqual(Key))
-		{
-			IncTransitionRef(TransitionIndex);
-			return { TransitionIndex, ETR_Success_Found };
-		}
+		IncTransitionRef(static_cast<AllegroTransitionIndex>(ExistingIndex));
+		return { ExistingIndex, ETR_Success_Found };
 	}
-	
 
 
 	//developer settings with console variable was not loading properly so we use CDO instead of CVar
@@ -1647,14 +2483,19 @@ TPair<int, UAllegroAnimCollection::ETransitionResult> UAllegroAnimCollection::Fi
 	FTransition& NewTransition = Transitions[NewTransitionIndex];
 	static_cast<FTransitionKey&>(NewTransition) = Key;
 	NewTransition.BlockOffset = BlockOffset;
-	NewTransition.FrameIndex = this->FrameCountSequences + BlockOffset;
+	NewTransition.FrameIndex = this->GetRuntimeTransitionBaseFrameIndex() + BlockOffset;
 
 	//push it for concurrent end of frame generation
 	//#Note CachedTransforms of the transitions contain invalid value
 	NewTransition.DeferredIndex = this->DeferredTransitions.Add(NewTransitionIndex);
 	this->DeferredTransitions_FrameCount += Key.FrameCount;
 
-	this->TransitionsHashTable.Add(KeyHash, NewTransitionIndex);
+	this->TransitionsHashTable.Add(Key.GetKeyHash(), NewTransitionIndex);
+
+#if WITH_EDITORONLY_DATA
+	if (GAllegro_RecordTransitions)
+		this->RecordedTransitions.Add(Key);
+#endif
 
 	return { NewTransitionIndex, ETR_Success_NewlyCreated };
 }
@@ -1664,8 +2505,11 @@ void UAllegroAnimCollection::IncTransitionRef(AllegroTransitionIndex TransitionI
 	check(IsInGameThread());
 	FTransition& T = this->Transitions[TransitionIndex];
 
-	if (T.RefCount > 0)
+	if (T.RefCount > 0 || T.bPrebaked)
 	{
+		if (T.bPrebaked)
+			INC_DWORD_STAT(STAT_ALLEGRO_NumPrebakedTransitionUsed);
+
 		T.RefCount++;
 	}
 	else
@@ -1688,7 +2532,7 @@ void UAllegroAnimCollection::DecTransitionRef(AllegroTransitionIndex& Transition
 	FTransition& T = this->Transitions[TransitionIndex];
 	check(T.RefCount > 0)
 	T.RefCount--;
-	if(T.RefCount == 0)
+	if(T.RefCount == 0 && !T.bPrebaked) //prebaked transitions are never released
 	{
 		T.StateIndex = this->ZeroRCTransitions.Add(TransitionIndex);
 	}
@@ -1711,23 +2555,15 @@ void UAllegroAnimCollection::ReleasePendingTransitions()
 
 }
 
-void UAllegroAnimCollection::GenerateTransition_Concurrent(uint32 TransitionIndex, uint32 ScatterIdx)
+void UAllegroAnimCollection::GenerateTransitionPoses(const FTransitionKey& Key, int FrameIndex, FMatrix3x4* OutMatrices)
 {
-	const FTransition& Trs = this->Transitions[TransitionIndex];
-	const FAllegroSequenceDef& SequenceStructFrom = this->Sequences[Trs.FromSI];
-	const FAllegroSequenceDef& SequenceStructTo = this->Sequences[Trs.ToSI];
+	const FAllegroSequenceDef& SequenceStructFrom = this->Sequences[Key.FromSI];
+	const FAllegroSequenceDef& SequenceStructTo = this->Sequences[Key.ToSI];
 
-	const int TransitionFrameCount = Trs.FrameCount;
+	const int TransitionFrameCount = Key.FrameCount;
 	const double TransitionFrameTime = 1.0f / SequenceStructTo.SampleFrequency;
 	const double FrameTime = 1.0f / SequenceStructFrom.SampleFrequency;
 
-	INC_DWORD_STAT_BY(STAT_ALLEGRO_NumTransitionPoseGenerated, TransitionFrameCount);
-
-	for (int i = 0; i < TransitionFrameCount; i++)
-		this->CurrentUpload.ScatterData[ScatterIdx + i] = static_cast<uint32>(Trs.FrameIndex + i);
-
-	FMatrix3x4* UploadMatrices = &this->CurrentUpload.PoseData[ScatterIdx * this->RenderBoneCount];
-
 	FMemMark MemMarker(FMemStack::Get());
 
 	FCompactPose CompactPoseFrom, CompactPoseTo;
@@ -1741,8 +2577,8 @@ void UAllegroAnimCollection::GenerateTransition_Concurrent(uint32 TransitionInde
 	FAnimationPoseData PoseDataTo(CompactPoseTo, InCurve, InAttributes);
 
 	{
-		const double SampleStartTimeA = Trs.FromFI * FrameTime;
-		const double SampleStartTimeB = Trs.ToFI * TransitionFrameTime;
+		const double SampleStartTimeA = Key.FromFI * FrameTime;
+		const double SampleStartTimeB = Key.ToFI * TransitionFrameTime;
 
 		TransformArrayAnimStack PoseComponentSpace;
 		PoseComponentSpace.SetNumUninitialized(this->AnimationBoneContainer.GetCompactPoseNumBones());
@@ -1755,11 +2591,11 @@ void UAllegroAnimCollection::GenerateTransition_Concurrent(uint32 TransitionInde
 			
 			const float TransitionAlpha = (TransitionFrameIndex + 1) / static_cast<float>(TransitionFrameCount + 1);
 			check(TransitionAlpha != 0 && TransitionAlpha != 1); //not having any blend is waste
-			const float FinalAlpha = FAlphaBlend::AlphaToBlendOption(TransitionAlpha, Trs.BlendOption);
-			const int TransitionPoseIndex = Trs.FrameIndex + TransitionFrameIndex;
+			const float FinalAlpha = FAlphaBlend::AlphaToBlendOption(TransitionAlpha, Key.BlendOption);
+			const int TransitionPoseIndex = FrameIndex + TransitionFrameIndex;
 
-			SequenceStructFrom.Sequence->GetAnimationPose(PoseDataFrom, FAnimExtractContext(SampleTimeA, this->bExtractRootMotion,{}, Trs.bFromLoops));
-			SequenceStructTo.Sequence->GetAnimationPose(PoseDataTo, FAnimExtractContext(SampleTimeB, this->bExtractRootMotion, {}, Trs.bToLoops));
+			SequenceStructFrom.Sequence->GetAnimationPose(PoseDataFrom, FAnimExtractContext(SampleTimeA, this->bExtractRootMotion,{}, Key.bFromLoops));
+			SequenceStructTo.Sequence->GetAnimationPose(PoseDataTo, FAnimExtractContext(SampleTimeB, this->bExtractRootMotion, {}, Key.bToLoops));
 
 			for (int TransformIndex = 0; TransformIndex < CompactPoseFrom.GetNumBones(); TransformIndex++)
 			{
@@ -1768,11 +2604,176 @@ void UAllegroAnimCollection::GenerateTransition_Concurrent(uint32 TransitionInde
 
 			Utils::LocalPoseToComponent(CompactPoseFrom, PoseComponentSpace.GetData());
 			CachePoseBones(TransitionPoseIndex, PoseComponentSpace);
-			CalcRenderMatrices(PoseComponentSpace, UploadMatrices + (TransitionFrameIndex * this->RenderBoneCount));
+			CalcRenderMatrices(PoseComponentSpace, OutMatrices + (TransitionFrameIndex * this->RenderBoneCount));
 		}
 	}
 }
 
+void UAllegroAnimCollection::GenerateTransition_Concurrent(uint32 TransitionIndex, uint32 ScatterIdx)
+{
+	const FTransition& Trs = this->Transitions[TransitionIndex];
+
+	INC_DWORD_STAT_BY(STAT_ALLEGRO_NumTransitionPoseGenerated, Trs.FrameCount);
+
+	for (int i = 0; i < Trs.FrameCount; i++)
+		this->CurrentUpload.ScatterData[ScatterIdx + i] = static_cast<uint32>(Trs.FrameIndex + i);
+
+	GenerateTransitionPoses(Trs, Trs.FrameIndex, &this->CurrentUpload.PoseData[ScatterIdx * this->RenderBoneCount]);
+}
+
+int UAllegroAnimCollection::GetTransitionImpostorFrameIndex(const FTransitionKey& Key, int TransitionFrameIndex) const
+{
+	//same alpha and sample times as GenerateTransitionPoses
+	const float TransitionAlpha = (TransitionFrameIndex + 1) / static_cast<float>(Key.FrameCount + 1);
+	const bool bTo = FAlphaBlend::AlphaToBlendOption(TransitionAlpha, Key.BlendOption) >= 0.5f;
+
+	const FAllegroSequenceDef& SequenceStructTo = this->Sequences[Key.ToSI];
+	const FAllegroSequenceDef& SequenceStruct = bTo ? SequenceStructTo : this->Sequences[Key.FromSI];
+	const int LocalFrameIndex = bTo ? Key.ToFI + TransitionFrameIndex
+		: Key.FromFI + static_cast<int>(TransitionFrameIndex * SequenceStruct.SampleFrequencyFloat / SequenceStructTo.SampleFrequencyFloat);
+
+	const int FrameCount = FMath::Max(SequenceStruct.AnimationFrameCount, 1);
+	const bool bLoops = bTo ? Key.bToLoops : Key.bFromLoops;
+	return SequenceStruct.AnimationFrameIndex + (bLoops ? LocalFrameIndex % FrameCount : FMath::Min(LocalFrameIndex, FrameCount - 1));
+}
+
+void UAllegroAnimCollection::InitImpostorFrames()
+{
+	//runtime transitions are filled when they get generated, dynamic poses have no sequence frame and show the reference pose
+	TArray<uint32>& ImpostorFrames = this->AnimationBuffer->ImpostorFrames;
+	ImpostorFrames.Init(0, this->NumPrebakedTransitionFrame + this->MaxTransitionPose);
+	this->AnimationBuffer->ImpostorFrameBase = this->FrameCountSequences;
+
+	for (const FTransition& T : this->Transitions)
+	{
+		if (!T.bPrebaked)
+			continue;
+
+		for (int TransitionFrameIndex = 0; TransitionFrameIndex < T.FrameCount; TransitionFrameIndex++)
+			ImpostorFrames[T.FrameIndex - this->FrameCountSequences + TransitionFrameIndex] = GetTransitionImpostorFrameIndex(T, TransitionFrameIndex);
+	}
+}
+
+void UAllegroAnimCollection::InitPrebakedTransitions()
+{
+	this->NumPrebakedTransitionFrame = this->NumPrebakedTransition = 0;
+	check(this->Transitions.Num() == 0);
+
+#if ALLEGRO_GPU_TRANSITION
+	//GPU transitions blend in the vertex shader and never look up the transition table, nothing is baked and no frames are reserved
+	if (this->PrebakedTransitions.Num())
+	{
+		UE_LOG(LogAllegro, Warning, TEXT("%s: %d prebaked transitions are ignored, GPU transitions are enabled (ALLEGRO_GPU_TRANSITION)."), *GetName(), this->PrebakedTransitions.Num());
+	}
+	return;
+#endif
+
+	bool bTableFull = false;
+	for (const FAllegroTransitionBakeDef& Def : this->PrebakedTransitions)
+	{
+		if (bTableFull)
+			break;
+
+		const int FromSI = FindSequenceDef(Def.From);
+		const int ToSI = FindSequenceDef(Def.To);
+		if (FromSI == INDEX_NONE || ToSI == INDEX_NONE || !Def.From || !Def.To)
+		{
+			UE_LOG(LogAllegro, Warning, TEXT("%s: prebaked transition %s -> %s skipped, both sequences must be in Sequences."), *GetName(), *GetNameSafe(Def.From), *GetNameSafe(Def.To));
+			continue;
+		}
+
+		const FAllegroSequenceDef& FromSeq = this->Sequences[FromSI];
+		const FAllegroSequenceDef& ToSeq = this->Sequences[ToSI];
+
+		//must match the key UAllegroComponent generates for the same play request
+		FTransitionKey Key;
+		Key.FromSI = static_cast<uint16>(FromSI);
+		Key.ToSI = static_cast<uint16>(ToSI);
+		Key.ToFI = static_cast<int>(Def.ToStartAt * ToSeq.SampleFrequencyFloat);
+		Key.BlendOption = Def.BlendOption;
+		Key.bFromLoops = Def.bFromLoops;
+		Key.bToLoops = Def.bToLoops;
+
+		const int FrameCount = FMath::Min(static_cast<int>(ToSeq.SampleFrequency * Def.Duration), ToSeq.AnimationFrameCount - Key.ToFI);
+		if (FrameCount < 3 || FrameCount > 0xFFff)
+		{
+			UE_LOG(LogAllegro, Warning, TEXT("%s: prebaked transition %s -> %s skipped, invalid Duration or ToStartAt."), *GetName(), *GetNameSafe(Def.From), *GetNameSafe(Def.To));
+			continue;
+		}
+		Key.FrameCount = static_cast<uint16>(FrameCount);
+
+		const int FromBegin = Def.FromFrame < 0 ? 0 : Def.FromFrame;
+		const int FromEnd = Def.FromFrame < 0 ? FromSeq.AnimationFrameCount : FMath::Min(Def.FromFrame + 1, FromSeq.AnimationFrameCount);
+		const int FromStride = Def.FromFrame < 0 ? FMath::Max(1, Def.FromFrameStride) : 1;
+
+		for (int FromFI = FromBegin; FromFI < FromEnd; FromFI += FromStride)
+		{
+			Key.FromFI = FromFI;
+			if (FindTransition(Key) != -1)
+				continue;
+
+			if (this->Transitions.Num() >= 0xFFff / 2) //leave room for runtime transitions, transition index is uint16
+			{
+				UE_LOG(LogAllegro, Warning, TEXT("%s: too many prebaked transitions, the rest are ignored."), *GetName());
+				bTableFull = true;
+				break;
+			}
+
+			const uint32 NewTransitionIndex = this->Transitions.Add(FTransition{});
+			check(NewTransitionIndex == this->NumPrebakedTransition);
+			FTransition& NewTransition = this->Transitions[NewTransitionIndex];
+			static_cast<FTransitionKey&>(NewTransition) = Key;
+			NewTransition.RefCount = 0;
+			NewTransition.bPrebaked = true;
+			NewTransition.FrameIndex = this->FrameCountSequences + this->NumPrebakedTransitionFrame;
+			this->TransitionsHashTable.Add(Key.GetKeyHash(), NewTransitionIndex);
+
+			this->NumPrebakedTransitionFrame += FrameCount;
+			this->NumPrebakedTransition++;
+		}
+	}
+
+	//same sizing as InitSkeletonData now that the number of prebaked transitions is known, entries are hashed again
+	if (this->NumPrebakedTransition > 0)
+	{
+		const int MaxNumTransition = FMath::Min(0xFFff, this->MaxTransitionPose / 3 + this->NumPrebakedTransition);
+		this->TransitionsHashTable.Clear(FMath::RoundUpToPowerOfTwo(FMath::Max(64, MaxNumTransition / 2)));
+		for (int TransitionIndex = 0; TransitionIndex < this->Transitions.Num(); TransitionIndex++)
+			this->TransitionsHashTable.Add(this->Transitions[TransitionIndex].GetKeyHash(), TransitionIndex);
+	}
+}
+
+void UAllegroAnimCollection::BuildPrebakedTransitions()
+{
+	if (this->NumPrebakedTransition == 0)
+		return;
+
+	const double StartTime = FPlatformTime::Seconds();
+	float MaxError = 0;
+	FCriticalSection ErrorLock;
+
+	ParallelFor(this->NumPrebakedTransition, [&](int TransitionIndex) {
+		FMemMark MemMarker(FMemStack::Get());
+
+		const FTransition& Trs = this->Transitions[TransitionIndex];
+		check(Trs.bPrebaked);
+
+		TArray<FMatrix3x4, TMemStackAllocator<>> RenderMatrices;
+		RenderMatrices.SetNumUninitialized(Trs.FrameCount * this->RenderBoneCount);
+		GenerateTransitionPoses(Trs, Trs.FrameIndex, RenderMatrices.GetData());
+
+		float Error = 0;
+		for (int i = 0; i < Trs.FrameCount; i++)
+			Error = FMath::Max(Error, WriteRenderMatrices(this->AnimationBuffer->GetBufferFrameIndex(Trs.FrameIndex + i), &RenderMatrices[i * this->RenderBoneCount]));
+
+		FScopeLock Lock(&ErrorLock);
+		MaxError = FMath::Max(MaxError, Error);
+
+	}, GGenerateSingleThread ? EParallelForFlags::ForceSingleThread : EParallelForFlags::None);
+
+	UE_LOG(LogAllegro, Log, TEXT("%s %d prebaked transitions (%d frames) generated in %f seconds, MaxError:%fcm"), *GetName(), this->NumPrebakedTransition, this->NumPrebakedTransitionFrame, FPlatformTime::Seconds() - StartTime, MaxError);
+}
+
 void UAllegroAnimCollection::FlushDeferredTransitions()
 {
 	check(IsInGameThread());
@@ -1791,6 +2792,12 @@ void UAllegroAnimCollection::FlushDeferredTransitions()
 			T.DeferredIndex = -1;
 			ScatterIndices[i] = ScatterIdx;
 			ScatterIdx += T.FrameCount;
+
+			for (int TransitionFrameIndex = 0; TransitionFrameIndex < T.FrameCount; TransitionFrameIndex++)
+			{
+				this->CurrentUpload.ImpostorFrameData.Add(static_cast<uint32>(T.FrameIndex + TransitionFrameIndex));
+				this->CurrentUpload.ImpostorFrameData.Add(static_cast<uint32>(GetTransitionImpostorFrameIndex(T, TransitionFrameIndex)));
+			}
 		}
 
 		ParallelFor(DeferredTransitions.Num(), [this, ScatterIndices](int Index) {
@@ -1811,10 +2818,34 @@ void UAllegroAnimCollection::ApplyScatterBufferRT(FRHICommandList& RHICmdList, c
 	{
 		ALLEGRO_SCOPE_CYCLE_COUNTER(UAllegroAnimCollection_ApplyScatterBufferRT);
 
-		const uint32 MatrixSize = sizeof(FMatrix3x4);
-		const uint32 PoseSizeBytes = this->RenderBoneCount * MatrixSize;
-		this->ScatterBuffer.Init(UploadData.ScatterData, PoseSizeBytes, true, TEXT("AnimCollectionScatter"));
-		FMemory::Memcpy(this->ScatterBuffer.UploadData, UploadData.PoseData.GetData(), UploadData.PoseData.Num() * MatrixSize);
+		//poses are always uploaded as float4, typed UAV takes care of half conversion
+		const EAllegroAnimBufferFormat Format = this->AnimationBuffer->Format;
+		const uint32 VectorsPerBone = AllegroAnimBufferVectorsPerBone(Format);
+		const uint32 PoseSizeBytes = this->RenderBoneCount * VectorsPerBone * sizeof(FVector4f);
+		if (this->AnimationBuffer->FrameRemapShift)
+		{
+			//uploads are never sequence frames, they only need the shift
+			TArray<uint32> BufferFrameIndices;
+			BufferFrameIndices.SetNumUninitialized(UploadData.ScatterData.Num());
+			for (int i = 0; i < UploadData.ScatterData.Num(); i++)
+				BufferFrameIndices[i] = this->AnimationBuffer->GetBufferFrameIndex(UploadData.ScatterData[i]);
+
+			this->ScatterBuffer.Init(BufferFrameIndices, PoseSizeBytes, true, TEXT("AnimCollectionScatter"));
+		}
+		else
+		{
+			this->ScatterBuffer.Init(UploadData.ScatterData, PoseSizeBytes, true, TEXT("AnimCollectionScatter"));
+		}
+		if (Format == EAllegroAnimBufferFormat::Matrix3x4)
+		{
+			FMemory::Memcpy(this->ScatterBuffer.UploadData, UploadData.PoseData.GetData(), UploadData.PoseData.Num() * sizeof(FMatrix3x4));
+		}
+		else
+		{
+			FVector4f* Dst = reinterpret_cast<FVector4f*>(this->ScatterBuffer.UploadData);
+			for (int i = 0; i < UploadData.PoseData.Num(); i++)
+				AllegroEncodeBone(Format, UploadData.PoseData[i], Dst + i * VectorsPerBone);
+		}
 
 		FRWBuffer buffData;
 		buffData.Buffer = this->AnimationBuffer->Buffer;
@@ -1822,6 +2853,35 @@ void UAllegroAnimCollection::ApplyScatterBufferRT(FRHICommandList& RHICmdList, c
 		buffData.UAV = this->AnimationBuffer->UAV;
 		this->ScatterBuffer.ResourceUploadTo(RHICmdList, buffData);
 	}
+
+	//streamed in sequences, scatter indices are already frame indices in the buffer
+	if (UploadData.StreamScatterData.Num())
+	{
+		ALLEGRO_SCOPE_CYCLE_COUNTER(UAllegroAnimCollection_ApplyStreamingRT);
+
+		const uint32 PoseSizeBytes = this->RenderBoneCount * this->AnimationBuffer->GetVectorsPerBone() * sizeof(FVector4f);
+		this->ScatterBuffer.Init(UploadData.StreamScatterData, PoseSizeBytes, true, TEXT("AnimCollectionStreaming"));
+		FMemory::Memcpy(this->ScatterBuffer.UploadData, UploadData.StreamPoseData.GetData(), UploadData.StreamPoseData.Num() * sizeof(FVector4f));
+
+		FRWBuffer buffData;
+		buffData.Buffer = this->AnimationBuffer->Buffer;
+		buffData.SRV = this->AnimationBuffer->ShaderResourceViewRHI;
+		buffData.UAV = this->AnimationBuffer->UAV;
+		this->ScatterBuffer.ResourceUploadTo(RHICmdList, buffData);
+	}
+
+	if (UploadData.ImpostorFrameData.Num())
+		this->AnimationBuffer->SetImpostorFrames(RHICmdList, UploadData.ImpostorFrameData);
+
+	if (UploadData.PageTable.Num() && this->AnimationBuffer->FrameRemapBuffer)
+	{
+		check(UploadData.PageTable.Num() == this->AnimationBuffer->FrameRemap.Num());
+		this->AnimationBuffer->FrameRemap = UploadData.PageTable;
+		const uint32 SizeBytes = UploadData.PageTable.Num() * sizeof(uint32);
+		void* Dst = RHICmdList.LockBuffer(this->AnimationBuffer->FrameRemapBuffer, 0, SizeBytes, RLM_WriteOnly);
+		FMemory::Memcpy(Dst, UploadData.PageTable.GetData(), SizeBytes);
+		RHICmdList.UnlockBuffer(this->AnimationBuffer->FrameRemapBuffer);
+	}
 }
 
 
@@ -1882,6 +2942,18 @@ void FAllegroMeshDef::SerializeCooked(FArchive& Ar)
 	}
 }
 
+FAllegroTransitionBakeDef::FAllegroTransitionBakeDef()
+{
+	From = To = nullptr;
+	Duration = 0.2f;
+	ToStartAt = 0;
+	BlendOption = EAlphaBlendOption::Linear;
+	bFromLoops = true;
+	bToLoops = true;
+	FromFrame = -1;
+	FromFrameStride = 1;
+}
+
 FAllegroSequenceDef::FAllegroSequenceDef()
 {
 	Sequence = nullptr;
@@ -1889,7 +2961,9 @@ FAllegroSequenceDef::FAllegroSequenceDef()
 	SampleFrequencyFloat = 30;
 	AnimationFrameIndex = 0;
 	AnimationFrameCount = 0;
+	StoredFrameCount = 0;
 	SequenceLength = 0;
+	BakeError = 0;
 }
 
 int FAllegroSequenceDef::CalcFrameIndex(float time) const
@@ -2135,8 +3209,9 @@ int FAllegroCompactPhysicsAsset::Raycast(const UAllegroAnimCollection* AnimColle
 void UAllegroAnimCollection::OnPreSendAllEndOfFrameUpdates(UWorld* World)
 {
 	FlushDeferredTransitions();
+	UpdateSequenceStreaming();
 
-	if (this->CurrentUpload.ScatterData.Num())
+	if (this->CurrentUpload.ScatterData.Num() || this->CurrentUpload.StreamScatterData.Num() || this->CurrentUpload.PageTable.Num())
 	{
 		ENQUEUE_RENDER_COMMAND(ScatterUpdate)([this, UploadData = MoveTemp(CurrentUpload)](FRHICommandListImmediate& RHICmdList) {
 			
@@ -9,6 +9,7 @@
 #include "Materials/MaterialRenderProxy.h"
 #include "Async/ParallelFor.h"
 #include "Allegro.h"
+#include "AllegroGPUCull.h"
 
 
 
@@ -52,6 +53,12 @@ struct alignas(16) FAllegroMeshGeneratorBase
 		P.W = (P.GetOrigin() - Offset) | P.GetNormal();
 	}
 
+	static float GetLODRadiusScale()
+	{
+		static const auto* SkeletalMeshLODRadiusScale = IConsoleManager::Get().FindTConsoleVariableDataFloat(TEXT("r.SkeletalMeshLODRadiusScale"));
+		return FMath::Clamp(SkeletalMeshLODRadiusScale->GetValueOnRenderThread(), 0.25f, 1.0f);
+	}
+
 
 	//////////////////////////////////////////////////////////////////////////
 	struct FIndexCollector
@@ -325,6 +332,20 @@ struct alignas(16) FAllegroMeshGeneratorBase
 		DefaultConstructItems<T>(addr, Count);
 		return (T*)addr;
 	}
+	//returns @Frustum moved by @Offset, allocated from the stack if it needs a copy
+	const FConvexVolume* StackOffsetFrustum(const FConvexVolume* Frustum, const FVector& Offset)
+	{
+		if (Offset.IsZero())
+			return Frustum;
+
+		auto NewPlanes = Frustum->Planes;
+		for (FPlane& P : NewPlanes)
+			P.W = (P.GetOrigin() + Offset) | P.GetNormal();
+
+		//regenerate Permuted planes
+		uint8* FrustumMem = this->StackAlloc(sizeof(FConvexVolume), alignof(FConvexVolume));
+		return new (FrustumMem) FConvexVolume(NewPlanes);
+	}
 #pragma endregion
 
 
@@ -350,10 +371,16 @@ struct alignas(16) FAllegroMeshGeneratorBase
 	uint32* VisibleInstances = nullptr;	//instance index of visible instances
 	uint32* Distances = nullptr; //distance of instances (float is treated as uint32 for faster comparison)
 
-	TArray<uint8>* VisibleInstanceLODLevel = nullptr;
+	uint8** VisibleInstanceLODLevel = nullptr;	//per LOD mesh, LOD of each visible instance. allocated from the mempool
+	int8 CulledHasStencil = -1;	//result of SecondCull, applied to the proxy by UploadData since culling may run on a worker thread
 
 	uint32 NumVisibleInstance = 0;
-	bool Use32BitElementIndex() const { return NumVisibleInstance >= 0xFFFF; }
+	bool bGPUCulled = false;	//true if culling and LOD selection are done by AllegroCull.usf, element indices are always uint32 then
+	FAllegroShadowSharedData* ShadowShared = nullptr;	//non null if shadow buffers and LODs are shared with other shadow views of the frame
+	FAllegroShadowSharedData::FLODView* ShadowLODView = nullptr;	//LODs of the main view owning this shadow view
+	uint32 SharedInstanceCount = 0;	//non zero if element indices are rows of the shared shadow buffers
+	uint32 PersistentInstanceCount = 0;	//non zero if element indices are instance indices to the persistent buffers of the proxy, see FAllegroGPUInstanceStore
+	bool Use32BitElementIndex() const { return bGPUCulled || FMath::Max3(NumVisibleInstance, SharedInstanceCount, PersistentInstanceCount) >= 0xFFFF; }
 	auto GetElementIndexSize() const { return Use32BitElementIndex() ? 4u : 2u; }
 
 	uint32 TotalElementCount = 0;	//
@@ -380,15 +407,33 @@ struct alignas(16) FAllegroMeshGeneratorBase
 	FAllegroElementIndexBufferPtr ElementIndexBuffer;
 	FAllegroBlendFrameBufferPtr BlendFrameBuffer;
 
+#if ALLEGRO_GPU_CULL
+	FAllegroGPUCullOutputPtr GPUCullOutput;
+	FAllegroGPUCullView GPUCullView;
+	TArray<FAllegroGPUCullSubMesh, SceneRenderingAllocator> GPUCullSubMeshes;
+	TArray<FAllegroGPUCullDraw, SceneRenderingAllocator> GPUCullDraws;
+
+	//turns @BatchElement to an indirect draw, its instance count is written by BuildArgsCS
+	void SetupGPUCullDraw(FMeshBatchElement& BatchElement, uint32 Bucket)
+	{
+		check(static_cast<uint32>(GPUCullDraws.Num()) < GPUCullOutput->DrawCapacity);
+
+		FAllegroGPUCullDraw& Draw = GPUCullDraws.AddDefaulted_GetRef();
+		Draw.Bucket = Bucket;
+		Draw.IndexCount = BatchElement.NumPrimitives * 3;
+		Draw.StartIndex = BatchElement.FirstIndex;
+		Draw.BaseVertex = 0;
+
+		BatchElement.IndirectArgsBuffer = GPUCullOutput->IndirectArgsBuffer;
+		BatchElement.IndirectArgsOffset = (GPUCullDraws.Num() - 1) * ALLEGRO_GPU_CULL_ARGS_STRIDE;
+		BatchElement.NumPrimitives = 0;
+	}
+#endif
+
 	static const uint32 DISTANCING_NUM_FLOAT_PER_REG = 4;
 
 	virtual ~FAllegroMeshGeneratorBase()
 	{
-		if (this->VisibleInstanceLODLevel)
-		{
-			delete[] this->VisibleInstanceLODLevel;
-			this->VisibleInstanceLODLevel = nullptr;
-		}
 	}
 };
 
@@ -426,13 +471,24 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 
 	void DoGenerate()
 	{
-		GenerateData();
+		CullData();
+		FinishGenerate();
+	}
+	//everything after CullData, touches RHI resources and the collector so it must run on the calling thread
+	void FinishGenerate()
+	{
+		UploadData();
 
 		if (this->TotalElementCount == 0)
 			return;
 
 		GenerateBatches();
 
+#if ALLEGRO_GPU_CULL
+		if (this->bGPUCulled)
+			AllegroDispatchGPUCullArgs(FRHICommandListImmediate::Get(), *this->GPUCullOutput, this->GPUCullDraws);
+#endif
+
 #if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
 		if (GAllegro_DrawInstanceBounds && !bShaddowCollector)
 		{
@@ -452,12 +508,12 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 	void RenderInstanceBound(uint32 InstanceIndex) const
 	{
 		check(InstanceIndex < static_cast<int>(Proxy->DynamicData->InstanceCount));
-		const FMatrix InstanceMatrix = FMatrix(Proxy->DynamicData->Transforms[InstanceIndex]);
+		const FMatrix InstanceMatrix = FMatrix(Proxy->DynamicData->Transforms[InstanceIndex]).ConcatTranslation(FVector(Proxy->RenderOrigin));
 		FPrimitiveDrawInterface* PDI = Collector->GetPDI(ViewIndex);
 		const ESceneDepthPriorityGroup DrawBoundsDPG = SDPG_World;
 		uint16 InstanceAnimationFrameIndex = Proxy->DynamicData->FrameIndices[InstanceIndex];
 		const FBoxCenterExtentFloat& InstanceBound = Proxy->DynamicData->Bounds[InstanceIndex];
-		DrawWireBox(PDI, FBox(InstanceBound.GetFBox()), FLinearColor::Green, DrawBoundsDPG);
+		DrawWireBox(PDI, FBox(InstanceBound.GetFBox()).ShiftBy(FVector(Proxy->RenderOrigin)), FLinearColor::Green, DrawBoundsDPG);
 		//draw axis
 		{
 			FVector AxisLoc = InstanceMatrix.GetOrigin();
@@ -488,6 +544,18 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 	//////////////////////////////////////////////////////////////////////////
 	void DrawCellBounds()
 	{
+		if (this->Proxy->DynamicData->bUseCullGrid)
+		{
+			FPrimitiveDrawInterface* PDI = Collector->GetPDI(ViewIndex);
+			const TArray<FAllegroCullGrid::FCell>& GridCells = this->Proxy->CullGrid.GetCells();
+			for (int32 CellIndex = 0; CellIndex < GridCells.Num(); CellIndex++)
+			{
+				if (GridCells[CellIndex].Instances.Num())
+					DrawWireBox(PDI, FBox(GridCells[CellIndex].Bound.ToBox()).ShiftBy(FVector(this->Proxy->RenderOrigin)), FColor::MakeRandomSeededColor(CellIndex), SDPG_World, 3);
+			}
+			return;
+		}
+
 		for (uint32 CellIndex = 0; CellIndex < this->Proxy->DynamicData->NumCells; CellIndex++)
 		{
 			const FAllegroDynamicData::FCell& Cell = this->Proxy->DynamicData->Cells[CellIndex];
@@ -496,11 +564,11 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 
 			FPrimitiveDrawInterface* PDI = Collector->GetPDI(ViewIndex);
 			FColor Color = FColor::MakeRandomSeededColor(CellIndex);
-			DrawWireBox(PDI, FBox(Cell.Bound.ToBox()), Color, SDPG_World, 3);
+			DrawWireBox(PDI, FBox(Cell.Bound.ToBox()).ShiftBy(FVector(this->Proxy->RenderOrigin)), Color, SDPG_World, 3);
 			if(0)
 			{
 				Cell.ForEachInstance(*this->Proxy->DynamicData, [&](uint32 InstanceIndex) {
-					FVector3f Center = this->Proxy->DynamicData->Bounds[InstanceIndex].Center;
+					FVector3f Center = this->Proxy->DynamicData->Bounds[InstanceIndex].Center + this->Proxy->RenderOrigin;
 					PDI->DrawPoint(FVector(Center), Color, 8, SDPG_World);
 				});
 			}
@@ -516,8 +584,30 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 		UniformParams.InstanceOffset = InstanceOffset;						//LODData.InstanceOffset;
 		UniformParams.InstanceEndOffset = InstanceOffset + NumInstance - 1; //LODData.InstanceOffset + LODData.NumInstance - 1;
 		UniformParams.NumCustomDataFloats = 0;
+		UniformParams.RenderOrigin = this->Proxy->RenderOrigin;
 
 		UniformParams.AnimationBuffer = (this->Proxy->AminCollection) ? (this->Proxy->AminCollection->AnimationBuffer->ShaderResourceViewRHI): GNullVertexBuffer.VertexBufferSRV;
+		UniformParams.AnimationBufferFormat = (this->Proxy->AminCollection) ? static_cast<uint32>(this->Proxy->AminCollection->AnimationBuffer->Format) : 0;
+		UniformParams.FrameRemap = GNullVertexBuffer.VertexBufferSRV;
+		UniformParams.FrameRemapCount = UniformParams.FrameRemapShift = 0;
+		if (this->Proxy->AminCollection && this->Proxy->AminCollection->AnimationBuffer->FrameRemapSRV)
+		{
+			UniformParams.FrameRemap = this->Proxy->AminCollection->AnimationBuffer->FrameRemapSRV;
+			UniformParams.FrameRemapCount = this->Proxy->AminCollection->AnimationBuffer->FrameRemap.Num();
+			UniformParams.FrameRemapShift = this->Proxy->AminCollection->AnimationBuffer->FrameRemapShift;
+		}
+		UniformParams.ImpostorFrames = GNullVertexBuffer.VertexBufferSRV;
+		UniformParams.ImpostorFrameBase = UniformParams.ImpostorFrameCount = 0;
+		if (this->Proxy->AminCollection)
+		{
+			const FAllegroAnimationBuffer* AnimBuffer = this->Proxy->AminCollection->AnimationBuffer.Get();
+			UniformParams.ImpostorFrameBase = AnimBuffer->ImpostorFrameBase;
+			if (AnimBuffer->ImpostorFrameSRV)
+			{
+				UniformParams.ImpostorFrames = AnimBuffer->ImpostorFrameSRV;
+				UniformParams.ImpostorFrameCount = AnimBuffer->ImpostorFrames.Num();
+			}
+		}
 		UniformParams.Instance_CustomData = GNullVertexBuffer.VertexBufferSRV;//#TODO proper SRV ?
 		
 		if (this->CIDBuffer) //do we have any per instance custom data 
@@ -529,6 +619,11 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 		UniformParams.Instance_Transforms = this->InstanceBuffer->TransformSRV;
 		UniformParams.Instance_AnimationFrameIndices = this->InstanceBuffer->FrameIndexSRV;
 
+#if ALLEGRO_GPU_CULL
+		if (this->bGPUCulled)
+			UniformParams.ElementIndices = this->GPUCullOutput->ElementIndexSRV;
+		else
+#endif
 		UniformParams.ElementIndices = this->Use32BitElementIndex() ? this->ElementIndexBuffer->ElementIndexUIN32SRV : this->ElementIndexBuffer->ElementIndexUIN16SRV;
 
 		UniformParams.Instance_BlendFrameIndex = InstanceBuffer->BlendFrameIndexmSRV;
@@ -542,6 +637,50 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 
 	}
 	//////////////////////////////////////////////////////////////////////////
+	//used by static sub meshes and impostors of skeletal ones
+	FMeshBatch& AllocateStaticMeshBatch(const FStaticMeshLODResources& StaticMeshLODData, uint32 SubMeshIndex, uint32 LODIndex, uint32 SectionIndex,
+		FAllegroBatchElementOFR* BatchUserData, int32 NumInstances)
+	{
+		FMeshBatch& Mesh = this->Collector->AllocateMesh();
+		Mesh.ReverseCulling = false;//IsLocalToWorldDeterminantNegative();
+		Mesh.Type = PT_TriangleList;
+		Mesh.DepthPriorityGroup = this->Proxy->GetDepthPriorityGroup(this->View);
+		Mesh.bCanApplyViewModeOverrides = true;
+		Mesh.bSelectable = false;
+		Mesh.bUseForMaterial = true;
+		Mesh.bUseSelectionOutline = false;
+		Mesh.LODIndex = static_cast<int8>(LODIndex);	//?
+		Mesh.SegmentIndex = static_cast<uint8>(SectionIndex);
+		//its useless, MeshIdInPrimitive is set by Collector->AddMesh()
+		//Mesh.MeshIdInPrimitive = static_cast<uint16>(LODIndex); //static_cast<uint16>((LODIndex << 8) | SectionIndex);
+
+#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+		Mesh.VisualizeLODIndex = static_cast<int8>(LODIndex);
+#endif
+		Mesh.VertexFactory = BatchUserData->VertexFactory;
+
+		FMeshBatchElement& BatchElement = Mesh.Elements[0];
+		BatchElement.UserData = BatchUserData;
+
+#if ALLEGRO_USE_GPU_SCENE
+
+#else
+		BatchElement.PrimitiveIdMode = PrimID_ForceZero;
+#endif
+
+		BatchElement.IndexBuffer = &StaticMeshLODData.IndexBuffer;
+		BatchElement.UserIndex = 0;
+		//BatchElement.PrimitiveUniformBufferResource = &PrimitiveUniformBuffer->UniformBuffer; //&GIdentityPrimitiveUniformBuffer; 
+		BatchElement.PrimitiveUniformBuffer = this->Proxy->GetUniformBuffer();
+
+		BatchElement.NumInstances = NumInstances; // this->SubMeshes_Data[SubMeshIndex].LODs[LODIndex].NumInstance;
+#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+		BatchElement.VisualizeElementIndex = static_cast<int32>(SectionIndex);
+#endif
+
+		return Mesh;
+	}
+	//////////////////////////////////////////////////////////////////////////
 	FMeshBatch& AllocateMeshBatch(const FSkeletalMeshLODRenderData& SkelLODData, uint32 SubMeshIndex, uint32 LODIndex, uint32 SectionIndex, 
 		FAllegroBatchElementOFR* BatchUserData, int32 NumInstances)
 	{
@@ -598,7 +737,35 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 			const FAllegroDynamicData* DynData = this->Proxy->DynamicData;
 			uint32* VisibleInstancesIter = this->VisibleInstances;
 
-			if(DynData->NumCells > 0 && !GAllegro_DisableFrustumCull)
+			if (DynData->bUseCullGrid && this->Proxy->CullGrid.IsValid() && !GAllegro_DisableFrustumCull)
+			{
+				//occlusion results are for the main view, shadow casters behind an occluder may still cast visible shadows
+				const FAllegroOcclusion::FViewResults* Occlusion = bShaddowCollector ? nullptr : this->Proxy->Occlusion.FindResults(View);
+
+				//blocks and cells of the persistent grid, cells only contain binnable instances
+				this->Proxy->CullGrid.ForEachVisibleCell(*EditedViewFrustum, [&](int32 CellIndex, const FAllegroCullGrid::FCell& Cell, bool bFullyInside) {
+					if (Occlusion && Occlusion->IsOccluded(CellIndex, Cell.Bound))
+					{
+						INC_DWORD_STAT(STAT_ALLEGRO_NumOcclusionCulledCell);
+						return;
+					}
+
+					if (bFullyInside)
+					{
+						FMemory::Memcpy(VisibleInstancesIter, Cell.Instances.GetData(), sizeof(uint32) * Cell.Instances.Num());
+						VisibleInstancesIter += Cell.Instances.Num();
+						return;
+					}
+
+					for (uint32 InstanceIndex : Cell.Instances)
+					{
+						const FBoxCenterExtentFloat& IB = DynData->Bounds[InstanceIndex];
+						if (EditedViewFrustum->IntersectBox(FVector(IB.Center), FVector(IB.Extent)))
+							*VisibleInstancesIter++ = InstanceIndex;
+					}
+				});
+			}
+			else if(DynData->NumCells > 0 && !GAllegro_DisableFrustumCull)
 			{
 				//cells intersection with frustum
 				for (uint32 CellIndex = 0; CellIndex < DynData->NumCells; CellIndex++)
@@ -667,24 +834,15 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 
 			if (this->NumSubMesh > 0)
 			{
-				if (this->VisibleInstanceLODLevel)
-				{
-					delete[] this->VisibleInstanceLODLevel;
-					this->VisibleInstanceLODLevel = nullptr;
-				}
-
 				uint32 NumLodMesh = 1;
 
 #if ALLEGRO_LOD_PRE_SUBMESH
 				NumLodMesh = this->NumSubMesh;
 #endif
 
-				this->VisibleInstanceLODLevel = new TArray<uint8>[NumLodMesh];
+				this->VisibleInstanceLODLevel = MempoolAlloc<uint8*>(sizeof(uint8*) * NumLodMesh, alignof(uint8*));
 				for (uint32 i = 0; i < NumLodMesh; ++i)
-				{
-					this->VisibleInstanceLODLevel[i].Reset(this->NumVisibleInstance);
-					this->VisibleInstanceLODLevel[i].AddUninitialized(this->NumVisibleInstance);
-				}
+					this->VisibleInstanceLODLevel[i] = MempoolAlloc<uint8>(this->NumVisibleInstance, 1);
 
 				this->UpdateLODLevel(NumLodMesh);
 
@@ -758,7 +916,7 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 #endif
 
 		{
-			if (NumVisibleInstance > 0xFFff)
+			if (Use32BitElementIndex())
 				SecondCull<uint32>();
 			else
 				SecondCull<uint16>();
@@ -767,33 +925,59 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 	}
 
 	
-	void UpdateLODLevelImpl(TArray<FProxyMeshDataBase*>& MDArray, TArray<uint8>* OutLodArray, int NumCalc)
+	void UpdateLODLevelImpl(TArray<FProxyMeshDataBase*>& MDArray, uint8** OutLodArray, int NumCalc)
 	{
 		const FAllegroDynamicData* DynData = this->Proxy->DynamicData;
-		static const auto* SkeletalMeshLODRadiusScale = IConsoleManager::Get().FindTConsoleVariableDataFloat(TEXT("r.SkeletalMeshLODRadiusScale"));
-		float LODScale = FMath::Clamp(SkeletalMeshLODRadiusScale->GetValueOnRenderThread(), 0.25f, 1.0f);
+		float LODScale = GetLODRadiusScale();
 		 
 		//const int32 CurrentLODLevel = 0;
 		//const float HysteresisOffset = 0.f;
 
 		uint32* VisInstance = this->VisibleInstances; 
-		const FSceneView* V = this->View;
 		const uint8* InstancesMeshSlots = this->Proxy->DynamicData->MeshSlots;
 		uint32 MaxMeshPerInst = this->MaxMeshPerInstance;
 		float CullScreenSize = GAllegro_CullScreenSize;
 		uint32 NumMesh = this->NumSubMesh;
+
+		FVector4 LODViewOrigin = this->View->ViewMatrices.GetViewOrigin();
+		FMatrix LODProjMatrix = this->View->ViewMatrices.GetProjectionMatrix();
+		bool bLODShowFlag = this->View->Family && 1 == this->View->Family->EngineShowFlags.LOD;
+		uint8* SharedLODs = nullptr;
+		if (this->ShadowShared)
+		{
+			check(this->ShadowShared->NumLODMesh == NumCalc);
+			LODViewOrigin = this->ShadowLODView->View->ViewMatrices.GetViewOrigin();
+			LODProjMatrix = this->ShadowLODView->View->ViewMatrices.GetProjectionMatrix();
+			bLODShowFlag = this->ShadowShared->bLODShowFlag;
+			SharedLODs = this->ShadowLODView->InstanceLODs.GetData();
+		}
+		LODViewOrigin -= FVector4(FVector(this->Proxy->RenderOrigin), 0);
+
+		//per visible instance, largest screen radius squared of its meshes (float bits)
+		uint32* ScreenSizes = UseLODBudget() && bLODShowFlag ? MempoolAlloc<uint32>(NumVisibleInstance * sizeof(uint32)) : nullptr;
 		
-		ParallelFor(TEXT("ParallelForLODLevel"), NumVisibleInstance, 400, [VisInstance, DynData, V, 
+		ParallelFor(TEXT("ParallelForLODLevel"), NumVisibleInstance, 400, [VisInstance, DynData, LODViewOrigin, LODProjMatrix, bLODShowFlag, SharedLODs, ScreenSizes,
 			LODScale, MDArray, OutLodArray, InstancesMeshSlots, MaxMeshPerInst, CullScreenSize, NumMesh, NumCalc](int i) {
 
+			//already decided by another shadow view of this frame
+			uint8* InstanceSharedLODs = SharedLODs ? SharedLODs + VisInstance[i] * NumCalc : nullptr;
+			if (InstanceSharedLODs && InstanceSharedLODs[0] != FAllegroShadowSharedData::LOD_UNKNOWN)
+			{
+				for (int SubIdx = 0; SubIdx < NumCalc; ++SubIdx)
+					OutLodArray[SubIdx][i] = InstanceSharedLODs[SubIdx];
+				return;
+			}
+
+			float InstanceScreenRadiusSquared = 0;
+
 			for (int SubIdx = 0; SubIdx < NumCalc; ++SubIdx)
 			{
-				TArray<uint8>& OutLod = OutLodArray[SubIdx];
+				uint8* OutLod = OutLodArray[SubIdx];
 				FProxyMeshDataBase* MD = MDArray[SubIdx];
 
 				OutLod[i] = 0xff; //default is cull
 
-				const uint8* MeshSlotIter = InstancesMeshSlots + i * (MaxMeshPerInst + 1);
+				const uint8* MeshSlotIter = InstancesMeshSlots + VisInstance[i] * (MaxMeshPerInst + 1);
 				for (uint32 n = 0; n < (MaxMeshPerInst + 1); ++n)
 				{
 					uint8 SubMeshIdx = *MeshSlotIter++;
@@ -817,14 +1001,15 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 					SphereRadius *= MD->ExtentFactor;
 #endif
 
-					float ScreenRadiusSquared = ComputeBoundsScreenRadiusSquared(Origin, SphereRadius, *(V)) * LODScale * LODScale;
+					float ScreenRadiusSquared = ComputeBoundsScreenRadiusSquared(Origin, SphereRadius, LODViewOrigin, LODProjMatrix) * LODScale * LODScale;
+					InstanceScreenRadiusSquared = FMath::Max(InstanceScreenRadiusSquared, ScreenRadiusSquared);
 					if (CullScreenSize > ScreenRadiusSquared)
 					{
 						OutLod[i] = 0xff;
 					}
 					else
 					{
-						if (V->Family && 1 == V->Family->EngineShowFlags.LOD)
+						if (bLODShowFlag)
 						{
 							// Iterate from worst to best LOD
 							for (int32 LODLevel = MD->LodNum - 1; LODLevel > 0; LODLevel--)
@@ -845,6 +1030,10 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 									break;
 								}
 							}
+
+							//past the last skeletal LOD, draw the impostor
+							if (MD->ImpostorLOD != 0xFF && FMath::Square(MD->ImpostorScreenSize * 0.5f) > ScreenRadiusSquared)
+								NewLODLevel = MD->ImpostorLOD;
 						}
 						OutLod[i] = NewLODLevel;
 					}
@@ -852,9 +1041,158 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 				}
 			}
 
+			if (InstanceSharedLODs)
+			{
+				for (int SubIdx = 0; SubIdx < NumCalc; ++SubIdx)
+					InstanceSharedLODs[SubIdx] = OutLodArray[SubIdx][i];
+			}
+
+			if (ScreenSizes)
+				ScreenSizes[i] = *reinterpret_cast<const uint32*>(&InstanceScreenRadiusSquared);
 		});
 
-		
+		if (ScreenSizes)
+			ApplyLODBudget(MDArray, OutLodArray, NumCalc, ScreenSizes);
+	}
+
+	//main pass views only, shadow LODs follow their own bias and are shared across cascades
+	bool UseLODBudget() const
+	{
+		return !bShaddowCollector && (GAllegro_TriangleBudget > 0 || GAllegro_VertexBudget > 0) && GAllegro_ForceLOD < 0;
+	}
+
+	/*
+	* lower LODs until the proxy's share of allegro.TriangleBudget / allegro.VertexBudget is met.
+	* all instances are lowered by Step - 1 and the ones smaller on screen than Threshold by Step, so the farthest instances degrade first.
+	* Step and Threshold are kept in the proxy per view, a new threshold close to the previous one is ignored and a step is held allegro.LODBudgetStepHoldFrames before lowering it to avoid popping.
+	*/
+	void ApplyLODBudget(const TArray<FProxyMeshDataBase*>& MDArray, uint8** LodArray, int NumCalc, uint32* ScreenSizes)
+	{
+		ALLEGRO_SCOPE_CYCLE_COUNTER(LODBudget);
+
+		const uint32 NumVis = this->NumVisibleInstance;
+
+		auto AddCost = [&](uint32 VisIndex, uint32 Step, FAllegroLODBudgetCost& Cost)
+		{
+			for (int SubIdx = 0; SubIdx < NumCalc; ++SubIdx)
+			{
+				const uint8 LOD = LodArray[SubIdx][VisIndex];
+				if (LOD == 0xff)
+					continue;
+
+				//impostors are past LodNum and never lowered
+				const FProxyMeshDataBase* MD = MDArray[SubIdx];
+				const FProxyLODData& LODData = MD->LODs[LOD >= MD->LodNum ? LOD : FMath::Min<uint32>(LOD + Step, MD->LodNum - 1)];
+				Cost.Triangles += LODData.SectionsNumTriangle;
+				Cost.Vertices += LODData.SectionsNumVertices;
+			}
+		};
+		auto TotalCost = [&](uint32 Step)
+		{
+			FAllegroLODBudgetCost Cost;
+			for (uint32 VisIndex = 0; VisIndex < NumVis; VisIndex++)
+				AddCost(VisIndex, Step, Cost);
+			return Cost;
+		};
+
+		const FAllegroLODBudgetCost Demand = TotalCost(0);
+		const FAllegroLODBudgetCost Budget = AllegroGetLODBudget(this->View, GFrameNumberRenderThread, Demand);
+
+		uint32 MaxStep = 0;
+		for (int SubIdx = 0; SubIdx < NumCalc; ++SubIdx)
+			MaxStep = FMath::Max<uint32>(MaxStep, MDArray[SubIdx]->LodNum - 1);
+
+		//smallest step that fits, instances are then moved back from Step to Step - 1 starting from the biggest ones
+		uint32 Step = 0;
+		FAllegroLODBudgetCost Cost = Demand;
+		FAllegroLODBudgetCost PrevStepCost = Demand;
+		while (!Cost.Fits(Budget) && Step < MaxStep)
+		{
+			PrevStepCost = Cost;
+			Step++;
+			Cost = TotalCost(Step);
+		}
+
+		const uint32 FrameNumber = GFrameNumberRenderThread;
+		const FAllegroLODBudgetState::FViewState PrevState = this->Proxy->LODBudgetState.Get(this->View);
+		const uint32 HeldStep = FMath::Min(PrevState.Step, MaxStep);
+		if (Step < HeldStep && FrameNumber - PrevState.StepFrameNumber < static_cast<uint32>(FMath::Max(GAllegro_LODBudgetStepHoldFrames, 0)))
+		{
+			Step = HeldStep;
+			PrevStepCost = TotalCost(Step - 1);
+		}
+
+		FAllegroLODBudgetState::FViewState NewState;
+		NewState.Step = Step;
+		NewState.StepFrameNumber = Step == PrevState.Step ? PrevState.StepFrameNumber : FrameNumber;
+		NewState.FrameNumber = FrameNumber;
+
+		if (Step == 0)
+		{
+			this->Proxy->LODBudgetState.Set(this->View, NewState);
+			return;
+		}
+
+		uint32* Order = MempoolAlloc<uint32>(NumVis * sizeof(uint32));
+		uint32* SortedOrder = MempoolAlloc<uint32>(NumVis * sizeof(uint32));
+		uint32* SortedSizes = MempoolAlloc<uint32>(NumVis * sizeof(uint32));
+		for (uint32 VisIndex = 0; VisIndex < NumVis; VisIndex++)
+			Order[VisIndex] = VisIndex;
+
+		//ascending, smallest on screen first. @ScreenSizes is used as scratch
+		AllegroRadixSort32(SortedOrder, Order, SortedSizes, ScreenSizes, NumVis);
+
+		//lower the smallest instances to Step until the rest fits at Step - 1
+		uint32 NumLowered = NumVis;
+		FAllegroLODBudgetCost Remaining = PrevStepCost;
+		for (uint32 SortedIndex = 0; SortedIndex < NumVis; SortedIndex++)
+		{
+			if (Remaining.Fits(Budget))
+			{
+				NumLowered = SortedIndex;
+				break;
+			}
+
+			FAllegroLODBudgetCost Before, After;
+			AddCost(SortedOrder[SortedIndex], Step - 1, Before);
+			AddCost(SortedOrder[SortedIndex], Step, After);
+			Remaining.Triangles -= Before.Triangles - After.Triangles;
+			Remaining.Vertices -= Before.Vertices - After.Vertices;
+		}
+
+		uint32 Threshold = NumLowered < NumVis ? SortedSizes[NumLowered] : ~0u;
+
+		const uint32 PrevThreshold = PrevState.Threshold;
+		if (PrevState.Step == Step && Threshold != ~0u && PrevThreshold != ~0u)
+		{
+			const float H = FMath::Square(1 + FMath::Max(GAllegro_LODBudgetHysteresis, 0.0f));
+			const float Cur = *reinterpret_cast<const float*>(&Threshold);
+			const float Prev = *reinterpret_cast<const float*>(&PrevThreshold);
+			if (Cur <= Prev * H && Cur * H >= Prev)
+				Threshold = PrevThreshold;
+		}
+
+		NewState.Threshold = Threshold;
+		this->Proxy->LODBudgetState.Set(this->View, NewState);
+
+		uint32 NumChanged = 0;
+		for (uint32 SortedIndex = 0; SortedIndex < NumVis; SortedIndex++)
+		{
+			const uint32 Bias = SortedSizes[SortedIndex] < Threshold ? Step : Step - 1;
+			if (Bias == 0)
+				break;	//sorted, the rest is bigger
+
+			const uint32 VisIndex = SortedOrder[SortedIndex];
+			for (int SubIdx = 0; SubIdx < NumCalc; ++SubIdx)
+			{
+				uint8& LOD = LodArray[SubIdx][VisIndex];
+				if (LOD < MDArray[SubIdx]->LodNum)
+					LOD = static_cast<uint8>(FMath::Min<uint32>(LOD + Bias, MDArray[SubIdx]->LodNum - 1));
+			}
+			NumChanged++;
+		}
+
+		INC_DWORD_STAT_BY(STAT_ALLEGRO_NumBudgetLoweredLOD, NumChanged);
 	}
 
 
@@ -1004,16 +1342,17 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 						continue;
 				}
 #endif
-				if (bShaddowCollector)
+				if (bShaddowCollector && GAllegro_ShadowMergeSubMeshes)
 				{
-					//##TODO optimize. in shadow pass sub meshes with same skeletal mesh can be merge if materials have same VS (default vertex shader)
-					//SubMeshIdx = this->ShadowSubmeshRemap[SubMeshIdx];
+					//sub meshes with same mesh and default depth materials are drawn by one batch. see FAllegroProxy::InitShadowSubMeshRemap
+					SubMeshIdx = this->Proxy->ShadowSubMeshRemap[SubMeshIdx];
 				}
 
 				FLODData& LODData = this->SubMeshes_Data[SubMeshIdx].LODs[CurLod];
 				if (bShaddowCollector)
 				{
-					LODData.template AddElem<TVisIndex>(*this, static_cast<TVisIndex>(VisIndex),-1);
+					const uint32 ElementValue = this->ShadowShared ? this->ShadowShared->GetSlot(InstanceIndex) : VisIndex;
+					LODData.template AddElem<TVisIndex>(*this, static_cast<TVisIndex>(ElementValue), -1);
 				}
 				else
 				{
@@ -1022,7 +1361,8 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 #else
 					int16 Stencil = -1;
 #endif
-					LODData.template AddElem<TVisIndex>(*this, static_cast<TVisIndex>(VisIndex), Stencil);
+					const uint32 ElementValue = this->PersistentInstanceCount ? InstanceIndex : VisIndex;
+					LODData.template AddElem<TVisIndex>(*this, static_cast<TVisIndex>(ElementValue), Stencil);
 				}
 				
 			}
@@ -1030,14 +1370,6 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 		}
 		
 
-#if ALLEGRO_USE_LOD_SCREEN_SIZE
-		if (this->VisibleInstanceLODLevel)
-		{
-			delete[] this->VisibleInstanceLODLevel;
-			this->VisibleInstanceLODLevel = nullptr;
-		}
-#endif
-
 		//assign offsets and count total
 		{
 			this->TotalElementCount = 0;
@@ -1085,34 +1417,14 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 			}
 			check(this->TotalBatch <= this->Proxy->MaxBatchCountPossible);
 #endif
-			if (!bShaddowCollector)
-			{
-				this->Proxy->SetHasStencil(bHasStencil);
-			}
+			this->CulledHasStencil = bHasStencil ? 1 : 0;
 		}
 	}
 	//////////////////////////////////////////////////////////////////////////
 	void FillBuffers()
 	{
 		const FAllegroDynamicData* DynamicData = this->Proxy->DynamicData;
-		const FAllegroDynamicData* OldDynamicData = this->Proxy->OldDynamicData;
-
-		if (OldDynamicData && !GAllegro_DebugForceNoPrevFrameData)
-		{
-			const int CFN = GFrameNumberRenderThread;
-			if ((CFN - OldDynamicData->CreationNumber) == 1)	//must belong to the previous frame exactly
-			{
-
-			}
-			else
-			{
-				OldDynamicData = DynamicData;
-			}
-		}
-		else
-		{
-			OldDynamicData = DynamicData;
-		}
+		const FAllegroDynamicData* OldDynamicData = this->Proxy->GetPrevFrameDynamicData();
 
 		//EIF_New means instance just added this frame, so it doesn't have previous frame data
 		check((int)EAllegroInstanceFlags::EIF_New == 2);
@@ -1140,51 +1452,28 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 			{
 				uint32 InstanceIndex = this->VisibleInstances[VisIdx];
 				check(InstanceIndex < DynamicData->InstanceCount);
+				const uint32 DstIdx = VisIdx;
 
 				const FAllegroDynamicData* PrevFrameDynamicData = PrevDynamicDataLUT[static_cast<uint16>(DynamicData->Flags[InstanceIndex] & EAllegroInstanceFlags::EIF_New)];
 				check(InstanceIndex < PrevFrameDynamicData->InstanceCount);
 
 				//converts from Matrix4x4f
-				DstInstanceTransform[VisIdx * 2 + 0] = DynamicData->Transforms[InstanceIndex];
-				DstInstanceTransform[VisIdx * 2 + 1] = PrevFrameDynamicData->Transforms[InstanceIndex];
+				DstInstanceTransform[DstIdx * 2 + 0] = DynamicData->Transforms[InstanceIndex];
+				DstInstanceTransform[DstIdx * 2 + 1] = PrevFrameDynamicData->Transforms[InstanceIndex];
 
-				DstPackedFrameIndex[VisIdx * 2 + 0] = OverrideAnimFrameIndex(DynamicData->FrameIndices[InstanceIndex]);
-				DstPackedFrameIndex[VisIdx * 2 + 1] = OverrideAnimFrameIndex(PrevFrameDynamicData->FrameIndices[InstanceIndex]);
+				DstPackedFrameIndex[DstIdx * 2 + 0] = OverrideAnimFrameIndex(DynamicData->FrameIndices[InstanceIndex]);
+				DstPackedFrameIndex[DstIdx * 2 + 1] = OverrideAnimFrameIndex(PrevFrameDynamicData->FrameIndices[InstanceIndex]);
 
-				//#TODO optimize
-				for (uint32 FloatIndex = 0; FloatIndex < NumCustomDataFloats; FloatIndex++)
-				{
-					DstCustomDatas[VisIdx * NumCustomDataFloats + FloatIndex] = DynamicData->CustomData[InstanceIndex * NumCustomDataFloats + FloatIndex];
-				}
-
-				DstBlendFrameIndices[VisIdx * 2] = DynamicData->BlendFrameInfoIndex[InstanceIndex];
-				DstBlendFrameIndices[VisIdx * 2 + 1] = PrevFrameDynamicData->BlendFrameInfoIndex[InstanceIndex];
+				DstBlendFrameIndices[DstIdx * 2] = DynamicData->BlendFrameInfoIndex[InstanceIndex];
+				DstBlendFrameIndices[DstIdx * 2 + 1] = PrevFrameDynamicData->BlendFrameInfoIndex[InstanceIndex];
 			}
 
+			if (NumCustomDataFloats)
+				CopyCustomData(DstCustomDatas, DynamicData, this->VisibleInstances, NumVisibleInstance, NumCustomDataFloats);
+
 			if (BlendFrameBuffer)
 			{
-				const FAllegroDynamicData* PrevFrameDynamicData = OldDynamicData;
-				int DataSize = 2 * Proxy->NumBlendFramePerInstance - 1;
-
-				FInstanceBlendFrameInfo nullInfo;
-				nullInfo.Weight[0] = 1;
-				nullInfo.Weight[1] = 0;
-				nullInfo.Weight[2] = 0;
-				nullInfo.Weight[3] = 0;
-
-				for (uint32 i = 0; i < DynamicData->NumBlendFrame; ++i)
-				{
-					if(DynamicData->BlendFrameInfoData)
-						FMemory::Memcpy(DstBlendFrameData + (i * 2 * DataSize), &(DynamicData->BlendFrameInfoData[i]),  sizeof(FInstanceBlendFrameInfo));
-					else
-						FMemory::Memcpy(DstBlendFrameData + (i * 2 * DataSize), &nullInfo, sizeof(FInstanceBlendFrameInfo));
-
-					if (PrevFrameDynamicData->BlendFrameInfoData && PrevFrameDynamicData->NumBlendFrame > i)
-						FMemory::Memcpy(DstBlendFrameData + (i * 2 * DataSize + DataSize), &(PrevFrameDynamicData->BlendFrameInfoData[i]), sizeof(FInstanceBlendFrameInfo));
-					else
-						FMemory::Memcpy(DstBlendFrameData + (i * 2 * DataSize + DataSize), DstBlendFrameData + (i * 2 * DataSize), sizeof(FInstanceBlendFrameInfo));
-				}
-
+				FAllegroGPUInstanceStore::WriteBlendFrames(DstBlendFrameData, DynamicData, OldDynamicData, Proxy->NumBlendFramePerInstance);
 				BlendFrameBuffer->UnlockBuffers();
 			}
 
@@ -1194,6 +1483,23 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 		}
 	}
 	//////////////////////////////////////////////////////////////////////////
+	//gather custom data of the first @NumVisible @Instances, copies nothing if @NumVisible is zero
+	void CopyCustomData(float* RESTRICT Dst, const FAllegroDynamicData* DynamicData, const uint32* RESTRICT Instances, uint32 NumVisible, uint32 NumCustomDataFloats) const
+	{
+		ALLEGRO_SCOPE_CYCLE_COUNTER(CopyCustomData);
+
+		if (GAllegro_DebugScalarCustomDataCopy)
+		{
+			for (uint32 VisIdx = 0; VisIdx < NumVisible; VisIdx++)
+				for (uint32 FloatIndex = 0; FloatIndex < NumCustomDataFloats; FloatIndex++)
+					Dst[VisIdx * NumCustomDataFloats + FloatIndex] = DynamicData->CustomData[Instances[VisIdx] * NumCustomDataFloats + FloatIndex];
+		}
+		else
+		{
+			AllegroGatherFloats(Dst, DynamicData->CustomData, Instances, NumVisible, NumCustomDataFloats);
+		}
+	}
+	//////////////////////////////////////////////////////////////////////////
 	void FillShadowBuffers()
 	{
 		const FAllegroDynamicData* DynamicData = this->Proxy->DynamicData;
@@ -1211,23 +1517,23 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 		}
 		const uint32 NumCustomDataFloats = DstCustomDatas ? Proxy->NumCustomDataFloats : 0;
 
-		//for each visible instance, copy their data to the buffer
-		for (uint32 VisIdx = 0; VisIdx < NumVisibleInstance; VisIdx++)
+		//for each visible instance, copy their data to the buffer. shared buffers only take the rows appended by this view
+		const uint32* RESTRICT SrcInstances = this->ShadowShared ? this->ShadowShared->SlotInstances.GetData() + this->ShadowShared->NumUploadedSlot : this->VisibleInstances;
+		const uint32 NumInstance = this->ShadowShared ? this->ShadowShared->SlotInstances.Num() - this->ShadowShared->NumUploadedSlot : this->NumVisibleInstance;
+		for (uint32 VisIdx = 0; VisIdx < NumInstance; VisIdx++)
 		{
-			uint32 InstanceIndex = this->VisibleInstances[VisIdx];
+			uint32 InstanceIndex = SrcInstances[VisIdx];
 			check(InstanceIndex < DynamicData->InstanceCount);
 
 			DstInstanceTransform[VisIdx] = DynamicData->Transforms[InstanceIndex];
 			DstFrameIndex[VisIdx] = OverrideAnimFrameIndex(DynamicData->FrameIndices[InstanceIndex]);
-
-			for (uint32 FloatIndex = 0; FloatIndex < NumCustomDataFloats; FloatIndex++)
-			{
-				DstCustomDatas[VisIdx * NumCustomDataFloats + FloatIndex] = DynamicData->CustomData[InstanceIndex * NumCustomDataFloats + FloatIndex];
-			}
 			DstBlendFrameIndices[VisIdx] = DynamicData->BlendFrameInfoIndex[InstanceIndex];
 		}
 
-		if (BlendFrameBuffer)
+		if (NumCustomDataFloats)
+			CopyCustomData(DstCustomDatas, DynamicData, SrcInstances, NumInstance, NumCustomDataFloats);
+
+		if (BlendFrameBuffer && BlendFrameBuffer->IsLocked())
 		{
 			if (DynamicData->BlendFrameInfoData)
 			{
@@ -1291,6 +1597,15 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 	}
 	//////////////////////////////////////////////////////////////////////////
 	
+	virtual uint32 GetLODNumSection(uint32 SubMeshIdx, uint32 LODIndex) const
+	{
+		const FProxyMeshData& ProxyMD = this->Proxy->SubMeshes[SubMeshIdx];
+		if (LODIndex == ProxyMD.ImpostorLOD)
+			return ProxyMD.GetImpostorLODResources().Sections.Num();
+
+		return ProxyMD.SkeletalRenderData->LODRenderData[LODIndex].RenderSections.Num();
+	}
+
 	virtual bool InitMeshLODData(uint32 SubMeshIdx, FProxyMeshDataBase** MeshDataBasePtr, uint8& CurrentFirstLODIdx, uint8& LODRenderData)
 	{
 		*MeshDataBasePtr = (FProxyMeshDataBase*)(&(this->Proxy->SubMeshes[SubMeshIdx]));
@@ -1395,13 +1710,32 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 				GenSubMesh.LODRemap[LODIndex] = FMath::Clamp(LODIndex + MeshLODBias, MinLOD, MaxLOD);
 			}
 
+			//impostor is main pass only, shadow views clamp it to the last skeletal LOD above
+			if (!bShaddowCollector && ProxySubMesh->ImpostorLOD != 0xFF && GAllegro_ForceLOD < 0)
+				GenSubMesh.LODRemap[ProxySubMesh->ImpostorLOD] = ProxySubMesh->ImpostorLOD;
+
+#if ALLEGRO_GPU_CULL
+			if (this->bGPUCulled)
+				InitGPUCullSubMesh(SubMeshIdx, *ProxySubMesh);
+#endif
 		}
 
 
-		ResolvedViewLocation = (FVector3f)View->CullingOrigin.GridSnap(16);	//OverrideLODViewOrigin ?
+		ResolvedViewLocation = (FVector3f)View->CullingOrigin.GridSnap(16) - Proxy->RenderOrigin;	//OverrideLODViewOrigin ?
 	}
 	//////////////////////////////////////////////////////////////////////////
-	void GenerateData()
+	//culling and LOD selection. main pass views only read the proxy here, so they can run it in parallel (see AllegroGenerateViews)
+	void CullData()
+	{
+#if ALLEGRO_GPU_CULL
+		this->bGPUCulled = ShouldUseGPUCull();
+		if (this->bGPUCulled)
+			return;	//done by UploadData, it dispatches compute work
+#endif
+
+		CullDataCPU();
+	}
+	void CullDataCPU()
 	{
 		InitLODData();
 
@@ -1413,12 +1747,14 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 			const uint32 ATI = Align(TotalInstances, DISTANCING_NUM_FLOAT_PER_REG);
 			const uint32 Size_Distances = sizeof(uint32) * ATI * 2;
 			const uint32 size_VisibleInstances = sizeof(uint32) * ATI * 2;
+			const uint32 Size_LODLevels = (sizeof(uint8*) + ATI) * this->NumSubMesh + alignof(uint8*);
+			const uint32 Size_LODBudget = UseLODBudget() ? sizeof(uint32) * ATI * 5 + 16 : 0;	//screen sizes + sort buffers
 			check(MaxMeshPerInstance > 0);
-			const uint32 ElementVBMaxPossibleSizeInBytes = TotalInstances * MaxMeshPerInstance * (TotalInstances > 0xFFFF ? 4u : 2u);
+			const uint32 ElementVBMaxPossibleSizeInBytes = TotalInstances * MaxMeshPerInstance * (Proxy->DynamicData->InstanceCount >= 0xFFFF ? 4u : 2u);	//shared shadow element indices are instance indices
 			const uint32 MaxPageNeeded = this->Proxy->MaxBatchCountPossible + (ElementVBMaxPossibleSizeInBytes / FIndexCollector::PAGE_DATA_SIZE_IN_BYTES) + 2;
 			const uint32 SizePageMemory = sizeof(typename FIndexCollector::FPageData) * MaxPageNeeded;
 
-			auto TotalBlockSize = Size_Distances + size_VisibleInstances + SizePageMemory + PLATFORM_CACHE_LINE_SIZE;
+			auto TotalBlockSize = Size_Distances + size_VisibleInstances + Size_LODLevels + Size_LODBudget + SizePageMemory + PLATFORM_CACHE_LINE_SIZE;
 
 			this->MempoolPtr = this->MempoolSeek = (uint8*)FMemory::Malloc(TotalBlockSize);
 			this->MempoolEnd = MempoolSeek + TotalBlockSize;
@@ -1428,20 +1764,12 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 
 		if (bShaddowCollector)	//is it collecting for shadow ?
 		{
-			//SCOPE_CYCLE_COUNTER(STAT_ALLEGRO_ShadowCullTime);
-			this->EditedViewFrustum = View->GetDynamicMeshElementsShadowCullFrustum();
-			const bool bShadowNeedTranslation = !View->GetPreShadowTranslation().IsZero();
-			if (bShadowNeedTranslation)
-			{
-				auto NewPlanes = View->GetDynamicMeshElementsShadowCullFrustum()->Planes;
-				//apply offset to the planes
-				for (FPlane& P : NewPlanes)
-					P.W = (P.GetOrigin() - View->GetPreShadowTranslation()) | P.GetNormal();
+			if (GAllegro_ShadowShareAcrossViews)
+				BeginSharedShadow();
 
-				//regenerate Permuted planes
-				uint8* FrustumMem = this->StackAlloc(sizeof(FConvexVolume), alignof(FConvexVolume));
-				this->EditedViewFrustum = new (FrustumMem) FConvexVolume(NewPlanes);
-			}
+			//SCOPE_CYCLE_COUNTER(STAT_ALLEGRO_ShadowCullTime);
+			//shadow frustum is pre shadow translated, bounds are relative to the render origin
+			this->EditedViewFrustum = this->StackOffsetFrustum(View->GetDynamicMeshElementsShadowCullFrustum(), -View->GetPreShadowTranslation() - FVector(Proxy->RenderOrigin));
 
 			Cull();
 
@@ -1450,7 +1778,9 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 		else
 		{
 			//SCOPE_CYCLE_COUNTER(STAT_ALLEGRO_CullTime);
-			EditedViewFrustum = &View->CullingFrustum;
+			EditedViewFrustum = this->StackOffsetFrustum(&View->CullingFrustum, -FVector(Proxy->RenderOrigin));
+			if (ShouldUsePersistentBuffers())
+				this->PersistentInstanceCount = Proxy->DynamicData->InstanceCount;
 
 			Cull();
 			INC_DWORD_STAT_BY(STAT_ALLEGRO_ViewNumCulled, TotalInstances - this->NumVisibleInstance);
@@ -1467,6 +1797,27 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 		{
 			INC_DWORD_STAT_BY(STAT_ALLEGRO_ViewNumVisible, this->NumVisibleInstance);
 		}
+	}
+	//allocates and fills instance buffers and element indices
+	void UploadData()
+	{
+#if ALLEGRO_GPU_CULL
+		if (this->bGPUCulled)
+		{
+			this->GPUCullSubMeshes.SetNum(NumSubMesh);
+			InitLODData();
+			GenerateGPUCullData();
+			return;
+		}
+#endif
+
+		if (!bShaddowCollector && this->CulledHasStencil >= 0)
+			this->Proxy->SetHasStencil(this->CulledHasStencil != 0);
+
+		if (this->TotalElementCount == 0)
+			return;
+
+		bool bNeedInstanceFill = true;
 
 		//allocate vertex buffers
 		//#Note because PreRenderDelegateEx is called before InitShadow we can't share a global vertex buffer for all proxies :(
@@ -1474,14 +1825,154 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 			this->ElementIndexBuffer = GAllegroElementIndexBufferPool.Alloc(this->TotalElementCount * this->GetElementIndexSize());
 			this->ElementIndexBuffer->LockBuffers();
 
+			if (this->ShadowShared)
+				bNeedInstanceFill = AcquireSharedShadowBuffers();
+			else if (this->PersistentInstanceCount)
+				bNeedInstanceFill = AcquirePersistentBuffers();
+			else
+				AllocateInstanceBuffers(this->NumVisibleInstance);
+		}
+
+		//fill mapped buffers
+		{
+			ALLEGRO_SCOPE_CYCLE_COUNTER(BufferFilling);
+
+			if (bShaddowCollector)
+			{
+				if (bNeedInstanceFill)
+					FillShadowBuffers();
+
+				if (this->ShadowShared)
+					this->ShadowShared->NumUploadedSlot = this->ShadowShared->SlotInstances.Num();
+			}
+			else if (bNeedInstanceFill)
+			{
+				FillBuffers();
+			}
+
+			if (Use32BitElementIndex())
+				FillElementsBuffer<uint32>();
+			else
+				FillElementsBuffer<uint16>();
+		}
+
+	}
+	//////////////////////////////////////////////////////////////////////////
+	void BeginSharedShadow()
+	{
+		FAllegroShadowSharedData& Shared = this->Proxy->ShadowSharedData;
+		const FAllegroDynamicData* DynData = this->Proxy->DynamicData;
+
+		if (!Shared.IsValidFor(this->ViewFamily, DynData))	//first shadow view of this frame
+		{
+#if ALLEGRO_LOD_PRE_SUBMESH
+			Shared.BeginFrame(this->ViewFamily, DynData, this->NumSubMesh);
+#else
+			Shared.BeginFrame(this->ViewFamily, DynData, 1);
+#endif
+		}
+
+		this->ShadowShared = &Shared;
+		this->ShadowLODView = &Shared.FindOrAddLODView(FindShadowOwnerView());
+		this->SharedInstanceCount = DynData->InstanceCount;
+	}
+	//main view of the family the shadow view is rendered for. shadow depth views are snapshots of their main view and keep its view state
+	const FSceneView* FindShadowOwnerView() const
+	{
+		if (this->View->State)
+		{
+			for (const FSceneView* FamilyView : this->ViewFamily->Views)
+				if (FamilyView->State == this->View->State)
+					return FamilyView;
+		}
+		return this->ViewFamily->Views.Num() ? this->ViewFamily->Views[0] : this->View;
+	}
+	//returns true if this view appended rows that must be filled, only those are locked
+	bool AcquireSharedShadowBuffers()
+	{
+		FAllegroShadowSharedData& Shared = *this->ShadowShared;
+		const uint32 FirstSlot = Shared.NumUploadedSlot;
+		const uint32 NumNewSlot = Shared.SlotInstances.Num() - FirstSlot;
+		const uint32 InstanceCount = this->SharedInstanceCount;
+
+		if (!Shared.InstanceBuffer || Shared.InstanceBuffer->InstanceCount < InstanceCount)
+		{
+			check(FirstSlot == 0);	//instance count doesn't change within a frame
+			Shared.InstanceBuffer = FAllegroInstanceBuffer::Create(Align(InstanceCount, FAllegroInstanceBuffer::SizeAlign), true);
+		}
+
+		const uint32 NumCustomDataFloats = Proxy->bNeedCustomDataForShadowPass ? Proxy->NumCustomDataFloats : 0;
+		if (NumCustomDataFloats == 0)
+		{
+			Shared.CIDBuffer.Reset();
+		}
+		else if (!Shared.CIDBuffer || Shared.CIDBuffer->NumberOfFloat < InstanceCount * NumCustomDataFloats)
+		{
+			check(FirstSlot == 0);
+			Shared.CIDBuffer = FAllegroCIDBuffer::Create(Align(InstanceCount * NumCustomDataFloats, FAllegroCIDBuffer::SizeAlign), true);
+		}
+
+		//blend frames are indexed by the instances, they are uploaded all at once by the first view that fills
+		const uint32 NumBlendFrame = std::max(Proxy->DynamicData->NumBlendFrame, (Proxy->OldDynamicData) ? Proxy->OldDynamicData->NumBlendFrame : 0);
+		if (NumBlendFrame <= 1)
+		{
+			Shared.BlendFrameBuffer.Reset();
+		}
+		else if (!Shared.bBlendFramesUploaded && NumNewSlot)
+		{
+			const uint32 DataSize = NumBlendFrame * (Proxy->NumBlendFramePerInstance * 2 - 1);
+			if (!Shared.BlendFrameBuffer || Shared.BlendFrameBuffer->NumberOfFloat < DataSize)
+				Shared.BlendFrameBuffer = FAllegroBlendFrameBuffer::Create(Align(DataSize, FAllegroBlendFrameBuffer::SizeAlign), true);
+
+			Shared.BlendFrameBuffer->NumBlendFrame = NumBlendFrame;
+			Shared.BlendFrameBuffer->LockBuffers();
+			Shared.bBlendFramesUploaded = true;
+		}
+
+		this->InstanceBuffer = Shared.InstanceBuffer;
+		this->CIDBuffer = Shared.CIDBuffer;
+		this->BlendFrameBuffer = Shared.BlendFrameBuffer;
+
+		if (NumNewSlot == 0)
+		{
+			INC_DWORD_STAT(STAT_ALLEGRO_ShadowNumSharedDataReuse);
+			return false;
+		}
+
+		this->InstanceBuffer->LockBuffers(FirstSlot, NumNewSlot);
+		if (this->CIDBuffer)
+			this->CIDBuffer->LockBuffers(FirstSlot * NumCustomDataFloats, NumNewSlot * NumCustomDataFloats);
+		return true;
+	}
+	//////////////////////////////////////////////////////////////////////////
+	bool ShouldUsePersistentBuffers() const
+	{
+		//shadow buffers have their own layout (no previous frame data) and are shared by allegro.ShadowShareAcrossViews
+		return GAllegro_PersistentInstanceBuffers && !bShaddowCollector && AllegroSupportsScatterUpload();
+	}
+	//binds the persistent buffers of the proxy after bringing them up to date, returns false since they never need filling by the view
+	bool AcquirePersistentBuffers()
+	{
+		FAllegroGPUInstanceStore& Store = this->Proxy->GPUInstanceStore;
+		Store.Update(FRHICommandListImmediate::Get(), Proxy->DynamicData, Proxy->GetPrevFrameDynamicData(), Proxy->NumCustomDataFloats, Proxy->NumBlendFramePerInstance);
+
+		this->InstanceBuffer = Store.InstanceBuffer;
+		this->CIDBuffer = Store.CIDBuffer;
+		this->BlendFrameBuffer = Store.BlendFrameBuffer;
+		return false;
+	}
+	//////////////////////////////////////////////////////////////////////////
+	void AllocateInstanceBuffers(uint32 NumInstance)
+	{
+		{
 			//need custom per instance float ?
 			if (Proxy->NumCustomDataFloats > 0 && (!bShaddowCollector || Proxy->bNeedCustomDataForShadowPass))
 			{
-				this->CIDBuffer = GAllegroCIDBufferPool.Alloc(NumVisibleInstance * Proxy->NumCustomDataFloats);
+				this->CIDBuffer = GAllegroCIDBufferPool.Alloc(NumInstance * Proxy->NumCustomDataFloats);
 				this->CIDBuffer->LockBuffers();
 			}
 
-			this->InstanceBuffer = GAllegroInstanceBufferPool.Alloc(this->NumVisibleInstance * (bShaddowCollector ? 1 : 2));	//#Note shadow pass doesn't need pref frame data
+			this->InstanceBuffer = GAllegroInstanceBufferPool.Alloc(NumInstance * (bShaddowCollector ? 1 : 2));	//#Note shadow pass doesn't need pref frame data
 			this->InstanceBuffer->LockBuffers();
 
 			uint32 NumBlendFrame = std::max(Proxy->DynamicData->NumBlendFrame, (Proxy->OldDynamicData)? Proxy->OldDynamicData->NumBlendFrame:0);
@@ -1506,23 +1997,113 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 				BlendFrameBuffer.Reset();
 			}
 		}
+	}
+#if ALLEGRO_GPU_CULL
+	//////////////////////////////////////////////////////////////////////////
+	bool ShouldUseGPUCull() const
+	{
+		//shadow needs the shadow cull frustum and LOD bias, translucent instances are drawn from far to near by InstanceEndOffset. both stay on CPU.
+		//buckets are instance indexed so instance data comes from the persistent store, LOD budget needs the screen sizes on CPU
+		return GAllegro_GPUCull && !bShaddowCollector && !this->Proxy->bHasAnyTranslucentMaterial && ShouldUsePersistentBuffers() && !UseLODBudget() && IsFeatureLevelSupported(GMaxRHIShaderPlatform, ERHIFeatureLevel::SM5);
+	}
 
-		//fill mapped buffers
+	void InitGPUCullSubMesh(uint32 SubMeshIdx, const FProxyMeshDataBase& MD)
+	{
+		FAllegroGPUCullSubMesh& CullSubMesh = this->GPUCullSubMeshes[SubMeshIdx];
+		CullSubMesh.bIsValid = 1;
+#if ALLEGRO_LOD_PRE_SUBMESH_FACTOR
+		CullSubMesh.ExtentFactor = MD.ExtentFactor;
+#endif
+		CullSubMesh.LodNum = MD.LodNum;
+		for (uint32 LODIndex = 0; LODIndex < ALLEGRO_MAX_LOD; LODIndex++)
 		{
-			ALLEGRO_SCOPE_CYCLE_COUNTER(BufferFilling);
+			CullSubMesh.LODScreenSizeSq[LODIndex] = FMath::Square(MD.LODScreenSize[LODIndex] * 0.5f);
+			CullSubMesh.LODRemap[LODIndex] = this->SubMeshes_Info[SubMeshIdx].LODRemap[LODIndex];
+		}
 
-			if (bShaddowCollector)
-				FillShadowBuffers();
-			else
-				FillBuffers();
+		CullSubMesh.ImpostorLOD = MD.ImpostorLOD;
+		if (MD.ImpostorLOD < ALLEGRO_MAX_LOD)
+			CullSubMesh.LODScreenSizeSq[MD.ImpostorLOD] = FMath::Square(MD.ImpostorScreenSize * 0.5f);
+	}
 
-			if (Use32BitElementIndex())
-				FillElementsBuffer<uint32>();
-			else
-				FillElementsBuffer<uint16>();
+	//replaces Cull and SecondCull, visible instances are written to the compacted buckets of GPUCullOutput by AllegroCull.usf
+	void GenerateGPUCullData()
+	{
+		ALLEGRO_SCOPE_CYCLE_COUNTER(GenerateGPUCullData);
+
+		const FAllegroDynamicData* DynData = this->Proxy->DynamicData;
+		FRHICommandListImmediate& RHICmdList = FRHICommandListImmediate::Get();
+
+		//bucket offsets are stored first, an instance adds at most one element per mesh slot
+		const uint32 NumBucket = this->NumSubMesh * ALLEGRO_MAX_LOD;
+		const uint32 MaxElement = DynData->AliveInstanceCount * this->MaxMeshPerInstance;
+		this->TotalElementCount = 0;
+		this->TotalBatch = 0;
+		uint32 MaxDraws = 0;
+
+		if (MaxElement == 0)
+			return;
+
+		for (uint32 SubMeshIdx = 0; SubMeshIdx < this->NumSubMesh; SubMeshIdx++)
+		{
+			FSubMeshData& SubMeshData = this->SubMeshes_Data[SubMeshIdx];
+			SubMeshData.Init(true);
+
+			FAllegroGPUCullSubMesh& CullSubMesh = this->GPUCullSubMeshes[SubMeshIdx];
+			if (!CullSubMesh.bIsValid)
+				continue;
+
+			//only the LODs that are reachable by LODRemap need a batch, counts are only known by the GPU
+			for (uint32 LODLevel = 0; LODLevel < ALLEGRO_MAX_LOD; LODLevel++)
+			{
+				if (LODLevel >= FMath::Max(CullSubMesh.LodNum, 1u) && LODLevel != CullSubMesh.ImpostorLOD)
+					continue;
+
+				const uint32 LODIndex = CullSubMesh.LODRemap[LODLevel];
+				FLODData& LODData = SubMeshData.LODs[LODIndex];
+				if (LODData.NumInstance > 0)
+					continue;
+
+				LODData.NumInstance = DynData->AliveInstanceCount;
+				LODData.InstanceOffset = ALLEGRO_GPU_CULL_BUCKET_FLAG | AllegroGPUCullBucket(SubMeshIdx, LODIndex);
+				SubMeshData.bHasAnyLOD = true;
+
+				this->TotalBatch++;
+				MaxDraws += GetLODNumSection(SubMeshIdx, LODIndex) + 1;	//+1 for unified depth batch
+			}
 		}
 
+		if (this->TotalBatch == 0)
+			return;
+
+		this->TotalElementCount = NumBucket + MaxElement;
+
+		this->Proxy->GPUCullInput.Update(RHICmdList, *DynData, this->MaxMeshPerInstance);
+
+		this->GPUCullOutput = GAllegroGPUCullOutputPool.Alloc(this->TotalElementCount);
+		this->GPUCullOutput->EnsureDrawCapacity(RHICmdList, MaxDraws);
+		this->GPUCullDraws.Reserve(MaxDraws);
+
+		this->GPUCullView.Init(View, *this->StackOffsetFrustum(&View->CullingFrustum, -FVector(Proxy->RenderOrigin)), GetLODRadiusScale(), GAllegro_CullScreenSize, !GAllegro_DisableFrustumCull);
+		this->GPUCullView.ViewOrigin -= Proxy->RenderOrigin;
+		AllegroDispatchGPUCull(RHICmdList, this->Proxy->GPUCullInput, *this->GPUCullOutput, this->GPUCullView, this->GPUCullSubMeshes, DynData->InstanceCount, this->MaxMeshPerInstance);
+
+#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+		//reference runs the same cull on CPU, no occlusion or cell culling, so the result must be identical
+		if (GAllegro_GPUCullVerify)
+		{
+			GAllegro_GPUCullVerify = false;
+			TArray<TArray<uint32>> RefBuckets;
+			RefBuckets.SetNum(NumBucket);
+			AllegroCullReference(this->GPUCullView, *DynData, this->MaxMeshPerInstance, this->GPUCullSubMeshes, RefBuckets.GetData());
+			AllegroVerifyGPUCull(RHICmdList, *this->GPUCullOutput, MoveTemp(RefBuckets), DynData->InstanceCount);
+		}
+#endif
+
+		//instance data is read from the persistent store, it is updated by dirty ranges once per frame
+		AcquirePersistentBuffers();
 	}
+#endif
 	//////////////////////////////////////////////////////////////////////////
 	void GenerateBatches()
 	{
@@ -1595,6 +2176,12 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 		}
 
 		const FProxyMeshData& ProxyMD = this->Proxy->SubMeshes[SubMeshIdx];
+		if (LODIndex == ProxyMD.ImpostorLOD)
+		{
+			GenerateImpostorBatch(SubMeshIdx, NumInstance, InstanceOffset, Stencil, RunArray);
+			return;
+		}
+
 		const FSkeletalMeshLODRenderData& SkelLODData = ProxyMD.SkeletalRenderData->LODRenderData[LODIndex];
 		const FProxyLODData& ProxyLODData = ProxyMD.LODs[LODIndex];
 
@@ -1703,6 +2290,10 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 				BatchElement.InstanceRuns = &RunArrayOFR.RunArray[0];
 				BatchElement.bIsInstanceRuns = true;
 			}
+#endif
+#if ALLEGRO_GPU_CULL
+			if (this->bGPUCulled)
+				this->SetupGPUCullDraw(BatchElement, AllegroGPUCullBucket(SubMeshIdx, LODIndex));
 #endif
 			//BatchElement.InstancedLODIndex = LODIndex;
 			Collector->AddMesh(ViewIndex, Mesh);
@@ -1737,6 +2328,63 @@ struct FAllegroMultiMeshGenerator : public FAllegroMeshGeneratorBase
 				BatchElement.InstanceRuns = &RunArrayOFR.RunArray[0];
 				BatchElement.bIsInstanceRuns = true;
 			}
+#endif
+#if ALLEGRO_GPU_CULL
+			if (this->bGPUCulled)
+				this->SetupGPUCullDraw(BatchElement, AllegroGPUCullBucket(SubMeshIdx, LODIndex));
+#endif
+			Collector->AddMesh(ViewIndex, Mesh);
+		}
+	}
+
+	//impostor of a skeletal sub mesh, drawn rigid by the unskinned vertex factory
+	void GenerateImpostorBatch(uint32 SubMeshIdx, uint32 NumInstance, uint32 InstanceOffset, int16 Stencil, TArray<uint32, SceneRenderingAllocator>& RunArray)
+	{
+		const FProxyMeshData& ProxyMD = this->Proxy->SubMeshes[SubMeshIdx];
+		const uint32 LODIndex = ProxyMD.ImpostorLOD;
+		const FStaticMeshLODResources& LODResource = ProxyMD.GetImpostorLODResources();
+		const FProxyLODData& ProxyLODData = ProxyMD.LODs[LODIndex];
+
+#if ALLEGRO_USE_GPU_SCENE
+		FAllegroElementRunArrayOFR& RunArrayOFR = Collector->AllocateOneFrameResource<FAllegroElementRunArrayOFR>();
+		RunArrayOFR.RunArray = MoveTemp(RunArray);
+#endif
+		FAllegroBatchElementOFR* BatchUserData = &Collector->AllocateOneFrameResource<FAllegroBatchElementOFR>();
+		BatchUserData->MaxBoneInfluences = 0;
+		BatchUserData->VertexFactory = Proxy->GetImpostorVertexFactory(SubMeshIdx);
+		BatchUserData->UniformBuffer = this->CreateUniformBuffer(InstanceOffset, NumInstance, 0);
+
+		for (int32 SectionIndex = 0; SectionIndex < LODResource.Sections.Num(); SectionIndex++)
+		{
+			const FStaticMeshSection& SectionInfo = LODResource.Sections[SectionIndex];
+
+			FMeshBatch& Mesh = AllocateStaticMeshBatch(LODResource, SubMeshIdx, LODIndex, SectionIndex, BatchUserData, NumInstance);
+#if	ALLEGRO_USE_STENCIL
+			Mesh.Stencil = Stencil;
+#endif
+			Mesh.bWireframe = bWireframe;
+			Mesh.MaterialRenderProxy = bWireframe ? WireframeMaterialInstance : Proxy->MaterialsProxy[ProxyLODData.SectionsMaterialIndices[SectionIndex]];
+			Mesh.bUseForDepthPass = Proxy->ShouldRenderInDepthPass();
+			Mesh.bUseAsOccluder = false;	//cards are poor occluders
+			Mesh.CastShadow = false;
+
+			FMeshBatchElement& BatchElement = Mesh.Elements[0];
+			BatchElement.FirstIndex = SectionInfo.FirstIndex;
+			BatchElement.NumPrimitives = OverrideNumPrimitive(SectionInfo.NumTriangles);
+			BatchElement.MinVertexIndex = SectionInfo.MinVertexIndex;
+			BatchElement.MaxVertexIndex = SectionInfo.MaxVertexIndex;
+
+#if ALLEGRO_USE_GPU_SCENE
+			if (RunArrayOFR.RunArray.Num() > 0)
+			{
+				BatchElement.NumInstances = RunArrayOFR.RunArray.Num() / 2;
+				BatchElement.InstanceRuns = &RunArrayOFR.RunArray[0];
+				BatchElement.bIsInstanceRuns = true;
+			}
+#endif
+#if ALLEGRO_GPU_CULL
+			if (this->bGPUCulled)
+				this->SetupGPUCullDraw(BatchElement, AllegroGPUCullBucket(SubMeshIdx, LODIndex));
 #endif
 			Collector->AddMesh(ViewIndex, Mesh);
 		}
@@ -1777,6 +2425,11 @@ struct FAllegroStaticMultiMeshGenerator : public FAllegroMultiMeshGenerator<bSha
 		
 	}
 
+	uint32 GetLODNumSection(uint32 SubMeshIdx, uint32 LODIndex) const override
+	{
+		return this->Proxy->SubStaticMeshes[SubMeshIdx].StaticMeshData->LODResources[LODIndex].Sections.Num();
+	}
+
 	bool InitMeshLODData(uint32 SubMeshIdx, FProxyMeshDataBase** MeshDataBasePtr, uint8& CurrentFirstLODIdx, uint8& LODRenderData) override
 	{
 		*MeshDataBasePtr = (FProxyMeshDataBase*)(&(this->Proxy->SubStaticMeshes[SubMeshIdx]));
@@ -1806,50 +2459,6 @@ struct FAllegroStaticMultiMeshGenerator : public FAllegroMultiMeshGenerator<bSha
 		this->UpdateLODLevelImpl(MeshDataBaseArray, this->VisibleInstanceLODLevel, NumCalc);
 	}
 
-
-	FMeshBatch& AllocateStaticMeshBatch(const FStaticMeshLODResources& StaticMeshLODData, uint32 SubMeshIndex, uint32 LODIndex, uint32 SectionIndex,
-		FAllegroBatchElementOFR* BatchUserData, int32 NumInstances)
-	{
-		FMeshBatch& Mesh = this->Collector->AllocateMesh();
-		Mesh.ReverseCulling = false;//IsLocalToWorldDeterminantNegative();
-		Mesh.Type = PT_TriangleList;
-		Mesh.DepthPriorityGroup = this->Proxy->GetDepthPriorityGroup(this->View);
-		Mesh.bCanApplyViewModeOverrides = true;
-		Mesh.bSelectable = false;
-		Mesh.bUseForMaterial = true;
-		Mesh.bUseSelectionOutline = false;
-		Mesh.LODIndex = static_cast<int8>(LODIndex);	//?
-		Mesh.SegmentIndex = static_cast<uint8>(SectionIndex);
-		//its useless, MeshIdInPrimitive is set by Collector->AddMesh()
-		//Mesh.MeshIdInPrimitive = static_cast<uint16>(LODIndex); //static_cast<uint16>((LODIndex << 8) | SectionIndex);
-
-#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
-		Mesh.VisualizeLODIndex = static_cast<int8>(LODIndex);
-#endif
-		Mesh.VertexFactory = BatchUserData->VertexFactory;
-
-		FMeshBatchElement& BatchElement = Mesh.Elements[0];
-		BatchElement.UserData = BatchUserData;
-
-#if ALLEGRO_USE_GPU_SCENE
-
-#else
-		BatchElement.PrimitiveIdMode = PrimID_ForceZero;
-#endif
-
-		BatchElement.IndexBuffer = &StaticMeshLODData.IndexBuffer;
-		BatchElement.UserIndex = 0;
-		//BatchElement.PrimitiveUniformBufferResource = &PrimitiveUniformBuffer->UniformBuffer; //&GIdentityPrimitiveUniformBuffer; 
-		BatchElement.PrimitiveUniformBuffer = this->Proxy->GetUniformBuffer();
-
-		BatchElement.NumInstances = NumInstances; // this->SubMeshes_Data[SubMeshIndex].LODs[LODIndex].NumInstance;
-#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
-		BatchElement.VisualizeElementIndex = static_cast<int32>(SectionIndex);
-#endif
-
-		return Mesh;
-	}
-
 	void GenerateLODBatchEx(uint32 SubMeshIdx, uint32 LODIndex, bool bAnyTranslucentMaterial, uint32 NumInstance, uint32 InstanceOffset, int16 Stencil, TArray<uint32, SceneRenderingAllocator>& RunArray) override
 	{
 		if (NumInstance == 0 && RunArray.Num() == 0)
@@ -1903,7 +2512,7 @@ struct FAllegroStaticMultiMeshGenerator : public FAllegroMultiMeshGenerator<bSha
 				BatchUserData->UniformBuffer = this->CreateUniformBuffer(InstanceOffset, NumInstance, NewLodIndex); //UniformBuffer;
 			}
 
-			FMeshBatch& Mesh = AllocateStaticMeshBatch(LODDataResource, SubMeshIdx, LODIndex, SectionIndex, BatchUserData, NumInstance);
+			FMeshBatch& Mesh = this->AllocateStaticMeshBatch(LODDataResource, SubMeshIdx, LODIndex, SectionIndex, BatchUserData, NumInstance);
 #if	ALLEGRO_USE_STENCIL
 			Mesh.Stencil = Stencil;
 #endif
@@ -1945,6 +2554,10 @@ struct FAllegroStaticMultiMeshGenerator : public FAllegroMultiMeshGenerator<bSha
 				BatchElement.InstanceRuns = &RunArrayOFR.RunArray[0];
 				BatchElement.bIsInstanceRuns = true;
 			}
+#endif
+#if ALLEGRO_GPU_CULL
+			if (this->bGPUCulled)
+				this->SetupGPUCullDraw(BatchElement, AllegroGPUCullBucket(SubMeshIdx, LODIndex));
 #endif
 			this->Collector->AddMesh(this->ViewIndex, Mesh);
 		}
@@ -1956,7 +2569,7 @@ struct FAllegroStaticMultiMeshGenerator : public FAllegroMultiMeshGenerator<bSha
 			FAllegroBatchElementOFR*& BatchUserData = LastOFRS[VFMode];
 			check(BatchUserData);
 
-			FMeshBatch& Mesh = AllocateStaticMeshBatch(LODDataResource, SubMeshIdx, LODIndex, 0, BatchUserData, NumInstance);
+			FMeshBatch& Mesh = this->AllocateStaticMeshBatch(LODDataResource, SubMeshIdx, LODIndex, 0, BatchUserData, NumInstance);
 #if	ALLEGRO_USE_STENCIL
 			Mesh.Stencil = Stencil;
 #endif
@@ -1979,6 +2592,10 @@ struct FAllegroStaticMultiMeshGenerator : public FAllegroMultiMeshGenerator<bSha
 				BatchElement.bIsInstanceRuns = true;
 			}
 #endif
+#if ALLEGRO_GPU_CULL
+			if (this->bGPUCulled)
+				this->SetupGPUCullDraw(BatchElement, AllegroGPUCullBucket(SubMeshIdx, LODIndex));
+#endif
 
 			this->Collector->AddMesh(this->ViewIndex, Mesh);
 		}
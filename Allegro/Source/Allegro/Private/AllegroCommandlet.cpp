@@ -4,6 +4,25 @@
 #include "AllegroPrivate.h"
 #include "AllegroPrivateUtils.h"
 #include "AllegroSpanAllocator.h"
+#include "AllegroComponent.h"
+#include "AllegroAnimCollection.h"
+#include "AllegroRender.h"
+
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "Components/SceneCaptureComponent2D.h"
+#include "Animation/AnimSequenceBase.h"
+#include "Serialization/JsonWriter.h"
+#include "Policies/PrettyJsonPrintPolicy.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Misc/EngineVersion.h"
+#include "DynamicRHI.h"
+#include "RenderingThread.h"
+#include "Async/ParallelFor.h"
+
+#include UE_INLINE_GENERATED_CPP_BY_NAME(AllegroCommandlet)
 
 
 int32 UAllegroCommandlet::Main(const FString& Params)
@@ -11,3 +30,403 @@ int32 UAllegroCommandlet::Main(const FString& Params)
 
 	return 0;
 }
+
+
+UAllegroBenchmarkCommandlet::UAllegroBenchmarkCommandlet()
+{
+	IsClient = false;
+	IsEditor = true;
+	IsServer = false;
+	LogToConsole = true;
+}
+
+#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+
+namespace AllegroBenchmark
+{
+	enum EStage
+	{
+		ES_PlayAnimation,
+		ES_TickAnimations,
+		ES_FlushDeferredTransitions,
+		ES_GenerateDynamicData,
+		ES_Render,
+		ES_Max
+	};
+
+	static const TCHAR* StageNames[ES_Max] = { TEXT("PlayAnimation"), TEXT("TickAnimations"), TEXT("FlushDeferredTransitions"), TEXT("GenerateDynamicData"), TEXT("Render") };
+
+	struct FCounterResult
+	{
+		FString Name;
+		double MsPerFrame;
+		double CallsPerFrame;
+	};
+
+	struct FRunResult
+	{
+		int32 InstanceCount = 0;
+		TArray<double> StageMs[ES_Max]; //wall time of each recorded frame
+		TArray<FCounterResult> Counters;
+	};
+
+	struct FLookupResult
+	{
+		int32 NumKey = 0;
+		int32 NumHashCollision = 0; //keys sharing their full hash with another key
+		int32 NumLookup = 0;
+		int32 NumHit = 0;
+		double ParallelMs = 0;
+		double SingleThreadMs = 0;
+	};
+
+	//FindTransition from task workers, as the parallel tick would do. half of the lookups hit @Keys, the other half miss
+	static FLookupResult BenchmarkTransitionLookup(const UAllegroAnimCollection* AnimCollection, int32 NumLookup)
+	{
+		FLookupResult Result;
+		TArray<UAllegroAnimCollection::FTransitionKey> Keys;
+		TSet<uint32> Hashes;
+		for (const UAllegroAnimCollection::FTransition& Transition : AnimCollection->Transitions)
+		{
+			bool bAlreadyInSet = false;
+			Hashes.Add(Transition.GetKeyHash(), &bAlreadyInSet);
+			Result.NumHashCollision += bAlreadyInSet ? 1 : 0;
+			Keys.Add(Transition);
+		}
+
+		Result.NumKey = Keys.Num();
+		Result.NumLookup = NumLookup;
+		if (Keys.Num() == 0 || NumLookup <= 0)
+			return Result;
+
+		const int32 BatchSize = 1024;
+		const int32 NumBatch = FMath::DivideAndRoundUp(NumLookup, BatchSize);
+		auto Run = [&](EParallelForFlags Flags)
+		{
+			std::atomic<int32> NumHit = 0;
+			const double Start = FPlatformTime::Seconds();
+			ParallelFor(TEXT("AllegroBenchmarkTransitionLookup"), NumBatch, 1, [&](int32 BatchIndex) {
+				int32 NumBatchHit = 0;
+				const int32 End = FMath::Min(NumLookup, (BatchIndex + 1) * BatchSize);
+				for (int32 LookupIndex = BatchIndex * BatchSize; LookupIndex < End; LookupIndex++)
+				{
+					UAllegroAnimCollection::FTransitionKey Key = Keys[(LookupIndex / 2) % Keys.Num()];
+					if (LookupIndex & 1)
+						Key.ToFI += 0x10000; //never a valid local frame index
+					NumBatchHit += AnimCollection->FindTransition(Key) != -1 ? 1 : 0;
+				}
+				NumHit += NumBatchHit;
+			}, Flags);
+			Result.NumHit = NumHit.load();
+			return (FPlatformTime::Seconds() - Start) * 1000.0;
+		};
+
+		Result.SingleThreadMs = Run(EParallelForFlags::ForceSingleThread);
+		Result.ParallelMs = Run(EParallelForFlags::None);
+		return Result;
+	}
+
+	static double Percentile(TArray<double> Samples, float P)
+	{
+		if (Samples.Num() == 0)
+			return 0;
+
+		Samples.Sort();
+		return Samples[FMath::Min(Samples.Num() - 1, static_cast<int>(Samples.Num() * P))];
+	}
+
+	static double Average(const TArray<double>& Samples)
+	{
+		double Sum = 0;
+		for (double S : Samples)
+			Sum += S;
+		return Samples.Num() ? Sum / Samples.Num() : 0;
+	}
+}
+
+int32 UAllegroBenchmarkCommandlet::Main(const FString& Params)
+{
+	using namespace AllegroBenchmark;
+
+	FString CollectionPath;
+	FParse::Value(*Params, TEXT("AnimCollection="), CollectionPath);
+	UAllegroAnimCollection* AnimCollection = CollectionPath.Len() ? LoadObject<UAllegroAnimCollection>(nullptr, *CollectionPath) : nullptr;
+	if (!AnimCollection)
+	{
+		UE_LOG(LogAllegro, Error, TEXT("AllegroBenchmark: -AnimCollection=<path> is missing or invalid."));
+		return 1;
+	}
+
+	if (!AnimCollection->bIsBuilt)
+		AnimCollection->TryBuildAll();
+
+	if (!AnimCollection->bIsBuilt || !AnimCollection->GetRandomAnimSequence())
+	{
+		UE_LOG(LogAllegro, Error, TEXT("AllegroBenchmark: %s could not be built or has no sequence."), *AnimCollection->GetName());
+		return 1;
+	}
+
+	FString CountsString = TEXT("10000,100000,500000");
+	FParse::Value(*Params, TEXT("Counts="), CountsString);
+	TArray<FString> CountTokens;
+	CountsString.ParseIntoArray(CountTokens, TEXT(","));
+
+	int32 NumFrame = 120;
+	int32 NumWarmupFrame = 10;
+	int32 Seed = 1234;
+	int32 CaptureWidth = 1920;
+	int32 CaptureHeight = 1080;
+	float DeltaTime = 1.0f / 30.0f;
+	float SwitchRate = 0.005f; //fraction of the instances that play a new animation (with transition) per frame
+	float TransitionDuration = 0.2f;
+	float Spacing = 150;
+	FString OutputPath;
+	FString Tag;
+
+	int32 NumLookup = 100000;
+	FParse::Value(*Params, TEXT("Frames="), NumFrame);
+	FParse::Value(*Params, TEXT("Lookups="), NumLookup);
+	FParse::Value(*Params, TEXT("WarmupFrames="), NumWarmupFrame);
+	FParse::Value(*Params, TEXT("Seed="), Seed);
+	FParse::Value(*Params, TEXT("CaptureWidth="), CaptureWidth);
+	FParse::Value(*Params, TEXT("CaptureHeight="), CaptureHeight);
+	FParse::Value(*Params, TEXT("DeltaTime="), DeltaTime);
+	FParse::Value(*Params, TEXT("SwitchRate="), SwitchRate);
+	FParse::Value(*Params, TEXT("TransitionDuration="), TransitionDuration);
+	FParse::Value(*Params, TEXT("Spacing="), Spacing);
+	FParse::Value(*Params, TEXT("Output="), OutputPath);
+	FParse::Value(*Params, TEXT("Tag="), Tag);
+	NumFrame = FMath::Max(1, NumFrame);
+	NumWarmupFrame = FMath::Max(0, NumWarmupFrame);
+
+	if (OutputPath.IsEmpty())
+		OutputPath = FPaths::ProjectSavedDir() / TEXT("Allegro") / FString::Printf(TEXT("Benchmark_%s.json"), *FDateTime::Now().ToString());
+
+	//world with a single component, ticked manually so that each stage can be timed alone
+	UWorld* World = UWorld::CreateWorld(EWorldType::Game, false, TEXT("AllegroBenchmark"));
+	FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+	WorldContext.SetCurrentWorld(World);
+	World->InitializeActorsForPlay(FURL());
+	World->BeginPlay();
+
+	AActor* Actor = World->SpawnActor<AActor>();
+	UAllegroComponent* Component = NewObject<UAllegroComponent>(Actor);
+	Actor->SetRootComponent(Component);
+	Component->SetAnimCollectionAndSkeletalMesh(AnimCollection);
+	Component->RegisterComponent();
+
+	//cull and batch generation only happen when a view renders the proxy
+	USceneCaptureComponent2D* Capture = nullptr;
+	if (FApp::CanEverRender() && !FParse::Param(*Params, TEXT("NoRender")))
+	{
+		UTextureRenderTarget2D* RenderTarget = NewObject<UTextureRenderTarget2D>(Actor);
+		RenderTarget->InitAutoFormat(CaptureWidth, CaptureHeight);
+		RenderTarget->UpdateResourceImmediate(true);
+
+		Capture = NewObject<USceneCaptureComponent2D>(Actor);
+		Capture->TextureTarget = RenderTarget;
+		Capture->bCaptureEveryFrame = false;
+		Capture->bCaptureOnMovement = false;
+		Capture->SetupAttachment(Component);
+		Capture->RegisterComponent();
+	}
+
+	UE_LOG(LogAllegro, Display, TEXT("AllegroBenchmark: %s, %d frames, render:%d"), *AnimCollection->GetName(), NumFrame, Capture != nullptr);
+
+	TArray<FRunResult> Results;
+	FAllegroBenchmarkCounter::bEnabled = true;
+
+	for (const FString& CountToken : CountTokens)
+	{
+		const int32 InstanceCount = FCString::Atoi(*CountToken);
+		if (InstanceCount <= 0)
+			continue;
+
+		FRunResult& Result = Results.AddDefaulted_GetRef();
+		Result.InstanceCount = InstanceCount;
+
+		FRandomStream Stream(Seed);
+		Component->ClearInstances(true);
+
+		//square grid of instances, each one playing a random looped sequence from a random time
+		const int32 Side = FMath::CeilToInt(FMath::Sqrt(static_cast<float>(InstanceCount)));
+		for (int32 i = 0; i < InstanceCount; i++)
+		{
+			const FVector3f Location((i % Side) * Spacing, (i / Side) * Spacing, 0);
+			const int InstanceIndex = Component->AddInstance(FTransform3f(FRotator3f(0, Stream.FRandRange(0, 360), 0), Location));
+			if (UAnimSequenceBase* Anim = AnimCollection->GetRandomAnimSequenceFromStream(Stream))
+				Component->InstancePlayAnimation(InstanceIndex, Anim, true, Stream.FRand() * Anim->GetPlayLength() * 0.9f, 1, 0);
+		}
+
+		if (Capture)
+		{
+			const float Extent = Side * Spacing;
+			const FVector CameraLocation(-Extent * 0.1f, -Extent * 0.1f, 1000);
+			const FVector LookAt(Extent * 0.5f, Extent * 0.5f, 0);
+			Capture->SetWorldLocationAndRotation(CameraLocation, (LookAt - CameraLocation).Rotation());
+		}
+
+		for (int32 Frame = -NumWarmupFrame; Frame < NumFrame; Frame++)
+		{
+			if (Frame == 0)
+				FAllegroBenchmarkCounter::ResetAll();
+
+			FAllegroModule::OnBeginFrame();
+			AnimCollection->OnBeginFrame();
+
+			double StageStart = FPlatformTime::Seconds();
+			auto EndStage = [&](EStage Stage)
+			{
+				const double Now = FPlatformTime::Seconds();
+				if (Frame >= 0)
+					Result.StageMs[Stage].Add((Now - StageStart) * 1000.0);
+				StageStart = Now;
+			};
+
+			const int32 NumSwitch = FMath::RoundToInt(InstanceCount * SwitchRate);
+			for (int32 i = 0; i < NumSwitch; i++)
+			{
+				const int InstanceIndex = Stream.RandHelper(InstanceCount);
+				if (UAnimSequenceBase* Anim = AnimCollection->GetRandomAnimSequenceFromStream(Stream))
+					Component->InstancePlayAnimation(InstanceIndex, Anim, true, 0, 1, TransitionDuration);
+			}
+			EndStage(ES_PlayAnimation);
+
+			Component->TickAnimations(DeltaTime);
+			EndStage(ES_TickAnimations);
+
+			AnimCollection->FlushDeferredTransitions();
+			EndStage(ES_FlushDeferredTransitions);
+
+			if (Component->SceneProxy)
+			{
+				Component->MarkRenderTransformDirty();
+				World->SendAllEndOfFrameUpdates();
+			}
+			else
+			{
+				delete Component->GenerateDynamicData_Internal();
+				AnimCollection->UploadDataSetNumUninitialized(0); //nothing to upload to
+			}
+			EndStage(ES_GenerateDynamicData);
+
+			if (Capture)
+			{
+				Capture->CaptureScene();
+				FlushRenderingCommands();
+				EndStage(ES_Render);
+			}
+
+			GFrameCounter++;
+		}
+
+		for (FAllegroBenchmarkCounter* Counter = FAllegroBenchmarkCounter::GetFirst(); Counter; Counter = Counter->Next)
+		{
+			if (Counter->Calls.load() == 0)
+				continue;
+
+			FCounterResult& CR = Result.Counters.AddDefaulted_GetRef();
+			CR.Name = Counter->Name;
+			CR.MsPerFrame = FPlatformTime::ToMilliseconds64(Counter->Cycles.load()) / NumFrame;
+			CR.CallsPerFrame = static_cast<double>(Counter->Calls.load()) / NumFrame;
+		}
+		Result.Counters.Sort([](const FCounterResult& A, const FCounterResult& B) { return A.Name < B.Name; });
+
+		for (int Stage = 0; Stage < ES_Max; Stage++)
+		{
+			if (Result.StageMs[Stage].Num())
+				UE_LOG(LogAllegro, Display, TEXT("%8d instances %-26s avg:%8.3fms p95:%8.3fms"), InstanceCount, StageNames[Stage], Average(Result.StageMs[Stage]), Percentile(Result.StageMs[Stage], 0.95f));
+		}
+	}
+
+	FAllegroBenchmarkCounter::bEnabled = false;
+
+	const FLookupResult Lookup = BenchmarkTransitionLookup(AnimCollection, NumLookup);
+	UE_LOG(LogAllegro, Display, TEXT("%8d transition lookups over %d keys (%d hash collisions) parallel:%8.3fms single thread:%8.3fms"), Lookup.NumLookup, Lookup.NumKey, Lookup.NumHashCollision, Lookup.ParallelMs, Lookup.SingleThreadMs);
+
+	Component->ClearInstances(true);
+	GEngine->DestroyWorldContext(World);
+	World->DestroyWorld(false);
+
+	//write results
+	FString Json;
+	TSharedRef<TJsonWriter<TCHAR, TPrettyJsonPrintPolicy<TCHAR>>> Writer = TJsonWriterFactory<TCHAR, TPrettyJsonPrintPolicy<TCHAR>>::Create(&Json);
+	Writer->WriteObjectStart();
+	Writer->WriteValue(TEXT("Tag"), Tag);
+	Writer->WriteValue(TEXT("Engine"), FEngineVersion::Current().ToString());
+	Writer->WriteValue(TEXT("Platform"), FString(FPlatformProperties::IniPlatformName()));
+	Writer->WriteValue(TEXT("RHI"), FString(GDynamicRHI ? GDynamicRHI->GetName() : TEXT("None")));
+	Writer->WriteValue(TEXT("AnimCollection"), AnimCollection->GetPathName());
+	Writer->WriteValue(TEXT("Frames"), NumFrame);
+	Writer->WriteValue(TEXT("DeltaTime"), DeltaTime);
+	Writer->WriteValue(TEXT("SwitchRate"), SwitchRate);
+	Writer->WriteValue(TEXT("Render"), Capture != nullptr);
+	Writer->WriteArrayStart(TEXT("Runs"));
+	for (const FRunResult& Result : Results)
+	{
+		Writer->WriteObjectStart();
+		Writer->WriteValue(TEXT("InstanceCount"), Result.InstanceCount);
+
+		Writer->WriteObjectStart(TEXT("Stages"));
+		for (int Stage = 0; Stage < ES_Max; Stage++)
+		{
+			const TArray<double>& Samples = Result.StageMs[Stage];
+			if (Samples.Num() == 0)
+				continue;
+
+			Writer->WriteObjectStart(StageNames[Stage]);
+			Writer->WriteValue(TEXT("AvgMs"), Average(Samples));
+			Writer->WriteValue(TEXT("MinMs"), Percentile(Samples, 0));
+			Writer->WriteValue(TEXT("P50Ms"), Percentile(Samples, 0.5f));
+			Writer->WriteValue(TEXT("P95Ms"), Percentile(Samples, 0.95f));
+			Writer->WriteValue(TEXT("MaxMs"), Percentile(Samples, 1));
+			Writer->WriteObjectEnd();
+		}
+		Writer->WriteObjectEnd();
+
+		//ALLEGRO_SCOPE_CYCLE_COUNTER totals, summed over threads
+		Writer->WriteObjectStart(TEXT("Counters"));
+		for (const FCounterResult& CR : Result.Counters)
+		{
+			Writer->WriteObjectStart(CR.Name);
+			Writer->WriteValue(TEXT("MsPerFrame"), CR.MsPerFrame);
+			Writer->WriteValue(TEXT("CallsPerFrame"), CR.CallsPerFrame);
+			Writer->WriteObjectEnd();
+		}
+		Writer->WriteObjectEnd();
+
+		Writer->WriteObjectEnd();
+	}
+	Writer->WriteArrayEnd();
+
+	Writer->WriteObjectStart(TEXT("TransitionLookup"));
+	Writer->WriteValue(TEXT("Keys"), Lookup.NumKey);
+	Writer->WriteValue(TEXT("HashCollisions"), Lookup.NumHashCollision);
+	Writer->WriteValue(TEXT("Lookups"), Lookup.NumLookup);
+	Writer->WriteValue(TEXT("Hits"), Lookup.NumHit);
+	Writer->WriteValue(TEXT("ParallelMs"), Lookup.ParallelMs);
+	Writer->WriteValue(TEXT("SingleThreadMs"), Lookup.SingleThreadMs);
+	Writer->WriteObjectEnd();
+
+	Writer->WriteObjectEnd();
+	Writer->Close();
+
+	if (!FFileHelper::SaveStringToFile(Json, *OutputPath))
+	{
+		UE_LOG(LogAllegro, Error, TEXT("AllegroBenchmark: failed to write %s"), *OutputPath);
+		return 1;
+	}
+
+	UE_LOG(LogAllegro, Display, TEXT("AllegroBenchmark: results written to %s"), *OutputPath);
+	return 0;
+}
+
+#else
+
+int32 UAllegroBenchmarkCommandlet::Main(const FString& Params)
+{
+	UE_LOG(LogAllegro, Error, TEXT("AllegroBenchmark is not available in shipping and test builds."));
+	return 1;
+}
+
+#endif
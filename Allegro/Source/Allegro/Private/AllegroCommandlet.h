@@ -14,4 +14,21 @@ class UAllegroCommandlet : public UCommandlet
 private:
 
 	int32 Main(const FString& Params);
-};
\ No newline at end of file
+};
+
+/*
+* headless benchmark of the per frame stages with synthetic populations. results are written as json so they can be tracked per commit.
+* UnrealEditor-Cmd <Project> -run=AllegroBenchmark -AnimCollection=/Game/Path/Asset -nullrhi [-Counts=10000,100000,500000] [-Frames=120] [-Lookups=100000] [-Output=File.json] [-Tag=CommitHash]
+* cull and batch generation run only when rendering is available (-AllowCommandletRendering without -nullrhi, -RenderOffscreen on Linux)
+* after the runs, -Lookups transition lookups are done concurrently against the transitions the runs created
+*/
+UCLASS()
+class UAllegroBenchmarkCommandlet : public UCommandlet
+{
+	GENERATED_BODY()
+public:
+	UAllegroBenchmarkCommandlet();
+
+private:
+	int32 Main(const FString& Params) override;
+};
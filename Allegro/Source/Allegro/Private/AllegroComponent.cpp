@@ -34,10 +34,28 @@
 #include "Animation/AnimMontage.h"
 #include "Animation/AnimSequence.h"
 #include "Engine/StaticMesh.h"
+#include "Async/ParallelFor.h"
+#include "GameFramework/PlayerController.h"
+#include "Camera/PlayerCameraManager.h"
 
 float GAllegro_LocalBoundUpdateInterval = 1 / 25.0f;
 FAutoConsoleVariableRef CVar_LocalBoundUpdateInterval(TEXT("Allegro.LocalBoundUpdateInterval"), GAllegro_LocalBoundUpdateInterval, TEXT(""), ECVF_Default);
 
+int32 GAllegro_SkipStaticRenderUpdate = 1;
+FAutoConsoleVariableRef CVar_SkipStaticRenderUpdate(TEXT("allegro.SkipStaticRenderUpdate"), GAllegro_SkipStaticRenderUpdate, TEXT("if not zero, end of frame render update of components whose instances haven't changed is skipped"), ECVF_Default);
+
+int32 GAllegro_BoundTaskSize = 2048;
+FAutoConsoleVariableRef CVar_BoundTaskSize(TEXT("allegro.BoundTaskSize"), GAllegro_BoundTaskSize, TEXT("number of instances per task for calculating bounds and grid binning. <= 0 means single threaded"), ECVF_Default);
+
+float GAllegro_RenderOriginRebaseDistance = 1000000;
+FAutoConsoleVariableRef CVar_RenderOriginRebaseDistance(TEXT("allegro.RenderOriginRebaseDistance"), GAllegro_RenderOriginRebaseDistance, TEXT("world origin shifts are accumulated as a translation of the render data. once it gets farther than this, all instances are resent to keep float precision of the render data"), ECVF_Default);
+
+
+int32 GAllegro_AnimTickLOD = 1;
+FAutoConsoleVariableRef CVar_AnimTickLOD(TEXT("allegro.AnimTickLOD"), GAllegro_AnimTickLOD, TEXT("0 = animations of all instances advance every frame. 1 = use UAllegroComponent::AnimTickLODBands"), ECVF_Scalability);
+
+float GAllegro_AnimTickLODDistanceScale = 1;
+FAutoConsoleVariableRef CVar_AnimTickLODDistanceScale(TEXT("allegro.AnimTickLODDistanceScale"), GAllegro_AnimTickLODDistanceScale, TEXT("scales distances of the animation tick LOD bands, lower values reduce update rate sooner"), ECVF_Scalability);
 
 ALLEGRO_AUTO_CVAR_DEBUG(bool, DebugAnimations, false, "", ECVF_Default);
 ALLEGRO_AUTO_CVAR_DEBUG(bool, DebugTransitions, false, "", ECVF_Default);
@@ -79,34 +97,19 @@ inline ETypeAdvanceAnim AnimAdvanceTime(bool bAllowLooping, float MoveDelta, flo
 	return ETAA_Default;
 }
 
-bool FAllegroInstanceAnimState::NeedTick(int32 InstanceIndex, uint32 FrameCounter, float& Delta, FBoxCenterExtentFloat& IB, FMatrix* ViewProjection, FVector* ViewLocation, float LODScale)
+bool FAllegroInstanceAnimState::NeedTick(int32 InstanceIndex, float& Delta, const FVector3f& Location, const FAllegroAnimTickLODContext& LODContext)
 {
 #if	ALLEGRO_ANIMTION_TICK_LOD
-	FVector4 Origin(IB.Center.X, IB.Center.Y, IB.Center.Z, 0);
-	float SphereRadius = FMath::Max(FMath::Max(IB.Extent.Y, IB.Extent.Z), IB.Extent.X);
-	FVector4 ViewOrigin(ViewLocation->X, ViewLocation->Y, ViewLocation->Z, 0);
+	const float DistSq = FVector3f::DistSquared(Location, LODContext.ViewLocation);
+	int LOD = 0;
+	while (LOD < LODContext.NumBand && DistSq >= LODContext.BandDistanceSq[LOD])
+		LOD++;
 
-	float ScreenRadiusSquared = ComputeBoundsScreenRadiusSquared(Origin, SphereRadius, ViewOrigin,*ViewProjection) * LODScale * LODScale;
+	AnimtioneLOD = LOD;
+	const uint32 FrameTickInter = LOD > 0 ? LODContext.BandInterval[LOD - 1] : 1;
 
-	uint8 FrameTickInter = 1;
-	AnimtioneLOD = 0;
-	if (ScreenRadiusSquared < 0.001f)
-	{
-		FrameTickInter = 5;
-		AnimtioneLOD = 3;
-	}
-	else if (ScreenRadiusSquared < 0.005f)
-	{
-		FrameTickInter = 3;
-		AnimtioneLOD = 2;
-	}
-	else if (ScreenRadiusSquared < 0.02f)
-	{
-		FrameTickInter = 2;
-		AnimtioneLOD = 1;
-	}
-
-	if (FrameTickInter == 1 || (InstanceIndex + FrameCounter) % FrameTickInter == 0)
+	//instance index staggers the updates so that the cost is spread over frames
+	if (FrameTickInter <= 1 || (InstanceIndex + LODContext.FrameCounter) % FrameTickInter == 0)
 	{
 		Delta += DeltaTimeAccumulate;
 		DeltaTimeAccumulate = 0.0f;
@@ -128,13 +131,9 @@ bool FAllegroInstanceAnimState::IsTicked()
 #endif
 }
 
-void FAllegroInstanceAnimState::Tick(UAllegroComponent* Owner, int32 InstanceIndex, float Delta,uint32 FrameCounter, FMatrix* ViewProjection, FVector* ViewLocation, float LODScale){
+void FAllegroInstanceAnimState::Tick(UAllegroComponent* Owner, int32 InstanceIndex, float Delta, const FAllegroAnimTickLODContext* LODContext, FAllegroAnimTickEvents& Events){
 	UAllegroAnimCollection* AnimCollection = Owner->AnimCollection;
 	EAllegroInstanceFlags& Flags = Owner->InstancesData.Flags[InstanceIndex];
-	TickDeferredEvent& DeferredEvent = Owner->ThreadSafeTickTempEvent[InstanceIndex];
-	DeferredEvent.FinishedSequence = nullptr;
-	DeferredEvent.FinishedTransitionIdx = -1;
-	DeferredEvent.GPUTransitionFinished = 0;
 
 	if (EnumHasAnyFlags(Flags, EAllegroInstanceFlags::EIF_Destroyed | EAllegroInstanceFlags::EIF_AnimPaused | EAllegroInstanceFlags::EIF_AnimNoSequence | EAllegroInstanceFlags::EIF_DynamicPose))
 		return;
@@ -146,16 +145,23 @@ void FAllegroInstanceAnimState::Tick(UAllegroComponent* Owner, int32 InstanceInd
 	}
 
 #if ALLEGRO_ANIMTION_TICK_LOD
-	if (ViewProjection)
+	if (LODContext)
 	{
-		FBoxCenterExtentFloat IB = Owner->InstancesData.LocalBounds[InstanceIndex].TransformBy(Owner->InstancesData.Matrices[InstanceIndex]);
-		if (!NeedTick(InstanceIndex, FrameCounter, Delta, IB,ViewProjection, ViewLocation, LODScale))
-		{
+		//finished animation is handled right away so that finish event is not delayed
+		if (!NeedTick(InstanceIndex, Delta, Owner->InstancesData.Locations[InstanceIndex], *LODContext) && !EnumHasAnyFlags(Flags, EAllegroInstanceFlags::EIF_AnimFinished))
 			return;
-		}
+	}
+	else
+	{
+		//LOD got disabled, don't lose the accumulated time
+		Delta += DeltaTimeAccumulate;
+		DeltaTimeAccumulate = 0.0f;
+		AnimtioneLOD = 0;
 	}
 #endif
 
+	Events.bAnyTicked = true;
+
 	float OldTime = Time;
 	float NewDelta = PlayScale * Delta;
 	FAllegroSequenceDef* ActiveSequenceStruct = nullptr;
@@ -171,7 +177,7 @@ void FAllegroInstanceAnimState::Tick(UAllegroComponent* Owner, int32 InstanceInd
 
 			//线程不安全
 			//Owner->AnimationFinishEvents.Add(FAllegroAnimFinishEvent{ InstanceIndex, ActiveSequenceStruct->Sequence });
-			DeferredEvent.FinishedSequence = ActiveSequenceStruct->Sequence;
+			Events.Finishes.Add(FAllegroAnimFinishEvent{ InstanceIndex, ActiveSequenceStruct->Sequence });
 
 			return;
 		}
@@ -191,7 +197,7 @@ void FAllegroInstanceAnimState::Tick(UAllegroComponent* Owner, int32 InstanceInd
 					{
 						//线程不安全
 						//Owner->AnimationNotifyEvents.Add(FAllegroAnimNotifyEvent{ InstanceIndex, ActiveSequenceStruct.Sequence, Notify.Name });
-						Owner->AddEvent(InstanceIndex, FAllegroAnimNotifyEvent{ InstanceIndex, ActiveSequenceStruct->Sequence, Notify.Name,Notify.Notify });
+						Events.Notifies.Add(FAllegroAnimNotifyEvent{ InstanceIndex, ActiveSequenceStruct->Sequence, Notify.Name,Notify.Notify });
 					}
 				}
 			}
@@ -204,7 +210,7 @@ void FAllegroInstanceAnimState::Tick(UAllegroComponent* Owner, int32 InstanceInd
 					{
 						//线程不安全
 						//Owner->AnimationNotifyEvents.Add(FAllegroAnimNotifyEvent{ InstanceIndex, ActiveSequenceStruct.Sequence, Notify.Name });
-						Owner->AddEvent(InstanceIndex, FAllegroAnimNotifyEvent{ InstanceIndex,ActiveSequenceStruct->Sequence, Notify.Name,Notify.Notify });
+						Events.Notifies.Add(FAllegroAnimNotifyEvent{ InstanceIndex,ActiveSequenceStruct->Sequence, Notify.Name,Notify.Notify });
 					}
 				}
 			}
@@ -223,13 +229,9 @@ void FAllegroInstanceAnimState::Tick(UAllegroComponent* Owner, int32 InstanceInd
 
 		this->Time += NewDelta;
 
-		InstanceExtend->Update(NewDelta);
-		InstanceExtend->PostUpdate(InstanceIndex, Owner);
-
-		if (!InstanceExtend->IsPlaying())
-		{
-			EnumAddFlags(Flags, EAllegroInstanceFlags::EIF_AnimFinished);
-		}
+		//advanced later by AnimExtendPool->Tick() together with other instances, it also writes the frame index
+		check(ExtendSlot != INDEX_NONE);
+		Owner->AnimExtendPool->QueueTick(AssetType, ExtendSlot, NewDelta);
 	}
 
 	//trans handle
@@ -252,7 +254,7 @@ void FAllegroInstanceAnimState::Tick(UAllegroComponent* Owner, int32 InstanceInd
 			
 			if (LocalFrame + GPUTransInfo.BeginFrameIndex >= GPUTransInfo.EndFrameIndex)
 			{
-				DeferredEvent.GPUTransitionFinished = 1;
+				Events.FinishedGPUTransitions.Add(InstanceIndex);
 			}
 			else
 			{
@@ -286,7 +288,7 @@ void FAllegroInstanceAnimState::Tick(UAllegroComponent* Owner, int32 InstanceInd
 			
 			//线程不安全
 			//AnimCollection->DecTransitionRef(this->TransitionIndex);
-			DeferredEvent.FinishedTransitionIdx = this->TransitionIndex;
+			Events.FinishedTransitions.Add(this->TransitionIndex);
 		}
 		else
 		{
@@ -310,27 +312,12 @@ void FAllegroInstanceAnimState::Tick(UAllegroComponent* Owner, int32 InstanceInd
 			EnumAddFlags(Flags, EAllegroInstanceFlags::EIF_AnimFinished);
 		}
 	}
-	else if (AssetType == EAnimAssetType::AnimMontage || AssetType == EAnimAssetType::AnimBlendSpace)
-	{
-		const FAllegroSequenceDef& ActiveSequence = AnimCollection->Sequences[InstanceExtend->CurrentSequence];
-		int LocalIndex = static_cast<int>(InstanceExtend->Time * ActiveSequence.SampleFrequencyFloat);
-	
-		//check(LocalIndex < ActiveSequence.AnimationFrameCount);
-		if (LocalIndex >= ActiveSequence.AnimationFrameCount)
-		{
-			LocalIndex = ActiveSequence.AnimationFrameCount - 1;
-		}
-
-		int GlobalIndex = ActiveSequence.AnimationFrameIndex + LocalIndex;
-		Owner->InstancesData.FrameIndices[InstanceIndex] = GlobalIndex;
-		this->CurrentSequence = InstanceExtend->CurrentSequence;
-	}
 
 	if (Owner->UseGPUTransition)
 	{
 		if (EnumHasAllFlags(Flags, EAllegroInstanceFlags::EIF_GPUTransition | EAllegroInstanceFlags::EIF_AnimFinished))
 		{
-			DeferredEvent.GPUTransitionFinished = 1;
+			Events.FinishedGPUTransitions.Add(InstanceIndex);
 		}
 	}
 }
@@ -347,27 +334,16 @@ void FAllegroInstanceAnimState::SetCurrentAnimAsset(TObjectPtr<UAnimationAsset>
 	AssetType = Type;
 }
 
-void FAllegroInstanceAnimState::ResetAnimState()
+void FAllegroInstanceAnimState::ResetAnimState(UAllegroComponent* Owner)
 {
-	CurrentAnimAsset = nullptr;
-	AssetType = EAnimAssetType::AnimNull;
-
-	if (InstanceExtend)
+	if (ExtendSlot != INDEX_NONE)
 	{
-		delete InstanceExtend;
-		InstanceExtend = nullptr;
+		Owner->AnimExtendPool->Free(AssetType, ExtendSlot);
+		ExtendSlot = INDEX_NONE;
 	}
-}
 
-FInstanceAnimStateExtend* FAllegroInstanceAnimState::CreateNewInstanceExtend()
-{
-	if (InstanceExtend)
-	{
-		delete InstanceExtend;
-		InstanceExtend = nullptr;
-	}
-	InstanceExtend = new FInstanceAnimStateExtend();
-	return InstanceExtend;
+	CurrentAnimAsset = nullptr;
+	AssetType = EAnimAssetType::AnimNull;
 }
 
 void FAllegroInstanceAnimState::AddReferencedObjects(FReferenceCollector& Collector)
@@ -435,7 +411,11 @@ UAllegroComponent::UAllegroComponent(const FObjectInitializer& ObjectInitializer
 	//MaxLODIndex = 0xFF;
 
 	AnimationPlayRate = 1;
+	bEnableAnimTickLOD = false;
+	AnimTickLODMetric = EAllegroAnimTickLODMetric::ScreenSize;
+	AnimTickLODBands = { FAllegroAnimTickLODBand{ 0.14f, 2 }, FAllegroAnimTickLODBand{ 0.07f, 4 }, FAllegroAnimTickLODBand{ 0.03f, 8 } };
 	MaxMeshPerInstance = 4;
+	SpatialIndexCellSize = 500;
 
 }
 
@@ -451,11 +431,15 @@ void UAllegroComponent::OnComponentCreated()
 
 void UAllegroComponent::FixInstanceData()
 {
+	InvalidateSpatialIndex();
 	InstancesData.Matrices.SetNum(InstancesData.Locations.Num());
 	//InstancesData.RenderMatrices.SetNum(InstancesData.Locations.Num());
 	InstancesData.FrameIndices.SetNum(InstancesData.Locations.Num());
 	InstancesData.RenderCustomData.SetNumZeroed(InstancesData.Locations.Num() * NumCustomDataFloats);
 	InstancesData.MeshSlots.SetNumZeroed(InstancesData.Locations.Num() * (MaxMeshPerInstance + 1));
+	InstancesData.RenderBounds.SetNumUninitialized(InstancesData.Locations.Num());
+	InstancesData.RenderDirty.SetNumUninitialized(InstancesData.Locations.Num());
+	InstancesData.MarkAllRenderDirty();
 
 	for (int InstanceIndex = 0; InstanceIndex < GetInstanceCount(); InstanceIndex++)
 	{
@@ -514,6 +498,9 @@ void UAllegroComponent::PostEditChangeProperty(struct FPropertyChangedEvent& Pro
 		
 	}
 
+	if (PrpName == GET_MEMBER_NAME_CHECKED(UAllegroComponent, SpatialIndexCellSize))
+		InvalidateSpatialIndex();
+
 	Super::PostEditChangeProperty(PropertyChangedEvent);
 
 	MarkRenderStateDirty();
@@ -552,11 +539,23 @@ void UAllegroComponent::ApplyWorldOffset(const FVector& InOffset, bool bWorldShi
 {
 	Super::ApplyWorldOffset(InOffset, bWorldShift);
 
-	for (int InstanceIndex = 0; InstanceIndex < GetInstanceCount(); InstanceIndex++)
-	{
-		if(IsInstanceAlive(InstanceIndex))
-			AddInstanceLocation(InstanceIndex, FVector3f(InOffset));
-	}
+	//every instance is moving, cheaper to rebuild the index
+	InvalidateSpatialIndex();
+
+	//game thread data remains in world space but nothing is marked render dirty, proxy applies the offset to its data as a whole (see FAllegroProxy::ApplyWorldOffset)
+	const FVector3f Offset3f(InOffset);
+	for (FVector3f& Location : InstancesData.Locations)
+		Location += Offset3f;
+
+	for (FMatrix44f& M : InstancesData.Matrices)
+		M.SetOrigin(M.GetOrigin() + Offset3f);
+
+	for (FBoxCenterExtentFloat& Bound : InstancesData.RenderBounds)
+		Bound.Center += Offset3f;
+
+	RenderOrigin += Offset3f;
+	if (RenderOrigin.SizeSquared() > FMath::Square(GAllegro_RenderOriginRebaseDistance))
+		InstancesData.MarkAllRenderDirty();
 }
 
 
@@ -578,6 +577,11 @@ void UAllegroComponent::TickImpl(float DeltaTime)
 				this->TickAnimations(DeltaTime);
 		}
 
+		if (AnimCollection && AnimCollection->IsSequenceStreamingEnabled())
+			RequestAnimationResidency();
+		else
+			bRequestedSequencesDirty = true;	//not tracked while streaming is off, gathered again once it is enabled
+
 		if(IsVisible() && IsRenderStateCreated() && this->SceneProxy)
 		{
 			MarkRenderTransformDirty();
@@ -601,6 +605,8 @@ void UAllegroComponent::TickImpl(float DeltaTime)
 		FillDynamicPoseFromComponents_Concurrent();
 	}
 
+	UpdateSpatialIndex();
+
 
 #if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
 	if (GAllegro_DebugAnimations || GAllegro_DebugTransitions)
@@ -637,6 +643,14 @@ void UAllegroComponent::SendRenderTransform_Concurrent()
 	const bool bDetailModeAllowsRendering = DetailMode <= GetCachedScalabilityCVars().DetailMode;
 	if (SKProxy && bDetailModeAllowsRendering && (ShouldRender() || bCastHiddenShadow || bAffectIndirectLightingWhileHidden || bRayTracingFarField))
 	{
+		//nothing has changed since the last send, proxy keeps drawing what it has. bounds are still valid too.
+		if (GAllegro_SkipStaticRenderUpdate && !InstancesData.bRenderDataChanged && !InstancesData.bRenderCustomDataDirty)
+		{
+			INC_DWORD_STAT(STAT_ALLEGRO_NumSkippedRenderUpdate);
+			UActorComponent::SendRenderTransform_Concurrent();
+			return;
+		}
+
 		
 		FAllegroDynamicData* DynamicData = GenerateDynamicData_Internal();
 		//no need to call UpdateBounds because we have a calculated bound now
@@ -677,6 +691,8 @@ void UAllegroComponent::SendRenderTransform_Concurrent()
 void UAllegroComponent::CreateRenderState_Concurrent(FRegisterComponentContext* Context)
 {
 	Super::CreateRenderState_Concurrent(Context);
+	//new proxy starts with an empty instance store, everything must be sent
+	InstancesData.MarkAllRenderDirty();
 	SendRenderTransform_Concurrent();
 	
 }
@@ -700,6 +716,13 @@ void UAllegroComponent::PostLoad()
 void UAllegroComponent::BeginDestroy()
 {
 	ClearInstances(true);
+
+	if (AnimExtendPool)
+	{
+		delete AnimExtendPool;
+		AnimExtendPool = nullptr;
+	}
+
 	Super::BeginDestroy();
 }
 
@@ -732,12 +755,14 @@ void UAllegroComponent::PostCDOContruct()
 void UAllegroComponent::OnVisibilityChanged()
 {
 	Super::OnVisibilityChanged();
+	InstancesData.bRenderDataChanged = true;
 	MarkRenderTransformDirty();
 }
 
 void UAllegroComponent::OnHiddenInGameChanged()
 {
 	Super::OnHiddenInGameChanged();
+	InstancesData.bRenderDataChanged = true;
 	MarkRenderTransformDirty();
 }
 
@@ -763,6 +788,17 @@ void UAllegroComponent::EndPlay(EEndPlayReason::Type Reason)
 }
 
 int32 UAllegroComponent::GetNumMaterials() const
+{
+	int Counter = GetImpostorMaterialBaseIndex();
+	for (const FAllegroSubmeshSlot& MeshSlot : Submeshes)
+	{
+		if (MeshSlot.SkeletalMesh && MeshSlot.ImpostorMesh)
+			Counter += MeshSlot.ImpostorMesh->GetStaticMaterials().Num();
+	}
+	return Counter;
+}
+
+int32 UAllegroComponent::GetImpostorMaterialBaseIndex() const
 {
 	int Counter = 0;
 	for (const FAllegroSubmeshSlot& MeshSlot : Submeshes)
@@ -812,6 +848,22 @@ UMaterialInterface* UAllegroComponent::GetMaterial(int32 MaterialIndex) const
 		}
 	}
 
+	for (const FAllegroSubmeshSlot& MeshSlot : Submeshes)
+	{
+		if (MeshSlot.SkeletalMesh && MeshSlot.ImpostorMesh)
+		{
+			const TArray<FStaticMaterial>& Mats = MeshSlot.ImpostorMesh->GetStaticMaterials();
+			if (MaterialIndex >= Mats.Num())
+			{
+				MaterialIndex -= Mats.Num();
+			}
+			else
+			{
+				return Mats[MaterialIndex].MaterialInterface;
+			}
+		}
+	}
+
 	return nullptr;
 }
 
@@ -878,69 +930,38 @@ void UAllegroComponent::TickAnimations(float DeltaTime)
 	DeltaTime *= AnimationPlayRate;
 	if (DeltaTime > 0)
 	{
-		FMatrix ViewProjectMatrix;
-		FVector ViewLocation;
-		float LODScale = 1.0f;
-		bool UseViewInfo = false;
-
+		FAllegroAnimTickLODContext LODContext;
+		bool UseTickLOD = false;
 #if ALLEGRO_ANIMTION_TICK_LOD
-		if (GetWorld()->GetFirstPlayerController())
-		{
-			const FMinimalViewInfo& ViewInfo = GetWorld()->GetFirstPlayerController()->PlayerCameraManager->GetCameraCacheView();
-			ViewProjectMatrix = ViewInfo.CalculateProjectionMatrix();
-			ViewLocation = ViewInfo.Location;
-			UseViewInfo = true;
-
-			static const auto* SkeletalMeshLODRadiusScale = IConsoleManager::Get().FindTConsoleVariableDataFloat(TEXT("r.SkeletalMeshLODRadiusScale"));
-			LODScale = FMath::Clamp(SkeletalMeshLODRadiusScale->GetValueOnGameThread(), 0.25f, 1.0f);
-		}
+		UseTickLOD = InitAnimTickLODContext(LODContext);
 #endif
-		FMatrix* ViewProjectMatrixPtr = UseViewInfo ? &ViewProjectMatrix : nullptr;
-		FVector* ViewLocationPtr = UseViewInfo ? &ViewLocation : nullptr;
+		const FAllegroAnimTickLODContext* LODContextPtr = UseTickLOD ? &LODContext : nullptr;
 
 		TimeSinceLastLocalBoundUpdate += DeltaTime;		
-		ThreadSafeTickTempEvent.Reset(InstanceNum);
-		ThreadSafeTickTempEvent.AddUninitialized(InstanceNum);
-
-		if (UseTaskMode && NumPreTask > 1
-			//&& InstanceNum > NumPreTask
-			)
-		{
-			
-			AnimationNotifyEventsTemp.Reset(InstanceNum);
-			AnimationNotifyEventsTemp.AddDefaulted(InstanceNum);
 
-			TArray<FAllegroInstanceAnimState>& InstanceState = InstancesData.AnimationStates;
-			UAllegroComponent* Owner = this;
-			uint32 FrameCnt = FrameCounter;
+		//instances are ticked in contiguous batches, each batch has its own event buffer so nothing is shared between tasks
+		const bool bParallel = UseTaskMode && NumPreTask > 1;
+		const int BatchSize = bParallel ? NumPreTask : InstanceNum;
+		const int NumBatch = FMath::DivideAndRoundUp(InstanceNum, BatchSize);
+		AnimTickEvents.SetNum(FMath::Max(AnimTickEvents.Num(), NumBatch), false);
 
-			ParallelFor(TEXT("ParallelForAnimState"), InstanceNum, NumPreTask, 
-				[&InstanceState, Owner, DeltaTime, FrameCnt, ViewProjectMatrixPtr, ViewLocationPtr, LODScale](int Index) {
-					auto& Ref = InstanceState[Index];
-					Ref.Tick(Owner, Index, DeltaTime, FrameCnt, ViewProjectMatrixPtr, ViewLocationPtr, LODScale);
-				});
+		TArray<FAllegroInstanceAnimState>& InstanceState = InstancesData.AnimationStates;
+		UAllegroComponent* Owner = this;
 
-			for (int i = 0; i < AnimationNotifyEventsTemp.Num(); ++i)
-			{
-				TArray<FAllegroAnimNotifyEvent>& Notifys = AnimationNotifyEventsTemp[i];
-				if (Notifys.Num() > 0)
+		ParallelFor(TEXT("ParallelForAnimState"), NumBatch, 1,
+			[&InstanceState, Owner, DeltaTime, LODContextPtr, BatchSize, InstanceNum](int BatchIndex) {
+				FAllegroAnimTickEvents& Events = Owner->AnimTickEvents[BatchIndex];
+				const int End = FMath::Min(InstanceNum, (BatchIndex + 1) * BatchSize);
+				for (int Index = BatchIndex * BatchSize; Index < End; Index++)
 				{
-					for (int n = 0; n < Notifys.Num(); ++n)
-					{
-						AnimationNotifyEvents.Add(Notifys[n]);
-					}
+					InstanceState[Index].Tick(Owner, Index, DeltaTime, LODContextPtr, Events);
 				}
-			}
-			
-		}
-		else
-		{
-			for (int InstanceIndex = 0; InstanceIndex < GetInstanceCount(); InstanceIndex++)
-			{
-				FAllegroInstanceAnimState& AS = InstancesData.AnimationStates[InstanceIndex];
-				AS.Tick(this, InstanceIndex, DeltaTime, FrameCounter,ViewProjectMatrixPtr, ViewLocationPtr, LODScale);
-			}
-		}
+			}, bParallel ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread);
+
+		if (AnimExtendPool)
+			AnimExtendPool->Tick(this, AnimTickEvents, bParallel, BatchSize);
+
+		DispatchAnimTickNotifies();
 	}
 
 	{
@@ -949,66 +970,130 @@ void UAllegroComponent::TickAnimations(float DeltaTime)
 	}
 
 	//最后发事件
-	for (int idx = 0; idx < ThreadSafeTickTempEvent.Num();++idx)
+	DispatchAnimTickFinishes();
+}
+
+void UAllegroComponent::DispatchAnimTickNotifies()
+{
+	int NumNotify = 0;
+	for (const FAllegroAnimTickEvents& Events : AnimTickEvents)
+		NumNotify += Events.Notifies.Num();
+
+	if (NumNotify == 0)
+		return;
+
+	AnimationNotifyEvents.Reserve(AnimationNotifyEvents.Num() + NumNotify);
+	for (FAllegroAnimTickEvents& Events : AnimTickEvents)
+	{
+		AnimationNotifyEvents.Append(Events.Notifies);
+		Events.Notifies.Reset();
+	}
+}
+
+void UAllegroComponent::DispatchAnimTickFinishes()
+{
+	for (FAllegroAnimTickEvents& Events : AnimTickEvents)
 	{
-		auto& Ref = ThreadSafeTickTempEvent[idx];
-		if (Ref.FinishedSequence)
+		if (Events.bAnyTicked)
+			InstancesData.bRenderDataChanged = true;
+		if (Events.bSequencesChanged)
+			bRequestedSequencesDirty = true;
+
+		for (const FAllegroAnimFinishEvent& Finish : Events.Finishes)
 		{
-			AnimationFinishEvents.Add(FAllegroAnimFinishEvent{ idx, Ref.FinishedSequence });
+			AnimationFinishEvents.Add(Finish);
 
-			if (UseGPUTransition)
-			{
-				if (InstanceHasAnyFlag(idx, EAllegroInstanceFlags::EIF_GPUTransition))
-				{
-					Ref.GPUTransitionFinished = 1;   //主动画结束了，也要跟着停止过渡
-				}
-			}
+			//主动画结束了，也要跟着停止过渡
+			if (UseGPUTransition && InstanceHasAnyFlag(Finish.InstanceIndex, EAllegroInstanceFlags::EIF_GPUTransition))
+				FinishGPUTransition(Finish.InstanceIndex);
 		}
 
-		if (Ref.FinishedTransitionIdx >= 0)
+		for (int32 FinishedTransitionIdx : Events.FinishedTransitions)
 		{
-			AllegroTransitionIndex TransitionIndex = Ref.FinishedTransitionIdx;
+			AllegroTransitionIndex TransitionIndex = FinishedTransitionIdx;
 			AnimCollection->DecTransitionRef(TransitionIndex);
 		}
 
-		if (Ref.GPUTransitionFinished > 0)
-		{
-			if (InstancesData.AnimationStates[idx].AssetType != EAnimAssetType::AnimBlendSpace)
-			{
-				InstanceRemoveFlags(idx, EAllegroInstanceFlags::EIF_BlendFrame | EAllegroInstanceFlags::EIF_GPUTransition);
+		for (int32 InstanceIndex : Events.FinishedGPUTransitions)
+			FinishGPUTransition(InstanceIndex);
 
-				if (InstancesData.BlendFrameInfoIndex[idx] > 0)
-				{
-					FreeBlendFrameIndex(InstancesData.BlendFrameInfoIndex[idx]);
-					InstancesData.BlendFrameInfoIndex[idx] = 0;
-				}
-			}
-			else
-			{
-				InstanceRemoveFlags(idx, EAllegroInstanceFlags::EIF_GPUTransition);
-			}
-		}
+		Events.Reset();
 	}
+}
+
+void UAllegroComponent::FinishGPUTransition(int InstanceIndex)
+{
+	InstancesData.bRenderDataChanged = true;
+	bRequestedSequencesDirty = true;	//source sequence is no longer blended
+
+	if (InstancesData.AnimationStates[InstanceIndex].AssetType != EAnimAssetType::AnimBlendSpace)
+	{
+		InstanceRemoveFlags(InstanceIndex, EAllegroInstanceFlags::EIF_BlendFrame | EAllegroInstanceFlags::EIF_GPUTransition);
 
-	ThreadSafeTickTempEvent.Reset(0);
+		if (InstancesData.BlendFrameInfoIndex[InstanceIndex] > 0)
+		{
+			FreeBlendFrameIndex(InstancesData.BlendFrameInfoIndex[InstanceIndex]);
+			InstancesData.BlendFrameInfoIndex[InstanceIndex] = 0;
+		}
+	}
+	else
+	{
+		InstanceRemoveFlags(InstanceIndex, EAllegroInstanceFlags::EIF_GPUTransition);
+	}
 }
 
 
-void UAllegroComponent::AddEvent(int InstanceIndex, const FAllegroAnimNotifyEvent& Notify)
+bool UAllegroComponent::InitAnimTickLODContext(FAllegroAnimTickLODContext& Context) const
 {
-	if (UseTaskMode)
+	if (!GAllegro_AnimTickLOD || !bEnableAnimTickLOD || AnimTickLODBands.Num() == 0)
+		return false;
+
+	const APlayerController* PC = GetWorld() ? GetWorld()->GetFirstPlayerController() : nullptr;
+	if (!PC || !PC->PlayerCameraManager)
+		return false;
+
+	const FMinimalViewInfo& ViewInfo = PC->PlayerCameraManager->GetCameraCacheView();
+	Context.ViewLocation = FVector3f(ViewInfo.Location);
+	Context.FrameCounter = FrameCounter;
+	Context.NumBand = FMath::Min(AnimTickLODBands.Num(), FAllegroAnimTickLODContext::MAX_BAND);
+
+	//screen size = 2 * ScreenMultiple * Radius / Distance, same as ComputeBoundsScreenSize
+	float ScreenSizeToDistance = 0;
+	if (AnimTickLODMetric == EAllegroAnimTickLODMetric::ScreenSize)
 	{
-		AnimationNotifyEventsTemp[InstanceIndex].Add(Notify);
+		const FMatrix ProjMatrix = ViewInfo.CalculateProjectionMatrix();
+		const float ScreenMultiple = FMath::Max(0.5f * ProjMatrix.M[0][0], 0.5f * ProjMatrix.M[1][1]);
+		ScreenSizeToDistance = 2.0f * ScreenMultiple * AnimCollection->MeshesBBox.Extent.Size();
 	}
-	else
+
+	const float DistanceScale = FMath::Max(0.0f, GAllegro_AnimTickLODDistanceScale);
+	for (int BandIndex = 0; BandIndex < Context.NumBand; BandIndex++)
 	{
-		AnimationNotifyEvents.Add(Notify);
+		const FAllegroAnimTickLODBand& Band = AnimTickLODBands[BandIndex];
+		float Distance = Band.Threshold;
+		if (AnimTickLODMetric == EAllegroAnimTickLODMetric::ScreenSize)
+			Distance = Band.Threshold > 0 ? ScreenSizeToDistance / Band.Threshold : MAX_flt;
+
+		Context.BandDistanceSq[BandIndex] = Distance < UE_LARGE_WORLD_MAX ? FMath::Square(Distance * DistanceScale) : MAX_flt;
+		Context.BandInterval[BandIndex] = FMath::Max<uint8>(1, Band.UpdateInterval);
 	}
+
+	return true;
+}
+
+FAllegroAnimExtendPool& UAllegroComponent::GetAnimExtendPool()
+{
+	if (!AnimExtendPool)
+		AnimExtendPool = new FAllegroAnimExtendPool();
+
+	return *AnimExtendPool;
 }
 
 
 void UAllegroComponent::CalcAnimationFrameIndices()
 {
+	InstancesData.bRenderDataChanged = true;
+	bRequestedSequencesDirty = true;
 	FMemory::Memzero(InstancesData.FrameIndices.GetData(), InstancesData.FrameIndices.Num() * InstancesData.FrameIndices.GetTypeSize());
 
 	if(!AnimCollection)
@@ -1034,6 +1119,68 @@ void UAllegroComponent::CalcAnimationFrameIndices()
 
 
 
+void UAllegroComponent::RequestAnimationResidency()
+{
+	ALLEGRO_SCOPE_CYCLE_COUNTER(RequestAnimationResidency);
+
+	//the collection forgets its components when streaming is reset
+	bool bAlreadyTracked = false;
+	AnimCollection->StreamingComponents.Add(this, &bAlreadyTracked);
+
+	//instances are only scanned when the sequences they sample may have changed, otherwise the previous list is requested again
+	if (!bRequestedSequencesDirty && bAlreadyTracked)
+	{
+		for (uint16 SequenceIndex : RequestedSequences)
+			AnimCollection->RequestSequenceResidency(SequenceIndex);
+
+		return;
+	}
+
+	bRequestedSequencesDirty = false;
+
+	//sequences are gathered once so that the collection can request them again on frames this component doesn't tick
+	TBitArray<> SequenceMask(false, AnimCollection->StreamingStates.Num());
+	RequestedSequences.Reset();
+
+	auto AddSequence = [&](int SequenceIndex)
+	{
+		if (!SequenceMask[SequenceIndex])
+		{
+			SequenceMask[SequenceIndex] = true;
+			RequestedSequences.Add(static_cast<uint16>(SequenceIndex));
+		}
+	};
+	auto AddFrame = [&](int FrameIndex)
+	{
+		if (AnimCollection->IsAnimationFrameIndex(FrameIndex))
+			AddSequence(AnimCollection->FrameToSequence[FrameIndex]);
+	};
+
+	for (int InstanceIndex = 0; InstanceIndex < GetInstanceCount(); InstanceIndex++)
+	{
+		if (!IsInstanceAlive(InstanceIndex))
+			continue;
+
+		AddFrame(InstancesData.FrameIndices[InstanceIndex]);
+
+		//blended frames (GPU transitions, blend spaces) are fetched in vertex shader too
+		const int32 BlendIndex = InstancesData.BlendFrameInfoIndex[InstanceIndex];
+		if (BlendIndex > 0)
+		{
+			for (float BlendFrameIndex : InstancesData.BlendFrameInfo[BlendIndex].FrameIndex)
+				AddFrame(static_cast<int>(BlendFrameIndex));
+		}
+
+		//transition target, so its resident by the time transition ends
+		const FAllegroInstanceAnimState& AS = InstancesData.AnimationStates[InstanceIndex];
+		if (AS.IsValid() && AS.IsTransitionValid())
+			AddSequence(AS.CurrentSequence);
+	}
+
+	for (uint16 SequenceIndex : RequestedSequences)
+		AnimCollection->RequestSequenceResidency(SequenceIndex);
+}
+
 void UAllegroComponent::SetLODDistanceScale(float NewLODDistanceScale)
 {
 	LODDistanceScale = FMath::Max(0.000001f, NewLODDistanceScale);
@@ -1086,14 +1233,15 @@ void UAllegroComponent::ResetInstanceAnimationState(int InstanceIndex)
 	}
 
 	//释放扩展的类实例
-	InstancesData.AnimationStates[InstanceIndex].ResetAnimState();
+	InstancesData.AnimationStates[InstanceIndex].ResetAnimState(this);
 
 	InstanceRemoveFlags(InstanceIndex, EAllegroInstanceFlags::EIF_AllUserFlags | EAllegroInstanceFlags::EIF_AllAnimationFlags | EAllegroInstanceFlags::EIF_DynamicPose | EAllegroInstanceFlags::EIF_BoundToSMC);
 	InstanceAddFlags(InstanceIndex, EAllegroInstanceFlags::EIF_AnimNoSequence | EAllegroInstanceFlags::EIF_New | EAllegroInstanceFlags::EIF_NeedLocalBoundUpdate);
 
 	InstancesData.AnimationStates[InstanceIndex] = FAllegroInstanceAnimState();
 	InstancesData.FrameIndices[InstanceIndex] = 0;
-
+	InstancesData.bRenderDataChanged = true;
+	bRequestedSequencesDirty = true;
 }
 
 bool UAllegroComponent::IsInstanceValid(int32 InstanceIndex) const
@@ -1163,6 +1311,9 @@ int UAllegroComponent::AddInstance(const FTransform3f& worldTransform)
 		InstancesData.Matrices.AddUninitialized(Count);
 		InstancesData.Stencil.AddUninitialized(Count);
 
+		InstancesData.RenderBounds.AddUninitialized(Count);
+		InstancesData.RenderDirty.AddZeroed(Count);
+
 		if (NumCustomDataFloats > 0)
 			InstancesData.RenderCustomData.AddUninitialized(Count * NumCustomDataFloats);
 
@@ -1195,6 +1346,7 @@ int UAllegroComponent::AddInstance(const FTransform3f& worldTransform)
 	InstancesData.AnimationStates[InstanceIndex] = FAllegroInstanceAnimState();
 	InstancesData.Flags[InstanceIndex] = EAllegroInstanceFlags::EIF_Default;
 	InstancesData.BlendFrameInfoIndex[InstanceIndex] = 0;
+	bRequestedSequencesDirty = true;
 	
 	check(MaxMeshPerInstance > 0);
 	{
@@ -1273,6 +1425,8 @@ bool UAllegroComponent::DestroyAt_Internal(int InstanceIndex)
 
 	NumAliveInstance--;
 	InstancesData.Flags[InstanceIndex] = EAllegroInstanceFlags::EIF_Destroyed;
+	InstancesData.MarkRenderDirty(InstanceIndex);	//render thread cull grid only visits dirty instances
+	SpatialIndex.Remove(InstanceIndex);
 	
 
 	//if(GetAliveInstanceCount() == 0) 
@@ -1376,6 +1530,7 @@ int UAllegroComponent::K2_FlushInstances(TArray<int>& InOutRemapArray)
 		InstancesData.Flags[i] |= EAllegroInstanceFlags::EIF_Destroyed;
 
 	InstanceDataSetNum_Internal(NewArrayLen);
+	InstancesData.MarkAllRenderDirty();
 
 	if (!IsRenderTransformDirty())
 		MarkRenderTransformDirty();
@@ -1408,6 +1563,8 @@ void UAllegroComponent::RemoveTailDataIfAny()
 
 void UAllegroComponent::InstanceDataSetNum_Internal(int NewArrayLen)
 {
+	InvalidateSpatialIndex();
+
 	InstancesData.Flags.SetNumUninitialized(NewArrayLen, true);
 	InstancesData.FrameIndices.SetNumUninitialized(NewArrayLen, true);
 	InstancesData.AnimationStates.SetNumUninitialized(NewArrayLen, true);
@@ -1420,6 +1577,9 @@ void UAllegroComponent::InstanceDataSetNum_Internal(int NewArrayLen)
 
 	InstancesData.Stencil.SetNumUninitialized(NewArrayLen, true);
 
+	InstancesData.RenderBounds.SetNumUninitialized(NewArrayLen, true);
+	InstancesData.RenderDirty.SetNumZeroed(NewArrayLen, true);
+
 	if (NumCustomDataFloats > 0)
 		InstancesData.RenderCustomData.SetNumUninitialized(NewArrayLen * NumCustomDataFloats, true);
 
@@ -1452,6 +1612,10 @@ void UAllegroComponent::ClearInstances(bool bEmptyOrReset)
 	}
 
 	NumAliveInstance = 0;
+	InvalidateSpatialIndex();
+	if (AnimExtendPool)
+		AnimExtendPool->Reset();
+
 	if (bEmptyOrReset)
 	{
 		IndexAllocator.Reset();
@@ -1474,6 +1638,7 @@ void UAllegroComponent::ClearInstances(bool bEmptyOrReset)
 	Info.Weight[3] = 0;
 	Info.FrameIndex[0] = 0;
 
+	bRequestedSequencesDirty = true;
 	MarkRenderTransformDirty();
 }
 
@@ -1486,6 +1651,9 @@ void UAllegroComponent::InstanceCopyFrom(int InstanceIndex, const UAllegroCompon
 		InstancesData.Rotations[InstanceIndex] = SrcComponent->InstancesData.Rotations[SrcInstanceIndex];
 		InstancesData.Scales[InstanceIndex] = SrcComponent->InstancesData.Scales[SrcInstanceIndex];
 		InstancesData.Matrices[InstanceIndex] = SrcComponent->InstancesData.Matrices[SrcInstanceIndex];
+		InstancesData.MarkRenderDirty(InstanceIndex);
+		SpatialIndex.Update(InstanceIndex, InstancesData.Locations[InstanceIndex]);
+		bRequestedSequencesDirty = true;
 		
 		const FAllegroInstanceAnimState& SrcAS = SrcComponent->InstancesData.AnimationStates[SrcInstanceIndex];
 		FAllegroInstanceAnimState& DstAS = InstancesData.AnimationStates[InstanceIndex];
@@ -1691,6 +1859,8 @@ bool UAllegroComponent::ShouldUseFixedInstanceBound() const
 void UAllegroComponent::OnInstanceTransformChange(int InstanceIndex)
 {
 	InstancesData.Matrices[InstanceIndex] = GetInstanceTransform(InstanceIndex).ToMatrixWithScale();
+	InstancesData.MarkRenderDirty(InstanceIndex);
+	SpatialIndex.Update(InstanceIndex, InstancesData.Locations[InstanceIndex]);
 }
 
 bool UAllegroComponent::IsInstanceHidden(int InstanceIndex) const
@@ -1711,6 +1881,7 @@ void UAllegroComponent::SetInstanceHidden(int InstanceIndex, bool bNewHidden)
 			EnumRemoveFlags(InstancesData.Flags[InstanceIndex], EAllegroInstanceFlags::EIF_Hidden);
 
 		EnumAddFlags(InstancesData.Flags[InstanceIndex], EAllegroInstanceFlags::EIF_New);
+		InstancesData.MarkRenderDirty(InstanceIndex);
 	}
 }
 
@@ -1719,6 +1890,7 @@ void UAllegroComponent::ToggleInstanceVisibility(int InstanceIndex)
 	check(IsInstanceValid(InstanceIndex));
 	InstancesData.Flags[InstanceIndex] ^= EAllegroInstanceFlags::EIF_Hidden;
 	InstancesData.Flags[InstanceIndex] |= EAllegroInstanceFlags::EIF_New;
+	InstancesData.MarkRenderDirty(InstanceIndex);
 }
 
 void UAllegroComponent::SetInstanceStencil(int InstanceIndex, int32 Stencil)
@@ -1728,6 +1900,7 @@ void UAllegroComponent::SetInstanceStencil(int InstanceIndex, int32 Stencil)
 
 	this->bRenderCustomDepth = 1;
 	InstancesData.Stencil[InstanceIndex] = Stencil;
+	InstancesData.bRenderDataChanged = true;
 }
 
 void UAllegroComponent::SetAnimCollectionAndSkeletalMesh(UAllegroAnimCollection* asset, USkeletalMesh* InMesh)
@@ -1784,6 +1957,8 @@ float UAllegroComponent::InstancePlayAnimation(int InstanceIndex, FAllegroAnimPl
 	if (!AnimCollection || !AnimCollection->bIsBuilt || !IsInstanceValid(InstanceIndex) || !Params.Animation)
 		return -1;
 
+	bRequestedSequencesDirty = true;
+
 	UAnimationAsset* AnimAsset = Params.Animation;
 	EAllegroInstanceFlags& Flags = InstancesData.Flags[InstanceIndex];
 	FAllegroInstanceAnimState& AnimState = InstancesData.AnimationStates[InstanceIndex];
@@ -1795,6 +1970,7 @@ float UAllegroComponent::InstancePlayAnimation(int InstanceIndex, FAllegroAnimPl
 	bool IsBlendFrame = false;
 	bool IsNewTransition = false;
 	float AnimLength = 0.0f;
+	int32 NewExtendSlot = INDEX_NONE;
 	
 	if (auto AnimSequence = Cast<UAnimSequence>(AnimAsset))
 	{
@@ -1812,25 +1988,21 @@ float UAllegroComponent::InstancePlayAnimation(int InstanceIndex, FAllegroAnimPl
 	else if (auto Montage = Cast<UAnimMontage>(AnimAsset))
 	{
 		AssetType = EAnimAssetType::AnimMontage;
-		
-		FInstanceAnimStateExtend* Extend = AnimState.CreateNewInstanceExtend();
-		AnimLength = Extend->SetMontage(Montage, Params,this);
-
-		TargetAnimSeqIndex = Extend->CurrentSequence;
-		Params.StartAt = Extend->Time;
+		NewExtendSlot = GetAnimExtendPool().AllocMontage(InstanceIndex, Montage, Params, this, AnimLength);
 	}
 	else if (auto BlendSpace = Cast<UBlendSpace>(AnimAsset))
 	{
 		AssetType = EAnimAssetType::AnimBlendSpace;
-
-		FInstanceAnimStateExtend* Extend = AnimState.CreateNewInstanceExtend();
-		AnimLength = Extend->SetBlendSpace(BlendSpace, Params, this);
-
-		TargetAnimSeqIndex = Extend->CurrentSequence;
-		Params.StartAt = Extend->Time;
+		NewExtendSlot = GetAnimExtendPool().AllocBlendSpace(InstanceIndex, BlendSpace, this, AnimLength);
 
 		IsBlendFrame = true;
 	}
+
+	if (NewExtendSlot != INDEX_NONE)
+	{
+		TargetAnimSeqIndex = AnimExtendPool->GetCurrentSequence(AssetType, NewExtendSlot);
+		Params.StartAt = AnimExtendPool->GetTime(AssetType, NewExtendSlot);
+	}
 	
 	if (TargetAnimSeqIndex == -1)
 	{
@@ -1839,13 +2011,24 @@ float UAllegroComponent::InstancePlayAnimation(int InstanceIndex, FAllegroAnimPl
 
 	if (TargetAnimSeqIndex == -1 || EnumHasAnyFlags(Flags, EAllegroInstanceFlags::EIF_AnimPaused | EAllegroInstanceFlags::EIF_DynamicPose))
 	{
+		//current animation keeps playing
+		if (NewExtendSlot != INDEX_NONE)
+			AnimExtendPool->Free(AssetType, NewExtendSlot);
+
 		return -1;
 	}
 
+#if ALLEGRO_ANIMTION_TICK_LOD
+	//time skipped by tick LOD belongs to the previous animation
+	AnimState.DeltaTimeAccumulate = 0.0f;
+#endif
+
 	const FAllegroSequenceDef& TargetSeq = AnimCollection->Sequences[TargetAnimSeqIndex];
+	AnimState.ResetAnimState(this);
+	AnimState.ExtendSlot = NewExtendSlot;
+	InstancesData.bRenderDataChanged = true;
 	if (AssetType == EAnimAssetType::AnimSequeue)
 	{
-		AnimState.ResetAnimState();
 		AnimLength = TargetSeq.GetSequenceLength();
 		AnimAdvanceTime(Params.bLoop, float(0), Params.StartAt, AnimLength);	//clamp or wrap time
 	}
@@ -2064,9 +2247,9 @@ void UAllegroComponent::SetInstanceBlendSpacePosition(int InstanceIndex, float I
 
 
 	FAllegroInstanceAnimState& AnimState = InstancesData.AnimationStates[InstanceIndex];
-	if (AnimState.InstanceExtend)
+	if (AnimState.AssetType == EAnimAssetType::AnimBlendSpace && AnimState.ExtendSlot != INDEX_NONE)
 	{
-		AnimState.InstanceExtend->SetBlendSpacePosition(InX, InY);
+		AnimExtendPool->SetBlendSpacePosition(AnimState.ExtendSlot, InX, InY);
 	}
 }
 
@@ -2077,9 +2260,10 @@ bool UAllegroComponent::InstanceMontageJumpToSectionName(int InstanceIndex, cons
 		return false;
 
 	FAllegroInstanceAnimState& AnimState = InstancesData.AnimationStates[InstanceIndex];
-	if (AnimState.InstanceExtend)
+	if (AnimState.AssetType == EAnimAssetType::AnimMontage && AnimState.ExtendSlot != INDEX_NONE)
 	{
-		return AnimState.InstanceExtend->MontageJumpToSectionName(SectionName, bEndOfSection);
+		bRequestedSequencesDirty = true;
+		return AnimExtendPool->MontageJumpToSectionName(AnimState.ExtendSlot, SectionName, bEndOfSection);
 	}
 
 	return false;
@@ -2113,6 +2297,7 @@ void UAllegroComponent::LeaveTransitionIfAny_Internal(int InstanceIndex)
 		FAllegroInstanceAnimState& AS = InstancesData.AnimationStates[InstanceIndex];
 		//switch to frame index in sequence range 
 		InstancesData.FrameIndices[InstanceIndex] = Utils::TransitionFrameRangeToSeuqnceFrameRange<true>(AS, InstancesData.FrameIndices[InstanceIndex], AnimCollection);
+		InstancesData.bRenderDataChanged = true;
 		AnimCollection->DecTransitionRef(AS.TransitionIndex);
 	}
 }
@@ -2542,6 +2727,8 @@ FTransform3f UAllegroComponent::GetInstanceSocketTransform_Fast(int InstanceInde
 void UAllegroComponent::OnUpdateTransform(EUpdateTransformFlags UpdateTransformFlags, ETeleportType Teleport /*= ETeleportType::None*/)
 {
 	Super::OnUpdateTransform(UpdateTransformFlags, ETeleportType::None);
+	//instances are in world space but scene still needs the new primitive transform
+	InstancesData.bRenderDataChanged = true;
 }
 
 void UAllegroComponent::DetachFromComponent(const FDetachmentTransformRules& DetachmentRules)
@@ -2593,20 +2780,95 @@ void UAllegroComponent::ResetAnimationStates()
 // 
 // }
 
-void UAllegroComponent::QueryLocationOverlappingSphere(const FVector3f& Center, float Radius, TArray<int>& OutIndices) const
+const FAllegroSpatialIndex* UAllegroComponent::GetSpatialIndex() const
+{
+	if (SpatialIndexCellSize <= 0)
+		return nullptr;
+
+	//normally rebuilt by the tick, a query made right after a bulk change rebuilds it and the concurrent ones wait for it
+	if (!bSpatialIndexReady.load(std::memory_order_acquire))
+	{
+		FScopeLock Lock(&SpatialIndexLock);
+		if (!bSpatialIndexReady.load(std::memory_order_relaxed))
+			RebuildSpatialIndex();
+	}
+
+	return &SpatialIndex;
+}
+
+void UAllegroComponent::InvalidateSpatialIndex()
 {
+	bSpatialIndexReady.store(false, std::memory_order_relaxed);
+	SpatialIndex.Invalidate();
+}
+
+void UAllegroComponent::RebuildSpatialIndex() const
+{
+	ALLEGRO_SCOPE_CYCLE_COUNTER(RebuildSpatialIndex);
+	SpatialIndex.Reset(SpatialIndexCellSize, GetInstanceCount());
 	for (int i = 0; i < GetInstanceCount(); i++)
 		if (IsInstanceAlive(i))
-			if (FVector3f::DistSquared(InstancesData.Locations[i], Center) < (Radius * Radius))
-				OutIndices.Add(i);
+			SpatialIndex.Update(i, InstancesData.Locations[i]);
+
+	bSpatialIndexReady.store(true, std::memory_order_release);
+}
+
+void UAllegroComponent::UpdateSpatialIndex()
+{
+	check(IsInGameThread());
+	if (SpatialIndexCellSize <= 0)
+		return;
+
+	if (!bSpatialIndexReady.load(std::memory_order_relaxed) || SpatialIndex.GetCellSize() != SpatialIndexCellSize)
+	{
+		FScopeLock Lock(&SpatialIndexLock);
+		RebuildSpatialIndex();
+	}
+}
+
+void UAllegroComponent::QueryLocationOverlappingSphere(const FVector3f& Center, float Radius, TArray<int>& OutIndices) const
+{
+	ForEachInstanceNearBox(FBox3f(Center - Radius, Center + Radius), [&](int i) {
+		if (FVector3f::DistSquared(InstancesData.Locations[i], Center) < (Radius * Radius))
+			OutIndices.Add(i);
+	});
 }
 
 void UAllegroComponent::QueryLocationOverlappingBox(const FBox3f& Box, TArray<int>& OutIndices) const
 {
+	ForEachInstanceNearBox(Box, [&](int i) {
+		if (Box.IsInside(InstancesData.Locations[i]))
+			OutIndices.Add(i);
+	});
+}
+
+void UAllegroComponent::QueryNearestInstances(const FVector3f& Center, int Count, float MaxDistance, TArray<int>& OutIndices, TFunctionRef<bool(int)> Filter) const
+{
+	if (Count <= 0)
+		return;
+
+	if (const FAllegroSpatialIndex* Index = GetSpatialIndex())
+	{
+		Index->FindNearest(Center, Count, MaxDistance, InstancesData.Locations.GetData(), Filter, OutIndices);
+		return;
+	}
+
+	//no index, brute force
+	TArray<TPair<float, int>> Candidates;
+	const float MaxDistSq = MaxDistance > 0 ? FMath::Square(MaxDistance) : MAX_flt;
 	for (int i = 0; i < GetInstanceCount(); i++)
+	{
 		if (IsInstanceAlive(i))
-			if (Box.IsInside(InstancesData.Locations[i]))
-				OutIndices.Add(i);
+		{
+			const float DistSq = FVector3f::DistSquared(InstancesData.Locations[i], Center);
+			if (DistSq <= MaxDistSq && Filter(i))
+				Candidates.Emplace(DistSq, i);
+		}
+	}
+
+	Candidates.Sort([](const TPair<float, int>& A, const TPair<float, int>& B) { return A.Key < B.Key; });
+	for (int i = 0; i < FMath::Min(Count, Candidates.Num()); i++)
+		OutIndices.Add(Candidates[i].Value);
 }
 
 
@@ -2644,19 +2906,38 @@ void UAllegroComponent::DebugDrawInstanceBound(int InstanceIndex, float BoundExt
 
 FAllegroDynamicData* UAllegroComponent::GenerateDynamicData_Internal()
 {
-	FAllegroDynamicData* DynamicData = FAllegroDynamicData::Allocate(this);
-	const uint32 InstanceCount = GetInstanceCount();
-	this->CalcInstancesBound(DynamicData->CompBound, DynamicData->Bounds);
+	FBoxMinMaxFloat CompBound(ForceInit);
+	uint32 NumVisible = 0;
+	this->CalcInstancesBound(CompBound, &NumVisible);
+
+	//only transforms and bounds of the dirty instances are sent, proxy keeps the rest in its instance store
+	const uint32 NumDirtyInstance = InstancesData.ConsumeRenderDirtyRanges(GetInstanceCount(), this->RenderDirtyRanges);
+	INC_DWORD_STAT_BY(STAT_ALLEGRO_NumRenderDirtyInstance, NumDirtyInstance);
+
+	//everything is resent anyway, instance store can go back to world space
+	FVector3f StoreRebase = FVector3f::ZeroVector;
+	if (NumDirtyInstance == (uint32)GetInstanceCount() && !RenderOrigin.IsZero())
+	{
+		StoreRebase = RenderOrigin;
+		RenderOrigin = FVector3f::ZeroVector;
+	}
+
+	FAllegroDynamicData* DynamicData = FAllegroDynamicData::Allocate(this, this->RenderDirtyRanges, NumDirtyInstance);
+	DynamicData->CompBound = CompBound;
+	DynamicData->VisibleInstanceCount = NumVisible;
+	DynamicData->StoreRebase = StoreRebase;
 
 	InstancesData.RemoveFlags(EAllegroInstanceFlags::EIF_New | EAllegroInstanceFlags::EIF_NeedLocalBoundUpdate);
+	InstancesData.bRenderDataChanged = false;
 
 	//happens if all instances are hidden or destroyed. rare case !
 	if (DynamicData->CompBound.IsForceInitValue())
 	{
+		//#Note InstanceCount is kept, instance store of the proxy must remain valid
 		DynamicData->CompBound = FBoxMinMaxFloat(FVector3f::ZeroVector, FVector3f::ZeroVector);
-		DynamicData->InstanceCount = 0;
 		DynamicData->AliveInstanceCount = 0;
 		DynamicData->NumCells = 0;
+		DynamicData->bUseCullGrid = false;
 		
 	}
 	else
@@ -2666,55 +2947,30 @@ FAllegroDynamicData* UAllegroComponent::GenerateDynamicData_Internal()
 		if (DynamicData->NumCells != 0)
 		{
 			DynamicData->InitGrid();
-
-			for (uint32 InstanceIndex = 0; InstanceIndex < InstanceCount; InstanceIndex++)	//for each instance
-			{
-				if (EnumHasAnyFlags(InstancesData.Flags[InstanceIndex], EAllegroInstanceFlags::EIF_Destroyed | EAllegroInstanceFlags::EIF_Hidden))
-					continue;
-
-				const FBoxCenterExtentFloat& IB = DynamicData->Bounds[InstanceIndex];
-				int CellIdx = DynamicData->LocationToCellIndex(IB.Center);
-				DynamicData->Cells[CellIdx].Bound.Add(IB);
-				DynamicData->Cells[CellIdx].AddValue(*DynamicData, InstanceIndex);
-			}
+			DynamicData->BinInstances(InstancesData.Flags.GetData(), InstancesData.RenderBounds.GetData(), GAllegro_BoundTaskSize);
 		}
 	}
 
 
 
 	return DynamicData;
-
-	//for (uint32 i = PrevDynamicDataInstanceCount; i < InstanceCount; i++)
-	//{
-	//	DynamicData->Flags[i] |= EAllegroInstanceFlags::EIF_New;
-	//}
-	//PrevDynamicDataInstanceCount = DynamicData->InstanceCount;
-	//
-	//ENQUEUE_RENDER_COMMAND(Allegro_SendRenderDynamicData)([=](FRHICommandListImmediate& RHICmdList) {
-	//	AllegroProxy->SetDynamicDataRT(DynamicData);
-	//});
 }
 
-void UAllegroComponent::CalcInstancesBound(FBoxMinMaxFloat& CompBound, FBoxCenterExtentFloat* InstancesBounds)
+void UAllegroComponent::CalcInstancesBound(FBoxMinMaxFloat& CompBound, uint32* OutNumVisible)
 {
 	ALLEGRO_SCOPE_CYCLE_COUNTER(UAllegroComponent_CalcInstancesBound);
 
-	if (ShouldUseFixedInstanceBound())
+	if (InstancesData.RenderBounds.Num() != InstancesData.Flags.Num() || InstancesData.RenderDirty.Num() != InstancesData.Flags.Num())
 	{
-		const FBoxCenterExtentFloat FixedBound = AnimCollection->MeshesBBox;
-		for (int32 InstanceIndex = 0; InstanceIndex < GetInstanceCount(); InstanceIndex++)	//for each instance
-		{
-			if (EnumHasAnyFlags(InstancesData.Flags[InstanceIndex], EAllegroInstanceFlags::EIF_Destroyed | EAllegroInstanceFlags::EIF_Hidden))
-				continue;
-
-			//#TODO why FixedBound.Center += Locations[InstanceIndex] is slower
-			FBoxCenterExtentFloat IB = FixedBound.TransformBy(InstancesData.Matrices[InstanceIndex]);
-			CompBound.Add(IB);
-			if(InstancesBounds)
-				InstancesBounds[InstanceIndex] = IB;
-		}
+		InstancesData.RenderBounds.SetNumUninitialized(InstancesData.Flags.Num());
+		InstancesData.RenderDirty.SetNumUninitialized(InstancesData.Flags.Num());
+		InstancesData.MarkAllRenderDirty();
 	}
-	else
+
+	const bool bFixedBound = ShouldUseFixedInstanceBound();
+	EAllegroInstanceFlags FlagToCheck = EAllegroInstanceFlags::EIF_None;
+
+	if (!bFixedBound)
 	{
 		if (InstancesData.LocalBounds.Num() != InstancesData.Flags.Num())
 		{
@@ -2727,24 +2983,84 @@ void UAllegroComponent::CalcInstancesBound(FBoxMinMaxFloat& CompBound, FBoxCente
 		{
 			this->TimeSinceLastLocalBoundUpdate = FMath::Fmod(this->TimeSinceLastLocalBoundUpdate, GAllegro_LocalBoundUpdateInterval);
 		}
-		
-		const EAllegroInstanceFlags FlagToCheck = bTimeForLBUpdate ? EAllegroInstanceFlags::EIF_None : EAllegroInstanceFlags::EIF_NeedLocalBoundUpdate;
 
-		for (int32 InstanceIndex = 0; InstanceIndex < GetInstanceCount(); InstanceIndex++)	//for each instance
+		FlagToCheck = bTimeForLBUpdate ? EAllegroInstanceFlags::EIF_None : EAllegroInstanceFlags::EIF_NeedLocalBoundUpdate;
+	}
+
+	const FBoxCenterExtentFloat FixedBound = bFixedBound ? AnimCollection->MeshesBBox : FBoxCenterExtentFloat(ForceInit);
+
+	//calculates bounds of instances in [Start, End) and returns their overall bound. only touches the data of those instances, safe to run in parallel for separate ranges
+	auto CalcRange = [this, bFixedBound, FlagToCheck, &FixedBound](int32 Start, int32 End, uint32& OutRangeVisible)
+	{
+		OutRangeVisible = 0;
+		FBoxCenterExtentFloat* RenderBounds = InstancesData.RenderBounds.GetData();
+		const uint8* RenderDirty = InstancesData.RenderDirty.GetData();
+		FBoxMinMaxFloat RangeBound(ForceInit);
+
+		for (int32 InstanceIndex = Start; InstanceIndex < End; InstanceIndex++)	//for each instance
 		{
-			if (EnumHasAnyFlags(InstancesData.Flags[InstanceIndex], EAllegroInstanceFlags::EIF_Destroyed | EAllegroInstanceFlags::EIF_Hidden))
+			const EAllegroInstanceFlags InstanceFlags = InstancesData.Flags[InstanceIndex];
+			if (EnumHasAnyFlags(InstanceFlags, EAllegroInstanceFlags::EIF_Destroyed))
 				continue;
 
-			if (EnumHasAllFlags(InstancesData.Flags[InstanceIndex], FlagToCheck))
+			//bound of hidden instances are kept up to date too, they may get visible without any transform change
+			const bool bHidden = EnumHasAnyFlags(InstanceFlags, EAllegroInstanceFlags::EIF_Hidden);
+			if (bFixedBound)
 			{
-				UpdateInstanceLocalBound(InstanceIndex);
+				//#TODO why FixedBound.Center += Locations[InstanceIndex] is slower
+				if (RenderDirty[InstanceIndex])
+					RenderBounds[InstanceIndex] = FixedBound.TransformBy(InstancesData.Matrices[InstanceIndex]);
+			}
+			else
+			{
+				if (!bHidden && EnumHasAllFlags(InstanceFlags, FlagToCheck))
+				{
+					UpdateInstanceLocalBound(InstanceIndex);	//marks render dirty if the bound changed
+				}
+
+				if (RenderDirty[InstanceIndex])
+					RenderBounds[InstanceIndex] = InstancesData.LocalBounds[InstanceIndex].TransformBy(InstancesData.Matrices[InstanceIndex]);
+			}
+
+			if (!bHidden)
+			{
+				RangeBound.Add(RenderBounds[InstanceIndex]);
+				OutRangeVisible++;
 			}
-			
-			FBoxCenterExtentFloat IB = InstancesData.LocalBounds[InstanceIndex].TransformBy(InstancesData.Matrices[InstanceIndex]);
-			CompBound.Add(IB);
-			if(InstancesBounds)
-				InstancesBounds[InstanceIndex] = IB;
 		}
+
+		return RangeBound;
+	};
+
+	const int32 InstanceCount = GetInstanceCount();
+	const int32 NumTask = GAllegro_BoundTaskSize > 0 ? FMath::DivideAndRoundUp(InstanceCount, GAllegro_BoundTaskSize) : 1;
+	if (NumTask <= 1)
+	{
+		uint32 NumVisible;
+		CompBound.Add(CalcRange(0, InstanceCount, NumVisible));
+		if (OutNumVisible)
+			*OutNumVisible = NumVisible;
+		return;
+	}
+
+	TArray<FBoxMinMaxFloat, TInlineAllocator<64>> TaskBounds;
+	TArray<uint32, TInlineAllocator<64>> TaskNumVisible;
+	TaskBounds.SetNumUninitialized(NumTask);
+	TaskNumVisible.SetNumUninitialized(NumTask);
+
+	ParallelFor(TEXT("ParallelForInstancesBound"), NumTask, 1, [&](int32 TaskIndex) {
+		const int32 Start = TaskIndex * GAllegro_BoundTaskSize;
+		TaskBounds[TaskIndex] = CalcRange(Start, FMath::Min(Start + GAllegro_BoundTaskSize, InstanceCount), TaskNumVisible[TaskIndex]);
+	});
+
+	for (const FBoxMinMaxFloat& TaskBound : TaskBounds)
+		CompBound.Add(TaskBound);
+
+	if (OutNumVisible)
+	{
+		*OutNumVisible = 0;
+		for (uint32 NumVisible : TaskNumVisible)
+			*OutNumVisible += NumVisible;
 	}
 }
 
@@ -2849,7 +3165,19 @@ void UAllegroComponent::UpdateInstanceLocalBound(int InstanceIndex)
 {
 	check(IsInstanceValid(InstanceIndex) && !ShouldUseFixedInstanceBound() && this->InstancesData.LocalBounds.IsValidIndex(InstanceIndex));
 
+	//local bounds are refreshed periodically for every animated instance, only the ones that actually changed need to be sent again
+	auto StoreLocalBound = [this, InstanceIndex](const FBoxCenterExtentFloat& NewBound)
+	{
+		FBoxCenterExtentFloat& StoredBound = this->InstancesData.LocalBounds[InstanceIndex];
+		if (StoredBound.Center != NewBound.Center || StoredBound.Extent != NewBound.Extent)
+		{
+			StoredBound = NewBound;
+			InstancesData.MarkRenderDirty(InstanceIndex);
+		}
+	};
+
 	FBoxMinMaxFloat LocalBound(ForceInit);
+	FBoxCenterExtentFloat NewBound;
 
 	//staticmesh 特别处理
 	if (!AnimCollection)
@@ -2867,7 +3195,8 @@ void UAllegroComponent::UpdateInstanceLocalBound(int InstanceIndex)
 				check(!LocalBound.IsForceInitValue());
 			}
 		}
-		LocalBound.ToCenterExtentBox(this->InstancesData.LocalBounds[InstanceIndex]);
+		LocalBound.ToCenterExtentBox(NewBound);
+		StoreLocalBound(NewBound);
 		return;
 	}
 
@@ -2875,7 +3204,7 @@ void UAllegroComponent::UpdateInstanceLocalBound(int InstanceIndex)
 	const uint8* MeshSlotIter = GetInstanceMeshSlots(InstanceIndex);
 	if (*MeshSlotIter == 0xFF) //has no mesh ?
 	{
-		this->InstancesData.LocalBounds[InstanceIndex] = FBoxCenterExtentFloat(ForceInit);
+		StoreLocalBound(FBoxCenterExtentFloat(ForceInit));
 		return;
 	}
 
@@ -2889,7 +3218,8 @@ void UAllegroComponent::UpdateInstanceLocalBound(int InstanceIndex)
 
 	} while (*MeshSlotIter != 0xFF);
 
-	LocalBound.ToCenterExtentBox(this->InstancesData.LocalBounds[InstanceIndex]);
+	LocalBound.ToCenterExtentBox(NewBound);
+	StoreLocalBound(NewBound);
 }
 
 void UAllegroComponent::UpdateLocalBounds()
@@ -2936,7 +3266,7 @@ FBoxSphereBounds UAllegroComponent::CalcBounds(const FTransform& LocalToWorld) c
 
 	UAllegroComponent* NonConst = const_cast<UAllegroComponent*>(this);
 	FBoxMinMaxFloat CompBound(ForceInit);
-	NonConst->CalcInstancesBound(CompBound, nullptr);
+	NonConst->CalcInstancesBound(CompBound);
 
 	//happens if all instances are hidden or destroyed. rare case !
 	if (CompBound.IsForceInitValue())
@@ -2964,6 +3294,18 @@ void UAllegroComponent::ApplyInstanceData(FAllegroComponentInstanceData& ID)
 {
 	InstancesData = ID.InstanceData;
 	IndexAllocator = ID.IndexAllocator;
+	bRequestedSequencesDirty = true;
+
+	//montage and blend space state lives in the pool of the old component, let them finish
+	for (int InstanceIndex = 0; InstanceIndex < InstancesData.AnimationStates.Num(); InstanceIndex++)
+	{
+		FAllegroInstanceAnimState& AnimState = InstancesData.AnimationStates[InstanceIndex];
+		if (AnimState.ExtendSlot != INDEX_NONE)
+		{
+			AnimState.ExtendSlot = INDEX_NONE;
+			EnumAddFlags(InstancesData.Flags[InstanceIndex], EAllegroInstanceFlags::EIF_AnimFinished);
+		}
+	}
 	FixInstanceData();
 	MarkRenderStateDirty();
 }
@@ -3008,6 +3350,10 @@ void FAllegroInstancesData::Reset()
 	CustomPerInstanceStruct.Reset();
 	BlendFrameInfoIndex.Reset();
 	Stencil.Reset();
+	RenderBounds.Reset();
+	RenderDirty.Reset();
+	bRenderCustomDataDirty = true;
+	bRenderDataChanged = true;
 }
 
 void FAllegroInstancesData::Empty()
@@ -3025,6 +3371,10 @@ void FAllegroInstancesData::Empty()
 	CustomPerInstanceStruct.Empty();
 	BlendFrameInfoIndex.Empty();
 	Stencil.Empty();
+	RenderBounds.Empty();
+	RenderDirty.Empty();
+	bRenderCustomDataDirty = true;
+	bRenderDataChanged = true;
 }
 
 FArchive& operator<<(FArchive& Ar, FAllegroInstancesData& R)
@@ -3049,6 +3399,73 @@ void FAllegroInstancesData::RemoveFlags(EAllegroInstanceFlags FlagsToRemove)
 	AllegroArrayAndSSE(Flags.GetData(), Flags.Num() / NumEnumPerPack, MaskDW);
 }
 
+void FAllegroInstancesData::MarkAllRenderDirty()
+{
+	if (RenderDirty.Num())
+		FMemory::Memset(RenderDirty.GetData(), 1, RenderDirty.Num());
+
+	bRenderCustomDataDirty = true;
+	bRenderDataChanged = true;
+}
+
+uint32 FAllegroInstancesData::ConsumeRenderDirtyRanges(uint32 InstanceCount, TArray<FAllegroIndexRange>& OutRanges)
+{
+	//dirty instances closer than this are merged in one range, copying few clean instances is cheaper than having too many ranges
+	static const uint32 MERGE_GAP = 4;
+
+	OutRanges.Reset();
+	check(RenderDirty.Num() % sizeof(uint64) == 0);
+
+	const uint8* DirtyData = RenderDirty.GetData();
+	const uint64* DirtyChunks = reinterpret_cast<const uint64*>(DirtyData);
+	check(InstanceCount <= (uint32)RenderDirty.Num());
+	const uint32 NumChunk = FMath::DivideAndRoundUp<uint32>(InstanceCount, sizeof(uint64));
+
+	uint32 RangeStart = 0;
+	uint32 RangeLast = 0;
+	bool bHasRange = false;
+	uint32 NumCovered = 0;
+
+	for (uint32 ChunkIndex = 0; ChunkIndex < NumChunk; ChunkIndex++)
+	{
+		if (DirtyChunks[ChunkIndex] == 0)	//skip 8 clean instances at once
+			continue;
+
+		const uint32 ChunkEnd = FMath::Min<uint32>((ChunkIndex + 1) * sizeof(uint64), InstanceCount);
+		for (uint32 InstanceIndex = ChunkIndex * sizeof(uint64); InstanceIndex < ChunkEnd; InstanceIndex++)
+		{
+			if (DirtyData[InstanceIndex] == 0)
+				continue;
+
+			if (bHasRange && (InstanceIndex - RangeLast) <= MERGE_GAP)
+			{
+				RangeLast = InstanceIndex;
+				continue;
+			}
+
+			if (bHasRange)
+			{
+				OutRanges.Add(FAllegroIndexRange{ RangeStart, RangeLast - RangeStart + 1 });
+				NumCovered += RangeLast - RangeStart + 1;
+			}
+
+			RangeStart = RangeLast = InstanceIndex;
+			bHasRange = true;
+		}
+	}
+
+	if (bHasRange)
+	{
+		OutRanges.Add(FAllegroIndexRange{ RangeStart, RangeLast - RangeStart + 1 });
+		NumCovered += RangeLast - RangeStart + 1;
+	}
+
+	for (const FAllegroIndexRange& Range : OutRanges)
+		FMemory::Memzero(RenderDirty.GetData() + Range.Start, Range.Count);
+
+	return NumCovered;
+}
+
 
 void FAllegroInstancesData::AddReferencedObjects(FReferenceCollector& Collector)
 {
@@ -3309,6 +3726,8 @@ bool UAllegroComponent::EnableInstanceDynamicPose(int InstanceIndex, bool bEnabl
 		InstanceAddFlags(InstanceIndex, EAllegroInstanceFlags::EIF_DynamicPose);
 		InstancesData.FrameIndices[InstanceIndex] = AnimCollection->DynamicPoseIndexToFrameIndex(DynamicPoseIndex);
 		InstancesData.AnimationStates[InstanceIndex] = FAllegroInstanceAnimState{};
+		InstancesData.bRenderDataChanged = true;
+		bRequestedSequencesDirty = true;
 	}
 	else
 	{
@@ -3330,6 +3749,7 @@ void UAllegroComponent::ReleaseDynamicPose_Internal(int InstanceIndex)
 	
 	FrameIndex = 0;
 	InstancesData.AnimationStates[InstanceIndex] = FAllegroInstanceAnimState{};
+	bRequestedSequencesDirty = true;
 }
 
 /*
@@ -3662,6 +4082,7 @@ bool UAllegroComponent::InstanceAttachSubmeshByIndex_Internal(int InstanceIndex,
 {
 	check(this->Submeshes.IsValidIndex(MeshIndex) && this->Submeshes[MeshIndex].MeshDefIndex != -1);
 	InstanceAddFlags(InstanceIndex, EAllegroInstanceFlags::EIF_NeedLocalBoundUpdate);
+	InstancesData.bRenderDataChanged = true;
 	uint8* SlotBegin = GetInstanceMeshSlots(InstanceIndex);
 	if (bAttach)
 	{
@@ -3693,6 +4114,7 @@ void UAllegroComponent::InstanceDetachAllSubmeshes(int InstanceIndex)
 	{
 		uint8* MS = this->GetInstanceMeshSlots(InstanceIndex);
 		*MS = 0xFF;
+		InstancesData.bRenderDataChanged = true;
 	}
 }
 
@@ -3715,6 +4137,7 @@ void UAllegroComponent::ResetMeshSlots()
 	if (InstancesData.MeshSlots.Num())
 	{
 		FMemory::Memset(InstancesData.MeshSlots.GetData(), 0xFF, InstancesData.MeshSlots.Num() * InstancesData.MeshSlots.GetTypeSize());
+		InstancesData.bRenderDataChanged = true;
 	}
 }
 
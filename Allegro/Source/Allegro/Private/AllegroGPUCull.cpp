@@ -0,0 +1,550 @@
+// Copyright 2024 Lazy Marmot Games. All Rights Reserved.
+
+#include "AllegroGPUCull.h"
+
+#if ALLEGRO_GPU_CULL
+
+#include "AllegroRender.h"
+#include "AllegroPrivate.h"
+#include "RenderGraphUtils.h"
+#include "RHIGPUReadback.h"
+#include "ConvexVolume.h"
+#include "SceneView.h"
+#include "DataDrivenShaderPlatformInfo.h"
+
+static_assert(sizeof(FBoxCenterExtentFloat) == sizeof(float) * 6, "AllegroCull.usf reads bounds as 6 floats");
+static_assert(sizeof(EAllegroInstanceFlags) == sizeof(uint16), "AllegroCull.usf reads flags as R16_UINT");
+
+
+class FAllegroCullCS : public FGlobalShader
+{
+	DECLARE_GLOBAL_SHADER(FAllegroCullCS);
+	SHADER_USE_PARAMETER_STRUCT(FAllegroCullCS, FGlobalShader);
+
+	//first pass counts the elements of each bucket, second pass writes them
+	class FScatterDim : SHADER_PERMUTATION_BOOL("ALLEGRO_CULL_SCATTER");
+	using FPermutationDomain = TShaderPermutationDomain<FScatterDim>;
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER(uint32, InstanceCount)
+		SHADER_PARAMETER(uint32, MaxMeshPerInstance)
+		SHADER_PARAMETER(uint32, NumSubMesh)
+		SHADER_PARAMETER(uint32, NumPlanes)
+		SHADER_PARAMETER(uint32, bFrustumCull)
+		SHADER_PARAMETER(uint32, bComputeLOD)
+		SHADER_PARAMETER(uint32, NumBucket)
+		SHADER_PARAMETER(uint32, ElementCapacity)
+		SHADER_PARAMETER_ARRAY(FVector4f, Planes, [ALLEGRO_GPU_CULL_MAX_PLANES])
+		SHADER_PARAMETER(FVector3f, ViewOrigin)
+		SHADER_PARAMETER(float, ScreenMultiple)
+		SHADER_PARAMETER(float, ProjM23)
+		SHADER_PARAMETER(float, LODScale)
+		SHADER_PARAMETER(float, CullScreenSize)
+		SHADER_PARAMETER_SRV(Buffer<float>, InstanceBounds)
+		SHADER_PARAMETER_SRV(Buffer<uint>, InstanceFlags)
+		SHADER_PARAMETER_SRV(Buffer<uint>, InstanceMeshSlots)
+		SHADER_PARAMETER_SRV(StructuredBuffer<FAllegroGPUCullSubMesh>, SubMeshes)
+		SHADER_PARAMETER_UAV(RWBuffer<uint>, RWBucketCounters)
+		SHADER_PARAMETER_UAV(RWBuffer<uint>, RWElementIndices)
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE"), ALLEGRO_GPU_CULL_GROUP_SIZE);
+		OutEnvironment.SetDefine(TEXT("ALLEGRO_MAX_LOD"), ALLEGRO_MAX_LOD);
+		OutEnvironment.SetDefine(TEXT("ALLEGRO_GPU_CULL_MAX_PLANES"), ALLEGRO_GPU_CULL_MAX_PLANES);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FAllegroCullCS, "/Plugin/Allegro/Private/AllegroCull.usf", "CullCS", SF_Compute);
+
+
+class FAllegroBucketOffsetsCS : public FGlobalShader
+{
+	DECLARE_GLOBAL_SHADER(FAllegroBucketOffsetsCS);
+	SHADER_USE_PARAMETER_STRUCT(FAllegroBucketOffsetsCS, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER(uint32, NumBucket)
+		SHADER_PARAMETER_UAV(RWBuffer<uint>, RWBucketCounters)
+		SHADER_PARAMETER_UAV(RWBuffer<uint>, RWElementIndices)
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE"), ALLEGRO_GPU_CULL_GROUP_SIZE);
+		OutEnvironment.SetDefine(TEXT("ALLEGRO_MAX_LOD"), ALLEGRO_MAX_LOD);
+		OutEnvironment.SetDefine(TEXT("ALLEGRO_GPU_CULL_MAX_PLANES"), ALLEGRO_GPU_CULL_MAX_PLANES);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FAllegroBucketOffsetsCS, "/Plugin/Allegro/Private/AllegroCull.usf", "BucketOffsetsCS", SF_Compute);
+
+
+class FAllegroBuildArgsCS : public FGlobalShader
+{
+	DECLARE_GLOBAL_SHADER(FAllegroBuildArgsCS);
+	SHADER_USE_PARAMETER_STRUCT(FAllegroBuildArgsCS, FGlobalShader);
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER(uint32, NumDraws)
+		SHADER_PARAMETER_SRV(StructuredBuffer<FAllegroGPUCullDraw>, Draws)
+		SHADER_PARAMETER_SRV(Buffer<uint>, BucketCounters)
+		SHADER_PARAMETER_UAV(RWBuffer<uint>, RWIndirectArgs)
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return IsFeatureLevelSupported(Parameters.Platform, ERHIFeatureLevel::SM5);
+	}
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE"), ALLEGRO_GPU_CULL_GROUP_SIZE);
+		OutEnvironment.SetDefine(TEXT("ALLEGRO_MAX_LOD"), ALLEGRO_MAX_LOD);
+		OutEnvironment.SetDefine(TEXT("ALLEGRO_GPU_CULL_MAX_PLANES"), ALLEGRO_GPU_CULL_MAX_PLANES);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FAllegroBuildArgsCS, "/Plugin/Allegro/Private/AllegroCull.usf", "BuildArgsCS", SF_Compute);
+
+
+
+void FAllegroGPUCullView::Init(const FSceneView* View, const FConvexVolume& Frustum, float InLODScale, float InCullScreenSize, bool bInFrustumCull)
+{
+	check(Frustum.Planes.Num() <= ALLEGRO_GPU_CULL_MAX_PLANES);
+	NumPlanes = FMath::Min<uint32>(Frustum.Planes.Num(), ALLEGRO_GPU_CULL_MAX_PLANES);
+	for (uint32 PlaneIndex = 0; PlaneIndex < NumPlanes; PlaneIndex++)
+	{
+		const FPlane& P = Frustum.Planes[PlaneIndex];
+		Planes[PlaneIndex] = FVector4f(P.X, P.Y, P.Z, P.W);
+	}
+
+	//same as ComputeBoundsScreenRadiusSquared
+	const FMatrix& ProjMatrix = View->ViewMatrices.GetProjectionMatrix();
+	ViewOrigin = FVector3f(View->ViewMatrices.GetViewOrigin());
+	ScreenMultiple = FMath::Max(0.5f * static_cast<float>(ProjMatrix.M[0][0]), 0.5f * static_cast<float>(ProjMatrix.M[1][1]));
+	ProjM23 = static_cast<float>(ProjMatrix.M[2][3]);
+
+	LODScale = InLODScale;
+	CullScreenSize = InCullScreenSize;
+	bFrustumCull = bInFrustumCull;
+	bComputeLOD = View->Family && View->Family->EngineShowFlags.LOD;
+}
+
+void AllegroCullReference(const FAllegroGPUCullView& CullView, const FAllegroDynamicData& DynData, uint8 MaxMeshPerInstance, TConstArrayView<FAllegroGPUCullSubMesh> SubMeshes, TArray<uint32>* OutBuckets)
+{
+	const uint32 NumSubMesh = static_cast<uint32>(SubMeshes.Num());
+
+	for (uint32 InstanceIndex = 0; InstanceIndex < DynData.InstanceCount; InstanceIndex++)
+	{
+		if (EnumHasAnyFlags(DynData.Flags[InstanceIndex], EAllegroInstanceFlags::EIF_Destroyed | EAllegroInstanceFlags::EIF_Hidden))
+			continue;
+
+		const FVector3f Center = DynData.Bounds[InstanceIndex].Center;
+		const FVector3f Extent = DynData.Bounds[InstanceIndex].Extent;
+
+		bool bCulled = false;
+		if (CullView.bFrustumCull)
+		{
+			for (uint32 PlaneIndex = 0; PlaneIndex < CullView.NumPlanes; PlaneIndex++)
+			{
+				const FVector4f& P = CullView.Planes[PlaneIndex];
+				const float Dist = (Center.X * P.X + Center.Y * P.Y + Center.Z * P.Z) - P.W;
+				const float PushOut = FMath::Abs(P.X) * Extent.X + FMath::Abs(P.Y) * Extent.Y + FMath::Abs(P.Z) * Extent.Z;
+				if (Dist > PushOut)
+				{
+					bCulled = true;
+					break;
+				}
+			}
+		}
+
+		if (bCulled)
+			continue;
+
+		const FVector3f ToView = Center - CullView.ViewOrigin;
+		const float DistSqr = FMath::Max(1.0f, (ToView.X * ToView.X + ToView.Y * ToView.Y + ToView.Z * ToView.Z) * CullView.ProjM23);
+		const float MaxExtent = FMath::Max(FMath::Max(Extent.Y, Extent.Z), Extent.X);
+
+		const uint8* MeshSlotIter = DynData.MeshSlots + InstanceIndex * (MaxMeshPerInstance + 1);
+		for (uint32 SlotIndex = 0; SlotIndex < (uint32)MaxMeshPerInstance + 1; SlotIndex++)
+		{
+			const uint8 SubMeshIdx = *MeshSlotIter++;
+			if (SubMeshIdx == 0xFF) //data should be terminated with 0xFF
+				break;
+
+			if (SubMeshIdx >= NumSubMesh)
+				continue;
+
+			const FAllegroGPUCullSubMesh& SubMesh = SubMeshes[SubMeshIdx];
+			if (!SubMesh.bIsValid)
+				continue;
+
+			const float Radius = MaxExtent * SubMesh.ExtentFactor;
+			const float ScreenRadiusSquared = (FMath::Square(CullView.ScreenMultiple * Radius) / DistSqr) * CullView.LODScale * CullView.LODScale;
+			if (CullView.CullScreenSize > ScreenRadiusSquared)
+				continue;
+
+			uint32 LODLevel = 0;
+			if (CullView.bComputeLOD)
+			{
+				//iterate from worst to best LOD
+				for (int32 L = static_cast<int32>(SubMesh.LodNum) - 1; L > 0; L--)
+				{
+					if (SubMesh.LODScreenSizeSq[L] > ScreenRadiusSquared)
+					{
+						LODLevel = static_cast<uint32>(L);
+						break;
+					}
+				}
+
+				//past the last skeletal LOD, draw the impostor
+				if (SubMesh.ImpostorLOD < ALLEGRO_MAX_LOD && SubMesh.LODScreenSizeSq[SubMesh.ImpostorLOD] > ScreenRadiusSquared)
+					LODLevel = SubMesh.ImpostorLOD;
+			}
+
+			OutBuckets[AllegroGPUCullBucket(SubMeshIdx, SubMesh.LODRemap[LODLevel])].Add(InstanceIndex);
+		}
+	}
+}
+
+void FAllegroGPUCullInput::Update(FRHICommandListBase& RHICmdList, const FAllegroDynamicData& DynData, uint8 MaxMeshPerInstance)
+{
+	if (UploadedData == &DynData)
+		return;
+
+	UploadedData = &DynData;
+
+	const uint32 InstanceCount = DynData.InstanceCount;
+	const uint32 InMeshSlotStride = MaxMeshPerInstance + 1;
+
+	if (InstanceCount > InstanceCapacity || InMeshSlotStride != MeshSlotStride)
+	{
+		InstanceCapacity = Align(FMath::Max(InstanceCount, 1u), SizeAlign);
+		MeshSlotStride = InMeshSlotStride;
+		{
+			FRHIResourceCreateInfo CreateInfo(TEXT("AllegroCullBounds"));
+			BoundsBuffer = RHICmdList.CreateVertexBuffer(InstanceCapacity * sizeof(FBoxCenterExtentFloat), (BUF_Dynamic | BUF_ShaderResource), CreateInfo);
+			BoundsSRV = RHICmdList.CreateShaderResourceView(BoundsBuffer, sizeof(float), PF_R32_FLOAT);
+		}
+		{
+			FRHIResourceCreateInfo CreateInfo(TEXT("AllegroCullFlags"));
+			FlagsBuffer = RHICmdList.CreateVertexBuffer(InstanceCapacity * sizeof(EAllegroInstanceFlags), (BUF_Dynamic | BUF_ShaderResource), CreateInfo);
+			FlagsSRV = RHICmdList.CreateShaderResourceView(FlagsBuffer, sizeof(uint16), PF_R16_UINT);
+		}
+		{
+			FRHIResourceCreateInfo CreateInfo(TEXT("AllegroCullMeshSlots"));
+			MeshSlotsBuffer = RHICmdList.CreateVertexBuffer(InstanceCapacity * MeshSlotStride, (BUF_Dynamic | BUF_ShaderResource), CreateInfo);
+			MeshSlotsSRV = RHICmdList.CreateShaderResourceView(MeshSlotsBuffer, sizeof(uint8), PF_R8_UINT);
+		}
+	}
+
+	if (InstanceCount == 0)
+		return;
+
+	void* MappedBounds = RHICmdList.LockBuffer(BoundsBuffer, 0, InstanceCount * sizeof(FBoxCenterExtentFloat), RLM_WriteOnly);
+	FMemory::Memcpy(MappedBounds, DynData.Bounds, InstanceCount * sizeof(FBoxCenterExtentFloat));
+	RHICmdList.UnlockBuffer(BoundsBuffer);
+
+	void* MappedFlags = RHICmdList.LockBuffer(FlagsBuffer, 0, InstanceCount * sizeof(EAllegroInstanceFlags), RLM_WriteOnly);
+	FMemory::Memcpy(MappedFlags, DynData.Flags, InstanceCount * sizeof(EAllegroInstanceFlags));
+	RHICmdList.UnlockBuffer(FlagsBuffer);
+
+	void* MappedMeshSlots = RHICmdList.LockBuffer(MeshSlotsBuffer, 0, InstanceCount * MeshSlotStride, RLM_WriteOnly);
+	FMemory::Memcpy(MappedMeshSlots, DynData.MeshSlots, InstanceCount * MeshSlotStride);
+	RHICmdList.UnlockBuffer(MeshSlotsBuffer);
+}
+
+
+void FAllegroGPUCullInput::Release()
+{
+	BoundsSRV = nullptr;
+	BoundsBuffer = nullptr;
+	FlagsSRV = nullptr;
+	FlagsBuffer = nullptr;
+	MeshSlotsSRV = nullptr;
+	MeshSlotsBuffer = nullptr;
+	InstanceCapacity = MeshSlotStride = 0;
+	UploadedData = nullptr;
+}
+
+SIZE_T FAllegroGPUCullInput::GetAllocatedSize() const
+{
+	return BoundsBuffer ? InstanceCapacity * (sizeof(FBoxCenterExtentFloat) + sizeof(EAllegroInstanceFlags) + MeshSlotStride) : 0;
+}
+
+TSharedPtr<FAllegroGPUCullOutput> FAllegroGPUCullOutput::Create(uint32 InNumElement)
+{
+	FRHICommandListBase& RHICmdList = FRHICommandListImmediate::Get();
+
+	FAllegroGPUCullOutputPtr Resource = MakeShared<FAllegroGPUCullOutput>();
+	Resource->NumElement = InNumElement;
+
+	{
+		FRHIResourceCreateInfo CreateInfo(TEXT("AllegroCullElementIndices"));
+		Resource->ElementIndexBuffer = RHICmdList.CreateVertexBuffer(InNumElement * sizeof(uint32), (BUF_UnorderedAccess | BUF_ShaderResource), CreateInfo);
+		Resource->ElementIndexSRV = RHICmdList.CreateShaderResourceView(Resource->ElementIndexBuffer, sizeof(uint32), PF_R32_UINT);
+		Resource->ElementIndexUAV = RHICmdList.CreateUnorderedAccessView(Resource->ElementIndexBuffer, PF_R32_UINT);
+	}
+	{
+		FRHIResourceCreateInfo CreateInfo(TEXT("AllegroCullBucketCounters"));
+		Resource->BucketCounterBuffer = RHICmdList.CreateVertexBuffer(ALLEGRO_GPU_CULL_NUM_BUCKET * 2 * sizeof(uint32), (BUF_UnorderedAccess | BUF_ShaderResource), CreateInfo);
+		Resource->BucketCounterSRV = RHICmdList.CreateShaderResourceView(Resource->BucketCounterBuffer, sizeof(uint32), PF_R32_UINT);
+		Resource->BucketCounterUAV = RHICmdList.CreateUnorderedAccessView(Resource->BucketCounterBuffer, PF_R32_UINT);
+	}
+	{
+		FRHIResourceCreateInfo CreateInfo(TEXT("AllegroCullSubMeshes"));
+		Resource->SubMeshBuffer = RHICmdList.CreateStructuredBuffer(sizeof(FAllegroGPUCullSubMesh), ALLEGRO_MAX_SUBMESH * sizeof(FAllegroGPUCullSubMesh), (BUF_Dynamic | BUF_ShaderResource), CreateInfo);
+		Resource->SubMeshSRV = RHICmdList.CreateShaderResourceView(Resource->SubMeshBuffer);
+	}
+
+	return Resource;
+}
+
+void FAllegroGPUCullOutput::EnsureDrawCapacity(FRHICommandListBase& RHICmdList, uint32 NumDraw)
+{
+	if (NumDraw <= DrawCapacity)
+		return;
+
+	DrawCapacity = Align(NumDraw, 256);
+	{
+		FRHIResourceCreateInfo CreateInfo(TEXT("AllegroCullDraws"));
+		DrawBuffer = RHICmdList.CreateStructuredBuffer(sizeof(FAllegroGPUCullDraw), DrawCapacity * sizeof(FAllegroGPUCullDraw), (BUF_Dynamic | BUF_ShaderResource), CreateInfo);
+		DrawSRV = RHICmdList.CreateShaderResourceView(DrawBuffer);
+	}
+	{
+		FRHIResourceCreateInfo CreateInfo(TEXT("AllegroCullIndirectArgs"));
+		IndirectArgsBuffer = RHICmdList.CreateVertexBuffer(DrawCapacity * ALLEGRO_GPU_CULL_ARGS_STRIDE, (BUF_DrawIndirect | BUF_UnorderedAccess | BUF_ShaderResource), CreateInfo);
+		IndirectArgsUAV = RHICmdList.CreateUnorderedAccessView(IndirectArgsBuffer, PF_R32_UINT);
+	}
+}
+
+FAllegroGPUCullOutputAllocator GAllegroGPUCullOutputPool;
+
+
+
+void AllegroDispatchGPUCull(FRHICommandListImmediate& RHICmdList, const FAllegroGPUCullInput& Input, FAllegroGPUCullOutput& Output, const FAllegroGPUCullView& CullView,
+	TConstArrayView<FAllegroGPUCullSubMesh> SubMeshes, uint32 InstanceCount, uint8 MaxMeshPerInstance)
+{
+	ALLEGRO_SCOPE_CYCLE_COUNTER(DispatchGPUCull);
+	check(SubMeshes.Num() <= ALLEGRO_MAX_SUBMESH);
+
+	const uint32 NumBucket = SubMeshes.Num() * ALLEGRO_MAX_LOD;
+	check(NumBucket < Output.NumElement);
+
+	void* MappedSubMeshes = RHICmdList.LockBuffer(Output.SubMeshBuffer, 0, SubMeshes.Num() * sizeof(FAllegroGPUCullSubMesh), RLM_WriteOnly);
+	FMemory::Memcpy(MappedSubMeshes, SubMeshes.GetData(), SubMeshes.Num() * sizeof(FAllegroGPUCullSubMesh));
+	RHICmdList.UnlockBuffer(Output.SubMeshBuffer);
+
+	RHICmdList.Transition({
+		FRHITransitionInfo(Output.BucketCounterUAV, ERHIAccess::Unknown, ERHIAccess::UAVCompute),
+		FRHITransitionInfo(Output.ElementIndexUAV, ERHIAccess::Unknown, ERHIAccess::UAVCompute)
+	});
+	RHICmdList.ClearUAVUint(Output.BucketCounterUAV, FUintVector4(0, 0, 0, 0));
+	RHICmdList.Transition(FRHITransitionInfo(Output.BucketCounterUAV, ERHIAccess::UAVCompute, ERHIAccess::UAVCompute));
+
+	FAllegroCullCS::FParameters Params;
+	Params.InstanceCount = InstanceCount;
+	Params.MaxMeshPerInstance = MaxMeshPerInstance;
+	Params.NumSubMesh = SubMeshes.Num();
+	Params.NumPlanes = CullView.NumPlanes;
+	Params.bFrustumCull = CullView.bFrustumCull ? 1 : 0;
+	Params.bComputeLOD = CullView.bComputeLOD ? 1 : 0;
+	Params.NumBucket = NumBucket;
+	Params.ElementCapacity = Output.NumElement;
+	for (uint32 PlaneIndex = 0; PlaneIndex < ALLEGRO_GPU_CULL_MAX_PLANES; PlaneIndex++)
+		Params.Planes[PlaneIndex] = CullView.Planes[PlaneIndex];
+	Params.ViewOrigin = CullView.ViewOrigin;
+	Params.ScreenMultiple = CullView.ScreenMultiple;
+	Params.ProjM23 = CullView.ProjM23;
+	Params.LODScale = CullView.LODScale;
+	Params.CullScreenSize = CullView.CullScreenSize;
+	Params.InstanceBounds = Input.BoundsSRV;
+	Params.InstanceFlags = Input.FlagsSRV;
+	Params.InstanceMeshSlots = Input.MeshSlotsSRV;
+	Params.SubMeshes = Output.SubMeshSRV;
+	Params.RWBucketCounters = Output.BucketCounterUAV;
+	Params.RWElementIndices = Output.ElementIndexUAV;
+
+	const FIntVector GroupCount = FComputeShaderUtils::GetGroupCount(FMath::Max(InstanceCount, 1u), ALLEGRO_GPU_CULL_GROUP_SIZE);
+	FGlobalShaderMap* ShaderMap = GetGlobalShaderMap(GMaxRHIFeatureLevel);
+
+	//count pass
+	{
+		FAllegroCullCS::FPermutationDomain PermutationVector;
+		PermutationVector.Set<FAllegroCullCS::FScatterDim>(false);
+		TShaderMapRef<FAllegroCullCS> CountCS(ShaderMap, PermutationVector);
+		FComputeShaderUtils::Dispatch(RHICmdList, CountCS, Params, GroupCount);
+	}
+
+	RHICmdList.Transition(FRHITransitionInfo(Output.BucketCounterUAV, ERHIAccess::UAVCompute, ERHIAccess::UAVCompute));
+
+	//prefix sum of the counters, written to the head of the element indices
+	{
+		FAllegroBucketOffsetsCS::FParameters OffsetsParams;
+		OffsetsParams.NumBucket = NumBucket;
+		OffsetsParams.RWBucketCounters = Output.BucketCounterUAV;
+		OffsetsParams.RWElementIndices = Output.ElementIndexUAV;
+		TShaderMapRef<FAllegroBucketOffsetsCS> OffsetsCS(ShaderMap);
+		FComputeShaderUtils::Dispatch(RHICmdList, OffsetsCS, OffsetsParams, FIntVector(1, 1, 1));
+	}
+
+	RHICmdList.Transition({
+		FRHITransitionInfo(Output.BucketCounterUAV, ERHIAccess::UAVCompute, ERHIAccess::UAVCompute),
+		FRHITransitionInfo(Output.ElementIndexUAV, ERHIAccess::UAVCompute, ERHIAccess::UAVCompute)
+	});
+
+	//scatter pass, same decisions as the count pass
+	{
+		FAllegroCullCS::FPermutationDomain PermutationVector;
+		PermutationVector.Set<FAllegroCullCS::FScatterDim>(true);
+		TShaderMapRef<FAllegroCullCS> ScatterCS(ShaderMap, PermutationVector);
+		FComputeShaderUtils::Dispatch(RHICmdList, ScatterCS, Params, GroupCount);
+	}
+
+	RHICmdList.Transition({
+		FRHITransitionInfo(Output.BucketCounterUAV, ERHIAccess::UAVCompute, ERHIAccess::SRVCompute),
+		FRHITransitionInfo(Output.ElementIndexUAV, ERHIAccess::UAVCompute, ERHIAccess::SRVMask)
+	});
+}
+
+void AllegroDispatchGPUCullArgs(FRHICommandListImmediate& RHICmdList, FAllegroGPUCullOutput& Output, TConstArrayView<FAllegroGPUCullDraw> Draws)
+{
+	ALLEGRO_SCOPE_CYCLE_COUNTER(DispatchGPUCullArgs);
+
+	if (Draws.Num() == 0)
+		return;
+
+	check((uint32)Draws.Num() <= Output.DrawCapacity);
+	void* MappedDraws = RHICmdList.LockBuffer(Output.DrawBuffer, 0, Draws.Num() * sizeof(FAllegroGPUCullDraw), RLM_WriteOnly);
+	FMemory::Memcpy(MappedDraws, Draws.GetData(), Draws.Num() * sizeof(FAllegroGPUCullDraw));
+	RHICmdList.UnlockBuffer(Output.DrawBuffer);
+
+	RHICmdList.Transition(FRHITransitionInfo(Output.IndirectArgsUAV, ERHIAccess::Unknown, ERHIAccess::UAVCompute));
+
+	FAllegroBuildArgsCS::FParameters Params;
+	Params.NumDraws = Draws.Num();
+	Params.Draws = Output.DrawSRV;
+	Params.BucketCounters = Output.BucketCounterSRV;
+	Params.RWIndirectArgs = Output.IndirectArgsUAV;
+
+	TShaderMapRef<FAllegroBuildArgsCS> BuildArgsCS(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	FComputeShaderUtils::Dispatch(RHICmdList, BuildArgsCS, Params, FComputeShaderUtils::GetGroupCount(Draws.Num(), ALLEGRO_GPU_CULL_GROUP_SIZE));
+
+	RHICmdList.Transition(FRHITransitionInfo(Output.IndirectArgsUAV, ERHIAccess::UAVCompute, ERHIAccess::IndirectArgs | ERHIAccess::SRVMask));
+}
+
+struct FAllegroGPUCullPendingVerify
+{
+	FRHIGPUBufferReadback CounterReadback{ TEXT("AllegroCullVerifyCounters") };
+	FRHIGPUBufferReadback ElementReadback{ TEXT("AllegroCullVerifyElements") };
+	TArray<TArray<uint32>> RefBuckets;
+	uint32 NumElement = 0;
+	uint32 InstanceCount = 0;
+};
+
+//render thread only
+static TArray<TUniquePtr<FAllegroGPUCullPendingVerify>> GAllegroGPUCullPendingVerifies;
+
+void AllegroVerifyGPUCull(FRHICommandListImmediate& RHICmdList, FAllegroGPUCullOutput& Output, TArray<TArray<uint32>>&& RefBuckets, uint32 InstanceCount)
+{
+	check(IsInRenderingThread());
+
+	TUniquePtr<FAllegroGPUCullPendingVerify> Pending = MakeUnique<FAllegroGPUCullPendingVerify>();
+	Pending->RefBuckets = MoveTemp(RefBuckets);
+	Pending->NumElement = Output.NumElement;
+	Pending->InstanceCount = InstanceCount;
+	//copies are taken now, the pooled output can be reused before they are read
+	Pending->CounterReadback.EnqueueCopy(RHICmdList, Output.BucketCounterBuffer);
+	Pending->ElementReadback.EnqueueCopy(RHICmdList, Output.ElementIndexBuffer);
+	GAllegroGPUCullPendingVerifies.Add(MoveTemp(Pending));
+}
+
+void AllegroPollGPUCullVerify()
+{
+	check(IsInRenderingThread());
+
+	for (int32 PendingIndex = GAllegroGPUCullPendingVerifies.Num() - 1; PendingIndex >= 0; PendingIndex--)
+	{
+		FAllegroGPUCullPendingVerify& Pending = *GAllegroGPUCullPendingVerifies[PendingIndex];
+		if (!Pending.CounterReadback.IsReady() || !Pending.ElementReadback.IsReady())
+			continue;
+
+		const uint32 NumBucket = static_cast<uint32>(Pending.RefBuckets.Num());
+		const uint32* Counters = static_cast<const uint32*>(Pending.CounterReadback.Lock(NumBucket * sizeof(uint32)));
+		const uint32* Elements = static_cast<const uint32*>(Pending.ElementReadback.Lock(Pending.NumElement * sizeof(uint32)));
+
+		//reference has no occlusion either, both must select exactly the same instances for every bucket. order inside a bucket is ignored
+		uint32 NumMismatchBucket = 0;
+		uint32 TotalMissing = 0;
+		uint32 TotalExtra = 0;
+		TArray<uint32> GPUBucket;
+		for (uint32 Bucket = 0; Bucket < NumBucket; Bucket++)
+		{
+			const TArray<uint32>& RefBucket = Pending.RefBuckets[Bucket];
+			const uint32 Offset = Elements[Bucket];
+			const uint32 NumGPU = Counters[Bucket];
+			if (Offset < NumBucket || Offset + NumGPU > Pending.NumElement)
+			{
+				NumMismatchBucket++;
+				UE_LOG(LogAllegro, Warning, TEXT("GPUCull bucket out of range. SubMesh:%d LOD:%d Offset:%d Num:%d"), Bucket / ALLEGRO_MAX_LOD, Bucket % ALLEGRO_MAX_LOD, Offset, NumGPU);
+				continue;
+			}
+
+			GPUBucket.Reset();
+			GPUBucket.Append(Elements + Offset, NumGPU);
+			GPUBucket.Sort();
+
+			//missing: in the reference but not drawn by GPU. extra: drawn by GPU but not in the reference (duplicates count as extra)
+			int32 NumMissing = 0;
+			int32 NumExtra = 0;
+			int32 GPUIter = 0;
+			int32 RefIter = 0;
+			while (GPUIter < GPUBucket.Num() || RefIter < RefBucket.Num())
+			{
+				if (RefIter == RefBucket.Num() || (GPUIter < GPUBucket.Num() && GPUBucket[GPUIter] < RefBucket[RefIter]))
+				{
+					NumExtra++;
+					GPUIter++;
+				}
+				else if (GPUIter == GPUBucket.Num() || RefBucket[RefIter] < GPUBucket[GPUIter])
+				{
+					NumMissing++;
+					RefIter++;
+				}
+				else
+				{
+					GPUIter++;
+					RefIter++;
+				}
+			}
+
+			TotalMissing += NumMissing;
+			TotalExtra += NumExtra;
+			if (NumMissing > 0 || NumExtra > 0)
+			{
+				NumMismatchBucket++;
+				UE_LOG(LogAllegro, Warning, TEXT("GPUCull mismatch. SubMesh:%d LOD:%d GPU:%d Ref:%d Missing:%d Extra:%d"), Bucket / ALLEGRO_MAX_LOD, Bucket % ALLEGRO_MAX_LOD, GPUBucket.Num(), RefBucket.Num(), NumMissing, NumExtra);
+			}
+		}
+
+		Pending.ElementReadback.Unlock();
+		Pending.CounterReadback.Unlock();
+
+		UE_LOG(LogAllegro, Log, TEXT("GPUCull verify %s. InstanceCount:%d NumMismatchBucket:%d Missing:%d Extra:%d"), NumMismatchBucket == 0 ? TEXT("passed") : TEXT("failed"), Pending.InstanceCount, NumMismatchBucket, TotalMissing, TotalExtra);
+		GAllegroGPUCullPendingVerifies.RemoveAt(PendingIndex);
+	}
+}
+
+#endif
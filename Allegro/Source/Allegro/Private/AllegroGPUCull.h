@@ -0,0 +1,144 @@
+// Copyright 2024 Lazy Marmot Games. All Rights Reserved.
+
+#pragma once
+
+#include "Allegro.h"
+#include "RHI.h"
+#include "RHIResources.h"
+#include "GlobalShader.h"
+#include "ShaderParameterStruct.h"
+#include "AllegroResourcePool.h"
+
+#if ALLEGRO_GPU_CULL
+
+struct FAllegroDynamicData;
+class FSceneView;
+struct FConvexVolume;
+
+static constexpr uint32 ALLEGRO_GPU_CULL_MAX_PLANES = 8;
+static constexpr uint32 ALLEGRO_GPU_CULL_GROUP_SIZE = 64;
+static constexpr uint32 ALLEGRO_GPU_CULL_NUM_BUCKET = ALLEGRO_MAX_SUBMESH * ALLEGRO_MAX_LOD;
+static constexpr uint32 ALLEGRO_GPU_CULL_ARGS_STRIDE = sizeof(uint32) * 5;	//FRHIDrawIndexedIndirectParameters
+
+//elements of a sub mesh LOD are written to a bucket
+inline uint32 AllegroGPUCullBucket(uint32 SubMeshIdx, uint32 LODIndex) { return SubMeshIdx * ALLEGRO_MAX_LOD + LODIndex; }
+//InstanceOffset of GPU culled batches is the bucket with this flag, the vertex factory reads the bucket offset from the head of the element indices
+static constexpr uint32 ALLEGRO_GPU_CULL_BUCKET_FLAG = 0x80000000u;
+
+//layout must match FAllegroGPUCullSubMesh of AllegroCull.usf
+struct FAllegroGPUCullSubMesh
+{
+	float ExtentFactor = 1;
+	uint32 LodNum = 0;
+	uint32 bIsValid = 0;
+	uint32 ImpostorLOD = 0xFF;	//LODScreenSizeSq[ImpostorLOD] is the impostor screen size
+	float LODScreenSizeSq[ALLEGRO_MAX_LOD] = {};	//FMath::Square(LODScreenSize * 0.5f)
+	uint32 LODRemap[ALLEGRO_MAX_LOD] = {};
+};
+
+//layout must match FAllegroGPUCullDraw of AllegroCull.usf, one per FMeshBatch
+struct FAllegroGPUCullDraw
+{
+	uint32 Bucket;
+	uint32 IndexCount;
+	uint32 StartIndex;
+	uint32 BaseVertex;
+};
+
+//view dependent parameters of the cull pass
+struct FAllegroGPUCullView
+{
+	FVector4f Planes[ALLEGRO_GPU_CULL_MAX_PLANES];
+	uint32 NumPlanes = 0;
+	bool bFrustumCull = true;
+	bool bComputeLOD = true;
+	FVector3f ViewOrigin;
+	float ScreenMultiple = 0;
+	float ProjM23 = 0;
+	float LODScale = 1;
+	float CullScreenSize = 0;
+
+	void Init(const FSceneView* View, const FConvexVolume& Frustum, float InLODScale, float InCullScreenSize, bool bInFrustumCull);
+};
+
+
+/*
+* per proxy input of the cull pass, uploaded once per dynamic data
+*/
+struct FAllegroGPUCullInput
+{
+	static const uint32 SizeAlign = 4096;
+
+	FBufferRHIRef BoundsBuffer;
+	FShaderResourceViewRHIRef BoundsSRV;
+	FBufferRHIRef FlagsBuffer;
+	FShaderResourceViewRHIRef FlagsSRV;
+	FBufferRHIRef MeshSlotsBuffer;
+	FShaderResourceViewRHIRef MeshSlotsSRV;
+
+	uint32 InstanceCapacity = 0;
+	uint32 MeshSlotStride = 0;
+	const FAllegroDynamicData* UploadedData = nullptr;	//data is uploaded once, shared by all views of the frame
+
+	//uploads bounds, flags and mesh slots of @DynData if they are not already
+	void Update(FRHICommandListBase& RHICmdList, const FAllegroDynamicData& DynData, uint8 MaxMeshPerInstance);
+	//must be called when dynamic data is replaced or modified in place
+	void Invalidate() { UploadedData = nullptr; }
+	void Release();
+	SIZE_T GetAllocatedSize() const;
+};
+
+/*
+* per view output of the cull pass.
+* buckets are compacted, element indices start with the offset of each bucket followed by the elements. bucket counters are followed by the write cursors of the scatter pass
+*/
+struct FAllegroGPUCullOutput : TSharedFromThis<FAllegroGPUCullOutput>
+{
+	static const uint32 SizeAlign = 4096;	//NumElement is aligned to this
+
+	FBufferRHIRef ElementIndexBuffer;
+	FShaderResourceViewRHIRef ElementIndexSRV;
+	FUnorderedAccessViewRHIRef ElementIndexUAV;
+
+	FBufferRHIRef BucketCounterBuffer;
+	FShaderResourceViewRHIRef BucketCounterSRV;
+	FUnorderedAccessViewRHIRef BucketCounterUAV;
+
+	FBufferRHIRef SubMeshBuffer;
+	FShaderResourceViewRHIRef SubMeshSRV;
+
+	FBufferRHIRef DrawBuffer;
+	FShaderResourceViewRHIRef DrawSRV;
+	FBufferRHIRef IndirectArgsBuffer;
+	FUnorderedAccessViewRHIRef IndirectArgsUAV;
+
+	uint32 NumElement = 0;
+	uint32 DrawCapacity = 0;
+
+	uint32 GetSize() const { return NumElement; }
+	void EnsureDrawCapacity(FRHICommandListBase& RHICmdList, uint32 NumDraw);
+
+	static TSharedPtr<FAllegroGPUCullOutput> Create(uint32 InNumElement);
+};
+
+typedef TSharedPtr<FAllegroGPUCullOutput> FAllegroGPUCullOutputPtr;
+typedef TBufferAllocatorSingle<FAllegroGPUCullOutputPtr> FAllegroGPUCullOutputAllocator;
+extern FAllegroGPUCullOutputAllocator GAllegroGPUCullOutputPool;
+
+
+//culls all instances and writes visible instance indices to the compacted buckets of @Output. counts, computes bucket offsets then scatters
+void AllegroDispatchGPUCull(FRHICommandListImmediate& RHICmdList, const FAllegroGPUCullInput& Input, FAllegroGPUCullOutput& Output, const FAllegroGPUCullView& CullView,
+	TConstArrayView<FAllegroGPUCullSubMesh> SubMeshes, uint32 InstanceCount, uint8 MaxMeshPerInstance);
+
+//writes indirect draw arguments of @Draws, must be called after AllegroDispatchGPUCull
+void AllegroDispatchGPUCullArgs(FRHICommandListImmediate& RHICmdList, FAllegroGPUCullOutput& Output, TConstArrayView<FAllegroGPUCullDraw> Draws);
+
+//CPU version of CullCS, adds visible instances to @OutBuckets (SubMeshes.Num() * ALLEGRO_MAX_LOD arrays) in increasing order. used by allegro.GPUCullVerify
+void AllegroCullReference(const FAllegroGPUCullView& CullView, const FAllegroDynamicData& DynData, uint8 MaxMeshPerInstance, TConstArrayView<FAllegroGPUCullSubMesh> SubMeshes, TArray<uint32>* OutBuckets);
+
+//queues a readback of @Output, compared by AllegroPollGPUCullVerify once it is ready. @RefBuckets are the buckets of AllegroCullReference for the same dispatch
+void AllegroVerifyGPUCull(FRHICommandListImmediate& RHICmdList, FAllegroGPUCullOutput& Output, TArray<TArray<uint32>>&& RefBuckets, uint32 InstanceCount);
+//compares and logs the readbacks that are ready, never waits for the GPU
+void AllegroPollGPUCullVerify();
+
+#endif
@@ -12,6 +12,8 @@ struct ALLEGRO_API FAllegroObjectVersion
 		// Before any version changes were made
 		BeforeCustomVersionWasAdded = 0,
 
+		// cooked collections carry their baked animation data
+		CookedAnimationPayload,
 
 		// -----<new versions can be added above this line>-------------------------------------------------
 		VersionPlusOne,
@@ -9,6 +9,51 @@ DEFINE_STAT(STAT_ALLEGRO_ViewNumVisible);
 
 DEFINE_STAT(STAT_ALLEGRO_ShadowNumCulled);
 DEFINE_STAT(STAT_ALLEGRO_ShadowNumVisible);
+DEFINE_STAT(STAT_ALLEGRO_ShadowNumSharedDataReuse);
 
 DEFINE_STAT(STAT_ALLEGRO_NumTransitionPoseGenerated);
+DEFINE_STAT(STAT_ALLEGRO_NumPrebakedTransitionUsed);
 
+DEFINE_STAT(STAT_ALLEGRO_NumRenderDirtyInstance);
+DEFINE_STAT(STAT_ALLEGRO_NumSkippedRenderUpdate);
+DEFINE_STAT(STAT_ALLEGRO_NumCullGridRecoveryRebuild);
+DEFINE_STAT(STAT_ALLEGRO_NumPersistentUploadedInstance);
+DEFINE_STAT(STAT_ALLEGRO_NumOcclusionCulledCell);
+DEFINE_STAT(STAT_ALLEGRO_NumBudgetLoweredLOD);
+DEFINE_STAT(STAT_ALLEGRO_NumStreamedInSequence);
+DEFINE_STAT(STAT_ALLEGRO_NumEvictedSequence);
+
+
+#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+
+bool FAllegroBenchmarkCounter::bEnabled = false;
+
+static std::atomic<FAllegroBenchmarkCounter*> GAllegroBenchmarkCounterHead(nullptr);
+
+void FAllegroBenchmarkCounter::Register()
+{
+	if (bRegistered.exchange(true))
+		return;
+
+	FAllegroBenchmarkCounter* Head = GAllegroBenchmarkCounterHead.load();
+	do
+	{
+		Next = Head;
+	} while (!GAllegroBenchmarkCounterHead.compare_exchange_weak(Head, this));
+}
+
+FAllegroBenchmarkCounter* FAllegroBenchmarkCounter::GetFirst()
+{
+	return GAllegroBenchmarkCounterHead.load();
+}
+
+void FAllegroBenchmarkCounter::ResetAll()
+{
+	for (FAllegroBenchmarkCounter* Counter = GetFirst(); Counter; Counter = Counter->Next)
+	{
+		Counter->Cycles = 0;
+		Counter->Calls = 0;
+	}
+}
+
+#endif
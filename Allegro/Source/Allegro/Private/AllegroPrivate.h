@@ -3,6 +3,7 @@
 #pragma once
 
 #include "Allegro.h"
+#include <atomic>
 
 DECLARE_STATS_GROUP(TEXT("Allegro"), STATGROUP_ALLEGRO, STATCAT_Advanced);
 
@@ -14,12 +15,82 @@ DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("ViewNumVisibleInstance"), STAT_ALLEGRO_V
 
 DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("ShadowNumCulledInstance"), STAT_ALLEGRO_ShadowNumCulled, STATGROUP_ALLEGRO, ALLEGRO_API);
 DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("ShadowNumVisibleInstance"), STAT_ALLEGRO_ShadowNumVisible, STATGROUP_ALLEGRO, ALLEGRO_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("ShadowNumSharedDataReuse"), STAT_ALLEGRO_ShadowNumSharedDataReuse, STATGROUP_ALLEGRO, ALLEGRO_API);
 
 
 DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("NumTransitionPoseGenerated"), STAT_ALLEGRO_NumTransitionPoseGenerated, STATGROUP_ALLEGRO, ALLEGRO_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("NumPrebakedTransitionUsed"), STAT_ALLEGRO_NumPrebakedTransitionUsed, STATGROUP_ALLEGRO, ALLEGRO_API);
 
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("NumRenderDirtyInstance"), STAT_ALLEGRO_NumRenderDirtyInstance, STATGROUP_ALLEGRO, ALLEGRO_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("NumSkippedRenderUpdate"), STAT_ALLEGRO_NumSkippedRenderUpdate, STATGROUP_ALLEGRO, ALLEGRO_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("NumCullGridRecoveryRebuild"), STAT_ALLEGRO_NumCullGridRecoveryRebuild, STATGROUP_ALLEGRO, ALLEGRO_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("NumPersistentUploadedInstance"), STAT_ALLEGRO_NumPersistentUploadedInstance, STATGROUP_ALLEGRO, ALLEGRO_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("NumOcclusionCulledCell"), STAT_ALLEGRO_NumOcclusionCulledCell, STATGROUP_ALLEGRO, ALLEGRO_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("NumBudgetLoweredLOD"), STAT_ALLEGRO_NumBudgetLoweredLOD, STATGROUP_ALLEGRO, ALLEGRO_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("NumStreamedInSequence"), STAT_ALLEGRO_NumStreamedInSequence, STATGROUP_ALLEGRO, ALLEGRO_API);
+DECLARE_DWORD_COUNTER_STAT_EXTERN(TEXT("NumEvictedSequence"), STAT_ALLEGRO_NumEvictedSequence, STATGROUP_ALLEGRO, ALLEGRO_API);
 
-#define ALLEGRO_SCOPE_CYCLE_COUNTER(CounterName) DECLARE_SCOPE_CYCLE_COUNTER(TEXT(#CounterName), STAT_ALLEGRO_##CounterName, STATGROUP_ALLEGRO)
+
+#if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
+
+/*
+* mirrors every ALLEGRO_SCOPE_CYCLE_COUNTER while a benchmark is running (see UAllegroBenchmarkCommandlet).
+* unlike stats it doesn't depend on the stats thread so it works in commandlets and under -nullrhi.
+* time is summed over all threads, a counter inside ParallelFor reports CPU time not wall time.
+*/
+struct ALLEGRO_API FAllegroBenchmarkCounter
+{
+	const TCHAR* Name;
+	std::atomic<uint64> Cycles;
+	std::atomic<uint32> Calls;
+	std::atomic<bool> bRegistered;
+	FAllegroBenchmarkCounter* Next;
+
+	constexpr FAllegroBenchmarkCounter(const TCHAR* InName) : Name(InName), Cycles(0), Calls(0), bRegistered(false), Next(nullptr) {}
+
+	//add to the global list, done lazily on first use so that counters stay constant initialized
+	void Register();
+
+	static bool bEnabled;
+	//head of the list of counters that have been hit since the start
+	static FAllegroBenchmarkCounter* GetFirst();
+	static void ResetAll();
+};
+
+struct FAllegroBenchmarkScope
+{
+	FAllegroBenchmarkCounter* Counter;
+	uint64 StartCycles;
+
+	FAllegroBenchmarkScope(FAllegroBenchmarkCounter& InCounter) : Counter(nullptr), StartCycles(0)
+	{
+		if (FAllegroBenchmarkCounter::bEnabled)
+		{
+			Counter = &InCounter;
+			if (!Counter->bRegistered.load(std::memory_order_relaxed))
+				Counter->Register();
+			StartCycles = FPlatformTime::Cycles64();
+		}
+	}
+	~FAllegroBenchmarkScope()
+	{
+		if (Counter)
+		{
+			Counter->Cycles.fetch_add(FPlatformTime::Cycles64() - StartCycles, std::memory_order_relaxed);
+			Counter->Calls.fetch_add(1, std::memory_order_relaxed);
+		}
+	}
+};
+
+#define ALLEGRO_BENCHMARK_SCOPE(CounterName) static FAllegroBenchmarkCounter AllegroBenchmarkCounter_##CounterName(TEXT(#CounterName)); FAllegroBenchmarkScope AllegroBenchmarkScope_##CounterName(AllegroBenchmarkCounter_##CounterName);
+
+#else
+
+#define ALLEGRO_BENCHMARK_SCOPE(CounterName)
+
+#endif
+
+#define ALLEGRO_SCOPE_CYCLE_COUNTER(CounterName) ALLEGRO_BENCHMARK_SCOPE(CounterName) DECLARE_SCOPE_CYCLE_COUNTER(TEXT(#CounterName), STAT_ALLEGRO_##CounterName, STATGROUP_ALLEGRO)
 
 #if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
 
@@ -218,6 +218,49 @@ inline void AllegroArrayOrSSE(void* Data, int NumPack, int Value)
 		VectorIntStore(VectorIntOr(VectorIntLoad(FlagPacks + i), MaskReg), FlagPacks + i);
 }
 
+//Dst[i] = Src[Indices[i]] for elements of NumFloats floats. NumFloats must be a multiple of 4
+template<uint32 NumFloats> void AllegroGatherFloatsSSE(float* RESTRICT Dst, const float* RESTRICT Src, const uint32* RESTRICT Indices, uint32 Num)
+{
+	static_assert(NumFloats % 4 == 0);
+	constexpr uint32 PrefetchDistance = 8;
+
+	for (uint32 i = 0; i < Num; i++)
+	{
+		if (i + PrefetchDistance < Num)
+			FPlatformMisc::Prefetch(Src + Indices[i + PrefetchDistance] * NumFloats);
+
+		const float* S = Src + Indices[i] * NumFloats;
+		float* D = Dst + i * NumFloats;
+		for (uint32 j = 0; j < NumFloats; j += 4)
+			VectorStore(VectorLoad(S + j), D + j);
+	}
+}
+
+template<uint32 NumFloats> void AllegroGatherFloatsScalar(float* RESTRICT Dst, const float* RESTRICT Src, const uint32* RESTRICT Indices, uint32 Num)
+{
+	for (uint32 i = 0; i < Num; i++)
+		for (uint32 j = 0; j < NumFloats; j++)
+			Dst[i * NumFloats + j] = Src[Indices[i] * NumFloats + j];
+}
+
+//gathers per instance float arrays (e.g custom data) of @Indices to a tightly packed @Dst. common sizes are specialized
+inline void AllegroGatherFloats(float* RESTRICT Dst, const float* RESTRICT Src, const uint32* RESTRICT Indices, uint32 Num, uint32 NumFloats)
+{
+	switch (NumFloats)
+	{
+	case 1: AllegroGatherFloatsScalar<1>(Dst, Src, Indices, Num); return;
+	case 2: AllegroGatherFloatsScalar<2>(Dst, Src, Indices, Num); return;
+	case 3: AllegroGatherFloatsScalar<3>(Dst, Src, Indices, Num); return;
+	case 4: AllegroGatherFloatsSSE<4>(Dst, Src, Indices, Num); return;
+	case 8: AllegroGatherFloatsSSE<8>(Dst, Src, Indices, Num); return;
+	case 12: AllegroGatherFloatsSSE<12>(Dst, Src, Indices, Num); return;
+	case 16: AllegroGatherFloatsSSE<16>(Dst, Src, Indices, Num); return;
+	}
+
+	for (uint32 i = 0; i < Num; i++)
+		FMemory::Memcpy(Dst + i * NumFloats, Src + Indices[i] * NumFloats, NumFloats * sizeof(float));
+}
+
 //because FMatrix3x4.SetMatrixTranspose takes FMatrix
 inline void AllegroSetMatrix3x4Transpose(FMatrix3x4& DstMatrix, const FMatrix44f& SrcMatrix)
 {
@@ -8,6 +8,7 @@
 #include "AllegroAnimCollection.h"
 #include "RendererInterface.h"
 #include "Async/ParallelFor.h"
+#include "Misc/MemStack.h"
 
 #include "Materials/MaterialRenderProxy.h"
 #include "ConvexVolume.h"
@@ -40,6 +41,12 @@ FAutoConsoleVariableRef CVar_ForceLOD(TEXT("allegro.ForceLOD"), GAllegro_ForceLO
 int GAllegro_ShadowForceLOD = -1;
 FAutoConsoleVariableRef CVar_ShadowForceLOD(TEXT("allegro.ShadowForceLOD"), GAllegro_ShadowForceLOD, TEXT(""), ECVF_Default);
 
+bool GAllegro_ShadowShareAcrossViews = true;
+FAutoConsoleVariableRef CVar_ShadowShareAcrossViews(TEXT("allegro.ShadowShareAcrossViews"), GAllegro_ShadowShareAcrossViews, TEXT("shadow views of a frame (e.g cascades) share instance buffers and LOD selection. buffers hold the union of the instances drawn by the views, LOD is selected from the main view owning the shadow view"), ECVF_Default);
+
+bool GAllegro_ShadowMergeSubMeshes = true;
+FAutoConsoleVariableRef CVar_ShadowMergeSubMeshes(TEXT("allegro.ShadowMergeSubMeshes"), GAllegro_ShadowMergeSubMeshes, TEXT("in shadow pass sub meshes of the same mesh are drawn by one batch if their materials don't need their own depth shader"), ECVF_Default);
+
 int GAllegro_MaxTrianglePerInstance = -1;
 FAutoConsoleVariableRef CVar_MaxTrianglePerInstance(TEXT("allegro.MaxTrianglePerInstance"), GAllegro_MaxTrianglePerInstance, TEXT("limits the per instance triangle counts, used for debug/profile purposes. <= 0 to disable"), ECVF_Default);
 
@@ -59,6 +66,18 @@ FAutoConsoleVariableRef CVar_DisableGriding(TEXT("allegro.DisableGridCull"), GAl
 int GAllegro_NumInstancePerGridCell = 256;
 FAutoConsoleVariableRef CVar_NumInstancePerGridCell(TEXT("allegro.NumInstancePerGridCell"), GAllegro_NumInstancePerGridCell, TEXT(""), ECVF_Default);
 
+bool GAllegro_OcclusionCull = true;
+FAutoConsoleVariableRef CVar_OcclusionCull(TEXT("allegro.OcclusionCull"), GAllegro_OcclusionCull, TEXT("cells of the persistent cull grid are occlusion queried, occluded cells are skipped by the main pass culling of the next frame"), ECVF_Default);
+
+float GAllegro_OcclusionBoundExpand = 50;
+FAutoConsoleVariableRef CVar_OcclusionBoundExpand(TEXT("allegro.OcclusionBoundExpand"), GAllegro_OcclusionBoundExpand, TEXT("cell bounds are expanded by this much when queried, instances that move farther in a frame make their cell visible"), ECVF_Default);
+
+int32 GAllegro_MaxOcclusionQueries = 1024;
+FAutoConsoleVariableRef CVar_MaxOcclusionQueries(TEXT("allegro.MaxOcclusionQueries"), GAllegro_MaxOcclusionQueries, TEXT("proxies with more cells than this don't issue occlusion queries"), ECVF_Default);
+
+bool GAllegro_PersistentCullGrid = true;
+FAutoConsoleVariableRef CVar_PersistentCullGrid(TEXT("allegro.PersistentCullGrid"), GAllegro_PersistentCullGrid, TEXT("cull by a grid kept on the render thread and updated incrementally, instead of binning all instances on the game thread every update. the per update grid is kept as a fallback, it has exact cell bounds and no render thread state, so it can be used to check the persistent grid or when most instances move every frame"), ECVF_Default);
+
 bool GAllegro_DisableSectionsUnification = false;
 FAutoConsoleVariableRef CVar_DisableSectionsUnification(TEXT("allegro.DisableSectionsUnification"), GAllegro_DisableSectionsUnification, TEXT(""), ECVF_Default);
 
@@ -70,6 +89,115 @@ FAutoConsoleVariableRef CVar_CullScreenSize(TEXT("allegro.CullScreenSize"), GAll
 
 
 ALLEGRO_AUTO_CVAR_DEBUG(bool, DebugForceNoPrevFrameData, false, "", ECVF_Default);
+ALLEGRO_AUTO_CVAR_DEBUG(bool, DebugVerifyCullGrid, false, "checks the persistent cull grid against flags and bounds of every instance after each update, reports instances whose hide/show/destroy or move didn't reach the proxy", ECVF_Default);
+ALLEGRO_AUTO_CVAR_DEBUG(bool, DebugScalarCustomDataCopy, false, "copies custom data by the old per float loop, to compare against the gather path in benchmarks", ECVF_Default);
+
+bool GAllegro_PersistentInstanceBuffers = false;
+FAutoConsoleVariableRef CVar_PersistentInstanceBuffers(TEXT("allegro.PersistentInstanceBuffers"), GAllegro_PersistentInstanceBuffers, TEXT("main pass views read instance data from persistent per proxy buffers that are updated by dirty ranges only, instead of filling new buffers per view"), ECVF_Default);
+
+
+#if ALLEGRO_GPU_CULL
+bool GAllegro_GPUCull = false;
+FAutoConsoleVariableRef CVar_GPUCull(TEXT("allegro.GPUCull"), GAllegro_GPUCull, TEXT("culls and selects LOD of instances by compute shader, draws are issued indirectly. needs allegro.PersistentInstanceBuffers, shadow, translucent and LOD budget views always use CPU culling"), ECVF_Default);
+
+ALLEGRO_AUTO_CVAR_DEBUG(bool, GPUCullVerify, false, "compares the next GPU cull result against AllegroCullReference (same cull on CPU, no occlusion) once it is read back, logs missing and extra instances per bucket. resets after use", ECVF_Default);
+#endif
+
+bool GAllegro_ParallelViews = true;
+FAutoConsoleVariableRef CVar_ParallelViews(TEXT("allegro.ParallelViews"), GAllegro_ParallelViews, TEXT("if a proxy is visible in several main pass views (e.g stereo, split screen), their culling and LOD selection run as parallel tasks"), ECVF_Default);
+
+int32 GAllegro_TriangleBudget = 0;
+FAutoConsoleVariableRef CVar_TriangleBudget(TEXT("allegro.TriangleBudget"), GAllegro_TriangleBudget, TEXT("max triangles of all allegro instances drawn by a main pass view, LODs of the smallest instances on screen are lowered to fit. <= 0 to disable"), ECVF_Default);
+
+int32 GAllegro_VertexBudget = 0;
+FAutoConsoleVariableRef CVar_VertexBudget(TEXT("allegro.VertexBudget"), GAllegro_VertexBudget, TEXT("same as allegro.TriangleBudget but for vertices. <= 0 to disable"), ECVF_Default);
+
+float GAllegro_LODBudgetHysteresis = 0.15f;
+FAutoConsoleVariableRef CVar_LODBudgetHysteresis(TEXT("allegro.LODBudgetHysteresis"), GAllegro_LODBudgetHysteresis, TEXT("relative screen size change the budget threshold must exceed before instances around it switch LOD"), ECVF_Default);
+
+int32 GAllegro_LODBudgetStepHoldFrames = 30;
+FAutoConsoleVariableRef CVar_LODBudgetStepHoldFrames(TEXT("allegro.LODBudgetStepHoldFrames"), GAllegro_LODBudgetStepHoldFrames, TEXT("number of frames the budget LOD step is kept before it can go back down. raising it is never delayed so the budget is met"), ECVF_Default);
+
+struct FAllegroLODBudgetCost
+{
+	uint64 Triangles = 0;
+	uint64 Vertices = 0;
+
+	bool Fits(const FAllegroLODBudgetCost& Budget) const { return Triangles <= Budget.Triangles && Vertices <= Budget.Vertices; }
+};
+
+/*
+* demand of all proxies drawn by a main view, per frame. views draw proxies in parallel so the total of the current frame isn't known yet,
+* proxies compare their demand against the total of the previous frame of the same view.
+*/
+struct FAllegroLODBudgetDemand
+{
+	struct FViewDemand
+	{
+		uint32 FrameNumber = 0;
+		FAllegroLODBudgetCost Cur;
+		FAllegroLODBudgetCost Prev;	//total of FrameNumber - 1
+	};
+
+	//add @Demand to the total of @View in @FrameNumber and return the total of the previous frame
+	FAllegroLODBudgetCost Accumulate(const FSceneView* View, uint32 FrameNumber, const FAllegroLODBudgetCost& Demand)
+	{
+		FScopeLock ScopeLock(&Lock);
+		FViewDemand* Found = ViewDemands.Find(View->GetViewKey());
+		if (!Found)
+		{
+			//views that stopped rendering (e.g closed split screen) leave stale entries
+			if (ViewDemands.Num() >= 8)
+			{
+				for (auto It = ViewDemands.CreateIterator(); It; ++It)
+					if (FrameNumber - It->Value.FrameNumber > 60)
+						It.RemoveCurrent();
+			}
+
+			Found = &ViewDemands.Add(View->GetViewKey());
+			Found->FrameNumber = FrameNumber;
+		}
+		else if (Found->FrameNumber != FrameNumber)
+		{
+			//first proxy of the frame
+			Found->Prev = Found->FrameNumber == FrameNumber - 1 ? Found->Cur : FAllegroLODBudgetCost();
+			Found->Cur = FAllegroLODBudgetCost();
+			Found->FrameNumber = FrameNumber;
+		}
+
+		Found->Cur.Triangles += Demand.Triangles;
+		Found->Cur.Vertices += Demand.Vertices;
+		return Found->Prev;
+	}
+
+private:
+	TMap<uint32, FViewDemand> ViewDemands;	//key is FSceneView::GetViewKey()
+	FCriticalSection Lock;
+};
+
+static FAllegroLODBudgetDemand GAllegro_LODBudgetDemand;
+
+/*
+* allegro.TriangleBudget/VertexBudget apply to each main view, proxies drawn by a view get a share proportional to their demand (cost with unlowered LODs).
+*/
+static FAllegroLODBudgetCost AllegroGetLODBudget(const FSceneView* View, uint32 FrameNumber, const FAllegroLODBudgetCost& Demand)
+{
+	const FAllegroLODBudgetCost PrevTotal = GAllegro_LODBudgetDemand.Accumulate(View, FrameNumber, Demand);
+
+	auto Share = [](int32 Budget, uint64 PrevTotal, uint64 Demand) -> uint64
+	{
+		if (Budget <= 0)
+			return MAX_uint64;
+		if (PrevTotal <= Demand)
+			return Budget;
+		return static_cast<uint64>(double(Budget) * double(Demand) / double(PrevTotal));
+	};
+
+	FAllegroLODBudgetCost Budget;
+	Budget.Triangles = Share(GAllegro_TriangleBudget, PrevTotal.Triangles, Demand.Triangles);
+	Budget.Vertices = Share(GAllegro_VertexBudget, PrevTotal.Vertices, Demand.Vertices);
+	return Budget;
+}
 
 #include "AllegroBatchGenerator.h"
 
@@ -199,6 +327,8 @@ FAllegroProxy::FAllegroProxy(const UAllegroComponent* Component, FName ResourceN
 		TArray<float> Factors;
 		Extents.Reset(SKMNum);
 
+		int ImpostorMaterialCounter = Component->GetImpostorMaterialBaseIndex();
+
 		//initialize sub meshes. the rest are initialized in CreateRenderThreadResources.
 		for (int MeshIdx = 0; MeshIdx < Component->Submeshes.Num(); MeshIdx++)
 		{
@@ -208,6 +338,11 @@ FAllegroProxy::FAllegroProxy(const UAllegroComponent* Component, FName ResourceN
 			if (!CompMeshSlot.SkeletalMesh)
 				continue;
 
+			//must advance as UAllegroComponent::GetMaterial does, even if the slot is skipped
+			const int ImpostorMaterialIndex = ImpostorMaterialCounter;
+			if (CompMeshSlot.ImpostorMesh)
+				ImpostorMaterialCounter += CompMeshSlot.ImpostorMesh->GetStaticMaterials().Num();
+
 			int MeshDefIdx = AminCollection->FindMeshDef(CompMeshSlot.SkeletalMesh);
 			if (MeshDefIdx == -1)
 				continue;
@@ -262,6 +397,28 @@ FAllegroProxy::FAllegroProxy(const UAllegroComponent* Component, FName ResourceN
 				MD.LODHysteresis[LodIdx] = LodInfos[LodIdx].LODHysteresis;
 			}
 
+			if (CompMeshSlot.ImpostorMesh && CompMeshSlot.ImpostorScreenSize > 0 && CompMeshSlot.ImpostorMesh->GetRenderData())
+			{
+				const int ImpostorLOD = FMath::Max<int>(MD.LodNum, MD.SkeletalRenderData->LODRenderData.Num());
+				if (ImpostorLOD < ALLEGRO_MAX_LOD)
+				{
+					MD.ImpostorRenderData = CompMeshSlot.ImpostorMesh->GetRenderData();
+					MD.ImpostorScreenSize = CompMeshSlot.ImpostorScreenSize;
+					MD.ImpostorLOD = static_cast<uint8>(ImpostorLOD);
+					MD.ImpostorMaterialIndex = ImpostorMaterialIndex;
+					MaxBatchCountPossible++;
+
+					int MaxImpostorSection = 0;
+					for (const FStaticMeshLODResources& ImpostorLODResource : MD.ImpostorRenderData->LODResources)
+						MaxImpostorSection = FMath::Max(MaxImpostorSection, ImpostorLODResource.Sections.Num());
+					SectionCounter += MaxImpostorSection;
+				}
+				else
+				{
+					UE_LOG(LogAllegro, Warning, TEXT("%s uses all %d LODs, its impostor is ignored"), *MD.SkeletalMesh->GetName(), ALLEGRO_MAX_LOD);
+				}
+			}
+
 			const TConstArrayView<FBoxCenterExtentFloat> MeshBounds = AminCollection->GetMeshBounds(MeshDefIdx);
 			//0 is default pos
 			Extent = MeshBounds[0];
@@ -405,23 +562,26 @@ void FAllegroProxy::ApplyWorldOffset(FVector InOffset)
 {
 	Super::ApplyWorldOffset(InOffset);
 
-	FVector3f InOffset3f(InOffset); //#TODO precision loss ?
-	if (DynamicData)
-	{
-		for (uint32 InstanceIndex = 0; InstanceIndex < DynamicData->InstanceCount; InstanceIndex++)
-		{
-			auto& M = DynamicData->Transforms[InstanceIndex];
-			M.SetOrigin(M.GetOrigin() + InOffset3f);
-		}
-	}
-	if (OldDynamicData)
-	{
-		for (uint32 InstanceIndex = 0; InstanceIndex < OldDynamicData->InstanceCount; InstanceIndex++)
-		{
-			auto& M = OldDynamicData->Transforms[InstanceIndex];
-			M.SetOrigin(M.GetOrigin() + InOffset3f);
-		}
-	}
+	//instance store, cull grid and GPU buffers stay as they are, everything reading them applies RenderOrigin.
+	//next dynamic data of the component carries the same offset, see UAllegroComponent::ApplyWorldOffset
+	RenderOrigin += FVector3f(InOffset);
+	Occlusion.ApplyWorldOffset(InOffset);
+}
+
+bool FAllegroProxy::HasSubprimitiveOcclusionQueries() const
+{
+	return GAllegro_OcclusionCull;
+}
+
+const TArray<FBoxSphereBounds>* FAllegroProxy::GetOcclusionQueries(const FSceneView* View) const
+{
+	return &Occlusion.QueryBounds;
+}
+
+void FAllegroProxy::AcceptOcclusionResults(const FSceneView* View, TArray<bool>* Results, int32 ResultsStart, int32 NumResults)
+{
+	if (Results && NumResults > 0)
+		Occlusion.Accept(View, *Results, ResultsStart, NumResults);
 }
 
 void FAllegroProxy::GetLightRelevance(const FLightSceneProxy* LightSceneProxy, bool& bDynamic, bool& bRelevant, bool& bLightMapped, bool& bShadowMapped) const
@@ -475,11 +635,40 @@ void FAllegroProxy::SetDynamicDataRT(FAllegroDynamicData* pData)
 		delete OldDynamicData;
 	}
 
+	pData->SerialNumber = DynamicData ? DynamicData->SerialNumber + 1 : 1;
+
 	OldDynamicData = DynamicData;
 	DynamicData = pData;
 
 	pData->CreationNumber = GFrameNumberRenderThread;
 
+	InstanceStore.Apply(DynamicData, OldDynamicData);
+	RenderOrigin = DynamicData->RenderOrigin;
+
+	if (DynamicData->bUseCullGrid)
+	{
+		if (!DynamicData->StoreRebase.IsZero())	//cell bounds and queried boxes are in the old space
+		{
+			CullGrid.Invalidate();
+			Occlusion.Reset();
+		}
+
+		CullGrid.Update(DynamicData);
+		if (GAllegro_DebugVerifyCullGrid)
+			CullGrid.Verify(DynamicData);
+
+		Occlusion.Update(CullGrid, RenderOrigin);
+	}
+	else
+	{
+		CullGrid.Reset();
+		Occlusion.Reset();
+	}
+
+#if ALLEGRO_GPU_CULL
+	GPUCullInput.Invalidate();
+#endif
+
 	//if(OldDynamicData)
 	//{
 	//	for (uint32 i = OldDynamicData->InstanceCount; i < DynamicData->InstanceCount; i++)
@@ -590,6 +779,37 @@ void FAllegroProxy::CreateRenderThreadResources()
 		}
 
 		this->bHasAnyTranslucentMaterial |= MD.bHasAnyTranslucentMaterial;
+
+		//impostor is kept as one more LOD after the skeletal ones
+		if (MD.ImpostorRenderData)
+		{
+			MD.ImpostorMeshLOD = static_cast<uint8>(FMath::Clamp<int>(MD.ImpostorRenderData->CurrentFirstLODIdx, 0, MD.ImpostorRenderData->LODResources.Num() - 1));
+			const FStaticMeshLODResources& ImpostorLODResource = MD.GetImpostorLODResources();
+			FProxyLODData& ProxyLODData = MD.LODs[MD.ImpostorLOD];
+
+			ProxyLODData.bHasAnyTranslucentMaterial = false;
+			ProxyLODData.SectionsMaxBoneInfluence = 0;
+			ProxyLODData.SectionsNumTriangle = 0;
+			ProxyLODData.SectionsNumVertices = 0;
+
+			ProxyLODData.SectionsMaterialIndices = MatIndexIter;
+			MatIndexIter += ImpostorLODResource.Sections.Num();
+			check(MatIndexIter <= (this->MaterialIndicesArray.GetData() + this->MaterialIndicesArray.Num()));
+
+			for (int SectionIndex = 0; SectionIndex < ImpostorLODResource.Sections.Num(); SectionIndex++)
+			{
+				const FStaticMeshSection& SectionInfo = ImpostorLODResource.Sections[SectionIndex];
+				const int SolvedMI = MD.ImpostorMaterialIndex + SectionInfo.MaterialIndex;
+				ProxyLODData.SectionsMaterialIndices[SectionIndex] = SolvedMI;
+
+				const FMaterial& Material = this->MaterialsProxy[SolvedMI]->GetIncompleteMaterialWithFallback(this->GetScene().GetFeatureLevel());
+				ProxyLODData.bHasAnyTranslucentMaterial |= IsTranslucentBlendMode(Material.GetBlendMode());
+				ProxyLODData.SectionsNumTriangle += SectionInfo.NumTriangles;
+				ProxyLODData.SectionsNumVertices += SectionInfo.MaxVertexIndex - SectionInfo.MinVertexIndex + 1;
+			}
+
+			this->bHasAnyTranslucentMaterial |= ProxyLODData.bHasAnyTranslucentMaterial;
+		}
 	}
 
 
@@ -668,10 +888,61 @@ void FAllegroProxy::CreateRenderThreadResources()
 
 		this->bHasAnyTranslucentMaterial |= MD.bHasAnyTranslucentMaterial;
 	}
+
+	InitShadowSubMeshRemap();
+}
+
+void FAllegroProxy::InitShadowSubMeshRemap()
+{
+	const bool bSKM = SubMeshes.Num() > 0;
+	const int NumSubMesh = bSKM ? SubMeshes.Num() : SubStaticMeshes.Num();
+	auto GetMeshData = [&](int MeshIdx) -> const FProxyMeshDataBase& { return bSKM ? (const FProxyMeshDataBase&)SubMeshes[MeshIdx] : (const FProxyMeshDataBase&)SubStaticMeshes[MeshIdx]; };
+	auto GetRenderData = [&](int MeshIdx) -> const void* { return bSKM ? (const void*)SubMeshes[MeshIdx].SkeletalRenderData : (const void*)SubStaticMeshes[MeshIdx].StaticMeshData; };
+
+	//shadow depth of these is drawn by the default material, so any sub mesh of the same mesh can draw them
+	auto CanMergeForShadow = [&](int MeshIdx)
+	{
+		const FProxyMeshDataBase& MD = GetMeshData(MeshIdx);
+		if (!GetRenderData(MeshIdx) || MD.PreSkinPostionOffset || MD.AdditionalStaticRenderData)
+			return false;
+
+		for (const FProxyLODData& ProxyLODData : MD.LODs)
+		{
+			if (ProxyLODData.SectionsMaterialIndices && !ProxyLODData.bMeshUnificationApplicable)	//LODs bellow min LOD are not initialized
+				return false;
+		}
+		return true;
+	};
+
+	this->ShadowSubMeshRemap.SetNumUninitialized(NumSubMesh);
+	for (int MeshIdx = 0; MeshIdx < NumSubMesh; MeshIdx++)
+	{
+		this->ShadowSubMeshRemap[MeshIdx] = static_cast<uint8>(MeshIdx);
+		if (!CanMergeForShadow(MeshIdx))
+			continue;
+
+		for (int OtherIdx = 0; OtherIdx < MeshIdx; OtherIdx++)
+		{
+			if (this->ShadowSubMeshRemap[OtherIdx] != OtherIdx || GetRenderData(OtherIdx) != GetRenderData(MeshIdx) || GetMeshData(OtherIdx).MinLODIndex != GetMeshData(MeshIdx).MinLODIndex)
+				continue;
+			if (bSKM && SubMeshes[OtherIdx].MeshDataEx != SubMeshes[MeshIdx].MeshDataEx)
+				continue;
+
+			if (CanMergeForShadow(OtherIdx))
+			{
+				this->ShadowSubMeshRemap[MeshIdx] = static_cast<uint8>(OtherIdx);
+				break;
+			}
+		}
+	}
 }
 
 void FAllegroProxy::DestroyRenderThreadResources()
 {
+	ShadowSharedData.Reset();
+	LODBudgetState.Reset();
+	GPUInstanceStore.Release();
+
 	for (int MeshIdx = 0; MeshIdx < SubMeshes.Num(); MeshIdx++)
 	{
 		FProxyMeshData& MD = SubMeshes[MeshIdx];
@@ -705,6 +976,10 @@ void FAllegroProxy::DestroyRenderThreadResources()
 			}
 		}
 	}
+
+#if ALLEGRO_GPU_CULL
+	GPUCullInput.Release();
+#endif
 }
 
 FAllegroBaseVertexFactory* FAllegroProxy::GetVertexFactory(int SubMeshIndex, int LodIndex, const FAllegroBoneIndexVertexBuffer* BoneIndexBuffer, const FSkeletalMeshLODRenderData* LODData, int MaxBoneInfluence, FStaticMeshVertexBuffers* AdditionalStaticMeshVB)
@@ -759,6 +1034,27 @@ FAllegroBaseVertexFactory* FAllegroProxy::GetStaticVertexFactory(int SubMeshInde
 	return LOD.VertexFactories[MaxBoneInfluence].Get();
 }
 
+FAllegroBaseVertexFactory* FAllegroProxy::GetImpostorVertexFactory(int SubMeshIndex)
+{
+	FProxyMeshData& MD = this->SubMeshes[SubMeshIndex];
+	check(MD.ImpostorLOD < ALLEGRO_MAX_LOD);
+	TUniquePtr<FAllegroBaseVertexFactory>& VFPtr = MD.LODs[MD.ImpostorLOD].VertexFactories[0];
+
+	if (!VFPtr)
+	{
+		check(IsInRenderingThread() && MD.ImpostorRenderData);
+
+		FAllegroBaseVertexFactory* VF = FAllegroBaseVertexFactory::New(0, false);
+		FAllegroBaseVertexFactory::FDataType VFData;
+		VF->FillDataForStaticMesh(VFData, &MD.GetImpostorLODResources(), nullptr);
+		VF->SetData(VFData);
+		VF->InitResource(FRHICommandListImmediate::Get());
+
+		VFPtr = TUniquePtr<FAllegroBaseVertexFactory>(VF);
+	}
+	return VFPtr.Get();
+}
+
 uint32 FAllegroProxy::GetMemoryFootprint(void) const
 {
 	return (sizeof(*this) + GetAllocatedSize());
@@ -766,7 +1062,35 @@ uint32 FAllegroProxy::GetMemoryFootprint(void) const
 
 uint32 FAllegroProxy::GetAllocatedSize(void) const
 {
-	return FPrimitiveSceneProxy::GetAllocatedSize() + this->SubMeshes.GetAllocatedSize() + this->MaterialsProxy.GetAllocatedSize() + this->MaterialIndicesArray.GetAllocatedSize();
+	return FPrimitiveSceneProxy::GetAllocatedSize() + this->SubMeshes.GetAllocatedSize() + this->MaterialsProxy.GetAllocatedSize() + this->MaterialIndicesArray.GetAllocatedSize() + this->InstanceStore.GetAllocatedSize()
+		+ this->ShadowSubMeshRemap.GetAllocatedSize() + this->ShadowSharedData.GetAllocatedSize() + this->GPUInstanceStore.GetAllocatedSize() + this->CullGrid.GetAllocatedSize() + this->Occlusion.GetAllocatedSize() + this->LODBudgetState.GetAllocatedSize()
+#if ALLEGRO_GPU_CULL
+		+ this->GPUCullInput.GetAllocatedSize()
+#endif
+		;
+}
+
+//generates main pass batches of @ViewIndices. culling runs in parallel, buffers and batches are then generated in view order on the calling thread
+template<typename TGenerator> static void AllegroGenerateViews(const FAllegroProxy* Proxy, const TArray<const FSceneView*>& Views, const FSceneViewFamily& ViewFamily, TArrayView<const int32> ViewIndices, FMeshElementCollector& Collector, int SubMeshNum)
+{
+	if (ViewIndices.Num() == 1 || !GAllegro_ParallelViews)
+	{
+		for (int32 ViewIndex : ViewIndices)
+		{
+			TGenerator Generator(Proxy, &ViewFamily, Views[ViewIndex], &Collector, ViewIndex, SubMeshNum);
+			Generator.DoGenerate();
+		}
+		return;
+	}
+
+	TArray<TUniquePtr<TGenerator>, TInlineAllocator<4>> Generators;
+	for (int32 ViewIndex : ViewIndices)
+		Generators.Add(MakeUnique<TGenerator>(Proxy, &ViewFamily, Views[ViewIndex], &Collector, ViewIndex, SubMeshNum));
+
+	ParallelFor(TEXT("AllegroCullViews"), Generators.Num(), 1, [&Generators](int32 Index) { Generators[Index]->CullData(); });
+
+	for (TUniquePtr<TGenerator>& Generator : Generators)
+		Generator->FinishGenerate();
 }
 
 void FAllegroProxy::GetDynamicMeshElements(const TArray<const FSceneView*>& Views, const FSceneViewFamily& ViewFamily, uint32 VisibilityMap, FMeshElementCollector& Collector) const
@@ -786,12 +1110,15 @@ void FAllegroProxy::GetDynamicMeshElements(const TArray<const FSceneView*>& View
 		return;
 	}
 
+	TArray<int32, TInlineAllocator<4>> MainViewIndices;
+
 	for (int32 ViewIndex = 0; ViewIndex < Views.Num(); ViewIndex++)
 	{
 		if (VisibilityMap & (1 << ViewIndex))
 		{
 			const FSceneView* View = Views[ViewIndex];
 
+			//#Note each shadow view (cascade) comes with its own call, the expensive part is shared through ShadowSharedData
 			if (View->GetDynamicMeshElementsShadowCullFrustum())
 			{
 				check(Views.Num() == 1);
@@ -810,18 +1137,7 @@ void FAllegroProxy::GetDynamicMeshElements(const TArray<const FSceneView*>& View
 			{
 				bool bIgnoreView = (View->bIsInstancedStereoEnabled && View->StereoPass == EStereoscopicPass::eSSP_SECONDARY);
 				if (!bIgnoreView)
-				{
-					if (bHasData)
-					{
-						FAllegroMultiMeshGenerator<false> generator(this, &ViewFamily, View, &Collector, ViewIndex, this->SubMeshes.Num());
-						generator.DoGenerate();
-					}
-					else if (bStaticMesh)
-					{
-						FAllegroStaticMultiMeshGenerator<false> generator(this, &ViewFamily, View, &Collector, ViewIndex, this->SubStaticMeshes.Num());
-						generator.DoGenerate();
-					}
-				}
+					MainViewIndices.Add(ViewIndex);
 
 #if !(UE_BUILD_SHIPPING || UE_BUILD_TEST)
 				// Render bounds
@@ -830,6 +1146,14 @@ void FAllegroProxy::GetDynamicMeshElements(const TArray<const FSceneView*>& View
 			}
 		}
 	}
+
+	if (MainViewIndices.Num())
+	{
+		if (bHasData)
+			AllegroGenerateViews<FAllegroMultiMeshGenerator<false>>(this, Views, ViewFamily, MainViewIndices, Collector, this->SubMeshes.Num());
+		else if (bStaticMesh)
+			AllegroGenerateViews<FAllegroStaticMultiMeshGenerator<false>>(this, Views, ViewFamily, MainViewIndices, Collector, this->SubStaticMeshes.Num());
+	}
 }
 #if 0
 void FProxyMeshData::Init(FAllegroProxy* Owner)
@@ -915,7 +1239,145 @@ void FAllegroDynamicData::InitGrid()
 	BoundMin = FVector2f(CompBound.GetMin());
 }
 
-FAllegroDynamicData* FAllegroDynamicData::Allocate(UAllegroComponent* Comp)
+void FAllegroDynamicData::BinInstances(const EAllegroInstanceFlags* InFlags, const FBoxCenterExtentFloat* InBounds, int32 NumInstancePerTask)
+{
+	ALLEGRO_SCOPE_CYCLE_COUNTER(FAllegroDynamicData_BinInstances);
+	check(NumCells > 0 && CellPageCounter == 0);
+
+	const int32 NumInstance = static_cast<int32>(InstanceCount);
+	//each task owns a partial grid of NumCells, more tasks than workers would only grow the merge
+	const int32 MaxTask = FMath::Max(1, FTaskGraphInterface::Get().GetNumWorkerThreads() + 1);
+	const int32 NumTask = NumInstancePerTask > 0 ? FMath::Clamp(FMath::DivideAndRoundUp(NumInstance, NumInstancePerTask), 1, MaxTask) : 1;
+	const int32 TaskSize = FMath::DivideAndRoundUp(FMath::Max(NumInstance, 1), NumTask);
+	//partial grids are merged in parallel over cell ranges
+	const int32 CellRangeSize = FMath::Max(256, FMath::DivideAndRoundUp(static_cast<int32>(NumCells), MaxTask));
+	const int32 NumCellRange = FMath::DivideAndRoundUp(static_cast<int32>(NumCells), CellRangeSize);
+
+	FMemMark MemMarker(FMemStack::Get());
+	//partial grid of each task, counters turn into write offsets after merge
+	uint32* TaskCellCounters = New<uint32>(FMemStack::Get(), NumTask * NumCells);
+	FBoxMinMaxFloat* TaskCellBounds = New<FBoxMinMaxFloat>(FMemStack::Get(), NumTask * NumCells);
+	int32* InstanceCells = New<int32>(FMemStack::Get(), NumInstance);	//cell index of each instance, -1 if not binned
+	uint32* CellInstanceCounts = New<uint32>(FMemStack::Get(), NumCells);
+
+	FMemory::Memzero(TaskCellCounters, sizeof(uint32) * NumTask * NumCells);
+	for (uint32 Index = 0; Index < NumTask * NumCells; Index++)
+		TaskCellBounds[Index] = FBoxMinMaxFloat(ForceInit);
+
+	auto BinTask = [&](int32 TaskIndex) {
+		const int32 Start = TaskIndex * TaskSize;
+		const int32 End = FMath::Min(Start + TaskSize, NumInstance);
+		uint32* CellCounters = TaskCellCounters + TaskIndex * NumCells;
+		FBoxMinMaxFloat* CellBounds = TaskCellBounds + TaskIndex * NumCells;
+
+		for (int32 InstanceIndex = Start; InstanceIndex < End; InstanceIndex++)
+		{
+			if (EnumHasAnyFlags(InFlags[InstanceIndex], EAllegroInstanceFlags::EIF_Destroyed | EAllegroInstanceFlags::EIF_Hidden))
+			{
+				InstanceCells[InstanceIndex] = -1;
+				continue;
+			}
+
+			const FBoxCenterExtentFloat& IB = InBounds[InstanceIndex];
+			const int CellIdx = LocationToCellIndex(IB.Center);
+			InstanceCells[InstanceIndex] = CellIdx;
+			CellCounters[CellIdx]++;
+			CellBounds[CellIdx].Add(IB);
+		}
+	};
+
+	//indices of each instance are written to their slot directly, pages of a cell are contiguous
+	auto ScatterTask = [&](int32 TaskIndex) {
+		const int32 Start = TaskIndex * TaskSize;
+		const int32 End = FMath::Min(Start + TaskSize, NumInstance);
+		uint32* CellOffsets = TaskCellCounters + TaskIndex * NumCells;
+
+		for (int32 InstanceIndex = Start; InstanceIndex < End; InstanceIndex++)
+		{
+			const int32 CellIdx = InstanceCells[InstanceIndex];
+			if (CellIdx == -1)
+				continue;
+
+			const uint32 Offset = CellOffsets[CellIdx]++;
+			FCell::FCellPage& Page = CellPagePool[Cells[CellIdx].PageHead + Offset / FCell::MAX_INSTANCE_PER_CELL];
+			Page.Indices[Offset % FCell::MAX_INSTANCE_PER_CELL] = static_cast<uint32>(InstanceIndex);
+		}
+	};
+
+	if (NumTask > 1)
+		ParallelFor(TEXT("ParallelForBinInstances"), NumTask, 1, BinTask);
+	else
+		BinTask(0);
+
+	//merge partial grids, task counters turn into write offsets within the cell
+	auto MergeTask = [&](int32 RangeIndex) {
+		const uint32 Start = RangeIndex * CellRangeSize;
+		const uint32 End = FMath::Min(Start + CellRangeSize, NumCells);
+		for (uint32 CellIdx = Start; CellIdx < End; CellIdx++)
+		{
+			FCell& Cell = Cells[CellIdx];
+			uint32 CellCounter = 0;
+			for (int32 TaskIndex = 0; TaskIndex < NumTask; TaskIndex++)
+			{
+				uint32& TaskCounter = TaskCellCounters[TaskIndex * NumCells + CellIdx];
+				const uint32 NumInTask = TaskCounter;
+				TaskCounter = CellCounter;
+				CellCounter += NumInTask;
+				Cell.Bound.Add(TaskCellBounds[TaskIndex * NumCells + CellIdx]);
+			}
+
+			CellInstanceCounts[CellIdx] = CellCounter;
+			//instances are binned by their world space bounds, culling is done in instance store space
+			if (CellCounter)
+				Cell.Bound.Shift(-RenderOrigin);
+		}
+	};
+
+	//pages of a cell are contiguous, each range chains its own cells
+	auto PageTask = [&](int32 RangeIndex) {
+		const uint32 Start = RangeIndex * CellRangeSize;
+		const uint32 End = FMath::Min(Start + CellRangeSize, NumCells);
+		for (uint32 CellIdx = Start; CellIdx < End; CellIdx++)
+		{
+			if (CellInstanceCounts[CellIdx] == 0)
+				continue;
+
+			const FCell& Cell = Cells[CellIdx];
+			for (int PageIndex = Cell.PageHead; PageIndex <= Cell.PageTail; PageIndex++)
+			{
+				FCell::FCellPage* CellPage = new (CellPagePool + PageIndex) FCell::FCellPage();
+				CellPage->NextPage = PageIndex < Cell.PageTail ? PageIndex + 1 : -1;
+			}
+		}
+	};
+
+	ParallelFor(TEXT("ParallelForMergeCells"), NumCellRange, 1, MergeTask);
+
+	//page allocation is a prefix over cell totals, O(NumCells)
+	for (uint32 CellIdx = 0; CellIdx < NumCells; CellIdx++)
+	{
+		const uint32 CellCounter = CellInstanceCounts[CellIdx];
+		if (CellCounter == 0)
+			continue;
+
+		FCell& Cell = Cells[CellIdx];
+		const uint32 NumPage = FMath::DivideAndRoundUp(CellCounter, FCell::MAX_INSTANCE_PER_CELL);
+		check(CellPageCounter + NumPage <= MaxCellPage);
+		Cell.PageHead = CellPageCounter;
+		Cell.PageTail = CellPageCounter + NumPage - 1;
+		Cell.Counter = CellCounter - (NumPage - 1) * FCell::MAX_INSTANCE_PER_CELL;
+		CellPageCounter += NumPage;
+	}
+
+	ParallelFor(TEXT("ParallelForInitCellPages"), NumCellRange, 1, PageTask);
+
+	if (NumTask > 1)
+		ParallelFor(TEXT("ParallelForScatterInstances"), NumTask, 1, ScatterTask);
+	else
+		ScatterTask(0);
+}
+
+FAllegroDynamicData* FAllegroDynamicData::Allocate(UAllegroComponent* Comp, const TArray<FAllegroIndexRange>& InDirtyRanges, uint32 InNumDirtyInstance)
 {
 	ALLEGRO_SCOPE_CYCLE_COUNTER(FAllegroDynamicData_Allocate);
 
@@ -925,11 +1387,19 @@ FAllegroDynamicData* FAllegroDynamicData::Allocate(UAllegroComponent* Comp)
 	if(GAllegro_DisableGridCull)
 		MaxNumCell = 0;
 
-	const size_t MemSizeTransforms = sizeof(*Transforms) * InstanceCount;
-	const size_t MemSizeBounds = sizeof(*Bounds) * InstanceCount;
+	//grid is kept by the proxy, nothing to bin here
+	const bool bUseCullGrid = MaxNumCell > 0 && GAllegro_PersistentCullGrid;
+	if (bUseCullGrid)
+		MaxNumCell = 0;
+
+	const bool bSendCustomData = Comp->NumCustomDataFloats > 0 && Comp->InstancesData.bRenderCustomDataDirty;
+
+	const size_t MemSizeDirtyRanges = sizeof(FAllegroIndexRange) * InDirtyRanges.Num();
+	const size_t MemSizeDirtyTransforms = sizeof(*DirtyTransforms) * InNumDirtyInstance;
+	const size_t MemSizeDirtyBounds = sizeof(*DirtyBounds) * InNumDirtyInstance;
 	const size_t MemSizeFrameIndices = sizeof(*FrameIndices) * InstanceCount;
 	const size_t MemSizeFlags = sizeof(EAllegroInstanceFlags) * InstanceCount;
-	const size_t MemSizeCustomData = Comp->NumCustomDataFloats > 0 ? (Comp->NumCustomDataFloats * sizeof(float) * InstanceCount) : 0;
+	const size_t MemSizeCustomData = bSendCustomData ? (Comp->NumCustomDataFloats * sizeof(float) * InstanceCount) : 0;
 	const size_t MemSizeMeshSlots = (Comp->MaxMeshPerInstance + 1) * sizeof(uint8) * InstanceCount;
 
 	const size_t MemSizeStencilData = sizeof(int16) * InstanceCount;
@@ -948,7 +1418,7 @@ FAllegroDynamicData* FAllegroDynamicData::Allocate(UAllegroComponent* Comp)
 
 	const size_t MemSizeCellPages = MaxCellPageNeeded * sizeof(FCell::FCellPage);
 
-	const size_t OverallSize = sizeof(FAllegroDynamicData) + MemSizeTransforms + MemSizeBounds + MemSizeFrameIndices + MemSizeFlags + MemSizeCustomData + MemSizeMeshSlots \
+	const size_t OverallSize = sizeof(FAllegroDynamicData) + MemSizeDirtyRanges + MemSizeDirtyTransforms + MemSizeDirtyBounds + MemSizeFrameIndices + MemSizeFlags + MemSizeCustomData + MemSizeMeshSlots \
 		+ MemSizeStencilData + MemSizeBlendAnimInfoIndex + MemSizeBlendAnimInfo \
 		+ MemSizeCells + MemSizeCellPages + 256;
 
@@ -965,14 +1435,20 @@ FAllegroDynamicData* FAllegroDynamicData::Allocate(UAllegroComponent* Comp)
 
 	DynData->InstanceCount = InstanceCount;
 	DynData->AliveInstanceCount = Comp->GetAliveInstanceCount();
+	DynData->bUseCullGrid = bUseCullGrid;
 
 	DynData->Flags = (EAllegroInstanceFlags*)TakeMem(MemSizeFlags);
-	DynData->Bounds = (FBoxCenterExtentFloat*)TakeMem(MemSizeBounds);
-	DynData->Transforms = (FMatrix44f*)TakeMem(MemSizeTransforms, 16);
 	DynData->FrameIndices = (uint32*)TakeMem(MemSizeFrameIndices);
-	DynData->CustomData = MemSizeCustomData ? (float*)TakeMem(MemSizeCustomData) : nullptr;
 	DynData->MeshSlots = MemSizeMeshSlots ? (uint8*)TakeMem(MemSizeMeshSlots) : nullptr;
 
+	DynData->NumDirtyRanges = InDirtyRanges.Num();
+	DynData->NumDirtyInstance = InNumDirtyInstance;
+	DynData->DirtyRanges = MemSizeDirtyRanges ? (FAllegroIndexRange*)TakeMem(MemSizeDirtyRanges) : nullptr;
+	DynData->DirtyTransforms = MemSizeDirtyTransforms ? (FMatrix44f*)TakeMem(MemSizeDirtyTransforms, 16) : nullptr;
+	DynData->DirtyBounds = MemSizeDirtyBounds ? (FBoxCenterExtentFloat*)TakeMem(MemSizeDirtyBounds) : nullptr;
+	DynData->DirtyCustomData = MemSizeCustomData ? (float*)TakeMem(MemSizeCustomData) : nullptr;
+	DynData->NumDirtyCustomDataFloats = MemSizeCustomData / sizeof(float);
+
 	DynData->Stencil = (int16*)TakeMem(MemSizeStencilData);
 	DynData->NumBlendFrame = InstanceBlendFrameNum;
 	DynData->BlendFrameInfoIndex = (uint32*)TakeMem(MemSizeBlendAnimInfoIndex);
@@ -992,9 +1468,41 @@ FAllegroDynamicData* FAllegroDynamicData::Allocate(UAllegroComponent* Comp)
 	//copy data
 	FMemory::Memcpy(DynData->Flags, Comp->InstancesData.Flags.GetData(), MemSizeFlags);
 	FMemory::Memcpy(DynData->FrameIndices, Comp->InstancesData.FrameIndices.GetData(), MemSizeFrameIndices);
-	FMemory::Memcpy(DynData->Transforms, Comp->InstancesData.Matrices.GetData(), MemSizeTransforms);
-	if (MemSizeCustomData )
-		FMemory::Memcpy(DynData->CustomData, Comp->InstancesData.RenderCustomData.GetData(), MemSizeCustomData);
+	
+	if (MemSizeCustomData)
+	{
+		FMemory::Memcpy(DynData->DirtyCustomData, Comp->InstancesData.RenderCustomData.GetData(), MemSizeCustomData);
+		Comp->InstancesData.bRenderCustomDataDirty = false;
+	}
+
+	DynData->RenderOrigin = Comp->RenderOrigin;
+
+	//pack transforms and bounds of dirty ranges
+	if (InNumDirtyInstance)
+	{
+		FMemory::Memcpy(DynData->DirtyRanges, InDirtyRanges.GetData(), MemSizeDirtyRanges);
+
+		FMatrix44f* TransformIter = DynData->DirtyTransforms;
+		FBoxCenterExtentFloat* BoundIter = DynData->DirtyBounds;
+		for (const FAllegroIndexRange& Range : InDirtyRanges)
+		{
+			FMemory::Memcpy(TransformIter, Comp->InstancesData.Matrices.GetData() + Range.Start, sizeof(FMatrix44f) * Range.Count);
+			FMemory::Memcpy(BoundIter, Comp->InstancesData.RenderBounds.GetData() + Range.Start, sizeof(FBoxCenterExtentFloat) * Range.Count);
+			TransformIter += Range.Count;
+			BoundIter += Range.Count;
+		}
+
+		//game thread data is in world space, the instance store is relative to RenderOrigin
+		if (!DynData->RenderOrigin.IsZero())
+		{
+			for (uint32 Index = 0; Index < InNumDirtyInstance; Index++)
+			{
+				FMatrix44f& M = DynData->DirtyTransforms[Index];
+				M.SetOrigin(M.GetOrigin() - DynData->RenderOrigin);
+				DynData->DirtyBounds[Index].Center -= DynData->RenderOrigin;
+			}
+		}
+	}
 	
 	FMemory::Memcpy(DynData->MeshSlots, Comp->InstancesData.MeshSlots.GetData(), MemSizeMeshSlots);
 
@@ -1006,6 +1514,719 @@ FAllegroDynamicData* FAllegroDynamicData::Allocate(UAllegroComponent* Comp)
 	return DynData;
 }
 
+void FAllegroInstanceStore::Apply(FAllegroDynamicData* Cur, FAllegroDynamicData* Prev)
+{
+	ALLEGRO_SCOPE_CYCLE_COUNTER(FAllegroInstanceStore_Apply);
+
+	const uint32 InstanceCount = Cur->InstanceCount;
+	if ((uint32)Transforms.Num() != InstanceCount)
+	{
+		//new slots are covered by dirty ranges, zeroed just to be safe
+		Transforms.SetNumZeroed(InstanceCount);
+		PrevTransforms.SetNumZeroed(InstanceCount);
+		Bounds.SetNumZeroed(InstanceCount);
+	}
+
+	auto CopyTransforms = [InstanceCount](FMatrix44f* Dst, const FMatrix44f* Src, const FAllegroIndexRange& Range) {
+		if (Range.Start < InstanceCount)
+			FMemory::Memcpy(Dst + Range.Start, Src + Range.Start, sizeof(FMatrix44f) * FMath::Min(Range.Count, InstanceCount - Range.Start));
+	};
+
+	//instances changed by the last update didn't move since then, their previous transform is the current one now
+	for (const FAllegroIndexRange& Range : LastRanges)
+		CopyTransforms(PrevTransforms.GetData(), Transforms.GetData(), Range);
+
+	LastRanges.Reset();
+
+	const FMatrix44f* TransformIter = Cur->DirtyTransforms;
+	const FBoxCenterExtentFloat* BoundIter = Cur->DirtyBounds;
+	for (uint32 RangeIndex = 0; RangeIndex < Cur->NumDirtyRanges; RangeIndex++)
+	{
+		const FAllegroIndexRange& Range = Cur->DirtyRanges[RangeIndex];
+		check(Range.Start + Range.Count <= InstanceCount);
+
+		CopyTransforms(PrevTransforms.GetData(), Transforms.GetData(), Range);
+		FMemory::Memcpy(Transforms.GetData() + Range.Start, TransformIter, sizeof(FMatrix44f) * Range.Count);
+		FMemory::Memcpy(Bounds.GetData() + Range.Start, BoundIter, sizeof(FBoxCenterExtentFloat) * Range.Count);
+		TransformIter += Range.Count;
+		BoundIter += Range.Count;
+
+		LastRanges.Add(Range);
+	}
+
+	//space of the store moved, previous transforms are the only ones not resent
+	if (!Cur->StoreRebase.IsZero())
+	{
+		for (FMatrix44f& M : PrevTransforms)
+			M.SetOrigin(M.GetOrigin() + Cur->StoreRebase);
+	}
+
+	if (Cur->DirtyCustomData)
+	{
+		CustomData.SetNumUninitialized(Cur->NumDirtyCustomDataFloats);
+		FMemory::Memcpy(CustomData.GetData(), Cur->DirtyCustomData, sizeof(float) * Cur->NumDirtyCustomDataFloats);
+	}
+
+	Cur->Transforms = Transforms.GetData();
+	Cur->Bounds = Bounds.GetData();
+	Cur->CustomData = CustomData.Num() ? CustomData.GetData() : nullptr;
+
+	if (Prev)
+	{
+		//arrays may be reallocated, previous data must point to the store as well
+		Prev->Transforms = PrevTransforms.GetData();
+		Prev->Bounds = Bounds.GetData();
+		Prev->CustomData = Cur->CustomData;
+	}
+}
+
+SIZE_T FAllegroInstanceStore::GetAllocatedSize() const
+{
+	return Transforms.GetAllocatedSize() + PrevTransforms.GetAllocatedSize() + Bounds.GetAllocatedSize() + CustomData.GetAllocatedSize() + LastRanges.GetAllocatedSize();
+}
+
+void FAllegroCullGrid::Update(const FAllegroDynamicData* Cur)
+{
+	ALLEGRO_SCOPE_CYCLE_COUNTER(FAllegroCullGrid_Update);
+
+	const uint32 InstanceCount = Cur->InstanceCount;
+	const int32 NumOccupied = Cells.Num() - NumEmptyCell;
+	//cells got crowded or mostly vacated since the cell size was chosen
+	const bool bDegenerated = NumOccupied > 0 && (NumIndexed > NumOccupied * 4 * FMath::Max(RebuildOccupancy, (float)GAllegro_NumInstancePerGridCell) || NumEmptyCell > FMath::Max(NumOccupied, 64));
+	if (!bValid || (uint32)InstanceCell.Num() > InstanceCount || bDegenerated)
+	{
+		Rebuild(Cur);
+		return;
+	}
+
+	if ((uint32)InstanceCell.Num() < InstanceCount)
+	{
+		const int32 OldNum = InstanceCell.Num();
+		InstanceCell.SetNumUninitialized(InstanceCount);
+		InstanceSlot.SetNumUninitialized(InstanceCount);
+		for (int32 InstanceIndex = OldNum; InstanceIndex < (int32)InstanceCount; InstanceIndex++)
+			InstanceCell[InstanceIndex] = INVALID_INDEX;
+	}
+
+	const FBoxCenterExtentFloat* Bounds = Cur->Bounds;
+
+	//added, moved, hidden, shown or destroyed instances. most moved ones stay in their cell and only its bound changes
+	for (uint32 RangeIndex = 0; RangeIndex < Cur->NumDirtyRanges; RangeIndex++)
+	{
+		const FAllegroIndexRange& Range = Cur->DirtyRanges[RangeIndex];
+		for (uint32 InstanceIndex = Range.Start; InstanceIndex < Range.Start + Range.Count; InstanceIndex++)
+		{
+			const bool bBinnable = !EnumHasAnyFlags(Cur->Flags[InstanceIndex], EAllegroInstanceFlags::EIF_Destroyed | EAllegroInstanceFlags::EIF_Hidden);
+			const int32 CellIndex = InstanceCell[InstanceIndex];
+			if (!bBinnable)
+			{
+				if (CellIndex != INVALID_INDEX)
+					Remove(InstanceIndex);
+				continue;
+			}
+
+			const FIntPoint Coord = ToCellCoord(Bounds[InstanceIndex].Center);
+			if (CellIndex == INVALID_INDEX)
+			{
+				Insert(InstanceIndex, Coord);
+				continue;
+			}
+
+			if (Cells[CellIndex].Coord == Coord)
+			{
+				MarkCellDirty(CellIndex);
+				continue;
+			}
+
+			Remove(InstanceIndex);
+			Insert(InstanceIndex, Coord);
+		}
+	}
+
+	//a visibility change that didn't mark its instance dirty would leave the grid stale forever
+	if ((uint32)NumIndexed != Cur->VisibleInstanceCount)
+	{
+		INC_DWORD_STAT(STAT_ALLEGRO_NumCullGridRecoveryRebuild);
+		Rebuild(Cur);
+		return;
+	}
+
+	RefreshBounds(Bounds);
+}
+
+void FAllegroCullGrid::Rebuild(const FAllegroDynamicData* Cur)
+{
+	ALLEGRO_SCOPE_CYCLE_COUNTER(FAllegroCullGrid_Rebuild);
+
+	const uint32 InstanceCount = Cur->InstanceCount;
+	const float TargetOccupancy = FMath::Max(GAllegro_NumInstancePerGridCell, 1);
+	const float MinCellSize = 100;
+
+	//initial guess assumes instances are spread evenly over the component bound, refined if they turn out to be clustered
+	FVector3f BoundSize;
+	Cur->CompBound.GetSize(BoundSize);
+	const float Area = FMath::Max(BoundSize.X * BoundSize.Y, 1.0f);
+	float NewCellSize = FMath::Max(FMath::Sqrt(Area * TargetOccupancy / FMath::Max(Cur->AliveInstanceCount, 1u)), MinCellSize);
+
+	for (int32 Iteration = 0; Iteration < 4; Iteration++)
+	{
+		Reset();
+		CellSize = NewCellSize;
+		InvCellSize = 1.0f / NewCellSize;
+		InstanceCell.Init(INVALID_INDEX, InstanceCount);
+		InstanceSlot.SetNumUninitialized(InstanceCount);
+
+		for (uint32 InstanceIndex = 0; InstanceIndex < InstanceCount; InstanceIndex++)
+		{
+			if (!EnumHasAnyFlags(Cur->Flags[InstanceIndex], EAllegroInstanceFlags::EIF_Destroyed | EAllegroInstanceFlags::EIF_Hidden))
+				Insert(InstanceIndex, ToCellCoord(Cur->Bounds[InstanceIndex].Center));
+		}
+
+		RebuildOccupancy = Cells.Num() ? float(NumIndexed) / Cells.Num() : 0;
+		if (RebuildOccupancy <= TargetOccupancy * 2 || CellSize <= MinCellSize)
+			break;
+
+		NewCellSize = FMath::Max(CellSize * FMath::Sqrt(TargetOccupancy / RebuildOccupancy), MinCellSize);
+	}
+
+	bValid = true;
+	RefreshBounds(Cur->Bounds);
+}
+
+void FAllegroCullGrid::Insert(uint32 InstanceIndex, const FIntPoint& Coord)
+{
+	int32& CellIndexRef = CellMap.FindOrAdd(Coord, INVALID_INDEX);
+	if (CellIndexRef == INVALID_INDEX)
+	{
+		CellIndexRef = Cells.AddDefaulted();
+		Cells[CellIndexRef].Coord = Coord;
+
+		const FIntPoint BlockCoord(Coord.X >> BLOCK_SHIFT, Coord.Y >> BLOCK_SHIFT);
+		int32& BlockIndex = BlockMap.FindOrAdd(BlockCoord, INVALID_INDEX);
+		if (BlockIndex == INVALID_INDEX)
+		{
+			BlockIndex = Blocks.AddDefaulted();
+			Blocks[BlockIndex].Coord = BlockCoord;
+		}
+
+		Cells[CellIndexRef].Block = BlockIndex;
+		NumEmptyCell++;
+	}
+
+	const int32 CellIndex = CellIndexRef;
+	FCell& Cell = Cells[CellIndex];
+	if (Cell.Instances.Num() == 0)
+	{
+		NumEmptyCell--;
+		LinkCell(CellIndex);
+	}
+
+	InstanceCell[InstanceIndex] = CellIndex;
+	InstanceSlot[InstanceIndex] = Cell.Instances.Add(InstanceIndex);
+	MarkCellDirty(CellIndex);
+	NumIndexed++;
+}
+
+void FAllegroCullGrid::Remove(uint32 InstanceIndex)
+{
+	const int32 CellIndex = InstanceCell[InstanceIndex];
+	FCell& Cell = Cells[CellIndex];
+	const int32 Slot = InstanceSlot[InstanceIndex];
+	check(Cell.Instances[Slot] == InstanceIndex);
+	Cell.Instances.RemoveAtSwap(Slot, 1, false);
+	if (Slot < Cell.Instances.Num())
+		InstanceSlot[Cell.Instances[Slot]] = Slot;
+
+	if (Cell.Instances.Num() == 0)
+	{
+		NumEmptyCell++;
+		UnlinkCell(CellIndex);
+	}
+
+	InstanceCell[InstanceIndex] = INVALID_INDEX;
+	MarkCellDirty(CellIndex);
+	NumIndexed--;
+}
+
+void FAllegroCullGrid::MarkCellDirty(int32 CellIndex)
+{
+	FCell& Cell = Cells[CellIndex];
+	if (!Cell.bBoundDirty)
+	{
+		Cell.bBoundDirty = true;
+		DirtyCells.Add(CellIndex);
+	}
+}
+
+void FAllegroCullGrid::Verify(const FAllegroDynamicData* Cur) const
+{
+	if (!bValid)
+		return;
+
+	int32 NumWrongVisibility = 0, NumWrongCell = 0, NumWrongSlot = 0;
+	for (uint32 InstanceIndex = 0; InstanceIndex < Cur->InstanceCount; InstanceIndex++)
+	{
+		const bool bBinnable = !EnumHasAnyFlags(Cur->Flags[InstanceIndex], EAllegroInstanceFlags::EIF_Destroyed | EAllegroInstanceFlags::EIF_Hidden);
+		const int32 CellIndex = InstanceCell[InstanceIndex];
+		if (bBinnable != (CellIndex != INVALID_INDEX))
+		{
+			NumWrongVisibility++;
+			continue;
+		}
+
+		if (CellIndex == INVALID_INDEX)
+			continue;
+
+		const FCell& Cell = Cells[CellIndex];
+		if (Cell.Coord != ToCellCoord(Cur->Bounds[InstanceIndex].Center))
+			NumWrongCell++;
+		if (!Cell.Instances.IsValidIndex(InstanceSlot[InstanceIndex]) || Cell.Instances[InstanceSlot[InstanceIndex]] != InstanceIndex)
+			NumWrongSlot++;
+	}
+
+	int32 NumWrongList = 0;
+	for (int32 CellIndex = 0; CellIndex < Cells.Num(); CellIndex++)
+	{
+		const FCell& Cell = Cells[CellIndex];
+		const FBlock& Block = Blocks[Cell.Block];
+		const bool bLinked = Cell.BlockSlot != INVALID_INDEX && Block.Cells.IsValidIndex(Cell.BlockSlot) && Block.Cells[Cell.BlockSlot] == CellIndex;
+		if (bLinked != (Cell.Instances.Num() > 0) || (bLinked && Block.ListSlot == INVALID_INDEX))
+			NumWrongList++;
+	}
+
+	if (NumWrongVisibility || NumWrongCell || NumWrongSlot || NumWrongList)
+	{
+		UE_LOG(LogAllegro, Warning, TEXT("allegro.DebugVerifyCullGrid: %d instances with stale visibility, %d in a wrong cell, %d with a wrong slot, %d cells with wrong non empty lists"),
+			NumWrongVisibility, NumWrongCell, NumWrongSlot, NumWrongList);
+	}
+}
+
+void FAllegroCullGrid::LinkCell(int32 CellIndex)
+{
+	FCell& Cell = Cells[CellIndex];
+	FBlock& Block = Blocks[Cell.Block];
+	Cell.BlockSlot = Block.Cells.Add(CellIndex);
+	if (Block.Cells.Num() == 1)
+		Block.ListSlot = NonEmptyBlocks.Add(Cell.Block);
+}
+
+void FAllegroCullGrid::UnlinkCell(int32 CellIndex)
+{
+	FCell& Cell = Cells[CellIndex];
+	FBlock& Block = Blocks[Cell.Block];
+	Block.Cells.RemoveAtSwap(Cell.BlockSlot, 1, false);
+	if (Cell.BlockSlot < Block.Cells.Num())
+		Cells[Block.Cells[Cell.BlockSlot]].BlockSlot = Cell.BlockSlot;
+
+	Cell.BlockSlot = INVALID_INDEX;
+
+	if (Block.Cells.Num() == 0)
+	{
+		NonEmptyBlocks.RemoveAtSwap(Block.ListSlot, 1, false);
+		if (Block.ListSlot < NonEmptyBlocks.Num())
+			Blocks[NonEmptyBlocks[Block.ListSlot]].ListSlot = Block.ListSlot;
+
+		Block.ListSlot = INVALID_INDEX;
+	}
+}
+
+void FAllegroCullGrid::RefreshBounds(const FBoxCenterExtentFloat* Bounds)
+{
+	for (int32 CellIndex : DirtyCells)
+	{
+		FCell& Cell = Cells[CellIndex];
+		Cell.Bound = FBoxMinMaxFloat(ForceInit);
+		for (uint32 InstanceIndex : Cell.Instances)
+			Cell.Bound.Add(Bounds[InstanceIndex]);
+
+		Cell.bBoundDirty = false;
+
+		FBlock& Block = Blocks[Cell.Block];
+		if (!Block.bBoundDirty)
+		{
+			Block.bBoundDirty = true;
+			DirtyBlocks.Add(Cell.Block);
+		}
+	}
+	DirtyCells.Reset();
+
+	for (int32 BlockIndex : DirtyBlocks)
+	{
+		FBlock& Block = Blocks[BlockIndex];
+		Block.Bound = FBoxMinMaxFloat(ForceInit);
+		for (int32 CellIndex : Block.Cells)
+			Block.Bound.Add(Cells[CellIndex].Bound);
+
+		Block.bBoundDirty = false;
+	}
+	DirtyBlocks.Reset();
+}
+
+void FAllegroCullGrid::Reset()
+{
+	if (!bValid && Cells.Num() == 0)
+		return;
+
+	CellMap.Reset();
+	BlockMap.Reset();
+	Cells.Reset();
+	Blocks.Reset();
+	NonEmptyBlocks.Reset();
+	InstanceCell.Reset();
+	InstanceSlot.Reset();
+	DirtyCells.Reset();
+	DirtyBlocks.Reset();
+	NumIndexed = 0;
+	NumEmptyCell = 0;
+	bValid = false;
+}
+
+SIZE_T FAllegroCullGrid::GetAllocatedSize() const
+{
+	SIZE_T Size = CellMap.GetAllocatedSize() + BlockMap.GetAllocatedSize() + Cells.GetAllocatedSize() + Blocks.GetAllocatedSize() + NonEmptyBlocks.GetAllocatedSize() + InstanceCell.GetAllocatedSize() + InstanceSlot.GetAllocatedSize()
+		+ DirtyCells.GetAllocatedSize() + DirtyBlocks.GetAllocatedSize();
+
+	for (const FCell& Cell : Cells)
+		Size += Cell.Instances.GetAllocatedSize();
+	for (const FBlock& Block : Blocks)
+		Size += Block.Cells.GetAllocatedSize();
+
+	return Size;
+}
+
+void FAllegroOcclusion::Update(const FAllegroCullGrid& Grid, const FVector3f& RenderOrigin)
+{
+	const uint32 FrameNumber = GFrameNumberRenderThread;
+	if (QueryFrameNumber != FrameNumber)
+	{
+		//queries of the previous frame were issued with these, results of them are accepted later in this frame
+		Swap(PrevQueryBoxes, QueryBoxes);
+		QueryFrameNumber = FrameNumber;
+
+		for (auto It = ViewResults.CreateIterator(); It; ++It)
+		{
+			if (FrameNumber - It->Value.FrameNumber > 2)	//view is gone
+				It.RemoveCurrent();
+		}
+	}
+
+	QueryBounds.Reset();
+	QueryBoxes.Reset();
+
+	const TArray<FAllegroCullGrid::FCell>& Cells = Grid.GetCells();
+	if (!GAllegro_OcclusionCull || Cells.Num() > GAllegro_MaxOcclusionQueries)
+		return;
+
+	QueryBounds.Reserve(Cells.Num());
+	QueryBoxes.Reserve(Cells.Num());
+	for (const FAllegroCullGrid::FCell& Cell : Cells)
+	{
+		//empty cells keep their index with a degenerate box, anything added later won't fit in it
+		const FBox3f Box = Cell.Instances.Num() ? Cell.Bound.ToBox().ExpandBy(GAllegro_OcclusionBoundExpand) : FBox3f(FVector3f::ZeroVector, FVector3f::ZeroVector);
+		QueryBoxes.Add(Box);
+		QueryBounds.Add(FBoxSphereBounds(FBox(Box.ShiftBy(RenderOrigin))));
+	}
+}
+
+void FAllegroOcclusion::ApplyWorldOffset(const FVector& Offset)
+{
+	for (FBoxSphereBounds& Bound : QueryBounds)
+		Bound.Origin += Offset;
+}
+
+void FAllegroOcclusion::Accept(const FSceneView* View, const TArray<bool>& Results, int32 ResultsStart, int32 NumResults)
+{
+	const TArray<FBox3f>& QueriedBoxes = QueryFrameNumber == GFrameNumberRenderThread ? PrevQueryBoxes : QueryBoxes;
+	if (QueriedBoxes.Num() != NumResults)
+		return;
+
+	FViewResults& ViewResult = ViewResults.FindOrAdd(View->GetViewKey());
+	ViewResult.FrameNumber = GFrameNumberRenderThread;
+	ViewResult.QueriedBounds = QueriedBoxes;
+	ViewResult.Occluded.SetNumUninitialized(NumResults);
+	for (int32 Index = 0; Index < NumResults; Index++)
+		ViewResult.Occluded[Index] = !Results[ResultsStart + Index];	//true means visible
+}
+
+const FAllegroOcclusion::FViewResults* FAllegroOcclusion::FindResults(const FSceneView* View) const
+{
+	if (!GAllegro_OcclusionCull)
+		return nullptr;
+
+	const FViewResults* Found = ViewResults.Find(View->GetViewKey());
+	return Found && Found->FrameNumber == GFrameNumberRenderThread ? Found : nullptr;
+}
+
+FAllegroLODBudgetState::FViewState FAllegroLODBudgetState::Get(const FSceneView* View) const
+{
+	FScopeLock ScopeLock(&Lock);
+	const FViewState* Found = ViewStates.Find(View->GetViewKey());
+	return Found ? *Found : FViewState();
+}
+
+void FAllegroLODBudgetState::Set(const FSceneView* View, const FViewState& State)
+{
+	FScopeLock ScopeLock(&Lock);
+	ViewStates.Add(View->GetViewKey(), State);
+
+	//views that stopped rendering (e.g closed split screen) leave stale entries
+	if (ViewStates.Num() > 8)
+	{
+		for (auto It = ViewStates.CreateIterator(); It; ++It)
+			if (State.FrameNumber - It->Value.FrameNumber > 60)
+				It.RemoveCurrent();
+	}
+}
+
+void FAllegroLODBudgetState::Reset()
+{
+	FScopeLock ScopeLock(&Lock);
+	ViewStates.Reset();
+}
+
+SIZE_T FAllegroLODBudgetState::GetAllocatedSize() const
+{
+	return ViewStates.GetAllocatedSize();
+}
+
+void FAllegroOcclusion::Reset()
+{
+	QueryBounds.Reset();
+	QueryBoxes.Reset();
+	PrevQueryBoxes.Reset();
+	ViewResults.Reset();
+}
+
+SIZE_T FAllegroOcclusion::GetAllocatedSize() const
+{
+	SIZE_T Size = QueryBounds.GetAllocatedSize() + QueryBoxes.GetAllocatedSize() + PrevQueryBoxes.GetAllocatedSize() + ViewResults.GetAllocatedSize();
+	for (const TPair<uint32, FViewResults>& Pair : ViewResults)
+		Size += Pair.Value.Occluded.GetAllocatedSize() + Pair.Value.QueriedBounds.GetAllocatedSize();
+
+	return Size;
+}
+
+const FAllegroDynamicData* FAllegroProxy::GetPrevFrameDynamicData() const
+{
+	if (OldDynamicData && !GAllegro_DebugForceNoPrevFrameData)
+	{
+		const int CFN = GFrameNumberRenderThread;
+		if ((CFN - OldDynamicData->CreationNumber) == 1)	//must belong to the previous frame exactly
+			return OldDynamicData;
+	}
+
+	return DynamicData;
+}
+
+void FAllegroGPUInstanceStore::WriteBlendFrames(float* Dst, const FAllegroDynamicData* Cur, const FAllegroDynamicData* Prev, uint32 NumBlendFramePerInstance)
+{
+	const uint32 DataSize = 2 * NumBlendFramePerInstance - 1;
+
+	FInstanceBlendFrameInfo nullInfo;
+	nullInfo.Weight[0] = 1;
+	nullInfo.Weight[1] = 0;
+	nullInfo.Weight[2] = 0;
+	nullInfo.Weight[3] = 0;
+
+	for (uint32 i = 0; i < Cur->NumBlendFrame; ++i)
+	{
+		float* DstCur = Dst + (i * 2 * DataSize);
+		if (Cur->BlendFrameInfoData)
+			FMemory::Memcpy(DstCur, &(Cur->BlendFrameInfoData[i]), sizeof(FInstanceBlendFrameInfo));
+		else
+			FMemory::Memcpy(DstCur, &nullInfo, sizeof(FInstanceBlendFrameInfo));
+
+		if (Prev->BlendFrameInfoData && Prev->NumBlendFrame > i)
+			FMemory::Memcpy(DstCur + DataSize, &(Prev->BlendFrameInfoData[i]), sizeof(FInstanceBlendFrameInfo));
+		else
+			FMemory::Memcpy(DstCur + DataSize, DstCur, sizeof(FInstanceBlendFrameInfo));
+	}
+}
+
+void FAllegroGPUInstanceStore::UploadFrameIndices(FRHICommandListImmediate& RHICmdList, FRHIUnorderedAccessView* DstUAV, TArray<uint32>& Uploaded, const FAllegroDynamicData* Cur, const FAllegroDynamicData* Prev, uint32* FAllegroDynamicData::* Indices, int32 ForcedIndex)
+{
+	const uint32 InstanceCount = Cur->InstanceCount;
+	const uint32* RESTRICT CurIndices = Cur->*Indices;
+	const uint32* RESTRICT PrevIndices = Prev->*Indices;
+
+	ScatterElements.Reset();
+	ScatterWords.Reset();
+	for (uint32 InstanceIndex = 0; InstanceIndex < InstanceCount; InstanceIndex++)
+	{
+		const bool bNew = EnumHasAnyFlags(Cur->Flags[InstanceIndex], EAllegroInstanceFlags::EIF_New);
+		uint32 CurIndex = CurIndices[InstanceIndex];
+		uint32 PrevIndex = (bNew ? CurIndices : PrevIndices)[InstanceIndex];
+		if (ForcedIndex >= 0)
+			CurIndex = PrevIndex = (uint32)ForcedIndex;
+
+		uint32* RESTRICT Dst = Uploaded.GetData() + InstanceIndex * 2;
+		if (Dst[0] != CurIndex || Dst[1] != PrevIndex)
+		{
+			Dst[0] = CurIndex;
+			Dst[1] = PrevIndex;
+			ScatterElements.Add(InstanceIndex);
+			ScatterWords.Add(CurIndex);
+			ScatterWords.Add(PrevIndex);
+		}
+	}
+
+	AllegroScatterUpload(RHICmdList, DstUAV, ScatterElements, ScatterWords.GetData(), 2);
+}
+
+void FAllegroGPUInstanceStore::Update(FRHICommandListImmediate& RHICmdList, const FAllegroDynamicData* Cur, const FAllegroDynamicData* Prev, uint32 NumCustomDataFloats, uint32 NumBlendFramePerInstance)
+{
+	const bool bSameData = UploadedSerial != 0 && Cur->SerialNumber == UploadedSerial;
+	if (bSameData && (UploadedFrameNumber == GFrameNumberRenderThread || !bPrevDiffers))
+		return;
+
+	ALLEGRO_SCOPE_CYCLE_COUNTER(FAllegroGPUInstanceStore_Update);
+
+	//dynamic data didn't change since the last upload, previous frame values must catch up with the current ones
+	if (bSameData)
+		Prev = Cur;
+
+	const uint32 InstanceCount = Cur->InstanceCount;
+	bool bFullUpload = !bSameData && Cur->SerialNumber != UploadedSerial + 1;	//missed an update or never uploaded
+
+	if (!InstanceBuffer || InstanceBuffer->InstanceCount < InstanceCount * 2)
+	{
+		InstanceBuffer = FAllegroInstanceBuffer::Create(Align(FMath::Max(InstanceCount, 1u) * 2, FAllegroInstanceBuffer::SizeAlign), false, true);
+		bFullUpload = true;
+	}
+
+	if (NumCustomDataFloats > 0 && (!CIDBuffer || CIDBuffer->NumberOfFloat < InstanceCount * NumCustomDataFloats))
+	{
+		CIDBuffer = FAllegroCIDBuffer::Create(Align(FMath::Max(InstanceCount, 1u) * NumCustomDataFloats, FAllegroCIDBuffer::SizeAlign), true);
+		bFullUpload = true;
+	}
+
+	//transforms of the dirty ranges, ranges whose previous transform was different need another upload to catch up
+	{
+		static_assert(sizeof(AllegroShaderMatrixT) % sizeof(uint32) == 0, "transforms are scattered as uint32 words");
+		const uint32 WordsPerInstance = 2 * sizeof(AllegroShaderMatrixT) / sizeof(uint32);
+
+		TArray<FAllegroIndexRange, TInlineAllocator<64>> Ranges;
+		if (bFullUpload)
+		{
+			Ranges.Add(FAllegroIndexRange{ 0, InstanceCount });
+		}
+		else
+		{
+			Ranges.Append(PrevRanges);
+			if (!bSameData)
+				Ranges.Append(Cur->DirtyRanges, Cur->NumDirtyRanges);
+		}
+
+		//ranges may overlap, every instance is uploaded once
+		Ranges.Sort([](const FAllegroIndexRange& A, const FAllegroIndexRange& B) { return A.Start < B.Start; });
+
+		ScatterElements.Reset();
+		ScatterWords.Reset();
+		uint32 UploadedEnd = 0;
+		for (const FAllegroIndexRange& Range : Ranges)
+		{
+			const uint32 RangeEnd = FMath::Min(Range.Start + Range.Count, InstanceCount);
+			for (uint32 InstanceIndex = FMath::Max(Range.Start, UploadedEnd); InstanceIndex < RangeEnd; InstanceIndex++)
+			{
+				const bool bNew = EnumHasAnyFlags(Cur->Flags[InstanceIndex], EAllegroInstanceFlags::EIF_New);
+				ScatterElements.Add(InstanceIndex);
+				AllegroShaderMatrixT* Dst = reinterpret_cast<AllegroShaderMatrixT*>(ScatterWords.GetData() + ScatterWords.AddUninitialized(WordsPerInstance));
+				Dst[0] = Cur->Transforms[InstanceIndex];
+				Dst[1] = (bNew ? Cur : Prev)->Transforms[InstanceIndex];
+			}
+			UploadedEnd = FMath::Max(UploadedEnd, RangeEnd);
+		}
+
+		AllegroScatterUpload(RHICmdList, InstanceBuffer->TransformUAV, ScatterElements, ScatterWords.GetData(), WordsPerInstance);
+		INC_DWORD_STAT_BY(STAT_ALLEGRO_NumPersistentUploadedInstance, ScatterElements.Num());
+
+		PrevRanges.Reset();
+		if (Prev != Cur)
+			PrevRanges.Append(Cur->DirtyRanges, Cur->NumDirtyRanges);
+	}
+
+	//frame indices change for every animated instance but not for idle or hidden ones, only instances whose values differ from the uploaded ones are scattered
+	{
+		if (bFullUpload)
+		{
+			UploadedFrameIndices.Reset();
+			UploadedBlendFrameIndices.Reset();
+		}
+		//new entries never match so they get uploaded
+		if (UploadedFrameIndices.Num() != (int32)InstanceCount * 2)
+		{
+			const int32 OldNum = FMath::Min<int32>(UploadedFrameIndices.Num(), InstanceCount * 2);
+			UploadedFrameIndices.SetNumUninitialized(InstanceCount * 2);
+			UploadedBlendFrameIndices.SetNumUninitialized(InstanceCount * 2);
+			for (int32 Index = OldNum; Index < UploadedFrameIndices.Num(); Index++)
+				UploadedFrameIndices[Index] = UploadedBlendFrameIndices[Index] = ~0u;
+		}
+
+		int32 ForcedFrameIndex = -1;
+#if !UE_BUILD_SHIPPING
+		ForcedFrameIndex = GAllegro_ForcedAnimFrameIndex;
+#endif
+		UploadFrameIndices(RHICmdList, InstanceBuffer->FrameIndexUAV, UploadedFrameIndices, Cur, Prev, &FAllegroDynamicData::FrameIndices, ForcedFrameIndex);
+		UploadFrameIndices(RHICmdList, InstanceBuffer->BlendFrameIndexUAV, UploadedBlendFrameIndices, Cur, Prev, &FAllegroDynamicData::BlendFrameInfoIndex, -1);
+	}
+
+	if (CIDBuffer && Cur->CustomData && (bFullUpload || (!bSameData && Cur->DirtyCustomData)))
+	{
+		const uint32 NumFloats = InstanceCount * NumCustomDataFloats;
+		float* Dst = (float*)RHICmdList.LockBuffer(CIDBuffer->CustomDataBuffer, 0, NumFloats * sizeof(float), RLM_WriteOnly);
+		FMemory::Memcpy(Dst, Cur->CustomData, NumFloats * sizeof(float));
+		RHICmdList.UnlockBuffer(CIDBuffer->CustomDataBuffer);
+	}
+
+	//blend frames are rewritten as a whole every update so their buffer is BUF_Dynamic
+	const uint32 NumBlendFrame = FMath::Max(Cur->NumBlendFrame, Prev->NumBlendFrame);
+	if (NumBlendFrame > 1)
+	{
+		const uint32 NumFloats = NumBlendFrame * (NumBlendFramePerInstance * 2 - 1) * 2;	//cur + prev
+		if (!BlendFrameBuffer || BlendFrameBuffer->NumberOfFloat < NumFloats)
+			BlendFrameBuffer = FAllegroBlendFrameBuffer::Create(Align(NumFloats, FAllegroBlendFrameBuffer::SizeAlign), false);
+
+		BlendFrameBuffer->NumBlendFrame = NumBlendFrame;
+		BlendFrameBuffer->LockBuffers();
+		WriteBlendFrames(BlendFrameBuffer->MappedData, Cur, Prev, NumBlendFramePerInstance);
+		BlendFrameBuffer->UnlockBuffers();
+	}
+	else
+	{
+		BlendFrameBuffer.Reset();
+	}
+
+	bPrevDiffers = Prev != Cur;
+	UploadedSerial = Cur->SerialNumber;
+	UploadedFrameNumber = GFrameNumberRenderThread;
+}
+
+void FAllegroGPUInstanceStore::Release()
+{
+	InstanceBuffer.Reset();
+	CIDBuffer.Reset();
+	BlendFrameBuffer.Reset();
+	PrevRanges.Empty();
+	UploadedFrameIndices.Empty();
+	UploadedBlendFrameIndices.Empty();
+	ScatterElements.Empty();
+	ScatterWords.Empty();
+	UploadedSerial = 0;
+}
+
+SIZE_T FAllegroGPUInstanceStore::GetAllocatedSize() const
+{
+	SIZE_T Size = PrevRanges.GetAllocatedSize() + UploadedFrameIndices.GetAllocatedSize() + UploadedBlendFrameIndices.GetAllocatedSize() + ScatterElements.GetAllocatedSize() + ScatterWords.GetAllocatedSize();
+	if (InstanceBuffer)
+		Size += InstanceBuffer->InstanceCount * (sizeof(AllegroShaderMatrixT) + sizeof(uint32) * 2);
+	if (CIDBuffer)
+		Size += CIDBuffer->NumberOfFloat * sizeof(float);
+	if (BlendFrameBuffer)
+		Size += BlendFrameBuffer->NumberOfFloat * sizeof(float);
+
+	return Size;
+}
+
 void FAllegroDynamicData::FCell::AddValue(FAllegroDynamicData& Owner, uint32 InValue)
 {
 	if (Counter == MAX_INSTANCE_PER_CELL)
@@ -7,8 +7,10 @@
 #include "Components.h"
 #include "AllegroComponent.h"
 #include "AllegroRenderResources.h"
+#include "AllegroGPUCull.h"
 #include "Containers/TripleBuffer.h"
 #include "Containers/CircularQueue.h"
+#include "ConvexVolume.h"
 
 class FAllegroProxy;
 
@@ -60,6 +62,7 @@ struct FAllegroDynamicData
 	FBoxMinMaxFloat CompBound { ForceInit };
 
 	EAllegroInstanceFlags* Flags = nullptr;
+	//#Note Transforms, Bounds and CustomData point to FAllegroInstanceStore of the proxy, they are valid after FAllegroProxy::SetDynamicDataRT
 	FMatrix44f* Transforms = nullptr;
 	FBoxCenterExtentFloat* Bounds = nullptr;
 	uint32* FrameIndices = nullptr;
@@ -75,7 +78,9 @@ struct FAllegroDynamicData
 
 	uint32 InstanceCount = 0;
 	uint32 AliveInstanceCount = 0;
+	uint32 VisibleInstanceCount = 0;	//alive and not hidden, FAllegroCullGrid rebuilds if it doesn't index this many after an update
 	uint32 CreationNumber = 0;
+	uint32 SerialNumber = 0;	//incremented by each dynamic data sent to the proxy, see FAllegroProxy::SetDynamicDataRT
 	
 
 	FCell::FCellPage* CellPagePool = nullptr;
@@ -84,6 +89,19 @@ struct FAllegroDynamicData
 
 	FCell* Cells = nullptr;
 	uint32 NumCells = 0;
+	bool bUseCullGrid = false;	//culled by FAllegroCullGrid of the proxy instead of Cells, see allegro.PersistentCullGrid
+
+	//delta sent from game thread, only the instances that changed since the last update
+	FAllegroIndexRange* DirtyRanges = nullptr;
+	uint32 NumDirtyRanges = 0;
+	uint32 NumDirtyInstance = 0;
+	FMatrix44f* DirtyTransforms = nullptr;	//packed in order of DirtyRanges, in the space of the instance store (world - RenderOrigin)
+	FBoxCenterExtentFloat* DirtyBounds = nullptr;
+	float* DirtyCustomData = nullptr;	//whole custom data array, null if it didn't change
+	uint32 NumDirtyCustomDataFloats = 0;
+
+	FVector3f RenderOrigin = FVector3f::ZeroVector;	//translation from the space of the instance store to world space, see UAllegroComponent::RenderOrigin
+	FVector3f StoreRebase = FVector3f::ZeroVector;	//non zero if the space of the instance store moved by this update. all instances are dirty then
 
 
 	FIntPoint GridSize = FIntPoint::NoneValue;	//number of cell in x y axis
@@ -113,14 +131,330 @@ struct FAllegroDynamicData
 	}
 
 	void InitGrid();
+	//bins visible instances into cells when allegro.PersistentCullGrid is off. tasks are bounded by the worker count, each fills its own partial grid then cell ranges are merged in parallel
+	void BinInstances(const EAllegroInstanceFlags* InFlags, const FBoxCenterExtentFloat* InBounds, int32 NumInstancePerTask);
 
-	static FAllegroDynamicData* Allocate(UAllegroComponent* Comp);
+	static FAllegroDynamicData* Allocate(UAllegroComponent* Comp, const TArray<FAllegroIndexRange>& InDirtyRanges, uint32 InNumDirtyInstance);
 
 	void operator delete(void* ptr) { return FMemory::Free(ptr); }
 
 
 };
 
+/*
+* persistent render thread copy of instances data, updated by delta of FAllegroDynamicData instead of taking a snapshot every frame.
+* transforms and bounds are relative to FAllegroProxy::RenderOrigin, origin rebasing doesn't touch them.
+*/
+struct FAllegroInstanceStore
+{
+	TArray<FMatrix44f, TAlignedHeapAllocator<16>> Transforms;
+	TArray<FMatrix44f, TAlignedHeapAllocator<16>> PrevTransforms;	//transforms of the previous update, required for velocity
+	TArray<FBoxCenterExtentFloat> Bounds;
+	TArray<float> CustomData;
+	//ranges applied by the last update. PrevTransforms of them are behind and must catch up in the next update
+	TArray<FAllegroIndexRange> LastRanges;
+
+	//applies the delta and binds arrays of the store to @Cur and @Prev
+	void Apply(FAllegroDynamicData* Cur, FAllegroDynamicData* Prev);
+	SIZE_T GetAllocatedSize() const;
+};
+
+/*
+* persistent render thread culling grid, used instead of the per update grid of FAllegroDynamicData if allegro.PersistentCullGrid is on.
+* instances are binned by their center into 2D cells of fixed size, cells keep loose bounds of their instances and are grouped into blocks for early rejects.
+* an update only touches instances that moved to another cell or got hidden/shown, bounds of the touched cells are recomputed.
+*/
+struct FAllegroCullGrid
+{
+	static constexpr int32 INVALID_INDEX = -1;
+	static constexpr int32 BLOCK_SHIFT = 3;	//blocks are 8x8 cells
+
+	struct FCell
+	{
+		FBoxMinMaxFloat Bound { ForceInit };
+		FIntPoint Coord;
+		int32 Block = INVALID_INDEX;
+		int32 BlockSlot = INVALID_INDEX;	//index in FBlock::Cells, INVALID_INDEX while the cell is empty
+		TArray<uint32> Instances;
+		bool bBoundDirty = false;
+	};
+
+	struct FBlock
+	{
+		FBoxMinMaxFloat Bound { ForceInit };
+		FIntPoint Coord;
+		TArray<int32> Cells;	//non empty cells only
+		int32 ListSlot = INVALID_INDEX;	//index in NonEmptyBlocks, INVALID_INDEX while the block is empty
+		bool bBoundDirty = false;
+	};
+
+	//applies the dirty ranges of @Cur, the game thread marks hidden, shown and destroyed instances dirty too. must be called after FAllegroInstanceStore::Apply
+	void Update(const FAllegroDynamicData* Cur);
+	void Reset();
+	//next update rebuilds the grid, e.g after origin rebasing
+	void Invalidate() { bValid = false; }
+	bool IsValid() const { return bValid; }
+	int32 GetNumIndexed() const { return NumIndexed; }
+	//logs instances whose binning doesn't match their flags and bounds in @Cur, see allegro.DebugVerifyCullGrid
+	void Verify(const FAllegroDynamicData* Cur) const;
+
+	//call @Proc(int32 CellIndex, const FCell&, bool bFullyInside) for every non empty cell that intersects @Frustum. only non empty blocks and cells are visited
+	template<typename TProc> void ForEachVisibleCell(const FConvexVolume& Frustum, TProc&& Proc) const
+	{
+		for (int32 BlockIndex : NonEmptyBlocks)
+		{
+			const FBlock& Block = Blocks[BlockIndex];
+			bool bBlockInside;
+			FBoxCenterExtentFloat BlockBound;
+			Block.Bound.ToCenterExtentBox(BlockBound);
+			if (!Frustum.IntersectBox(FVector(BlockBound.Center), FVector(BlockBound.Extent), bBlockInside))
+				continue;
+
+			for (int32 CellIndex : Block.Cells)
+			{
+				const FCell& Cell = Cells[CellIndex];
+				bool bFullyInside = bBlockInside;
+				if (!bBlockInside)
+				{
+					FBoxCenterExtentFloat CellBound;
+					Cell.Bound.ToCenterExtentBox(CellBound);
+					if (!Frustum.IntersectBox(FVector(CellBound.Center), FVector(CellBound.Extent), bFullyInside))
+						continue;
+				}
+
+				Proc(CellIndex, Cell, bFullyInside);
+			}
+		}
+	}
+
+	const TArray<FCell>& GetCells() const { return Cells; }
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	void Rebuild(const FAllegroDynamicData* Cur);
+	void Insert(uint32 InstanceIndex, const FIntPoint& Coord);
+	void Remove(uint32 InstanceIndex);
+	void MarkCellDirty(int32 CellIndex);
+	//add/remove a cell that got occupied/vacated to the non empty lists of its block and of the grid
+	void LinkCell(int32 CellIndex);
+	void UnlinkCell(int32 CellIndex);
+	//recompute bounds of the cells and blocks touched by the last update
+	void RefreshBounds(const FBoxCenterExtentFloat* Bounds);
+
+	FIntPoint ToCellCoord(const FVector3f& Center) const
+	{
+		const float Limit = 1 << 30;
+		return FIntPoint(FMath::FloorToInt(FMath::Clamp(Center.X * InvCellSize, -Limit, Limit)), FMath::FloorToInt(FMath::Clamp(Center.Y * InvCellSize, -Limit, Limit)));
+	}
+
+	TMap<FIntPoint, int32> CellMap;		//cell coordinate -> index in Cells
+	TMap<FIntPoint, int32> BlockMap;	//block coordinate -> index in Blocks
+	TArray<FCell> Cells;
+	TArray<FBlock> Blocks;
+	TArray<int32> NonEmptyBlocks;
+	TArray<int32> InstanceCell;	//per instance, index in Cells or INVALID_INDEX if not binned
+	TArray<int32> InstanceSlot;	//per instance, index in FCell::Instances
+	TArray<int32> DirtyCells;
+	TArray<int32> DirtyBlocks;
+	float CellSize = 0;
+	float InvCellSize = 0;
+	int32 NumIndexed = 0;
+	int32 NumEmptyCell = 0;
+	float RebuildOccupancy = 0;	//average number of instances per occupied cell right after the last rebuild
+	bool bValid = false;
+};
+
+/*
+* per cell occlusion culling by the sub primitive occlusion queries of the engine (same mechanism HISM uses for its nodes).
+* every cell of FAllegroCullGrid is queried each frame, the results are consumed by the culling of the next frame.
+* a result is trusted only if the cell still fits in the expanded bound it was queried with, so cells of fast moving instances stay visible.
+*/
+struct FAllegroOcclusion
+{
+	struct FViewResults
+	{
+		TArray<bool> Occluded;		//per cell index
+		TArray<FBox3f> QueriedBounds;	//per cell index
+		uint32 FrameNumber = ~0u;
+
+		bool IsOccluded(int32 CellIndex, const FBoxMinMaxFloat& CellBound) const
+		{
+			return CellIndex < Occluded.Num() && Occluded[CellIndex] && QueriedBounds[CellIndex].IsInside(CellBound.ToBox());
+		}
+	};
+
+	TArray<FBoxSphereBounds> QueryBounds;	//world space bounds queried by this frame, index is the cell index
+	TArray<FBox3f> QueryBoxes;				//same as QueryBounds in instance store space
+	TArray<FBox3f> PrevQueryBoxes;			//boxes queried by the previous frame if QueryBoxes is already rebuilt in this frame
+	uint32 QueryFrameNumber = ~0u;
+	TMap<uint32, FViewResults> ViewResults;	//key is FSceneView::GetViewKey()
+
+	//rebuild query bounds from the cells of @Grid, @RenderOrigin moves them to world space
+	void Update(const FAllegroCullGrid& Grid, const FVector3f& RenderOrigin);
+	//cells don't move by origin rebasing, only the world space query bounds do. results remain valid
+	void ApplyWorldOffset(const FVector& Offset);
+	void Accept(const FSceneView* View, const TArray<bool>& Results, int32 ResultsStart, int32 NumResults);
+	//results usable by this frame, null if there is none
+	const FViewResults* FindResults(const FSceneView* View) const;
+	void Reset();
+	SIZE_T GetAllocatedSize() const;
+};
+
+/*
+* LOD budget state of a proxy per main view, see ApplyLODBudget. main views are generated in parallel so each one keeps its own step and threshold.
+*/
+struct FAllegroLODBudgetState
+{
+	struct FViewState
+	{
+		uint32 Step = 0;
+		uint32 Threshold = ~0u;	//screen size (float bits)
+		uint32 StepFrameNumber = 0;	//frame the step last changed
+		uint32 FrameNumber = 0;	//frame the state was last written
+	};
+
+	//state of @View, default if it has none
+	FViewState Get(const FSceneView* View) const;
+	void Set(const FSceneView* View, const FViewState& State);
+	void Reset();
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	TMap<uint32, FViewState> ViewStates;	//key is FSceneView::GetViewKey()
+	mutable FCriticalSection Lock;
+};
+
+/*
+* persistent instance indexed GPU copy of the instance data, used by the main pass views instead of per view buffers if allegro.PersistentInstanceBuffers is on.
+* views then only upload their element indices which are instance indices. updated at most once per frame,
+* transforms of the dirty ranges and frame indices that differ from the uploaded ones are written in place by AllegroScatterUpload, the buffers are never locked.
+* custom data rarely changes and is locked as a whole, blend frames are rewritten every update and live in a BUF_Dynamic buffer.
+*/
+struct FAllegroGPUInstanceStore
+{
+	//same layout as the per view buffers of the main pass: [InstanceIndex * 2] current, [InstanceIndex * 2 + 1] previous frame
+	FAllegroInstanceBufferPtr InstanceBuffer;
+	FAllegroCIDBufferPtr CIDBuffer;
+	FAllegroBlendFrameBufferPtr BlendFrameBuffer;
+
+	uint32 UploadedSerial = 0;	//SerialNumber of the uploaded dynamic data, 0 if nothing is uploaded
+	uint32 UploadedFrameNumber = ~0u;
+	bool bPrevDiffers = false;	//true if previous frame data of the last upload isn't the current one, it must catch up once dynamic data gets stale
+	TArray<FAllegroIndexRange> PrevRanges;	//ranges whose previous transform differs from the current one
+	TArray<uint32> UploadedFrameIndices;	//CPU copy of FrameIndexVB, same layout
+	TArray<uint32> UploadedBlendFrameIndices;	//CPU copy of BlendFrameIndexVB, same layout
+	TArray<uint32> ScatterElements;	//scratch of the scatter uploads
+	TArray<uint32> ScatterWords;
+
+	//brings the buffers up to date for the current frame. @Prev is the dynamic data of the previous frame or @Cur if there is none
+	void Update(FRHICommandListImmediate& RHICmdList, const FAllegroDynamicData* Cur, const FAllegroDynamicData* Prev, uint32 NumCustomDataFloats, uint32 NumBlendFramePerInstance);
+	//forces a full upload by the next Update
+	void Invalidate() { UploadedSerial = 0; }
+	void Release();
+	SIZE_T GetAllocatedSize() const;
+
+	//writes blend frame data of @Cur and @Prev interleaved, layout of the main pass
+	static void WriteBlendFrames(float* Dst, const FAllegroDynamicData* Cur, const FAllegroDynamicData* Prev, uint32 NumBlendFramePerInstance);
+
+private:
+	//scatters the instances whose current or previous @Indices differ from @Uploaded, @Uploaded is updated to the new values. @ForcedIndex overrides all values if >= 0
+	void UploadFrameIndices(FRHICommandListImmediate& RHICmdList, FRHIUnorderedAccessView* DstUAV, TArray<uint32>& Uploaded, const FAllegroDynamicData* Cur, const FAllegroDynamicData* Prev, uint32* FAllegroDynamicData::* Indices, int32 ForcedIndex);
+};
+
+
+/*
+* shadow data shared by all shadow views of a frame. each cascade of a whole scene shadow gathers its meshes separately,
+* instead of building everything per cascade the views append the instances they draw to shared buffers and LOD of an instance is decided once per main view.
+* shadow batches of every view then only differ by their element indices (rows of the shared buffers).
+*/
+struct FAllegroShadowSharedData
+{
+	static constexpr uint8 LOD_UNKNOWN = 0xFE;	//0xFF means culled
+	static constexpr uint32 SLOT_NONE = ~0u;
+
+	uint32 FrameNumber = ~0u;
+	const FSceneViewFamily* ViewFamily = nullptr;
+	const FAllegroDynamicData* DynamicData = nullptr;
+
+	//persistent buffers kept across frames, rows are appended in order of first draw so they only hold the union of the instances drawn by the views
+	FAllegroInstanceBufferPtr InstanceBuffer;
+	FAllegroCIDBufferPtr CIDBuffer;
+	FAllegroBlendFrameBufferPtr BlendFrameBuffer;
+	TArray<uint32> InstanceSlots;	//[InstanceIndex] row of the instance, SLOT_NONE if no view of this frame has drawn it yet
+	TArray<uint32> SlotInstances;	//[Row] instance index
+	uint32 NumUploadedSlot = 0;	//rows below this are already in the buffers
+	bool bBlendFramesUploaded = false;
+
+	//LOD is selected from the main view that owns the shadow view so that an instance has the same LOD in every cascade of that view
+	struct FLODView
+	{
+		const FSceneView* View = nullptr;
+		TArray<uint8> InstanceLODs;	//[InstanceIndex * NumLODMesh + LODMeshIndex], filled lazily by the shadow views
+	};
+	bool bLODShowFlag = true;
+	uint32 NumLODMesh = 0;
+	TArray<FLODView, TInlineAllocator<1>> LODViews;
+
+	bool IsValidFor(const FSceneViewFamily* InViewFamily, const FAllegroDynamicData* InDynamicData) const
+	{
+		return FrameNumber == InViewFamily->FrameNumber && ViewFamily == InViewFamily && DynamicData == InDynamicData;
+	}
+	//starts a new frame, buffers are kept for reuse
+	void BeginFrame(const FSceneViewFamily* InViewFamily, const FAllegroDynamicData* InDynamicData, uint32 InNumLODMesh)
+	{
+		FrameNumber = InViewFamily->FrameNumber;
+		ViewFamily = InViewFamily;
+		DynamicData = InDynamicData;
+		InstanceSlots.Init(SLOT_NONE, InDynamicData->InstanceCount);
+		SlotInstances.Reset();
+		NumUploadedSlot = 0;
+		bBlendFramesUploaded = false;
+		bLODShowFlag = InViewFamily->EngineShowFlags.LOD;
+		NumLODMesh = InNumLODMesh;
+		LODViews.Reset();
+	}
+	//returns the row of the instance, assigning the next one if it isn't in the buffers yet
+	uint32 GetSlot(uint32 InstanceIndex)
+	{
+		uint32& Slot = InstanceSlots[InstanceIndex];
+		if (Slot == SLOT_NONE)
+			Slot = SlotInstances.Add(InstanceIndex);
+		return Slot;
+	}
+	FLODView& FindOrAddLODView(const FSceneView* OwnerView)
+	{
+		for (FLODView& LODView : LODViews)
+			if (LODView.View == OwnerView)
+				return LODView;
+
+		FLODView& LODView = LODViews.AddDefaulted_GetRef();
+		LODView.View = OwnerView;
+		LODView.InstanceLODs.Init(LOD_UNKNOWN, DynamicData->InstanceCount * NumLODMesh);
+		return LODView;
+	}
+	void Reset()
+	{
+		FrameNumber = ~0u;
+		ViewFamily = nullptr;
+		DynamicData = nullptr;
+		InstanceBuffer.Reset();
+		CIDBuffer.Reset();
+		BlendFrameBuffer.Reset();
+		InstanceSlots.Empty();
+		SlotInstances.Empty();
+		NumUploadedSlot = 0;
+		bBlendFramesUploaded = false;
+		LODViews.Empty();
+	}
+	SIZE_T GetAllocatedSize() const
+	{
+		SIZE_T Size = InstanceSlots.GetAllocatedSize() + SlotInstances.GetAllocatedSize() + LODViews.GetAllocatedSize();
+		for (const FLODView& LODView : LODViews)
+			Size += LODView.InstanceLODs.GetAllocatedSize();
+		return Size;
+	}
+};
+
 
 struct FProxyLODData
 {
@@ -168,6 +502,9 @@ struct FProxyMeshDataBase
 	float LODHysteresis[ALLEGRO_MAX_LOD];
 
 	float ExtentFactor = 1.0f;
+
+	float ImpostorScreenSize = 0;
+	uint8 ImpostorLOD = 0xFF;	//LOD index the impostor is drawn as, right after the last skeletal LOD. 0xFF if there is no impostor
 };
 
 struct FProxyMeshData : public FProxyMeshDataBase
@@ -175,6 +512,12 @@ struct FProxyMeshData : public FProxyMeshDataBase
 	USkeletalMesh* SkeletalMesh = nullptr; //not touched during rendering
 	const FSkeletalMeshRenderData* SkeletalRenderData = nullptr;
 	FAllegroMeshDataExPtr MeshDataEx;
+
+	const FStaticMeshRenderData* ImpostorRenderData = nullptr;
+	int ImpostorMaterialIndex = 0;	//index of the first impostor material in FAllegroProxy::MaterialsProxy
+	uint8 ImpostorMeshLOD = 0;		//LOD of ImpostorRenderData that is drawn, resolved in CreateRenderThreadResources
+
+	const FStaticMeshLODResources& GetImpostorLODResources() const { return ImpostorRenderData->LODResources[ImpostorMeshLOD]; }
 };
 
 struct FProxyStaticMeshData : public FProxyMeshDataBase
@@ -210,12 +553,25 @@ public:
 	uint32 MaxBatchCountPossible;
 	FAllegroDynamicData* DynamicData;
 	FAllegroDynamicData* OldDynamicData;
+	FAllegroInstanceStore InstanceStore;
+	FAllegroGPUInstanceStore GPUInstanceStore;
+	FAllegroCullGrid CullGrid;
+	FAllegroOcclusion Occlusion;
+	FVector3f RenderOrigin = FVector3f::ZeroVector;	//translation from instance store space to world space. culling and the vertex factory apply it
+	FAllegroLODBudgetState LODBudgetState;
+#if ALLEGRO_GPU_CULL
+	FAllegroGPUCullInput GPUCullInput;
+#endif
 	TArray<FProxyMeshData> SubMeshes;
 	TArray<FMaterialRenderProxy*> MaterialsProxy;
 	TArray<uint16> MaterialIndicesArray;
 
 	TArray<FProxyStaticMeshData>  SubStaticMeshes;
 
+	//sub mesh index -> sub mesh whose shadow batch draws it. sub meshes of the same mesh with default depth materials share one batch
+	TArray<uint8> ShadowSubMeshRemap;
+	FAllegroShadowSharedData ShadowSharedData;
+
 	FBoxMinMaxFloat FixBound;
 
 
@@ -227,9 +583,9 @@ public:
 
 	bool CanBeOccluded() const override;
 	void ApplyWorldOffset(FVector InOffset) override;
-	const TArray<FBoxSphereBounds>* GetOcclusionQueries(const FSceneView* View) const override { return nullptr; }
-	void AcceptOcclusionResults(const FSceneView* View, TArray<bool>* Results, int32 ResultsStart, int32 NumResults) override { }
-	bool HasSubprimitiveOcclusionQueries() const override { return false; }
+	const TArray<FBoxSphereBounds>* GetOcclusionQueries(const FSceneView* View) const override;
+	void AcceptOcclusionResults(const FSceneView* View, TArray<bool>* Results, int32 ResultsStart, int32 NumResults) override;
+	bool HasSubprimitiveOcclusionQueries() const override;
 	void GetLightRelevance(const FLightSceneProxy* LightSceneProxy, bool& bDynamic, bool& bRelevant, bool& bLightMapped, bool& bShadowMapped) const override;
 	FPrimitiveViewRelevance GetViewRelevance(const FSceneView* View) const override;
 	SIZE_T GetTypeHash() const override;
@@ -240,14 +596,19 @@ public:
 	void GetDynamicMeshElements(const TArray<const FSceneView*>& Views, const FSceneViewFamily& ViewFamily, uint32 VisibilityMap, FMeshElementCollector& Collector) const override;
 
 	void SetDynamicDataRT(FAllegroDynamicData* pData);
+	//dynamic data to take previous frame values from (velocity). its DynamicData itself if OldDynamicData doesn't belong to the previous frame exactly
+	const FAllegroDynamicData* GetPrevFrameDynamicData() const;
 
 	bool IsMultiMesh() const { return SubMeshes.Num() > 1 && MaxMeshPerInstance > 0; }
 
 
 	FAllegroBaseVertexFactory* GetVertexFactory(int SubMeshIndex, int LodIndex, const FAllegroBoneIndexVertexBuffer* BoneIndexBuffer, const FSkeletalMeshLODRenderData* LODData, int MaxBoneInfluence, FStaticMeshVertexBuffers* AdditionalStaticMeshVB);
 	FAllegroBaseVertexFactory* GetStaticVertexFactory(int SubMeshIndex, int LodIndex, const FStaticMeshLODResources* LODData, FStaticMeshVertexBuffers* AdditionalStaticMeshVB);
+	//unskinned vertex factory of the impostor of a skeletal sub mesh, kept in the VertexFactories of its impostor LOD
+	FAllegroBaseVertexFactory* GetImpostorVertexFactory(int SubMeshIndex);
 
 	void SetHasStencil(bool HasStencil);
+	void InitShadowSubMeshRemap();
 
 private:
 
@@ -11,6 +11,9 @@
 #include "MeshMaterialShader.h"
 #include "MaterialDomain.h"
 #include "DataDrivenShaderPlatformInfo.h"
+#include "GlobalShader.h"
+#include "ShaderParameterStruct.h"
+#include "RenderGraphUtils.h"
 #include "GlobalRenderResources.h"
 #include "AllegroPrivateUtils.h"
 #include "Animation/Skeleton.h"
@@ -423,13 +426,33 @@ FAllegroAnimationBuffer::~FAllegroAnimationBuffer()
 
 void FAllegroAnimationBuffer::InitRHI(FRHICommandListBase& RHICmdList)
 {
-	const uint32 Stride = bHighPrecision ? sizeof(float[4]) : sizeof(uint16[4]);
-	FRHIResourceCreateInfo info(TEXT("FAllegroAnimationBuffer"), Transforms->GetResourceArray());
+	const uint32 Stride = bHighPrecision ? sizeof(FVector4f) : sizeof(FFloat16Color);
+	const uint32 BufferSize = Transforms ? Transforms->Num() * Transforms->GetStride() : ExternalTransforms.GetResourceDataSize();
+	FRHIResourceCreateInfo info(TEXT("FAllegroAnimationBuffer"), Transforms ? Transforms->GetResourceArray() : &ExternalTransforms);
 	ERHIAccess AM = ERHIAccess::Unknown;// ERHIAccess::SRVGraphics | ERHIAccess::UAVCompute | ERHIAccess::CopyDest;
-	Buffer = RHICmdList.CreateVertexBuffer(Transforms->Num() * Transforms->GetStride(), BUF_UnorderedAccess | BUF_ShaderResource, AM, info);
+	Buffer = RHICmdList.CreateVertexBuffer(BufferSize, BUF_UnorderedAccess | BUF_ShaderResource, AM, info);
 	ShaderResourceViewRHI = RHICmdList.CreateShaderResourceView(Buffer, Stride, bHighPrecision ? PF_A32B32G32R32F : PF_FloatRGBA);
 	UAV = RHICmdList.CreateUnorderedAccessView(Buffer, bHighPrecision ? PF_A32B32G32R32F : PF_FloatRGBA);
 
+	if (FrameRemap.Num())
+	{
+		TResourceArray<uint32> RemapData;
+		RemapData.Append(FrameRemap);
+		FRHIResourceCreateInfo RemapInfo(TEXT("FAllegroAnimationBuffer_FrameRemap"), &RemapData);
+		FrameRemapBuffer = RHICmdList.CreateVertexBuffer(RemapData.GetResourceDataSize(), (bDynamicFrameRemap ? BUF_Dynamic : BUF_Static) | BUF_ShaderResource, ERHIAccess::SRVMask, RemapInfo);
+		FrameRemapSRV = RHICmdList.CreateShaderResourceView(FrameRemapBuffer, sizeof(uint32), PF_R32_UINT);
+	}
+
+	if (ImpostorFrames.Num())
+	{
+		//runtime transitions update their range by sub range locks, the rest must be kept
+		TResourceArray<uint32> ImpostorData;
+		ImpostorData.Append(ImpostorFrames);
+		FRHIResourceCreateInfo ImpostorInfo(TEXT("FAllegroAnimationBuffer_ImpostorFrames"), &ImpostorData);
+		ImpostorFrameBuffer = RHICmdList.CreateVertexBuffer(ImpostorData.GetResourceDataSize(), BUF_Static | BUF_ShaderResource, ERHIAccess::SRVMask, ImpostorInfo);
+		ImpostorFrameSRV = RHICmdList.CreateShaderResourceView(ImpostorFrameBuffer, sizeof(uint32), PF_R32_UINT);
+	}
+
 	delete Transforms;
 	Transforms = nullptr;
 }
@@ -437,6 +460,10 @@ void FAllegroAnimationBuffer::InitRHI(FRHICommandListBase& RHICmdList)
 
 void FAllegroAnimationBuffer::ReleaseRHI()
 {
+	ImpostorFrameSRV.SafeRelease();
+	ImpostorFrameBuffer.SafeRelease();
+	FrameRemapSRV.SafeRelease();
+	FrameRemapBuffer.SafeRelease();
 	ShaderResourceViewRHI.SafeRelease();
 	Buffer.SafeRelease();
 }
@@ -444,6 +471,7 @@ void FAllegroAnimationBuffer::ReleaseRHI()
 void FAllegroAnimationBuffer::Serialize(FArchive& Ar)
 {
 	Ar << bHighPrecision;
+	Ar << Format;
 	bool bAnyData = Transforms != nullptr;
 	Ar << bAnyData;
 	if (Ar.IsSaving())
@@ -467,58 +495,48 @@ void FAllegroAnimationBuffer::AllocateBuffer()
 		delete Transforms;
 
 	if (bHighPrecision)
-		Transforms = new TStaticMeshVertexData<FMatrix3x4>();
+		Transforms = new TStaticMeshVertexData<FVector4f>();
 	else
-		Transforms = new TStaticMeshVertexData<FMatrix3x4Half>();
+		Transforms = new TStaticMeshVertexData<FFloat16Color>();
 }
 
-void FAllegroAnimationBuffer::InitBuffer(const TArrayView<FTransform> InTransforms, bool InHightPrecision)
+void FAllegroAnimationBuffer::InitBuffer(uint32 NumBone, bool InHightPrecision, EAllegroAnimBufferFormat InFormat, bool bFillIdentity)
 {
-	InitBuffer(InTransforms.Num(), InHightPrecision, false);
-
-	if (bHighPrecision)
-	{
-		FMatrix3x4* Dst = (FMatrix3x4*)Transforms->GetDataPointer();
-		for (int i = 0; i < InTransforms.Num(); i++)
-			Dst[i].SetMatrixTranspose(InTransforms[i].ToMatrixWithScale());
-
-	}
-	else
-	{
-		FMatrix3x4Half* Dst = (FMatrix3x4Half*)Transforms->GetDataPointer();
-		for (int i = 0; i < InTransforms.Num(); i++)
-			Dst[i].SetMatrixTranspose(FMatrix44f(InTransforms[i].ToMatrixWithScale()));
+	this->bHighPrecision = InHightPrecision;
+	this->Format = InFormat;
+	this->AllocateBuffer();
+	this->Transforms->ResizeBuffer(NumBone * GetVectorsPerBone());
 
-	}
+	if(bFillIdentity)
+		FillIdentity(0, NumBone);
 }
 
-void FAllegroAnimationBuffer::InitBuffer(uint32 NumMatrix, bool InHightPrecision, bool bFillIdentity)
+void FAllegroAnimationBuffer::InitExternal(const void* Data, uint32 Size, bool InHightPrecision, EAllegroAnimBufferFormat InFormat)
 {
+	check(Data && Size % (AllegroAnimBufferVectorsPerBone(InFormat) * (InHightPrecision ? sizeof(FVector4f) : sizeof(FFloat16Color))) == 0);
 	this->bHighPrecision = InHightPrecision;
-	this->AllocateBuffer();
-	this->Transforms->ResizeBuffer(NumMatrix);
+	this->Format = InFormat;
+	this->DestroyBuffer();
+	this->ExternalTransforms.Data = Data;
+	this->ExternalTransforms.Size = Size;
+}
 
-	if(bFillIdentity)
-	{
-		if (InHightPrecision)
-		{
-			FMatrix3x4 IdentityMatrix;
-			IdentityMatrix.SetMatrixTranspose(FMatrix::Identity);
+void FAllegroAnimationBuffer::ResizeBuffer(uint32 NumBone, uint32 NumBoneToKeep)
+{
+	check(Transforms && NumBoneToKeep <= NumBone);
+	this->Transforms->ResizeBuffer(NumBone * GetVectorsPerBone());
+	FillIdentity(NumBoneToKeep, NumBone - NumBoneToKeep);
+}
 
-			FMatrix3x4* Dst = (FMatrix3x4*)Transforms->GetDataPointer();
-			for (uint32 i = 0; i < NumMatrix; i++)
-				Dst[i] = IdentityMatrix;
-		}
-		else
-		{
-			FMatrix3x4Half IdentityMatrix;
-			IdentityMatrix.SetMatrixTranspose(FMatrix44f::Identity);
+void FAllegroAnimationBuffer::FillIdentity(uint32 BoneOffset, uint32 NumBone)
+{
+	FVector4f IdentityBone[3];
+	FMatrix3x4 IdentityMatrix;
+	IdentityMatrix.SetMatrixTranspose(FMatrix::Identity);
+	AllegroEncodeBone(Format, IdentityMatrix, IdentityBone);
 
-			FMatrix3x4Half* Dst = (FMatrix3x4Half*)Transforms->GetDataPointer();
-			for (uint32 i = 0; i < NumMatrix; i++)
-				Dst[i] = IdentityMatrix;
-		}
-	}
+	for (uint32 i = 0; i < NumBone; i++)
+		SetBones(BoneOffset + i, 1, IdentityBone);
 }
 
 void FAllegroAnimationBuffer::DestroyBuffer()
@@ -530,19 +548,39 @@ void FAllegroAnimationBuffer::DestroyBuffer()
 	}
 }
 
-
-
-
-FMatrix3x4Half* FAllegroAnimationBuffer::GetDataPointerLP() const
+void FAllegroAnimationBuffer::SetBones(uint32 BoneOffset, uint32 NumBone, const FVector4f* EncodedBones)
 {
-	check(!this->bHighPrecision);
-	return (FMatrix3x4Half*)this->Transforms->GetDataPointer();
+	const uint32 VectorOffset = BoneOffset * GetVectorsPerBone();
+	const uint32 NumVector = NumBone * GetVectorsPerBone();
+	check(Transforms && (VectorOffset + NumVector) <= Transforms->Num());
+
+	if (bHighPrecision)
+	{
+		FMemory::Memcpy(((FVector4f*)Transforms->GetDataPointer()) + VectorOffset, EncodedBones, NumVector * sizeof(FVector4f));
+	}
+	else
+	{
+		FFloat16Color* Dst = ((FFloat16Color*)Transforms->GetDataPointer()) + VectorOffset;
+		for (uint32 i = 0; i < NumVector; i++)
+			Dst[i] = FLinearColor(EncodedBones[i].X, EncodedBones[i].Y, EncodedBones[i].Z, EncodedBones[i].W);
+	}
 }
 
-FMatrix3x4* FAllegroAnimationBuffer::GetDataPointerHP() const
+void FAllegroAnimationBuffer::GetBone(uint32 BoneIndex, FVector4f* OutEncodedBone) const
 {
-	check(this->bHighPrecision);
-	return (FMatrix3x4*)this->Transforms->GetDataPointer();
+	const uint32 VectorOffset = BoneIndex * GetVectorsPerBone();
+	for (uint32 i = 0; i < GetVectorsPerBone(); i++)
+	{
+		if (bHighPrecision)
+		{
+			OutEncodedBone[i] = ((const FVector4f*)Transforms->GetDataPointer())[VectorOffset + i];
+		}
+		else
+		{
+			const FFloat16Color& Value = ((const FFloat16Color*)Transforms->GetDataPointer())[VectorOffset + i];
+			OutEncodedBone[i] = FVector4f(Value.R.GetFloat(), Value.G.GetFloat(), Value.B.GetFloat(), Value.A.GetFloat());
+		}
+	}
 }
 
 #if WITH_EDITOR
@@ -707,6 +745,29 @@ void FAllegroMeshDataEx::FLODData::Serialize(FArchive& Ar)
 	BoneData.Serialize(Ar);
 }
 
+void FAllegroAnimationBuffer::SetImpostorFrames(FRHICommandListBase& RHICmdList, const TArray<uint32>& Data)
+{
+	uint32 MinIndex = MAX_uint32, MaxIndex = 0;
+	for (int i = 0; i < Data.Num(); i += 2)
+	{
+		const uint32 Index = Data[i] - ImpostorFrameBase;
+		if (Index >= static_cast<uint32>(ImpostorFrames.Num()))
+			continue;
+
+		ImpostorFrames[Index] = Data[i + 1];
+		MinIndex = FMath::Min(MinIndex, Index);
+		MaxIndex = FMath::Max(MaxIndex, Index);
+	}
+
+	if (MinIndex > MaxIndex || !ImpostorFrameBuffer)
+		return;
+
+	const uint32 Count = MaxIndex - MinIndex + 1;
+	void* Dst = RHICmdList.LockBuffer(ImpostorFrameBuffer, MinIndex * sizeof(uint32), Count * sizeof(uint32), RLM_WriteOnly);
+	FMemory::Memcpy(Dst, ImpostorFrames.GetData() + MinIndex, Count * sizeof(uint32));
+	RHICmdList.UnlockBuffer(ImpostorFrameBuffer);
+}
+
 void FAllegroInstanceBuffer::LockBuffers()
 {
 	FRHICommandListBase& RHICmdList = FRHICommandListImmediate::Get();
@@ -716,6 +777,16 @@ void FAllegroInstanceBuffer::LockBuffers()
 	MappedBlendFrameIndices = (uint32*)RHICmdList.LockBuffer(BlendFrameIndexVB, 0, InstanceCount * sizeof(uint32), RLM_WriteOnly);
 }
 
+void FAllegroInstanceBuffer::LockBuffers(uint32 FirstInstance, uint32 NumInstance)
+{
+	FRHICommandListBase& RHICmdList = FRHICommandListImmediate::Get();
+	check(MappedTransforms == nullptr && MappedFrameIndices == nullptr);
+	check(FirstInstance + NumInstance <= InstanceCount);
+	MappedTransforms = (AllegroShaderMatrixT*)RHICmdList.LockBuffer(TransformVB, FirstInstance * sizeof(AllegroShaderMatrixT), NumInstance * sizeof(AllegroShaderMatrixT), RLM_WriteOnly);
+	MappedFrameIndices = (uint32*)RHICmdList.LockBuffer(FrameIndexVB, FirstInstance * sizeof(uint32), NumInstance * sizeof(uint32), RLM_WriteOnly);
+	MappedBlendFrameIndices = (uint32*)RHICmdList.LockBuffer(BlendFrameIndexVB, FirstInstance * sizeof(uint32), NumInstance * sizeof(uint32), RLM_WriteOnly);
+}
+
 void FAllegroInstanceBuffer::UnlockBuffers()
 {
 	check(IsLocked());
@@ -729,9 +800,10 @@ void FAllegroInstanceBuffer::UnlockBuffers()
 	MappedBlendFrameIndices = nullptr;
 }
 
-TSharedPtr<FAllegroInstanceBuffer> FAllegroInstanceBuffer::Create(uint32 InstanceCount)
+TSharedPtr<FAllegroInstanceBuffer> FAllegroInstanceBuffer::Create(uint32 InstanceCount, bool bPersistent, bool bScatterUpload)
 {
 	FRHICommandListImmediate& RHICmdList = FRHICommandListImmediate::Get();
+	const EBufferUsageFlags Usage = (bPersistent || bScatterUpload ? BUF_Static : BUF_Dynamic) | BUF_ShaderResource | (bScatterUpload ? BUF_UnorderedAccess : BUF_None);
 
 	FAllegroInstanceBufferPtr Resource = MakeShared<FAllegroInstanceBuffer>();
 	Resource->InstanceCount = InstanceCount;
@@ -739,25 +811,103 @@ TSharedPtr<FAllegroInstanceBuffer> FAllegroInstanceBuffer::Create(uint32 Instanc
 
 	{
 		FRHIResourceCreateInfo CreateInfo(TEXT("InstanceTransform"));
-		Resource->TransformVB = RHICmdList.CreateVertexBuffer(InstanceCount * sizeof(AllegroShaderMatrixT), (BUF_Dynamic | BUF_ShaderResource), CreateInfo);
+		Resource->TransformVB = RHICmdList.CreateVertexBuffer(InstanceCount * sizeof(AllegroShaderMatrixT), Usage, CreateInfo);
 		Resource->TransformSRV = RHICmdList.CreateShaderResourceView(Resource->TransformVB, sizeof(float[4]), PF_A32B32G32R32F);
 	}
 	{
 		FRHIResourceCreateInfo CreateInfo(TEXT("InstanceAnimationFrameIndex"));
-		Resource->FrameIndexVB = RHICmdList.CreateVertexBuffer(InstanceCount * sizeof(uint32), (BUF_Dynamic | BUF_ShaderResource), CreateInfo);
+		Resource->FrameIndexVB = RHICmdList.CreateVertexBuffer(InstanceCount * sizeof(uint32), Usage, CreateInfo);
 		Resource->FrameIndexSRV = RHICmdList.CreateShaderResourceView(Resource->FrameIndexVB, sizeof(uint32), PF_R32_UINT);
 	}
 
 	{
 		FRHIResourceCreateInfo CreateInfo(TEXT("InstanceBlendFrameIndex"));
-		Resource->BlendFrameIndexVB = RHICmdList.CreateVertexBuffer(InstanceCount * sizeof(uint32), (BUF_Dynamic | BUF_ShaderResource), CreateInfo);
+		Resource->BlendFrameIndexVB = RHICmdList.CreateVertexBuffer(InstanceCount * sizeof(uint32), Usage, CreateInfo);
 		Resource->BlendFrameIndexmSRV = RHICmdList.CreateShaderResourceView(Resource->BlendFrameIndexVB, sizeof(uint32), PF_R32_UINT);
 	}
 
+	if (bScatterUpload)
+	{
+		Resource->TransformUAV = RHICmdList.CreateUnorderedAccessView(Resource->TransformVB, PF_R32_UINT);
+		Resource->FrameIndexUAV = RHICmdList.CreateUnorderedAccessView(Resource->FrameIndexVB, PF_R32_UINT);
+		Resource->BlendFrameIndexUAV = RHICmdList.CreateUnorderedAccessView(Resource->BlendFrameIndexVB, PF_R32_UINT);
+	}
+
 	return Resource;
 }
 
 
+class FAllegroScatterCS : public FGlobalShader
+{
+	DECLARE_GLOBAL_SHADER(FAllegroScatterCS);
+	SHADER_USE_PARAMETER_STRUCT(FAllegroScatterCS, FGlobalShader);
+
+	static const uint32 GroupSize = 64;
+
+	BEGIN_SHADER_PARAMETER_STRUCT(FParameters, )
+		SHADER_PARAMETER(uint32, NumElements)
+		SHADER_PARAMETER(uint32, WordsPerElement)
+		SHADER_PARAMETER_SRV(Buffer<uint>, ElementIndices)
+		SHADER_PARAMETER_SRV(Buffer<uint>, SrcWords)
+		SHADER_PARAMETER_UAV(RWBuffer<uint>, RWDstWords)
+	END_SHADER_PARAMETER_STRUCT()
+
+	static bool ShouldCompilePermutation(const FGlobalShaderPermutationParameters& Parameters)
+	{
+		return RHISupportsComputeShaders(Parameters.Platform);
+	}
+	static void ModifyCompilationEnvironment(const FGlobalShaderPermutationParameters& Parameters, FShaderCompilerEnvironment& OutEnvironment)
+	{
+		FGlobalShader::ModifyCompilationEnvironment(Parameters, OutEnvironment);
+		OutEnvironment.SetDefine(TEXT("THREADGROUP_SIZE"), GroupSize);
+	}
+};
+
+IMPLEMENT_GLOBAL_SHADER(FAllegroScatterCS, "/Plugin/Allegro/Private/AllegroScatter.usf", "ScatterCS", SF_Compute);
+
+bool AllegroSupportsScatterUpload()
+{
+	return RHISupportsComputeShaders(GMaxRHIShaderPlatform);
+}
+
+void AllegroScatterUpload(FRHICommandListImmediate& RHICmdList, FRHIUnorderedAccessView* DstUAV, TConstArrayView<uint32> ElementIndices, const uint32* SrcWords, uint32 WordsPerElement)
+{
+	const uint32 NumElements = ElementIndices.Num();
+	if (NumElements == 0)
+		return;
+
+	//volatile upload buffers, they only live for this frame
+	FBufferRHIRef ElementIndexBuffer;
+	FBufferRHIRef SrcBuffer;
+	{
+		FRHIResourceCreateInfo CreateInfo(TEXT("AllegroScatterElementIndices"));
+		ElementIndexBuffer = RHICmdList.CreateVertexBuffer(NumElements * sizeof(uint32), (BUF_Volatile | BUF_ShaderResource), CreateInfo);
+		void* Mapped = RHICmdList.LockBuffer(ElementIndexBuffer, 0, NumElements * sizeof(uint32), RLM_WriteOnly);
+		FMemory::Memcpy(Mapped, ElementIndices.GetData(), NumElements * sizeof(uint32));
+		RHICmdList.UnlockBuffer(ElementIndexBuffer);
+	}
+	{
+		FRHIResourceCreateInfo CreateInfo(TEXT("AllegroScatterSrcWords"));
+		SrcBuffer = RHICmdList.CreateVertexBuffer(NumElements * WordsPerElement * sizeof(uint32), (BUF_Volatile | BUF_ShaderResource), CreateInfo);
+		void* Mapped = RHICmdList.LockBuffer(SrcBuffer, 0, NumElements * WordsPerElement * sizeof(uint32), RLM_WriteOnly);
+		FMemory::Memcpy(Mapped, SrcWords, NumElements * WordsPerElement * sizeof(uint32));
+		RHICmdList.UnlockBuffer(SrcBuffer);
+	}
+
+	FAllegroScatterCS::FParameters Params;
+	Params.NumElements = NumElements;
+	Params.WordsPerElement = WordsPerElement;
+	Params.ElementIndices = RHICmdList.CreateShaderResourceView(ElementIndexBuffer, sizeof(uint32), PF_R32_UINT);
+	Params.SrcWords = RHICmdList.CreateShaderResourceView(SrcBuffer, sizeof(uint32), PF_R32_UINT);
+	Params.RWDstWords = DstUAV;
+
+	RHICmdList.Transition(FRHITransitionInfo(DstUAV, ERHIAccess::Unknown, ERHIAccess::UAVCompute));
+	TShaderMapRef<FAllegroScatterCS> ScatterCS(GetGlobalShaderMap(GMaxRHIFeatureLevel));
+	FComputeShaderUtils::Dispatch(RHICmdList, ScatterCS, Params, FComputeShaderUtils::GetGroupCountWrapped(NumElements, FAllegroScatterCS::GroupSize));
+	RHICmdList.Transition(FRHITransitionInfo(DstUAV, ERHIAccess::UAVCompute, ERHIAccess::SRVMask));
+}
+
+
 
 
 void Allegro_PreRenderFrame(class FRDGBuilder&)
@@ -777,6 +927,10 @@ void Allegro_PostRenderFrame(class FRDGBuilder&)
 	GAllegroCIDBufferPool.EndOfFrame();
 	GAllegroElementIndexBufferPool.EndOfFrame();
 	GAllegroBlendFrameBufferPool.EndOfFrame();
+#if ALLEGRO_GPU_CULL
+	GAllegroGPUCullOutputPool.EndOfFrame();
+	AllegroPollGPUCullVerify();
+#endif
 }
 
 void FAllegroCIDBuffer::LockBuffers()
@@ -786,6 +940,14 @@ void FAllegroCIDBuffer::LockBuffers()
 	MappedData = (float*)RHICmdList.LockBuffer(CustomDataBuffer, 0, NumberOfFloat * sizeof(float), RLM_WriteOnly);
 }
 
+void FAllegroCIDBuffer::LockBuffers(uint32 FirstFloat, uint32 NumFloat)
+{
+	check(MappedData == nullptr);
+	check(FirstFloat + NumFloat <= NumberOfFloat);
+	FRHICommandListBase& RHICmdList = FRHICommandListImmediate::Get();
+	MappedData = (float*)RHICmdList.LockBuffer(CustomDataBuffer, FirstFloat * sizeof(float), NumFloat * sizeof(float), RLM_WriteOnly);
+}
+
 void FAllegroCIDBuffer::UnlockBuffers()
 {
 	check(IsLocked());
@@ -794,7 +956,7 @@ void FAllegroCIDBuffer::UnlockBuffers()
 	MappedData = nullptr;
 }
 
-TSharedPtr<FAllegroCIDBuffer> FAllegroCIDBuffer::Create(uint32 InNumberOfFloat)
+TSharedPtr<FAllegroCIDBuffer> FAllegroCIDBuffer::Create(uint32 InNumberOfFloat, bool bPersistent)
 {
 	FRHICommandListBase& RHICmdList = FRHICommandListImmediate::Get();
 
@@ -803,13 +965,13 @@ TSharedPtr<FAllegroCIDBuffer> FAllegroCIDBuffer::Create(uint32 InNumberOfFloat)
 	Resource->CreationFrameNumber = GFrameNumberRenderThread;
 
 	FRHIResourceCreateInfo CreateInfo(TEXT("CustomData"));
-	Resource->CustomDataBuffer = RHICmdList.CreateVertexBuffer(InNumberOfFloat * sizeof(float), (BUF_Dynamic | BUF_ShaderResource), CreateInfo);
+	Resource->CustomDataBuffer = RHICmdList.CreateVertexBuffer(InNumberOfFloat * sizeof(float), (bPersistent ? BUF_Static : BUF_Dynamic) | BUF_ShaderResource, CreateInfo);
 	Resource->CustomDataSRV = RHICmdList.CreateShaderResourceView(Resource->CustomDataBuffer, sizeof(float), PF_R32_FLOAT);
 
 	return Resource;
 }
 
-TSharedPtr<FAllegroBlendFrameBuffer> FAllegroBlendFrameBuffer::Create(uint32 NumOfFloat)
+TSharedPtr<FAllegroBlendFrameBuffer> FAllegroBlendFrameBuffer::Create(uint32 NumOfFloat, bool bPersistent)
 {
 	FRHICommandListBase& RHICmdList = FRHICommandListImmediate::Get();
 
@@ -817,7 +979,7 @@ TSharedPtr<FAllegroBlendFrameBuffer> FAllegroBlendFrameBuffer::Create(uint32 Num
 	FRHIResourceCreateInfo CreateInfo(TEXT("BlendFrameBuffer"));
 
 	Resource->NumberOfFloat = NumOfFloat;
-	Resource->BlendFrameDataBuffer = RHICmdList.CreateVertexBuffer(NumOfFloat * sizeof(float), (BUF_Dynamic | BUF_ShaderResource), CreateInfo);
+	Resource->BlendFrameDataBuffer = RHICmdList.CreateVertexBuffer(NumOfFloat * sizeof(float), (bPersistent ? BUF_Static : BUF_Dynamic) | BUF_ShaderResource, CreateInfo);
 	Resource->BlendFrameDataSRV = RHICmdList.CreateShaderResourceView(Resource->BlendFrameDataBuffer, sizeof(float), PF_R32_FLOAT);
 
 	return Resource;
@@ -13,6 +13,7 @@
 #include "Allegro.h"
 #include "AllegroResourcePool.h"
 #include "StaticMeshResources.h"
+#include "AllegroAnimCollection.h"
 
 
 class FAllegroSkinWeightVertexBuffer;
@@ -27,7 +28,15 @@ SHADER_PARAMETER(uint32, BoneCount)
 SHADER_PARAMETER(uint32, InstanceOffset)
 SHADER_PARAMETER(uint32, InstanceEndOffset)
 SHADER_PARAMETER(uint32, NumCustomDataFloats)
+SHADER_PARAMETER(uint32, AnimationBufferFormat)
+SHADER_PARAMETER(uint32, FrameRemapCount)
+SHADER_PARAMETER(uint32, FrameRemapShift)
+SHADER_PARAMETER(uint32, ImpostorFrameBase)
+SHADER_PARAMETER(uint32, ImpostorFrameCount)
+SHADER_PARAMETER(FVector3f, RenderOrigin)
 SHADER_PARAMETER_SRV(Buffer<float4>, AnimationBuffer)
+SHADER_PARAMETER_SRV(Buffer<uint>, FrameRemap)
+SHADER_PARAMETER_SRV(Buffer<uint>, ImpostorFrames)
 SHADER_PARAMETER_SRV(Buffer<float4>, Instance_Transforms)
 SHADER_PARAMETER_SRV(Buffer<uint>, Instance_AnimationFrameIndices)
 SHADER_PARAMETER_SRV(Buffer<float>, Instance_CustomData)
@@ -172,16 +181,52 @@ public:
 	
 };
 
+/*
+* resource array over memory we don't own (memory mapped cooked payload), lets RHI read it without copying into a TResourceArray
+*/
+class FAllegroExternalResourceArray : public FResourceArrayInterface
+{
+public:
+	const void* Data = nullptr;
+	uint32 Size = 0;
+
+	const void* GetResourceData() const override { return Data; }
+	uint32 GetResourceDataSize() const override { return Size; }
+	void Discard() override {} //owner keeps the memory alive, buffer can be recreated from it
+	bool IsStatic() const override { return true; }
+	bool GetAllowCPUAccess() const override { return false; }
+	void SetAllowCPUAccess(bool bInNeedsCPUAccess) override {}
+};
+
 //vertex buffer containing bone transforms of all baked animations
+//elements are float4 (or half4 if !bHighPrecision), AllegroAnimBufferVectorsPerBone(Format) elements per bone
 class FAllegroAnimationBuffer : public FRenderResource
 {
 public:
 	FStaticMeshVertexDataInterface* Transforms = nullptr;
+	//encoded buffer image used instead of Transforms, memory is owned by the anim collection
+	FAllegroExternalResourceArray ExternalTransforms;
 
 	FBufferRHIRef Buffer;
 	FShaderResourceViewRHIRef ShaderResourceViewRHI;
 	FUnorderedAccessViewRHIRef UAV;
 	bool bHighPrecision = false;
+	EAllegroAnimBufferFormat Format = EAllegroAnimBufferFormat::Matrix3x4;
+
+	//animation frame index -> frame index in the buffer, covers sequence frames only. empty if no frame got reduced
+	TArray<uint32> FrameRemap;
+	//number of reduced frames, frames after the sequences are shifted back by this
+	uint32 FrameRemapShift = 0;
+	//true if FrameRemap is a page table of streamed sequences and gets updated at runtime
+	bool bDynamicFrameRemap = false;
+	FBufferRHIRef FrameRemapBuffer;
+	FShaderResourceViewRHIRef FrameRemapSRV;
+
+	//(frame index - ImpostorFrameBase) -> sequence frame shown by impostors, covers transition frames. see AllegroFrameIndex.ush
+	TArray<uint32> ImpostorFrames;
+	uint32 ImpostorFrameBase = 0;
+	FBufferRHIRef ImpostorFrameBuffer;
+	FShaderResourceViewRHIRef ImpostorFrameSRV;
 	
 	~FAllegroAnimationBuffer();
 	void InitRHI(FRHICommandListBase& RHICmdList) override;
@@ -189,12 +234,23 @@ public:
 	void Serialize(FArchive& Ar);
 
 	void AllocateBuffer();
-	void InitBuffer(const TArrayView<FTransform> InTransforms, bool InHightPrecision);
-	void InitBuffer(uint32 NumMatrix, bool InHightPrecision, bool bFillIdentity);
+	void InitBuffer(uint32 NumBone, bool InHightPrecision, EAllegroAnimBufferFormat InFormat, bool bFillIdentity);
+	//use already encoded buffer image of @Size bytes, @Data must stay valid as long as the resource
+	void InitExternal(const void* Data, uint32 Size, bool InHightPrecision, EAllegroAnimBufferFormat InFormat);
 	void DestroyBuffer();
-
-	FMatrix3x4* GetDataPointerHP() const;
-	FMatrix3x4Half* GetDataPointerLP() const;
+	//shrink or grow to @NumBone, bones from @NumBoneToKeep on are set to identity
+	void ResizeBuffer(uint32 NumBone, uint32 NumBoneToKeep);
+	void FillIdentity(uint32 BoneOffset, uint32 NumBone);
+
+	uint32 GetVectorsPerBone() const { return AllegroAnimBufferVectorsPerBone(Format); }
+	//animation frame index (as stored in instances) to frame index in the buffer. must match AllegroBufferFrameIndex in AllegroVertexFactory.ush
+	uint32 GetBufferFrameIndex(uint32 FrameIndex) const { return FrameIndex < static_cast<uint32>(FrameRemap.Num()) ? FrameRemap[FrameIndex] : FrameIndex - FrameRemapShift; }
+	//@Data is pairs of transition frame index and impostor frame, only the covered range is locked
+	void SetImpostorFrames(FRHICommandListBase& RHICmdList, const TArray<uint32>& Data);
+	//write already encoded bones, converted to half if !bHighPrecision
+	void SetBones(uint32 BoneOffset, uint32 NumBone, const FVector4f* EncodedBones);
+	//read back a bone as the GPU sees it
+	void GetBone(uint32 BoneIndex, FVector4f* OutEncodedBone) const;
 
 	//void SetPoseTransform(uint32 PoseIndex, uint32 BoneCount, const FTransform* BoneTransforms);
 	//void SetPoseTransform(uint32 PoseIndex, uint32 BoneCount, const FMatrix3x4* BoneTransforms);
@@ -255,6 +311,11 @@ struct FAllegroInstanceBuffer : TSharedFromThis<FAllegroInstanceBuffer>
 	FBufferRHIRef BlendFrameIndexVB;
 	FShaderResourceViewRHIRef BlendFrameIndexmSRV;
 
+	//R32_UINT views for AllegroScatterUpload, only created for @bScatterUpload buffers
+	FUnorderedAccessViewRHIRef TransformUAV;
+	FUnorderedAccessViewRHIRef FrameIndexUAV;
+	FUnorderedAccessViewRHIRef BlendFrameIndexUAV;
+
 	uint32 CreationFrameNumber = 0;
 	uint32 InstanceCount = 0;
 
@@ -263,14 +324,22 @@ struct FAllegroInstanceBuffer : TSharedFromThis<FAllegroInstanceBuffer>
 	uint32* MappedBlendFrameIndices = nullptr;
 
 	void LockBuffers();
+	void LockBuffers(uint32 FirstInstance, uint32 NumInstance);	//maps only the given range, Mapped* point to @FirstInstance
 	void UnlockBuffers();
 	bool IsLocked() const { return MappedTransforms != nullptr; }
 	uint32 GetSize() const { return InstanceCount; }
 
-	static TSharedPtr<FAllegroInstanceBuffer> Create(uint32 InstanceCount);
+	//@bPersistent buffers are updated by sub range locks, they can't be BUF_Dynamic because locking would discard the rest of the content
+	//@bScatterUpload buffers are updated in place by AllegroScatterUpload and never locked
+	static TSharedPtr<FAllegroInstanceBuffer> Create(uint32 InstanceCount, bool bPersistent = false, bool bScatterUpload = false);
 };
 typedef TSharedPtr<FAllegroInstanceBuffer> FAllegroInstanceBufferPtr;
 
+//true if the scatter compute shader is available, persistent instance buffers depend on it
+bool AllegroSupportsScatterUpload();
+//copies elements of @WordsPerElement uint32 from @SrcWords to their index in @ElementIndices of the buffer behind @DstUAV (R32_UINT view)
+void AllegroScatterUpload(FRHICommandListImmediate& RHICmdList, FRHIUnorderedAccessView* DstUAV, TConstArrayView<uint32> ElementIndices, const uint32* SrcWords, uint32 WordsPerElement);
+
 
 
 
@@ -292,11 +361,12 @@ struct FAllegroCIDBuffer : TSharedFromThis<FAllegroCIDBuffer>
 	float* MappedData = nullptr;
 
 	void LockBuffers();
+	void LockBuffers(uint32 FirstFloat, uint32 NumFloat);	//maps only the given range, MappedData points to @FirstFloat
 	void UnlockBuffers();
 	bool IsLocked() const { return MappedData != nullptr; }
 	uint32 GetSize() const { return NumberOfFloat; }
 
-	static TSharedPtr<FAllegroCIDBuffer> Create(uint32 InNumberOfFloat);
+	static TSharedPtr<FAllegroCIDBuffer> Create(uint32 InNumberOfFloat, bool bPersistent = false);
 };
 typedef TSharedPtr<FAllegroCIDBuffer> FAllegroCIDBufferPtr;
 
@@ -321,7 +391,7 @@ struct FAllegroBlendFrameBuffer : TSharedFromThis<FAllegroBlendFrameBuffer>
 	bool IsLocked() const { return MappedData != nullptr; }
 	uint32 GetSize() const { return NumberOfFloat; }
 
-	static TSharedPtr<FAllegroBlendFrameBuffer> Create(uint32 NumOfFloat);
+	static TSharedPtr<FAllegroBlendFrameBuffer> Create(uint32 NumOfFloat, bool bPersistent = false);
 };
 typedef TSharedPtr<FAllegroBlendFrameBuffer> FAllegroBlendFrameBufferPtr;
 
@@ -0,0 +1,195 @@
+// Copyright 2024 Lazy Marmot Games. All Rights Reserved.
+
+#include "AllegroSpatialIndex.h"
+
+
+void FAllegroSpatialIndex::Reset(float InCellSize, int32 NumInstance)
+{
+	check(InCellSize > 0);
+	CellSize = InCellSize;
+	InvCellSize = 1.0f / InCellSize;
+	CellMap.Reset();
+	Cells.Reset();
+	InstanceCell.Init(INVALID_CELL, NumInstance);
+	InstanceSlot.SetNumUninitialized(NumInstance);
+	OccupiedMin = FIntPoint(MAX_int32, MAX_int32);
+	OccupiedMax = FIntPoint(MIN_int32, MIN_int32);
+	NumIndexed = 0;
+	bValid = true;
+}
+
+void FAllegroSpatialIndex::Invalidate()
+{
+	bValid = false;
+}
+
+void FAllegroSpatialIndex::Insert(int32 InstanceIndex, const FIntPoint& Coord)
+{
+	int32& CellIndex = CellMap.FindOrAdd(Coord, INVALID_CELL);
+	if (CellIndex == INVALID_CELL)
+	{
+		CellIndex = Cells.AddDefaulted();
+		Cells[CellIndex].Coord = Coord;
+		OccupiedMin = OccupiedMin.ComponentMin(Coord);
+		OccupiedMax = OccupiedMax.ComponentMax(Coord);
+	}
+
+	InstanceCell[InstanceIndex] = CellIndex;
+	InstanceSlot[InstanceIndex] = Cells[CellIndex].Instances.Add(InstanceIndex);
+	NumIndexed++;
+}
+
+void FAllegroSpatialIndex::Update(int32 InstanceIndex, const FVector3f& Location)
+{
+	if (!bValid)
+		return;
+
+	if (InstanceIndex >= InstanceCell.Num())
+	{
+		const int32 NewNum = Align(InstanceIndex + 1, 64);
+		InstanceSlot.SetNumUninitialized(NewNum);
+		const int32 OldNum = InstanceCell.Num();
+		InstanceCell.SetNumUninitialized(NewNum);
+		for (int32 i = OldNum; i < NewNum; i++)
+			InstanceCell[i] = INVALID_CELL;
+	}
+
+	const FIntPoint Coord = ToCellCoord(Location.X, Location.Y);
+	const int32 CurCell = InstanceCell[InstanceIndex];
+	if (CurCell != INVALID_CELL)
+	{
+		if (Cells[CurCell].Coord == Coord) //most common case, still in the same cell
+			return;
+
+		Remove(InstanceIndex);
+	}
+
+	Insert(InstanceIndex, Coord);
+}
+
+void FAllegroSpatialIndex::Remove(int32 InstanceIndex)
+{
+	if (!bValid || !InstanceCell.IsValidIndex(InstanceIndex) || InstanceCell[InstanceIndex] == INVALID_CELL)
+		return;
+
+	TArray<int32>& CellInstances = Cells[InstanceCell[InstanceIndex]].Instances;
+	const int32 Slot = InstanceSlot[InstanceIndex];
+	check(CellInstances[Slot] == InstanceIndex);
+	CellInstances.RemoveAtSwap(Slot, 1, false);
+	if (Slot < CellInstances.Num())
+		InstanceSlot[CellInstances[Slot]] = Slot;
+
+	InstanceCell[InstanceIndex] = INVALID_CELL;
+	NumIndexed--;
+}
+
+void FAllegroSpatialIndex::FindNearest(const FVector3f& Center, int32 K, float MaxDistance, const FVector3f* Locations, TFunctionRef<bool(int32)> Filter, TArray<int>& OutIndices) const
+{
+	check(bValid);
+	if (K <= 0 || NumIndexed == 0)
+		return;
+
+	struct FCandidate
+	{
+		float DistSq;
+		int32 InstanceIndex;
+	};
+	//max heap, top is the farthest candidate
+	auto HeapPred = [](const FCandidate& A, const FCandidate& B) { return A.DistSq > B.DistSq; };
+	TArray<FCandidate, TInlineAllocator<32>> Heap;
+
+	const float MaxDistSq = MaxDistance > 0 ? FMath::Square(MaxDistance) : MAX_flt;
+
+	auto VisitCell = [&](int32 CellIndex)
+	{
+		for (int32 InstanceIndex : Cells[CellIndex].Instances)
+		{
+			const float DistSq = FVector3f::DistSquared(Locations[InstanceIndex], Center);
+			if (DistSq > MaxDistSq || !Filter(InstanceIndex))
+				continue;
+
+			if (Heap.Num() < K)
+			{
+				Heap.HeapPush(FCandidate{ DistSq, InstanceIndex }, HeapPred);
+			}
+			else if (DistSq < Heap.HeapTop().DistSq)
+			{
+				Heap.HeapPopDiscard(HeapPred, false);
+				Heap.HeapPush(FCandidate{ DistSq, InstanceIndex }, HeapPred);
+			}
+		}
+	};
+
+	const FIntPoint C = ToCellCoord(Center.X, Center.Y);
+	//farthest ring that can contain any cell
+	int64 MaxRing = FMath::Max(FMath::Max(int64(C.X) - OccupiedMin.X, int64(OccupiedMax.X) - C.X), FMath::Max(int64(C.Y) - OccupiedMin.Y, int64(OccupiedMax.Y) - C.Y));
+	if (MaxDistance > 0)
+		MaxRing = FMath::Min(MaxRing, int64(FMath::CeilToInt(MaxDistance * InvCellSize)) + 1);
+
+	auto IsOccupiedCoord = [&](int64 X, int64 Y)
+	{
+		return X >= OccupiedMin.X && X <= OccupiedMax.X && Y >= OccupiedMin.Y && Y <= OccupiedMax.Y;
+	};
+	auto VisitCoord = [&](int64 X, int64 Y)
+	{
+		if (IsOccupiedCoord(X, Y))
+			if (const int32* CellIndex = CellMap.Find(FIntPoint(int32(X), int32(Y))))
+				VisitCell(*CellIndex);
+	};
+
+	int64 NumVisitedCoord = 0;
+	for (int64 Ring = 0; Ring <= MaxRing; Ring++)
+	{
+		//any cell in this ring is at least (Ring - 1) cells away from the center
+		const float RingMinDist = FMath::Max<int64>(Ring - 1, 0) * CellSize;
+		if (RingMinDist > MaxDistance && MaxDistance > 0)
+			break;
+		if (Heap.Num() == K && FMath::Square(RingMinDist) >= Heap.HeapTop().DistSq)
+			break;
+
+		//rings grew bigger than the map itself, walk the remaining cells directly
+		if (NumVisitedCoord > CellMap.Num())
+		{
+			for (const TPair<FIntPoint, int32>& Pair : CellMap)
+			{
+				const int64 CellRing = FMath::Max(FMath::Abs(int64(Pair.Key.X) - C.X), FMath::Abs(int64(Pair.Key.Y) - C.Y));
+				if (CellRing >= Ring && CellRing <= MaxRing)
+					VisitCell(Pair.Value);
+			}
+			break;
+		}
+
+		if (Ring == 0)
+		{
+			VisitCoord(C.X, C.Y);
+			NumVisitedCoord++;
+			continue;
+		}
+
+		for (int64 X = C.X - Ring; X <= C.X + Ring; X++)
+		{
+			VisitCoord(X, C.Y - Ring);
+			VisitCoord(X, C.Y + Ring);
+		}
+		for (int64 Y = C.Y - Ring + 1; Y <= C.Y + Ring - 1; Y++)
+		{
+			VisitCoord(C.X - Ring, Y);
+			VisitCoord(C.X + Ring, Y);
+		}
+		NumVisitedCoord += Ring * 8;
+	}
+
+	Heap.Sort([](const FCandidate& A, const FCandidate& B) { return A.DistSq < B.DistSq; });
+	OutIndices.Reserve(OutIndices.Num() + Heap.Num());
+	for (const FCandidate& Candidate : Heap)
+		OutIndices.Add(Candidate.InstanceIndex);
+}
+
+SIZE_T FAllegroSpatialIndex::GetAllocatedSize() const
+{
+	SIZE_T Size = CellMap.GetAllocatedSize() + Cells.GetAllocatedSize() + InstanceCell.GetAllocatedSize() + InstanceSlot.GetAllocatedSize();
+	for (const FCell& Cell : Cells)
+		Size += Cell.Instances.GetAllocatedSize();
+
+	return Size;
+}
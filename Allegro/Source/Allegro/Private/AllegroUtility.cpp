@@ -130,28 +130,36 @@ USkeletalMeshComponent* UAllegroBPUtility::ConstructSkeletalMeshComponentsFromIn
 	return RootComp;
 }
 
+static bool InstancePassFlags(const UAllegroComponent* Component, int InstanceIndex, EAllegroInstanceFlags RightOp, bool bAllFlags, bool bInvert)
+{
+	if (bAllFlags)
+		return EnumHasAllFlags(Component->InstancesData.Flags[InstanceIndex], RightOp) != bInvert;
+	else
+		return EnumHasAnyFlags(Component->InstancesData.Flags[InstanceIndex], RightOp) != bInvert;
+}
+
 template<typename TLambda> void ForEachInstanceConditional(UAllegroComponent* Component, int32 FlagsToTest, bool bAllFlags, bool bInvert, TLambda Proc)
 {
 	EAllegroInstanceFlags RightOp = static_cast<EAllegroInstanceFlags>(FlagsToTest << InstaceUserFlagStart);
 
 	for (int i = 0; i < Component->GetInstanceCount(); i++)
 	{
-		if (Component->IsInstanceAlive(i))
-		{
-			if (bAllFlags)
-			{
-				if (EnumHasAllFlags(Component->InstancesData.Flags[i], RightOp) != bInvert)
-					Proc(i);
-			}
-			else
-			{
-				if (EnumHasAnyFlags(Component->InstancesData.Flags[i], RightOp) != bInvert)
-					Proc(i);
-			}
-		}
+		if (Component->IsInstanceAlive(i) && InstancePassFlags(Component, i, RightOp, bAllFlags, bInvert))
+			Proc(i);
 	}
 }
 
+//same as ForEachInstanceConditional but only for instances that may be inside the box, using the component's spatial index
+template<typename TLambda> void ForEachInstanceNearBoxConditional(UAllegroComponent* Component, const FBox3f& Box, int32 FlagsToTest, bool bAllFlags, bool bInvert, TLambda Proc)
+{
+	EAllegroInstanceFlags RightOp = static_cast<EAllegroInstanceFlags>(FlagsToTest << InstaceUserFlagStart);
+
+	Component->ForEachInstanceNearBox(Box, [&](int InstanceIndex) {
+		if (InstancePassFlags(Component, InstanceIndex, RightOp, bAllFlags, bInvert))
+			Proc(InstanceIndex);
+	});
+}
+
 void UAllegroBPUtility::MoveAllInstancesConditional( UAllegroComponent* Component, FVector Offset, int32 FlagsToTest, bool bAllFlags, bool bInvert)
 {
 	if(IsValid(Component))
@@ -167,7 +175,7 @@ void UAllegroBPUtility::QueryLocationOverlappingBoxAdvanced(UAllegroComponent* C
 	if (IsValid(Component))
 	{
 		FBox3f BoxFloat(Box);
-		ForEachInstanceConditional(Component, FlagsToTest, bAllFlags, bInvert, [&](int InstanceIndex) {
+		ForEachInstanceNearBoxConditional(Component, BoxFloat, FlagsToTest, bAllFlags, bInvert, [&](int InstanceIndex) {
 			if (BoxFloat.IsInside(Component->GetInstanceLocation(InstanceIndex)))
 				InstanceIndices.Add(InstanceIndex);
 		});
@@ -179,7 +187,8 @@ void UAllegroBPUtility::QueryLocationOverlappingSphereAdvanced(UAllegroComponent
 {
 	if (IsValid(Component))
 	{
-		ForEachInstanceConditional(Component, FlagsToTest, bAllFlags, bInvert, [&](int InstanceIndex) {
+		const FBox3f Bound(FVector3f(Center) - Radius, FVector3f(Center) + Radius);
+		ForEachInstanceNearBoxConditional(Component, Bound, FlagsToTest, bAllFlags, bInvert, [&](int InstanceIndex) {
 			if(FVector3f::DistSquared(FVector3f(Center), Component->GetInstanceLocation(InstanceIndex)) <= FMath::Square(Radius))
 				InstanceIndices.Add(InstanceIndex);
 		});
@@ -188,9 +197,10 @@ void UAllegroBPUtility::QueryLocationOverlappingSphereAdvanced(UAllegroComponent
 
 void UAllegroBPUtility::QueryLocationOverlappingComponentAdvanced(UAllegroComponent* Component, UPrimitiveComponent* ComponentToTest, int32 FlagsToTest, bool bAllFlags, bool bInvert, TArray<int>& InstanceIndices)
 {
-	if (IsValid(Component) && IsValid(Component))
+	if (IsValid(Component) && IsValid(ComponentToTest))
 	{
-		ForEachInstanceConditional(Component, FlagsToTest, bAllFlags, bInvert, [&](int InstanceIndex) {
+		const FBox3f Bound(ComponentToTest->Bounds.GetBox());
+		ForEachInstanceNearBoxConditional(Component, Bound, FlagsToTest, bAllFlags, bInvert, [&](int InstanceIndex) {
 			float Dist;
 			FVector ClosestPoint;
 			if (ComponentToTest->GetSquaredDistanceToCollision(FVector(Component->GetInstanceLocation(InstanceIndex)), Dist, ClosestPoint))
@@ -204,4 +214,15 @@ void UAllegroBPUtility::QueryLocationOverlappingComponentAdvanced(UAllegroCompon
 	}
 }
 
+void UAllegroBPUtility::QueryNearestInstancesAdvanced(UAllegroComponent* Component, int32 FlagsToTest, bool bAllFlags, bool bInvert, const FVector& Center, int Count, float MaxDistance, TArray<int>& InstanceIndices)
+{
+	if (IsValid(Component))
+	{
+		EAllegroInstanceFlags RightOp = static_cast<EAllegroInstanceFlags>(FlagsToTest << InstaceUserFlagStart);
+		Component->QueryNearestInstances(FVector3f(Center), Count, MaxDistance, InstanceIndices, [&](int InstanceIndex) {
+			return InstancePassFlags(Component, InstanceIndex, RightOp, bAllFlags, bInvert);
+		});
+	}
+}
+
 #undef LOCTEXT_NAMESPACE
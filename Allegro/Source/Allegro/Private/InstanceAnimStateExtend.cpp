@@ -1,295 +1,486 @@
+
 #include "InstanceAnimStateExtend.h"
-#include "BlendSpaceInstance.h"
-#include "AnimMontageInstance.h"
 #include "Animation/AnimSequence.h"
 #include "Animation/BlendSpace.h"
 #include "Animation/AnimMontage.h"
+#include "Animation/AnimNotifyQueue.h"
 #include "AllegroAnimCollection.h"
 #include "Allegro.h"
+#include "Async/ParallelFor.h"
 
 static const FName DefaultSlotName = "DefaultSlot";
 
-FInstanceAnimStateExtend::FInstanceAnimStateExtend()
+namespace
 {
+	struct FSequenceWeight
+	{
+		int32 SequenceIndex;
+		float Weight;
+	};
+
+	using FSequenceWeightArray = TArray<FSequenceWeight, TInlineAllocator<ALLEGRO_BLEND_FRAME_NUM_MAX * 2>>;
+
+	//map blend samples to collection sequences, heaviest first
+	void GatherSequenceWeights(const UAllegroAnimCollection* AnimCollection, const TArray<FBlendSampleData>& SampleDatas, FSequenceWeightArray& Out)
+	{
+		for (int i = 0; i < SampleDatas.Num() && Out.Num() < ALLEGRO_BLEND_FRAME_NUM_MAX * 2; ++i)
+		{
+			const int32* Idx = AnimCollection->SequenceIndexMap.Find(SampleDatas[i].Animation.Get());
+			if (Idx && *Idx >= 0)
+				Out.Add(FSequenceWeight{ *Idx, SampleDatas[i].GetClampedWeight() });
+		}
+
+		Out.Sort([](const FSequenceWeight& LHS, const FSequenceWeight& RHS) { return LHS.Weight > RHS.Weight; });
+	}
+}
 
+int32 FAllegroAnimExtendPool::FCommonTable::AddSlot()
+{
+	InstanceIndex.Add(INDEX_NONE);
+	CurrentSequence.Add(INDEX_NONE);
+	Time.Add(0);
+	PendingDelta.Add(0);
+	bPending.Add(0);
+	return InstanceIndex.Num() - 1;
 }
 
-FInstanceAnimStateExtend::~FInstanceAnimStateExtend()
+void FAllegroAnimExtendPool::FCommonTable::InitSlot(int32 Slot, int32 InInstanceIndex)
 {
-	Reset();
+	InstanceIndex[Slot] = InInstanceIndex;
+	CurrentSequence[Slot] = INDEX_NONE;
+	Time[Slot] = 0;
+	PendingDelta[Slot] = 0;
+	bPending[Slot] = 0;
 }
 
-void FInstanceAnimStateExtend::Reset()
+void FAllegroAnimExtendPool::FCommonTable::FreeSlot(int32 Slot)
 {
-	if (MontageInstanceProxy)
-	{
-		delete MontageInstanceProxy;
-		MontageInstanceProxy = nullptr;
-	}
+	check(InstanceIndex[Slot] != INDEX_NONE);
+	InstanceIndex[Slot] = INDEX_NONE;
+	bPending[Slot] = 0;
+	FreeSlots.Add(Slot);
+}
 
-	if (BlendSpaceInstance)
-	{
-		delete BlendSpaceInstance;
-		BlendSpaceInstance = nullptr;
-	}
+void FAllegroAnimExtendPool::FCommonTable::Reset()
+{
+	InstanceIndex.Reset();
+	CurrentSequence.Reset();
+	Time.Reset();
+	PendingDelta.Reset();
+	bPending.Reset();
+	FreeSlots.Reset();
+}
+
+int32 FAllegroAnimExtendPool::FMontageTable::AddSlot()
+{
+	Montage.Add(nullptr);
+	Track.Add(nullptr);
+	Position.Add(0);
+	Section.Add(INDEX_NONE);
+	LoopSection.Add(INDEX_NONE);
+	Segment.Add(INDEX_NONE);
+	SegmentSequence.Add(INDEX_NONE);
+	bPlaying.Add(0);
+	return FCommonTable::AddSlot();
+}
+
+void FAllegroAnimExtendPool::FMontageTable::Reset()
+{
+	FCommonTable::Reset();
+	Montage.Reset();
+	Track.Reset();
+	Position.Reset();
+	Section.Reset();
+	LoopSection.Reset();
+	Segment.Reset();
+	SegmentSequence.Reset();
+	bPlaying.Reset();
+}
+
+int32 FAllegroAnimExtendPool::FBlendSpaceTable::AddSlot()
+{
+	BlendSpace.Add(nullptr);
+	BlendPosition.Add(FVector2f::ZeroVector);
+	NormalizedTime.Add(0);
+	Filter.AddDefaulted();
+	SampleDataCache.AddDefaulted();
+	DeltaTimeRecord.AddDefaulted();
+	return FCommonTable::AddSlot();
+}
+
+void FAllegroAnimExtendPool::FBlendSpaceTable::Reset()
+{
+	FCommonTable::Reset();
+	BlendSpace.Reset();
+	BlendPosition.Reset();
+	NormalizedTime.Reset();
+	Filter.Reset();
+	SampleDataCache.Reset();
+	DeltaTimeRecord.Reset();
+}
+
+template<typename TTable> int32 FAllegroAnimExtendPool::AllocSlot(TTable& Table, int32 InstanceIndex)
+{
+	const int32 Slot = Table.FreeSlots.Num() ? Table.FreeSlots.Pop(false) : Table.AddSlot();
+	Table.InitSlot(Slot, InstanceIndex);
+	return Slot;
 }
 
-bool FInstanceAnimStateExtend::IsPlaying()
+int32 FAllegroAnimExtendPool::AllocMontage(int32 InstanceIndex, UAnimMontage* Asset, const FAllegroAnimPlayParams& Params, UAllegroComponent* Owner, float& OutLength)
 {
-	if (MontageInstanceProxy)
+	check(Asset);
+	const int32 Slot = AllocSlot(Montages, InstanceIndex);
+
+	const float MontageLength = Asset->GetPlayLength();
+	Montages.Montage[Slot] = Asset;
+	Montages.Track[Slot] = Asset->GetAnimationData(DefaultSlotName);
+	Montages.Position[Slot] = FMath::Clamp(Params.StartAt, 0.0f, MontageLength);
+	Montages.Section[Slot] = Asset->GetSectionIndexFromPosition(Montages.Position[Slot]);
+	//looping repeats the starting section, same as setting its next section to itself
+	Montages.LoopSection[Slot] = Params.bLoop ? Montages.Section[Slot] : INDEX_NONE;
+	Montages.Segment[Slot] = INDEX_NONE;
+	Montages.SegmentSequence[Slot] = INDEX_NONE;
+	Montages.bPlaying[Slot] = MontageLength > 0.0f;
+
+	ResolveMontageSequence(Owner, Slot);
+
+	OutLength = MontageLength > 0.0f ? MontageLength : 0.0f;
+	return Slot;
+}
+
+int32 FAllegroAnimExtendPool::AllocBlendSpace(int32 InstanceIndex, UBlendSpace* Asset, UAllegroComponent* Owner, float& OutLength)
+{
+	check(Asset);
+	const int32 Slot = AllocSlot(BlendSpaces, InstanceIndex);
+
+	BlendSpaces.BlendSpace[Slot] = Asset;
+	BlendSpaces.BlendPosition[Slot] = FVector2f::ZeroVector;
+	BlendSpaces.NormalizedTime[Slot] = 0.0f;
+	BlendSpaces.SampleDataCache[Slot].Reset();
+	BlendSpaces.DeltaTimeRecord[Slot] = FDeltaTimeRecord();
+	Asset->InitializeFilter(&BlendSpaces.Filter[Slot]);
+
+	AdvanceBlendSpace(Slot, 0.0f);
+
+	OutLength = 1.0f;
+	FSequenceWeightArray Weights;
+	GatherSequenceWeights(Owner->AnimCollection, BlendSpaces.SampleDataCache[Slot], Weights);
+	if (Weights.Num() > 0)
 	{
-		return MontageInstanceProxy->IsPlaying();
+		BlendSpaces.CurrentSequence[Slot] = Weights[0].SequenceIndex;
+		OutLength = Owner->AnimCollection->Sequences[Weights[0].SequenceIndex].GetSequenceLength();
 	}
-	return true;
+
+	return Slot;
 }
 
-void FInstanceAnimStateExtend::Update(float Delta)
+void FAllegroAnimExtendPool::Free(EAnimAssetType AssetType, int32 Slot)
 {
-	if (MontageInstanceProxy)
+	if (AssetType == EAnimAssetType::AnimMontage)
 	{
-		MontageInstanceProxy->UpdateMontage(Delta);
+		Montages.FreeSlot(Slot);
+		Montages.Montage[Slot] = nullptr;
+		Montages.Track[Slot] = nullptr;
 	}
-	else if (BlendSpaceInstance)
+	else
 	{
-		BlendSpaceInstance->Update(Delta);
+		check(AssetType == EAnimAssetType::AnimBlendSpace);
+		BlendSpaces.FreeSlot(Slot);
+		BlendSpaces.BlendSpace[Slot] = nullptr;
+		BlendSpaces.SampleDataCache[Slot].Reset();
 	}
 }
 
-float FInstanceAnimStateExtend::SetMontage(UAnimMontage* Asset, FAllegroAnimPlayParams& Params, UAllegroComponent* Owner)
+void FAllegroAnimExtendPool::Reset()
 {
-	Reset();
+	Montages.Reset();
+	BlendSpaces.Reset();
+}
 
-	if (MontageInstanceProxy != nullptr)
-	{
-		delete MontageInstanceProxy;
-		MontageInstanceProxy = nullptr;
-	}
+int32 FAllegroAnimExtendPool::GetCurrentSequence(EAnimAssetType AssetType, int32 Slot) const
+{
+	return AssetType == EAnimAssetType::AnimMontage ? Montages.CurrentSequence[Slot] : BlendSpaces.CurrentSequence[Slot];
+}
+
+float FAllegroAnimExtendPool::GetTime(EAnimAssetType AssetType, int32 Slot) const
+{
+	return AssetType == EAnimAssetType::AnimMontage ? Montages.Time[Slot] : BlendSpaces.Time[Slot];
+}
+
+void FAllegroAnimExtendPool::QueueTick(EAnimAssetType AssetType, int32 Slot, float Delta)
+{
+	FCommonTable& Table = AssetType == EAnimAssetType::AnimMontage ? static_cast<FCommonTable&>(Montages) : static_cast<FCommonTable&>(BlendSpaces);
+	Table.PendingDelta[Slot] += Delta;
+	Table.bPending[Slot] = 1;
+}
 
-	MontageInstanceProxy = new FAllegroAnimMontageInstanceProxy();
-	float Length = MontageInstanceProxy->MontagePlay(Asset, 1.0f, EMontagePlayReturnType::MontageLength, Params.StartAt);
+void FAllegroAnimExtendPool::Tick(UAllegroComponent* Owner, TArray<FAllegroAnimTickEvents>& EventBuffers, bool bParallel, int32 BatchSize)
+{
+	const int32 NumMontage = Montages.Num();
+	const int32 NumSlot = NumMontage + BlendSpaces.Num();
+	if (NumSlot == 0)
+		return;
 
-	this->CurrentSequence = -1;
-	this->Time = 0;
+	BatchSize = FMath::Max(1, BatchSize);
+	const int32 NumBatch = FMath::DivideAndRoundUp(NumSlot, BatchSize);
+	EventBuffers.SetNum(FMath::Max(EventBuffers.Num(), NumBatch), false);
 
-	FAnimTrack const* const AnimTrack = Asset->GetAnimationData(DefaultSlotName);
-	const float ClampedTime = FMath::Clamp(Params.StartAt, 0.0f, AnimTrack->GetLength());
-	if (const FAnimSegment* const AnimSegment = AnimTrack->GetSegmentAtTime(ClampedTime))
+	//slots are owned by a single instance, so they can be ticked in any order
+	ParallelFor(TEXT("ParallelForAnimExtend"), NumBatch, 1, [this, Owner, &EventBuffers, NumMontage, NumSlot, BatchSize](int32 BatchIndex)
 	{
-		if (AnimSegment->IsValid())
+		FAllegroAnimTickEvents& Events = EventBuffers[BatchIndex];
+		const int32 End = FMath::Min(NumSlot, (BatchIndex + 1) * BatchSize);
+		for (int32 Index = BatchIndex * BatchSize; Index < End; Index++)
 		{
-			float PositionInAnim = 0.0f;
-			if (UAnimSequenceBase* AnimRef = AnimSegment->GetAnimationData(ClampedTime, PositionInAnim))
+			if (Index < NumMontage)
+			{
+				if (Montages.bPending[Index])
+					TickMontage(Owner, Index, Events);
+			}
+			else if (BlendSpaces.bPending[Index - NumMontage])
 			{
-				int32* idx = Owner->AnimCollection->SequenceIndexMap.Find(AnimRef); 
-				if (idx && *idx >= 0)
-				{
-					this->CurrentSequence = *idx;
-					this->Time = PositionInAnim;
-				}
+				TickBlendSpace(Owner, Index - NumMontage, Events);
 			}
 		}
-	}
-
-	if (Params.bLoop)
-	{
-		MontageInstanceProxy->SetLoop();
-	}
-
-	return Length;
+	}, bParallel ? EParallelForFlags::None : EParallelForFlags::ForceSingleThread);
 }
 
-float FInstanceAnimStateExtend::SetBlendSpace(UBlendSpace* Asset, FAllegroAnimPlayParams& Params, UAllegroComponent* Owner)
+void FAllegroAnimExtendPool::TickMontage(UAllegroComponent* Owner, int32 Slot, FAllegroAnimTickEvents& Events)
 {
-	Reset();
-
-	if (!BlendSpaceInstance)
-	{
-		BlendSpaceInstance = new FAllegroBlendSpaceInstance();
-	}
+	const float Delta = Montages.PendingDelta[Slot];
+	Montages.PendingDelta[Slot] = 0;
+	Montages.bPending[Slot] = 0;
 
-	BlendSpaceInstance->SetPosition(BlendSpacePositionX, BlendSpacePositionY);
-	BlendSpaceInstance->SetBlendSpace(Asset);
+	UAnimMontage* Montage = Montages.Montage[Slot];
+	const int32 InstanceIndex = Montages.InstanceIndex[Slot];
 
-	BlendSpaceInstance->Update(0.0f);
-
-	this->CurrentSequence = -1;
-	this->Time = BlendSpaceInstance->CurrentTime;
-
-	float Length = 1.0f;
-	const TArray<struct FBlendSampleData>& BlendSamples = BlendSpaceInstance->BlendSampleDataCache;
-	TArray<OrderAnimSequenceWeight> Temp;
-	Temp.Reset(BlendSamples.Num());
-
-	for (int i = 0; i < BlendSamples.Num(); ++i)
+	if (Montages.bPlaying[Slot] && Montage->CompositeSections.IsValidIndex(Montages.Section[Slot]))
 	{
-		int32* idx = Owner->AnimCollection->SequenceIndexMap.Find(BlendSamples[i].Animation.Get()); // FindSequenceDef(SampleDatas[i].Animation.Get());   
-		if (idx && *idx >= 0)
+		FAnimNotifyContext NotifyContext;
+		float Remaining = Delta * Montage->RateScale;
+		//each step stops at the end of the section so that notifies are gathered from contiguous positions
+		for (int Step = 0; Remaining > 0 && Step <= Montage->CompositeSections.Num(); Step++)
 		{
-			auto& Ref = Temp.AddDefaulted_GetRef();
-			Ref.SequenceIndex = *idx;
-			Ref.Weight = BlendSamples[i].GetClampedWeight();
+			float SectionStart, SectionEnd;
+			Montage->GetSectionStartAndEndTime(Montages.Section[Slot], SectionStart, SectionEnd);
+
+			const float PrevPosition = Montages.Position[Slot];
+			const float NewPosition = FMath::Min(PrevPosition + Remaining, SectionEnd);
+			Montage->GetAnimNotifiesFromDeltaPositions(PrevPosition, NewPosition, NotifyContext);
+			Remaining -= NewPosition - PrevPosition;
+			Montages.Position[Slot] = NewPosition;
+			if (NewPosition < SectionEnd)
+				break;
+
+			const int32 CurSection = Montages.Section[Slot];
+			const int32 NextSection = CurSection == Montages.LoopSection[Slot] ? CurSection : Montage->GetSectionIndex(Montage->CompositeSections[CurSection].NextSectionName);
+			if (NextSection == INDEX_NONE)
+			{
+				Montages.bPlaying[Slot] = 0;
+				break;
+			}
+
+			Montage->GetSectionStartAndEndTime(NextSection, SectionStart, SectionEnd);
+			Montages.Section[Slot] = NextSection;
+			Montages.Position[Slot] = SectionStart;
 		}
-	}
 
-	Temp.Sort([](const OrderAnimSequenceWeight& LHS, const OrderAnimSequenceWeight& RHS)
+		for (const FAnimNotifyEventReference& NotifyRef : NotifyContext.ActiveNotifies)
 		{
-			return LHS.Weight > RHS.Weight;
+			if (const FAnimNotifyEvent* Notify = NotifyRef.GetNotify())
+				Events.Notifies.Add(FAllegroAnimNotifyEvent{ InstanceIndex, Montage, Notify->NotifyName, Notify->Notify });
 		}
-	);
-
-	if (Temp.Num() > 0)
-	{
-		this->CurrentSequence = Temp[0].SequenceIndex;
-		const FAllegroSequenceDef& ActiveSequenceStruct = Owner->AnimCollection->Sequences[this->CurrentSequence];
-		Length = ActiveSequenceStruct.GetSequenceLength();
 	}
 
-	return Length;
+	ResolveMontageSequence(Owner, Slot);
+	WriteBack(Owner, InstanceIndex, Montages.CurrentSequence[Slot], Montages.Time[Slot], !Montages.bPlaying[Slot], Events);
 }
 
-void FInstanceAnimStateExtend::SetBlendSpacePosition(float InX, float InY)
+void FAllegroAnimExtendPool::ResolveMontageSequence(UAllegroComponent* Owner, int32 Slot)
 {
-	if (BlendSpaceInstance)
+	const FAnimTrack* Track = Montages.Track[Slot];
+	if (!Track)
+		return;
+
+	const float ClampedTime = FMath::Clamp(Montages.Position[Slot], 0.0f, Track->GetLength());
+	int32 SegmentIndex = Montages.Segment[Slot];
+	//segment rarely changes, only look it up when position leaves the cached one
+	if (!Track->AnimSegments.IsValidIndex(SegmentIndex) || !Track->AnimSegments[SegmentIndex].IsInRange(ClampedTime))
 	{
-		BlendSpaceInstance->SetPosition(InX, InY);
+		SegmentIndex = Track->GetSegmentIndexAtTime(ClampedTime);
+		Montages.Segment[Slot] = SegmentIndex;
+		Montages.SegmentSequence[Slot] = INDEX_NONE;
+
+		if (SegmentIndex != INDEX_NONE && Track->AnimSegments[SegmentIndex].IsValid())
+		{
+			float PositionInAnim = 0.0f;
+			if (UAnimSequenceBase* AnimRef = Track->AnimSegments[SegmentIndex].GetAnimationData(ClampedTime, PositionInAnim))
+			{
+				const int32* Idx = Owner->AnimCollection->SequenceIndexMap.Find(AnimRef);
+				if (Idx && *Idx >= 0)
+					Montages.SegmentSequence[Slot] = *Idx;
+			}
+		}
 	}
-}
 
-bool FInstanceAnimStateExtend::MontageJumpToSectionName(const FString& SectionName, bool bEndOfSection)
-{
-	if (MontageInstanceProxy)
+	//keep the last valid sequence if current one is not in the collection
+	if (SegmentIndex == INDEX_NONE || Montages.SegmentSequence[Slot] == INDEX_NONE)
+		return;
+
+	float PositionInAnim = 0.0f;
+	if (Track->AnimSegments[SegmentIndex].GetAnimationData(ClampedTime, PositionInAnim))
 	{
-		return MontageInstanceProxy->MontageJumpToSectionName(SectionName, bEndOfSection);
+		Montages.CurrentSequence[Slot] = Montages.SegmentSequence[Slot];
+		Montages.Time[Slot] = PositionInAnim;
 	}
-	return false;
 }
 
-void FInstanceAnimStateExtend::PostUpdate(int32 InstanceIndex, UAllegroComponent* Owner)
+void FAllegroAnimExtendPool::AdvanceBlendSpace(int32 Slot, float Delta)
+{
+	//tick record only points to the pooled state, so its rebuilt on the stack instead of being stored per instance
+	FAnimTickRecord TickRecord;
+	TickRecord.bLooping = true;
+	TickRecord.SourceAsset = BlendSpaces.BlendSpace[Slot];
+	TickRecord.BlendSpace.BlendSpacePositionX = BlendSpaces.BlendPosition[Slot].X;
+	TickRecord.BlendSpace.BlendSpacePositionY = BlendSpaces.BlendPosition[Slot].Y;
+	TickRecord.BlendSpace.BlendFilter = &BlendSpaces.Filter[Slot];
+	TickRecord.BlendSpace.BlendSampleDataCache = &BlendSpaces.SampleDataCache[Slot];
+	TickRecord.TimeAccumulator = &BlendSpaces.NormalizedTime[Slot];
+	TickRecord.DeltaTimeRecord = &BlendSpaces.DeltaTimeRecord[Slot];
+
+	TArray<FName> ValidMarkers;
+	FAnimNotifyQueue NotifyQueue;
+	FAnimAssetTickContext TickContext(Delta, ERootMotionMode::RootMotionFromEverything, false, ValidMarkers);
+	TickRecord.SourceAsset->TickAssetPlayer(TickRecord, NotifyQueue, TickContext);
+}
+
+void FAllegroAnimExtendPool::TickBlendSpace(UAllegroComponent* Owner, int32 Slot, FAllegroAnimTickEvents& Events)
 {
+	const float Delta = BlendSpaces.PendingDelta[Slot];
+	BlendSpaces.PendingDelta[Slot] = 0;
+	BlendSpaces.bPending[Slot] = 0;
+
+	AdvanceBlendSpace(Slot, Delta);
 
 	UAllegroAnimCollection* AnimCollection = Owner->AnimCollection;
 	FAllegroInstancesData& InstancesData = Owner->InstancesData;
+	const int32 InstanceIndex = BlendSpaces.InstanceIndex[Slot];
 
-	if (MontageInstanceProxy)
+	const int32 DataIndex = InstancesData.BlendFrameInfoIndex[InstanceIndex];
+	if (DataIndex > 0)
 	{
-		MontageInstanceProxy->PostUpdate([&](const TArray<FMontageEvaluationState>& MontageEvaluationData, TArray<FAnimNotifyEventReference>& NotitfyRefs, float NotifyWeight)
+		FInstanceBlendFrameInfo& BlendInfo = InstancesData.BlendFrameInfo[DataIndex];
+
+		BlendInfo.Weight[0] = 1.0f;
+		for (int i = 1; i < ALLEGRO_BLEND_FRAME_NUM_MAX; ++i)
+		{
+			BlendInfo.Weight[i] = 0.0f;
+		}
+
+		FSequenceWeightArray Weights;
+		GatherSequenceWeights(AnimCollection, BlendSpaces.SampleDataCache[Slot], Weights);
+
+		int BlendNumMax = ALLEGRO_BLEND_FRAME_NUM_MAX;
+
+#if ALLEGRO_ANIMTION_TICK_LOD
+		int AnimLOD = InstancesData.AnimationStates[InstanceIndex].AnimtioneLOD;
+		if (AnimLOD > 2)
+		{
+			BlendNumMax = ALLEGRO_BLEND_FRAME_NUM_MAX - 3;
+		}
+		else if (AnimLOD > 1)
+		{
+			BlendNumMax = ALLEGRO_BLEND_FRAME_NUM_MAX - 2;
+		}
+		else if (AnimLOD > 0)
+		{
+			BlendNumMax = ALLEGRO_BLEND_FRAME_NUM_MAX - 1;
+		}
+		if (BlendNumMax < 1)
+			BlendNumMax = 1;
+#endif
+
+		float WeightTotal = 0.0f;
+		for (int i = 0; i < BlendNumMax && i < Weights.Num(); ++i)
+		{
+			WeightTotal += Weights[i].Weight;
+		}
+
+		const float NormalizedTime = BlendSpaces.NormalizedTime[Slot];
+		for (int i = 0; i < BlendNumMax && i < Weights.Num(); ++i)
+		{
+			const FAllegroSequenceDef& ActiveSequenceStruct = AnimCollection->Sequences[Weights[i].SequenceIndex];
+			int LocalFrameIndex = NormalizedTime * ActiveSequenceStruct.AnimationFrameCount;
+			if (i == 0)
+			{
+				BlendSpaces.CurrentSequence[Slot] = Weights[i].SequenceIndex;
+				BlendSpaces.Time[Slot] = NormalizedTime * ActiveSequenceStruct.SequenceLength;
+			}
+			else
 			{
-				for (const FMontageEvaluationState& EvalState : MontageEvaluationData)
-				{
-					if (!EvalState.Montage.IsValid())
-					{
-						return;
-					}
-					const UAnimMontage* const Montage = EvalState.Montage.Get();
-
-					FAnimTrack const* const AnimTrack = Montage->GetAnimationData(DefaultSlotName);
-					const float ClampedTime = FMath::Clamp(EvalState.MontagePosition, 0.0f, AnimTrack->GetLength());
-					if (const FAnimSegment* const AnimSegment = AnimTrack->GetSegmentAtTime(ClampedTime))
-					{
-						if (AnimSegment->IsValid())
-						{
-							float PositionInAnim = 0.0f;
-							if (UAnimSequenceBase* AnimRef = AnimSegment->GetAnimationData(ClampedTime, PositionInAnim))
-							{
-								int32* idx = Owner->AnimCollection->SequenceIndexMap.Find(AnimRef); // FindSequenceDef(AnimRef); 
-								 if (idx && *idx>=0)
-								 {
-									 this->CurrentSequence = *idx;
-									 this->Time = PositionInAnim;
-								 }
-							}
-						}
-					}
-				}
-
-				for (auto& Notify : NotitfyRefs)
-				{
-					Owner->AddEvent(InstanceIndex, FAllegroAnimNotifyEvent{ InstanceIndex,MontageInstanceProxy->GetMonageAsset(), Notify.GetNotify()->NotifyName,Notify.GetNotify()->Notify});
-				}
+				int GlobalFrameIndex = ActiveSequenceStruct.AnimationFrameIndex + LocalFrameIndex;
+				const int PrevFrameIndex = static_cast<int>(BlendInfo.FrameIndex[i - 1]);
+				if (PrevFrameIndex < ActiveSequenceStruct.AnimationFrameIndex || PrevFrameIndex >= ActiveSequenceStruct.AnimationFrameIndex + ActiveSequenceStruct.AnimationFrameCount)
+					Events.bSequencesChanged = true;
 
+				BlendInfo.FrameIndex[i - 1] = GlobalFrameIndex;
 			}
-		);
+			BlendInfo.Weight[i] = Weights[i].Weight / WeightTotal;
+		}
 	}
-	else if (BlendSpaceInstance)
+
+	WriteBack(Owner, InstanceIndex, BlendSpaces.CurrentSequence[Slot], BlendSpaces.Time[Slot], false, Events);
+}
+
+void FAllegroAnimExtendPool::WriteBack(UAllegroComponent* Owner, int32 InstanceIndex, int32 Sequence, float Time, bool bFinished, FAllegroAnimTickEvents& Events)
+{
+	FAllegroInstancesData& InstancesData = Owner->InstancesData;
+	EAllegroInstanceFlags& Flags = InstancesData.Flags[InstanceIndex];
+	if (bFinished)
 	{
-		BlendSpaceInstance->PostUpdate([&](const TArray<FBlendSampleData>& SampleDatas)
-			{
-				int32 DataIndex = InstancesData.BlendFrameInfoIndex[InstanceIndex];
-				if (DataIndex <= 0)
-					return;
-	
-				FInstanceBlendFrameInfo& BlendInfo = InstancesData.BlendFrameInfo[DataIndex];
-				
-				BlendInfo.Weight[0] = 1.0f;
-				for (int i = 1; i < ALLEGRO_BLEND_FRAME_NUM_MAX; ++i)
-				{
-					BlendInfo.Weight[i] = 0.0f;
-				}
-
-				int TempNum = ALLEGRO_BLEND_FRAME_NUM_MAX * 2;   
-				TArray<OrderAnimSequenceWeight> Temp;
-				Temp.Reset(TempNum);
-
-				for (int i = 0; (i < SampleDatas.Num() && i < TempNum) ; ++i)
-				{	
-					int32* idx = Owner->AnimCollection->SequenceIndexMap.Find(SampleDatas[i].Animation.Get()); // FindSequenceDef(SampleDatas[i].Animation.Get());   
-					if (idx && *idx >= 0)
-					{
-						auto& Ref = Temp.AddDefaulted_GetRef();
-						Ref.SequenceIndex = *idx;
-						Ref.Weight = SampleDatas[i].GetClampedWeight();
-					}
-				}
-
-				Temp.Sort([](const OrderAnimSequenceWeight& LHS, const OrderAnimSequenceWeight& RHS)
-					{
-						return LHS.Weight > RHS.Weight;
-					}
-				);
-
-				int BlendNumMax = ALLEGRO_BLEND_FRAME_NUM_MAX;
+		EnumAddFlags(Flags, EAllegroInstanceFlags::EIF_AnimFinished);
+	}
 
-#if ALLEGRO_ANIMTION_TICK_LOD
-				int AnimLOD = InstancesData.AnimationStates[InstanceIndex].AnimtioneLOD;
-				if (AnimLOD > 2)
-				{
-					BlendNumMax = ALLEGRO_BLEND_FRAME_NUM_MAX - 3;
-				}
-				else if (AnimLOD > 1)
-				{
-					BlendNumMax = ALLEGRO_BLEND_FRAME_NUM_MAX - 2;
-				}
-				else if (AnimLOD > 0)
-				{
-					BlendNumMax = ALLEGRO_BLEND_FRAME_NUM_MAX - 1;
-				}
-				if (BlendNumMax < 1) 
-					BlendNumMax = 1;
-#endif
+	//old transition is still playing and owns the frame index
+	const bool bPlayingTransition = !Owner->UseGPUTransition && EnumHasAnyFlags(Flags, EAllegroInstanceFlags::EIF_AnimPlayingTransition);
+	if (Sequence >= 0 && !bPlayingTransition)
+	{
+		const FAllegroSequenceDef& ActiveSequence = Owner->AnimCollection->Sequences[Sequence];
+		int LocalIndex = static_cast<int>(Time * ActiveSequence.SampleFrequencyFloat);
+		if (LocalIndex >= ActiveSequence.AnimationFrameCount)
+		{
+			LocalIndex = ActiveSequence.AnimationFrameCount - 1;
+		}
+
+		InstancesData.FrameIndices[InstanceIndex] = ActiveSequence.AnimationFrameIndex + LocalIndex;
+		if (InstancesData.AnimationStates[InstanceIndex].CurrentSequence != Sequence)
+		{
+			InstancesData.AnimationStates[InstanceIndex].CurrentSequence = static_cast<uint16>(Sequence);
+			Events.bSequencesChanged = true;
+		}
+	}
 
-				float WeightTotal = 0.0f;
-				for (int i = 0; i < BlendNumMax && i < Temp.Num(); ++i)
-				{
-					WeightTotal += Temp[i].Weight;
-				}
-
-				for (int i = 0; i < BlendNumMax && i < Temp.Num(); ++i)
-				{
-					const FAllegroSequenceDef& ActiveSequenceStruct = AnimCollection->Sequences[Temp[i].SequenceIndex];
-					int LocalFrameIndex = BlendSpaceInstance->NormalizedCurrentTime * ActiveSequenceStruct.AnimationFrameCount;
-					if (i == 0)
-					{
-						this->CurrentSequence = Temp[i].SequenceIndex;
-						this->Time = BlendSpaceInstance->NormalizedCurrentTime * ActiveSequenceStruct.SequenceLength;
-					}
-					else
-					{
-						int GlobalFrameIndex = ActiveSequenceStruct.AnimationFrameIndex + LocalFrameIndex;
-						BlendInfo.FrameIndex[i - 1] = GlobalFrameIndex;
-					}
-					BlendInfo.Weight[i] = Temp[i].Weight / WeightTotal;
-				}
-
-			});
+	if (Owner->UseGPUTransition && EnumHasAllFlags(Flags, EAllegroInstanceFlags::EIF_GPUTransition | EAllegroInstanceFlags::EIF_AnimFinished))
+	{
+		Events.FinishedGPUTransitions.Add(InstanceIndex);
 	}
 }
+
+void FAllegroAnimExtendPool::SetBlendSpacePosition(int32 Slot, float InX, float InY)
+{
+	BlendSpaces.BlendPosition[Slot] = FVector2f(InX, InY);
+}
+
+bool FAllegroAnimExtendPool::MontageJumpToSectionName(int32 Slot, const FString& SectionName, bool bEndOfSection)
+{
+	UAnimMontage* Montage = Montages.Montage[Slot];
+	const int32 SectionIndex = Montage->GetSectionIndex(FName(SectionName));
+	if (SectionIndex == INDEX_NONE)
+		return false;
+
+	float SectionStart, SectionEnd;
+	Montage->GetSectionStartAndEndTime(SectionIndex, SectionStart, SectionEnd);
+	Montages.Section[Slot] = SectionIndex;
+	Montages.Position[Slot] = bEndOfSection ? FMath::Max(SectionStart, SectionEnd - KINDA_SMALL_NUMBER) : SectionStart;
+	return true;
+}
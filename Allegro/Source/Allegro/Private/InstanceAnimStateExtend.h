@@ -1,65 +1,101 @@
-﻿#pragma once
+#pragma once
 
 #include "AllegroComponent.h"
+#include "Animation/AnimationAsset.h"
 
 
 
 class UAnimMontage;
 class UBlendSpace;
+struct FAnimTrack;
 
-struct FAllegroBlendSpaceInstance;
-struct FAllegroAnimMontageInstanceProxy;
 
-
-
-class FInstanceAnimStateExtend
+/*
+* playback state of montage and blend space instances, stored as pooled SoA tables owned by UAllegroComponent.
+* FAllegroInstanceAnimState::ExtendSlot indexes the montage or blend space table depending on its AssetType.
+* instance tick only queues the delta time, Tick() then advances all queued slots in a batch.
+*/
+class FAllegroAnimExtendPool
 {
-
 public:
-
-	FInstanceAnimStateExtend();
-
-	~FInstanceAnimStateExtend();
-
-	float SetMontage(UAnimMontage* Asset, FAllegroAnimPlayParams& Params, UAllegroComponent* Owner);
-
-	float SetBlendSpace(UBlendSpace* Asset, FAllegroAnimPlayParams& Params, UAllegroComponent* Owner);
-
-	void Update(float Delta);
-
-	void PostUpdate(int32 InstanceIndex,UAllegroComponent* Owner);
-
-	void SetBlendSpacePosition(float InX, float InY = 0);
-
-	bool MontageJumpToSectionName(const FString& SectionName, bool bEndOfSection = false);
-
+	//allocate a slot and start playing, @OutLength receives the length of the asset. never fails, caller must Free the slot if it doesn't use it
+	int32 AllocMontage(int32 InstanceIndex, UAnimMontage* Asset, const FAllegroAnimPlayParams& Params, UAllegroComponent* Owner, float& OutLength);
+	int32 AllocBlendSpace(int32 InstanceIndex, UBlendSpace* Asset, UAllegroComponent* Owner, float& OutLength);
+	void Free(EAnimAssetType AssetType, int32 Slot);
+	//free all slots
 	void Reset();
 
-	bool IsPlaying();
+	//sequence index and its local time that the slot is currently playing, sequence is -1 if not found in the collection
+	int32 GetCurrentSequence(EAnimAssetType AssetType, int32 Slot) const;
+	float GetTime(EAnimAssetType AssetType, int32 Slot) const;
 
-	float						Time = 0;
-	int32						CurrentSequence = -1;
+	//called from instance tick, thread safe as long as each slot is touched by its instance only
+	void QueueTick(EAnimAssetType AssetType, int32 Slot, float Delta);
+	//advance all queued slots and write their frame indices, must be called after all instances are ticked.
+	//slots are ticked in batches of @BatchSize, each batch appends to its own element of @EventBuffers
+	void Tick(UAllegroComponent* Owner, TArray<FAllegroAnimTickEvents>& EventBuffers, bool bParallel, int32 BatchSize);
 
-private:
+	void SetBlendSpacePosition(int32 Slot, float InX, float InY);
+	bool MontageJumpToSectionName(int32 Slot, const FString& SectionName, bool bEndOfSection);
 
-	FAllegroAnimMontageInstanceProxy* MontageInstanceProxy = nullptr;
-	FAllegroBlendSpaceInstance* BlendSpaceInstance = nullptr;
+private:
+	/* columns shared by both tables */
+	struct FCommonTable
+	{
+		TArray<int32> InstanceIndex;		//INDEX_NONE if slot is free
+		TArray<int32> CurrentSequence;
+		TArray<float> Time;
+		TArray<float> PendingDelta;
+		TArray<uint8> bPending;
+		TArray<int32> FreeSlots;
+
+		int32 Num() const { return InstanceIndex.Num(); }
+		//grow all columns by one, return the new slot
+		int32 AddSlot();
+		void InitSlot(int32 Slot, int32 InInstanceIndex);
+		void FreeSlot(int32 Slot);
+		void Reset();
+	};
 
-	float						BlendSpacePositionX = 0.0f;
-	float						BlendSpacePositionY = 0.0f;
+	struct FMontageTable : FCommonTable
+	{
+		TArray<UAnimMontage*> Montage;
+		TArray<const FAnimTrack*> Track;	//cached default slot track
+		TArray<float> Position;
+		TArray<int32> Section;
+		TArray<int32> LoopSection;			//section that loops to itself, INDEX_NONE if none
+		TArray<int32> Segment;				//cached segment of Track, INDEX_NONE if unknown
+		TArray<int32> SegmentSequence;		//collection sequence index of Segment
+		TArray<uint8> bPlaying;
+
+		int32 AddSlot();
+		void Reset();
+	};
 
-	struct OrderAnimSequenceWeight
+	struct FBlendSpaceTable : FCommonTable
 	{
-		int32 SequenceIndex;
-		float Weight;
-
-		OrderAnimSequenceWeight()
-		{
-			SequenceIndex = 1;
-			Weight = 0.0f;
-		}
+		TArray<UBlendSpace*> BlendSpace;
+		TArray<FVector2f> BlendPosition;
+		TArray<float> NormalizedTime;
+		TArray<FBlendFilter> Filter;
+		TArray<TArray<FBlendSampleData>> SampleDataCache;
+		TArray<FDeltaTimeRecord> DeltaTimeRecord;
+
+		int32 AddSlot();
+		void Reset();
 	};
 
-};
+	template<typename TTable> static int32 AllocSlot(TTable& Table, int32 InstanceIndex);
 
+	void TickMontage(UAllegroComponent* Owner, int32 Slot, FAllegroAnimTickEvents& Events);
+	void TickBlendSpace(UAllegroComponent* Owner, int32 Slot, FAllegroAnimTickEvents& Events);
+	//tick the blend space by @Delta and update its sample cache
+	void AdvanceBlendSpace(int32 Slot, float Delta);
+	//find the segment of montage track at its current position and update CurrentSequence/Time
+	void ResolveMontageSequence(UAllegroComponent* Owner, int32 Slot);
+	//write the result of a ticked slot to the instance
+	static void WriteBack(UAllegroComponent* Owner, int32 InstanceIndex, int32 Sequence, float Time, bool bFinished, FAllegroAnimTickEvents& Events);
 
+	FMontageTable Montages;
+	FBlendSpaceTable BlendSpaces;
+};
@@ -41,6 +41,9 @@ extern ALLEGRO_API float GAllegro_DistanceScale;
 
 #define ALLEGRO_USE_GPU_SCENE 0
 
+//optional compute shader culling and LOD selection, enabled at runtime by allegro.GPUCull. only screen size LOD is supported
+#define ALLEGRO_GPU_CULL (ALLEGRO_USE_LOD_SCREEN_SIZE && !ALLEGRO_USE_STENCIL && !ALLEGRO_USE_GPU_SCENE)
+
 #define ALLEGRO_DEBUG 0
 
 #define ALLEGRO_LOD_PRE_SUBMESH 1
@@ -48,4 +51,5 @@ extern ALLEGRO_API float GAllegro_DistanceScale;
 
 #define ALLEGRO_GPU_TRANSITION 1
 
-#define ALLEGRO_ANIMTION_TICK_LOD 0
\ No newline at end of file
+//animation tick LOD, far instances advance their animation every few frames. compiled in but off unless UAllegroComponent::bEnableAnimTickLOD is set, allegro.AnimTickLOD 0 disables it globally
+#define ALLEGRO_ANIMTION_TICK_LOD 1
\ No newline at end of file
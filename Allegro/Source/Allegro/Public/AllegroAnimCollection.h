@@ -13,6 +13,7 @@
 #include "BoneContainer.h"
 #include "RenderCommandFence.h"
 #include "UnifiedBuffer.h"
+#include "Serialization/BulkData.h"
 
 #include "AllegroAnimCollection.generated.h"
 
@@ -22,6 +23,7 @@ class USkeletalMesh;
 class USkeleton;
 class UPhysicsAsset;
 class UAnimNotify;
+class UAllegroComponent;
 
 struct FAllegroSimpleAnimNotifyEvent
 {
@@ -41,6 +43,30 @@ class FAllegroMeshDataEx;
 typedef TSharedPtr<FAllegroMeshDataEx, ESPMode::ThreadSafe> FAllegroMeshDataExPtr;
 
 
+//how bone transforms are encoded in the animation buffer. must match ALLEGRO_ANIMBUFFER_* in AllegroVertexFactory.ush
+UENUM()
+enum class EAllegroAnimBufferFormat : uint8
+{
+	//3 float4 per bone (48 bytes, 24 with half precision), exact
+	Matrix3x4,
+	//2 float4 per bone (32 bytes, 16 with half precision), rotation quaternion + translation and uniform scale. non uniform scale is lost.
+	QuatTranslation,
+	//2 float4 per bone (32 bytes, 16 with half precision), dual quaternion. blended as dual quaternion in vertex shader (no candy-wrapper artifacts). scale is lost.
+	DualQuat,
+};
+
+//number of float4 per bone in the animation buffer
+inline uint32 AllegroAnimBufferVectorsPerBone(EAllegroAnimBufferFormat Format)
+{
+	return Format == EAllegroAnimBufferFormat::Matrix3x4 ? 3 : 2;
+}
+
+//encode a render matrix (as generated by CalcRenderMatrices) to @Format, writes AllegroAnimBufferVectorsPerBone() vectors
+ALLEGRO_API void AllegroEncodeBone(EAllegroAnimBufferFormat Format, const FMatrix3x4& RenderMatrix, FVector4f* Out);
+//CPU equivalent of GetBoneMatrix in AllegroVertexFactory.ush
+ALLEGRO_API FMatrix3x4 AllegroDecodeBone(EAllegroAnimBufferFormat Format, const FVector4f* In);
+
+
 USTRUCT(BlueprintType)
 struct ALLEGRO_API FAllegroSequenceDef
 {
@@ -58,10 +84,17 @@ struct ALLEGRO_API FAllegroSequenceDef
 	//number of frame generated
 	UPROPERTY(VisibleAnywhere, Transient, Category = "Allegro|AnimCollection")
 	int AnimationFrameCount;
+	//number of frames stored in animation buffer, less than AnimationFrameCount if some frames are reused. see FrameReductionTolerance
+	UPROPERTY(VisibleAnywhere, Transient, Category = "Allegro|AnimCollection")
+	int StoredFrameCount;
 	//copied from UAnimSequence, we don't need to touch @Sequence
 	float SequenceLength;
 	//copied from SampleFrequency, to avoid int to float cast
 	float SampleFrequencyFloat;
+	//maximum vertex error (cm) caused by animation buffer encoding, measured at bake time
+	float BakeError;
+	//local frame index -> index of the stored frame it uses, relative to AnimationFrameIndex. only used during build
+	TArray<int32> StoredFrameRemap;
 	//we cache name only notifications for faster access. other types of notification are not supported yet.
 	TArray<FAllegroSimpleAnimNotifyEvent, TInlineAllocator<4>> Notifies;
 
@@ -77,6 +110,46 @@ struct ALLEGRO_API FAllegroSequenceDef
 
 };
 
+/*
+* transition generated at build time together with the sequences instead of on demand at runtime.
+* runtime requests with the same key (as created by UAllegroComponent) are served from the baked frames, no generation and no upload.
+*/
+USTRUCT(BlueprintType)
+struct ALLEGRO_API FAllegroTransitionBakeDef
+{
+	GENERATED_USTRUCT_BODY()
+
+	//sequence transition starts from, must be listed in Sequences
+	UPROPERTY(EditAnywhere, Category = "Allegro|AnimCollection")
+	UAnimSequenceBase* From;
+	//sequence transition blends to, must be listed in Sequences
+	UPROPERTY(EditAnywhere, Category = "Allegro|AnimCollection")
+	UAnimSequenceBase* To;
+	//same as TransitionDuration of the play request
+	UPROPERTY(EditAnywhere, Category = "Allegro|AnimCollection", meta=(ClampMin=0, Units="Seconds"))
+	float Duration;
+	//same as StartAt of the play request
+	UPROPERTY(EditAnywhere, Category = "Allegro|AnimCollection", meta=(ClampMin=0, Units="Seconds"))
+	float ToStartAt;
+	//
+	UPROPERTY(EditAnywhere, Category = "Allegro|AnimCollection")
+	EAlphaBlendOption BlendOption;
+	//true if source sequence is looping when transition starts
+	UPROPERTY(EditAnywhere, Category = "Allegro|AnimCollection")
+	bool bFromLoops;
+	//same as bLoop of the play request
+	UPROPERTY(EditAnywhere, Category = "Allegro|AnimCollection")
+	bool bToLoops;
+	//local frame index of the source sequence transition starts from. -1 bakes one transition for every FromFrameStride frames of the source.
+	UPROPERTY(EditAnywhere, Category = "Allegro|AnimCollection", meta=(ClampMin=-1))
+	int FromFrame;
+	//
+	UPROPERTY(EditAnywhere, Category = "Allegro|AnimCollection", meta=(ClampMin=1, EditCondition="FromFrame < 0"))
+	int FromFrameStride;
+
+	FAllegroTransitionBakeDef();
+};
+
 
 
 /*
@@ -208,6 +281,16 @@ public:
 	//true if animation data should be kept as float32 instead of float16, with low precision you may see jitter in places like fingers
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Animation")
 	bool bHighPrecision;
+	//encoding of bone transforms in the animation buffer. at the same precision QuatTranslation and DualQuat take 2/3 of the memory and vertex shader fetches of Matrix3x4 (1.5x smaller), check AnimationBufferMaxError after build.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Animation")
+	EAllegroAnimBufferFormat AnimationBufferFormat;
+	//a sampled frame of a sequence isn't stored if it differs less than this from the last stored frame, the stored one is shown instead. static parts of sequences (idles, holds) take nearly no memory. 0 stores every frame
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Animation", meta=(Units="Centimeters", ClampMin=0))
+	float FrameReductionTolerance = 0.05f;
+	//number of sequence frames kept in GPU memory. sequences become resident when instances play them and least recently played ones are evicted, non resident sequences show the reference pose.
+	//all frames stay in system memory. 0 keeps all sequences resident
+	UPROPERTY(EditAnywhere, Category = "Animation", meta=(ClampMin=0))
+	int StreamingPoolFrames;
 	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Animation")
 	bool bDisableRetargeting;
 	//generating bounding box for all animation frames may take up too much memory. if set to true uses biggest bound generated from all sequences. See also Allegro.DrawInstanceBounds 1
@@ -232,6 +315,12 @@ public:
 	//VRAM taken for animations
 	UPROPERTY(VisibleAnywhere, Transient, Category = "Info", meta=(Units="Bytes"))
 	int TotalAnimationBufferSize;
+	//maximum vertex error caused by bHighPrecision and AnimationBufferFormat, measured on baked sequences. (for a vertex fully weighted to a single bone inside the mesh bounds)
+	UPROPERTY(VisibleAnywhere, Transient, Category = "Info", meta=(Units="Centimeters"))
+	float AnimationBufferMaxError;
+	//average of per sequence maximum error
+	UPROPERTY(VisibleAnywhere, Transient, Category = "Info", meta=(Units="Centimeters"))
+	float AnimationBufferAvgError;
 	//VRAM taken for custom bone indices
 	UPROPERTY(VisibleAnywhere, Transient, Category = "Info", meta=(Units="Bytes"))
 	int TotalMeshBonesBufferSize;
@@ -241,6 +330,15 @@ public:
 	//number of animation frames to be reserved for dynamic instances
 	UPROPERTY(EditAnywhere, Category = "Animation")
 	int MaxDynamicPose;
+	//transitions generated at build time. they never get evicted and cost nothing at runtime. see AddRecordedTransitions
+	//only used by the CPU transition path, ignored (with a warning) when ALLEGRO_GPU_TRANSITION is enabled
+	UPROPERTY(EditAnywhere, Category = "Animation")
+	TArray<FAllegroTransitionBakeDef> PrebakedTransitions;
+	//number of animation frames taken by PrebakedTransitions, they are placed right after the sequences
+	UPROPERTY(VisibleAnywhere, Transient, Category = "Info")
+	int NumPrebakedTransitionFrame;
+	//prebaked transitions are the first elements of Transitions
+	int NumPrebakedTransition;
 
 	//
 	//
@@ -320,6 +418,9 @@ public:
 	void AddAllAnimations();
 	UFUNCTION(CallInEditor, Category = "Animation")
 	void AddSelectedAssets();
+	//append transitions recorded while allegro.RecordTransitions was enabled to PrebakedTransitions
+	UFUNCTION(CallInEditor, Category = "Animation")
+	void AddRecordedTransitions();
 
 	void AddMeshUnique(const FAssetData& InAssetData);
 	void AddAnimationUnique(const FAssetData& InAssetData);
@@ -377,6 +478,10 @@ public:
 	{
 		TArray<uint32> ScatterData;		//value is animation frame index
 		TArray<FMatrix3x4> PoseData;	//length is == ScatterData.Num() * RenderBoneCount
+		TArray<uint32> StreamScatterData;	//value is frame index in animation buffer
+		TArray<FVector4f> StreamPoseData;	//already encoded bones of streamed in sequences
+		TArray<uint32> PageTable;			//new FrameRemap of animation buffer if residency changed
+		TArray<uint32> ImpostorFrameData;	//pairs of transition frame index and the sequence frame impostors show for it
 	};
 
 	struct FTransitionKey
@@ -407,7 +512,10 @@ public:
 		}
 		uint32 GetKeyHash() const 
 		{
-			return static_cast<uint32>(FromSI ^ ToSI ^ FromFI ^ ToFI);
+			//every field takes part, transitions between the same sequences at nearby frames must not collide
+			const uint64 A = Packed[0] | (static_cast<uint64>(Packed[1]) << 32);
+			const uint64 B = Packed[2] | (static_cast<uint64>(Packed[3]) << 32);
+			return static_cast<uint32>(MurmurFinalize64(MurmurFinalize64(A) ^ B));
 		}
 		bool KeysEqual(const FTransitionKey& Other) const 
 		{
@@ -423,6 +531,7 @@ public:
 		int FrameIndex = 0; //animation buffer frame index
 		uint16 DeferredIndex = 0xFFff; //index in DeferredTransitions
 		uint16 StateIndex = 0xFFff; //index in ZeroRCTransitions or NegativeRCTransitions depending on RefCount
+		bool bPrebaked = false; //generated at build time, lives as long as the build data and RefCount doesn't matter
 
 		bool IsDeferred() const { return DeferredIndex != 0xFFff; }
 		//true if transition has no references and passed one more frame 
@@ -441,6 +550,28 @@ public:
 	FAllegroSpanAllocator DynamicPoseAllocator;
 	TBitArray<> DynamicPoseFlipFlags;
 
+	/* residency of a sequence when StreamingPoolFrames is used */
+	struct FSequenceStreamingState
+	{
+		int PoolOffset = -1;			//offset of the stored frames in StreamingPoolAllocator, -1 if not resident
+		int SourceFrame = 0;			//first stored frame in StreamingSource
+		uint32 LastRequestFrame = 0;	//GFrameCounter of the last residency request
+	};
+
+	TArray<FSequenceStreamingState> StreamingStates;	//empty if streaming is disabled
+	TArray<uint16> FrameToSequence;			//animation frame index -> sequence index, covers sequence frames
+	TArray<uint32> StreamingSourceRemap;	//animation frame index -> frame in StreamingSource
+	TArray<uint8> StreamingSource;			//encoded stored frames of all the sequences
+	const uint8* StreamingSourceData = nullptr;	//StreamingSource or its section in CookedAnimationPayload
+	TArray<uint32> StreamingPageTable;		//game thread copy of AnimationBuffer->FrameRemap
+	TArray<int> PendingResidency;			//sequences requested this frame that are not resident
+	TArray<int> ResidentSequences;
+	//components that requested residency, their sequences are requested again every frame they are drawn even if they don't tick. see UAllegroComponent::RequestedSequences
+	TSet<TWeakObjectPtr<UAllegroComponent>> StreamingComponents;
+	FAllegroSpanAllocator StreamingPoolAllocator;
+	bool bStreamingPageTableDirty = false;
+	bool bStreamingPoolOverflowReported = false;
+
 	FPoseUploadData CurrentUpload;
 	FScatterUploadBuffer ScatterBuffer;	//used for uploading pose to GPU, index identifies animation frame index (can't upload single bone)
 
@@ -455,6 +586,11 @@ public:
 		ETR_Success_NewlyCreated,
 	};
 
+#if WITH_EDITORONLY_DATA
+	//keys of transitions created at runtime while allegro.RecordTransitions is on
+	TArray<FTransitionKey> RecordedTransitions;
+#endif
+
 	int ReserveUploadData(int FrameCount);
 
 	void UploadDataSetNumUninitialized(int N);
@@ -462,13 +598,50 @@ public:
 	void RemoveUnusedTransition(AllegroTransitionIndex UnusedTI);
 	void RemoveAllUnusedTransitions();
 
+	//@return index of the existing transition or -1
+	//read only, safe to call from tick workers since transitions are created and removed on game thread only, outside the parallel tick
+	int FindTransition(const FTransitionKey& Key) const;
 	TPair<int,ETransitionResult> FindOrCreateTransition(const FTransitionKey& Key, bool bIgonreTransitionGeneration);
 	//increase transition refcount
 	void IncTransitionRef(AllegroTransitionIndex TransitionIndex);
 	//decrease transition refcount and fill TransitionIndex with invalid index
 	void DecTransitionRef(AllegroTransitionIndex& TransitionIndex);
 	void ReleasePendingTransitions();
+
+	bool IsSequenceStreamingEnabled() const { return StreamingStates.Num() > 0; }
+	//keep the sequence resident in GPU memory, must be called every frame its played. game thread only
+	void RequestSequenceResidency(int SequenceIndex)
+	{
+		FSequenceStreamingState& State = StreamingStates[SequenceIndex];
+		if (State.LastRequestFrame != static_cast<uint32>(GFrameCounter))
+		{
+			State.LastRequestFrame = static_cast<uint32>(GFrameCounter);
+			if (State.PoolOffset == -1)
+				PendingResidency.Add(SequenceIndex);
+		}
+	}
+	void RequestFrameResidency(int FrameIndex)
+	{
+		if (IsAnimationFrameIndex(FrameIndex))
+			RequestSequenceResidency(FrameToSequence[FrameIndex]);
+	}
+	//make requested sequences resident and queue their upload, evicts least recently requested ones if pool is full.
+	//sequences of recently drawn StreamingComponents count as requested this frame
+	void UpdateSequenceStreaming();
+	void EvictSequence(int SequenceIndex);
+	//point page table entries of the sequence to its pool frames, or to the reference pose if not resident
+	void UpdateSequencePageTable(int SequenceIndex);
+	//sample and blend poses of a transition. fills cached bones of frames starting at @FrameIndex and writes Key.FrameCount * RenderBoneCount matrices to @OutMatrices
+	void GenerateTransitionPoses(const FTransitionKey& Key, int FrameIndex, FMatrix3x4* OutMatrices);
 	void GenerateTransition_Concurrent(uint32 TransitionIndex, uint32 ScatterIdx);
+	//create transition entries for PrebakedTransitions, must be called before animation buffer allocation
+	void InitPrebakedTransitions();
+	//sequence frame impostors show for frame @TransitionFrameIndex of a transition, the one with the higher blend weight
+	int GetTransitionImpostorFrameIndex(const FTransitionKey& Key, int TransitionFrameIndex) const;
+	//impostor frames of all transition frames, prebaked ones are filled. see FAllegroAnimationBuffer::ImpostorFrames
+	void InitImpostorFrames();
+	//generate poses of the prebaked transitions directly into the animation buffer
+	void BuildPrebakedTransitions();
 	void FlushDeferredTransitions();
 	bool HasAnyDeferredTransitions() const { return this->DeferredTransitions.Num() > 0; }
 	//flush transitions if FrameIndex is in transition range 
@@ -478,8 +651,8 @@ public:
 			FlushDeferredTransitions();
 	}
 	bool IsAnimationFrameIndex(int FrameIndex) const	{ return FrameIndex > 0 && FrameIndex < FrameCountSequences; }
-	bool IsTransitionFrameIndex(int FrameIndex) const	{ return FrameIndex >= FrameCountSequences && FrameIndex < (FrameCountSequences + MaxTransitionPose); }
-	bool IsDynamicPoseFrameIndex(int FrameIndex) const	{ return FrameIndex >= (FrameCountSequences + MaxTransitionPose) && FrameIndex < TotalFrameCount; }
+	bool IsTransitionFrameIndex(int FrameIndex) const	{ return FrameIndex >= FrameCountSequences && FrameIndex < GetDynamicPoseBaseFrameIndex(); }
+	bool IsDynamicPoseFrameIndex(int FrameIndex) const	{ return FrameIndex >= GetDynamicPoseBaseFrameIndex() && FrameIndex < TotalFrameCount; }
 	bool IsFrameIndexValid(int FrameIndex) const		{ return FrameIndex >= 0 && FrameIndex < TotalFrameCount; }
 
 	void ApplyScatterBufferRT(FRHICommandList& RHICmdList, const FPoseUploadData& UploadData);
@@ -487,8 +660,12 @@ public:
 	FMatrix3x4* RequestPoseUpload(int FrameInde);
 	void RequestPoseUpload(int FrameInde, const TArrayView<FMatrix3x4> PoseTransforms);
 
-	int FrameIndexToDynamicPoseIndex(int FrameIndex) const { return (FrameIndex - (FrameCountSequences + MaxTransitionPose)) / 2; }
-	int DynamicPoseIndexToFrameIndex(int DynamicPoseIndex) { return (FrameCountSequences + MaxTransitionPose) + (DynamicPoseIndex * 2) + (DynamicPoseFlipFlags[DynamicPoseIndex] ? 1 : 0); }
+	//animation buffer layout : [sequences][prebaked transitions][runtime transitions][dynamic poses]
+	int GetRuntimeTransitionBaseFrameIndex() const { return FrameCountSequences + NumPrebakedTransitionFrame; }
+	int GetDynamicPoseBaseFrameIndex() const { return FrameCountSequences + NumPrebakedTransitionFrame + MaxTransitionPose; }
+
+	int FrameIndexToDynamicPoseIndex(int FrameIndex) const { return (FrameIndex - GetDynamicPoseBaseFrameIndex()) / 2; }
+	int DynamicPoseIndexToFrameIndex(int DynamicPoseIndex) { return GetDynamicPoseBaseFrameIndex() + (DynamicPoseIndex * 2) + (DynamicPoseFlipFlags[DynamicPoseIndex] ? 1 : 0); }
 	
 	//flip the flag of dynamic pose and return new animation frame index
 	int FlipDynamicPoseSign(int DynamicPoseIndex)
@@ -507,16 +684,86 @@ public:
 
 	#pragma endregion
 
-	void CachePose(int PoseIndex, const TArrayView<FTransform>& PoseComponentSpace);
-	void CachePoseBounds(int PoseIndex, const TArrayView<FTransform>& PoseComponentSpace);
+	//@OutMaxBounds is indexed by mesh def, receives the bounds of meshes that generate their own
+	void CachePose(int PoseIndex, const TArrayView<FTransform>& PoseComponentSpace, TArrayView<FBoxMinMaxFloat> OutMaxBounds);
+	void CachePoseBounds(int PoseIndex, const TArrayView<FTransform>& PoseComponentSpace, TArrayView<FBoxMinMaxFloat> OutMaxBounds);
 	void CachePoseBones(int PoseIndex, const TArrayView<FTransform>& PoseComponentSpace);
 
 	bool CheckCanBuild(FString& OutError) const;
 	bool BuildData();
 	bool BuildAnimationData();
-	void BuildSequence(int SequenceIndex);
+	//bake frames of a sequence, or take them from DDC if nothing it depends on has changed. @return true if the sequence got sampled
+	bool BuildSequence(int SequenceIndex, TArrayView<FBoxMinMaxFloat> OutMaxBounds);
+	//pack stored frames of the sequences together, shrink the animation buffer and fill its frame remap
+	void CompactSequenceFrames();
+	//sample sequences and prebaked transitions into a new animation buffer, fills per frame bounds and cached bones
+	void BakeAnimationData();
+	//move stored frames to StreamingSource and leave a pool in the animation buffer. @NumStoredFrame including reference pose
+	void InitSequenceStreaming(int NumStoredFrame);
+	//residency states of the sequences from StreamingSourceRemap, nothing is resident. @PoolFrames size of the pool in the animation buffer
+	void InitStreamingStates(int PoolFrames);
 	void BuildMeshData();
 
+	/*
+	* result of BakeAnimationData saved with cooked collections. small tables are serialized inline, bulky data is a section of CookedAnimationPayload.
+	* payload is the exact memory image of what runtime reads so it can be memory mapped and used in place.
+	*/
+	struct FCookedAnimationData
+	{
+		static constexpr uint32 SectionAlignment = 16;
+
+		struct FSection
+		{
+			uint32 Offset = 0;	//relative to the start of the payload, aligned to SectionAlignment
+			uint32 Size = 0;
+		};
+
+		bool bValid = false;
+		//layout the data was baked for, must match the one computed at load
+		int FrameCountSequences = 0;
+		int TotalFrameCount = 0;
+		int RenderBoneCount = 0;
+		int NumCachedBone = 0;
+		int NumPrebakedTransitionFrame = 0;
+		uint32 RenderMatrixSize = 0;
+
+		TArray<int> StoredFrameCounts;			//per sequence
+		TArray<float> BakeErrors;				//per sequence
+		TArray<FBoxMinMaxFloat> MaxBBoxes;		//per mesh def
+		TArray<uint32> FrameRemap;				//see FAllegroAnimationBuffer::FrameRemap, empty if streamed
+		uint32 FrameRemapShift = 0;
+		int StreamingPoolFrames = 0;			//0 if sequences are not streamed
+		TArray<uint32> StreamingSourceRemap;
+		int TotalAnimationBufferSize = 0;
+
+		FSection AnimationBuffer;				//encoded animation buffer as uploaded to GPU
+		FSection CachedTransforms;				//cached bones of sequence and prebaked transition frames
+		FSection StreamingSource;
+		TArray<FSection> OwningBounds;			//per mesh def, empty if mesh doesn't generate bounds
+
+		void Serialize(FArchive& Ar);
+	};
+
+	FCookedAnimationData CookedAnimationData;
+	//memory mapped in cooked builds, stays locked while the build data points into it
+	FByteBulkData CookedAnimationPayload;
+
+	//take baked data from CookedAnimationPayload instead of sampling sequences. @return false if there is no valid cooked data
+	bool LoadCookedAnimationData();
+	void SerializeCookedAnimationData(FArchive& Ar);
+
+#if WITH_EDITOR
+	//fill CookedAnimationData and CookedAnimationPayload from the current build data, needs CPU copy of the animation buffer
+	void BuildCookedAnimationData();
+	//hash of everything but the sequence itself that baked frames depend on (bones, ref pose, bounds sources, encoding)
+	FString CalcSequenceBakeContextHash() const;
+	FString GetDDCKeyForSequence(int SequenceIndex) const;
+	//baked frames of a sequence in DDC, independent of its frame range in the animation buffer. @return false if loaded data doesn't match
+	bool SerializeSequenceBake(FArchive& Ar, int SequenceIndex, TArrayView<FBoxMinMaxFloat> MaxBounds);
+	//set by BuildAnimationData, empty if sequences are not cached
+	FString SequenceBakeContextHash;
+#endif
+
 
 	void InitBoneContainer();
 	void InitRefPoseOverride();
@@ -524,8 +771,14 @@ public:
 	FBox CalcPhysicsAssetBound(const UPhysicsAsset* PhysAsset, const TArrayView<FTransform>& PoseComponentSpace, bool bConsiderAllBodiesForBounds);
 
 	void CalcRenderMatrices(const TArrayView<FTransform> PoseComponentSpace, FMatrix3x4* OutMatrices) const;
-	void CalcRenderMatrices(const TArrayView<FTransform> PoseComponentSpace, FMatrix3x4Half* OutMatrices) const;
+	//encode render matrices of a baked frame into AnimationBuffer. @BufferFrameIndex is the frame in the buffer, not animation frame index. @return maximum error measured on BakeErrorProbes
+	float WriteRenderMatrices(int BufferFrameIndex, const FMatrix3x4* RenderMatrices);
+	//maximum distance of BakeErrorProbes transformed by two poses
+	float CalcPoseDistance(const FMatrix3x4* RenderMatricesA, const FMatrix3x4* RenderMatricesB, float EarlyOutDistance) const;
+	//points in reference pose component space used to measure encoding error
+	TArray<FVector3f> BakeErrorProbes;
 	
+	//size of a bone in the animation buffer (in bytes)
 	uint32 GetRenderMatrixSize() const;
 
 	void EnqueueReleaseResources();
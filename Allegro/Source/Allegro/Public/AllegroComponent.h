@@ -10,6 +10,7 @@
 #include "InstancedStruct.h"
 #include "AlphaBlend.h"
 #include "SpanAllocator.h"
+#include "AllegroSpatialIndex.h"
 
 
 #include "AllegroComponent.generated.h"
@@ -92,7 +93,43 @@ enum class EAnimAssetType : uint8
 ENUM_CLASS_FLAGS(EAnimAssetType);
 
 
-class FInstanceAnimStateExtend;
+class FAllegroAnimExtendPool;
+struct FAllegroAnimTickEvents;
+
+//metric used to pick the animation tick LOD band of instances
+UENUM()
+enum class EAllegroAnimTickLODMetric : uint8
+{
+	//projected size of the meshes bound, same definition as LOD screen size
+	ScreenSize,
+	//distance from view
+	Distance,
+};
+
+USTRUCT(BlueprintType)
+struct FAllegroAnimTickLODBand
+{
+	GENERATED_USTRUCT_BODY()
+
+	//band applies if screen size of instance is less than this (ScreenSize metric) or its distance is greater than this (Distance metric)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Allegro", meta=(ClampMin=0))
+	float Threshold = 0;
+	//animation advances every UpdateInterval frames, skipped time is accumulated and applied at the next update
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Allegro", meta=(ClampMin=1))
+	uint8 UpdateInterval = 1;
+};
+
+//per tick data of animation tick LOD, bands are turned into squared distances so that per instance test is a single compare per band
+struct FAllegroAnimTickLODContext
+{
+	static constexpr int MAX_BAND = 8;
+
+	FVector3f ViewLocation;
+	float BandDistanceSq[MAX_BAND];
+	uint8 BandInterval[MAX_BAND];
+	int NumBand = 0;
+	uint32 FrameCounter = 0;
+};
 
 
 USTRUCT(BlueprintType)
@@ -119,9 +156,10 @@ struct ALLEGRO_API FAllegroInstanceAnimState
 
 	bool IsTransitionValid() const { return TransitionIndex != 0xFFff; }
 
-	void Tick(UAllegroComponent* Owner, int32 InstanceIndex, float Delta, uint32 FrameCounter, FMatrix* ViewProjection,FVector* ViewLocation,float LODScale);
-
-	bool NeedTick(int32 InstanceIndex, uint32 FrameCounter, float& Delta, FBoxCenterExtentFloat& IB, FMatrix* ViewProjection, FVector* ViewLocation, float LODScale);
+	//@LODContext null if animation tick LOD is disabled. @Events buffer of the calling task, events are dispatched after all instances are ticked
+	void Tick(UAllegroComponent* Owner, int32 InstanceIndex, float Delta, const FAllegroAnimTickLODContext* LODContext, FAllegroAnimTickEvents& Events);
+	//pick LOD band of the instance, return true if animation should advance this frame. @Delta receives the accumulated time
+	bool NeedTick(int32 InstanceIndex, float& Delta, const FVector3f& Location, const FAllegroAnimTickLODContext& LODContext);
 
 	bool IsTicked();
 	void AddReferencedObjects(FReferenceCollector& Collector);
@@ -132,22 +170,13 @@ struct ALLEGRO_API FAllegroInstanceAnimState
 	UPROPERTY(Transient)
 	TObjectPtr<UAnimationAsset> CurrentAnimAsset;
 
-	FInstanceAnimStateExtend*  InstanceExtend = nullptr;
+	//slot in UAllegroComponent::AnimExtendPool for montage and blend space, table depends on AssetType
+	int32 ExtendSlot = INDEX_NONE;
 
-	void ResetAnimState();
+	void ResetAnimState(UAllegroComponent* Owner);
 
 	void SetCurrentAnimAsset(TObjectPtr<UAnimationAsset> Asset, EAnimAssetType Type);
 
-	FInstanceAnimStateExtend* CreateNewInstanceExtend();
-
-	struct TickDeferredEvent
-	{
-		UAnimSequenceBase* FinishedSequence;
-		int FinishedTransitionIdx;
-
-		uint8 GPUTransitionFinished : 1;  //新过渡是否结束事件位
-	};
-
 	struct FGPUTransitionInfo
 	{
 		int32 StartAnimSeqIndex; //暂时只做一个AS的过渡
@@ -176,6 +205,13 @@ struct FInstanceBlendFrameInfo
 	float FrameIndex[ALLEGRO_BLEND_FRAME_NUM_MAX - 1] = { 0.0f };
 };
 
+//range of instance indices [Start, Start + Count)
+struct FAllegroIndexRange
+{
+	uint32 Start;
+	uint32 Count;
+};
+
 /*
 * SOA to keep data of instances
 */
@@ -217,6 +253,16 @@ struct ALLEGRO_API FAllegroInstancesData
 	//#TODO Garbage collection support ?
 	TArray<uint8, TAlignedHeapAllocator<16>> CustomPerInstanceStruct;
 
+	//world space bounds of instances, only render dirty ones are recalculated. see @UAllegroComponent::CalcInstancesBound
+	TArray<FBoxCenterExtentFloat> RenderBounds;
+	//non zero if transform/bound of the instance must be resent to the proxy's instance store
+	TArray<uint8> RenderDirty;
+	//custom data is resent as a whole when dirty
+	bool bRenderCustomDataDirty = true;
+	//true if anything the proxy reads (flags, frame indices, mesh slots, stencil, blend frames, transforms) changed since the last send.
+	//end of frame update is skipped when its false, proxy keeps drawing the data it has. see @UAllegroComponent::SendRenderTransform_Concurrent
+	bool bRenderDataChanged = true;
+
 	void Reset();
 	void Empty();
 
@@ -224,6 +270,11 @@ struct ALLEGRO_API FAllegroInstancesData
 
 	void RemoveFlags(EAllegroInstanceFlags FlagsToRemove);
 
+	void MarkRenderDirty(int InstanceIndex) { RenderDirty[InstanceIndex] = 1; bRenderDataChanged = true; }
+	void MarkAllRenderDirty();
+	//collects the dirty instances in [0, InstanceCount) as ranges and clears them. returns number of instances covered by the ranges
+	uint32 ConsumeRenderDirtyRanges(uint32 InstanceCount, TArray<FAllegroIndexRange>& OutRanges);
+
 	void AddReferencedObjects(FReferenceCollector& Collector);
 };
 
@@ -256,6 +307,31 @@ struct FAllegroAnimNotifyEvent
 	TObjectPtr<class UAnimNotify>  Notify;
 };
 
+/*
+* events gathered by a single animation tick task. each task appends to its own buffer without locking,
+* buffers are merged after all tasks are done so the cost depends on the number of events not instances.
+* buffers are kept between frames to avoid reallocation.
+*/
+struct FAllegroAnimTickEvents
+{
+	TArray<FAllegroAnimNotifyEvent> Notifies;
+	TArray<FAllegroAnimFinishEvent> Finishes;
+	TArray<int32> FinishedTransitions;		//index for AnimCollection->Transitions, ref must be released
+	TArray<int32> FinishedGPUTransitions;	//instance indices, may contain duplicates
+	bool bAnyTicked = false;				//true if animation of any instance advanced
+	bool bSequencesChanged = false;			//true if any instance started sampling another sequence (montage sections, blend space samples)
+
+	void Reset()
+	{
+		bAnyTicked = false;
+		bSequencesChanged = false;
+		Notifies.Reset();
+		Finishes.Reset();
+		FinishedTransitions.Reset();
+		FinishedGPUTransitions.Reset();
+	}
+};
+
 struct FAllegroAnimPlayParams
 {
 	UAnimationAsset* Animation = nullptr;
@@ -311,6 +387,13 @@ struct FAllegroSubmeshSlot
 	float OverrideDistance = 0;
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "OverrideDistance > 0", EditConditionHides, GetOptions="GetSubmeshNames"), Category = "Allegro")
 	FName OverrideSubmeshName;
+	//if screen size of the instance is lower than this, ImpostorMesh is drawn instead of the skeletal LODs. 0 to disable. skeletal meshes only
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta=(ClampMin=0), Category = "Allegro")
+	float ImpostorScreenSize = 0;
+	//usually a camera facing card whose material picks its sprite from an atlas by the sequence frame of the instance (see AllegroFrameIndex.ush).
+	//the atlas isn't baked by the plugin, it must have one cell per collection frame. drawn without skinning in main pass only, shadow views keep the last skeletal LOD.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (EditCondition = "ImpostorScreenSize > 0", EditConditionHides), Category = "Allegro")
+	UStaticMesh* ImpostorMesh = nullptr;
 	//
 	int MeshDefIndex = -1; //index in AnimCollection.Meshes
 	//SkeletalMesh.MinimumLOD won't effect us
@@ -426,12 +509,32 @@ public:
 	//
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Allegro", meta=(ClampMin=0))
 	float AnimationPlayRate;
+	//opt in, far instances advance their animation every few frames, see AnimTickLODBands. requires a player camera. globally controlled by allegro.AnimTickLOD
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Allegro")
+	bool bEnableAnimTickLOD;
+	//
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Allegro", meta=(EditCondition="bEnableAnimTickLOD"))
+	EAllegroAnimTickLODMetric AnimTickLODMetric;
+	//must be sorted from near to far. instances past the first N bands use the UpdateInterval of band N. max 8 bands.
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Allegro", meta=(EditCondition="bEnableAnimTickLOD"))
+	TArray<FAllegroAnimTickLODBand> AnimTickLODBands;
 	
 	UPROPERTY(EditAnywhere, Category = "Allegro")
 	const UScriptStruct* PerInstanceScriptStruct;
 
+	//cell size of the grid used to accelerate location queries (QueryLocationOverlapping*, QueryNearestInstances). 0 means no index, queries will iterate over all the instances.
+	//should be around the typical query radius.
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Allegro", meta=(ClampMin=0))
+	float SpatialIndexCellSize;
+
 	//Struct of Arrays
 	FAllegroInstancesData InstancesData;
+	//kept up to date by transform writes, rebuilt after bulk changes (flush, clear, load, ...) at the end of the tick, or by the first query if it comes earlier
+	mutable FAllegroSpatialIndex SpatialIndex;
+	//serializes the rebuild done by a query, const queries may run concurrently
+	mutable FCriticalSection SpatialIndexLock;
+	//set once SpatialIndex is fully built, queries read the index without locking when set
+	mutable std::atomic<bool> bSpatialIndexReady = false;
 
 	FSpanAllocator IndexAllocator;
 	FSpanAllocator BlendFrameIndexAllocator;
@@ -444,6 +547,15 @@ public:
 
 	float TimeSinceLastLocalBoundUpdate;
 	int PrevDynamicDataInstanceCount;
+	//scratch array for GenerateDynamicData_Internal, kept to avoid allocation per frame
+	TArray<FAllegroIndexRange> RenderDirtyRanges;
+	//unique sequences requested by the last RequestAnimationResidency, AnimCollection keeps them resident while the component is drawn
+	TArray<uint16> RequestedSequences;
+	//true if the sequences instances sample may have changed since RequestedSequences was gathered (play, transition end, add/remove ...)
+	bool bRequestedSequencesDirty = true;
+	//translation from the space of the proxy's instance store to world space. origin rebasing accumulates here instead of resending every instance.
+	//folded back to zero by the next update that resends all instances, see @ApplyWorldOffset
+	FVector3f RenderOrigin = FVector3f::ZeroVector;
 
 	void PostApplyToComponent() override;
 	void OnComponentCreated() override;
@@ -497,6 +609,8 @@ public:
 	void EndPlay(EEndPlayReason::Type Reason) override;
 
 	int32 GetNumMaterials() const override;
+	//impostor materials come after the materials of all sub meshes, so indices of sub mesh materials don't depend on them
+	int32 GetImpostorMaterialBaseIndex() const;
 	UMaterialInterface* GetMaterial(int32 MaterialIndex) const override;
 	int32 GetMaterialIndex(FName MaterialSlotName) const override;
 	TArray<FName> GetMaterialSlotNames() const override;
@@ -509,6 +623,8 @@ public:
 	void TickAnimations(float DeltaTime); 
 
 	void CalcAnimationFrameIndices();
+	//keep sequences that instances are showing resident in AnimCollection streaming pool
+	void RequestAnimationResidency();
 
 	//fast enough. won't recreate render state.
 	UFUNCTION(BlueprintCallable, Category = "Allegro|Rendering")
@@ -684,15 +800,18 @@ public:
 		return InstanceHasAnyFlag(InstanceIndex, static_cast<EAllegroInstanceFlags>(Flags << InstaceUserFlagStart));
 	}
 
+	//flags are read by the proxy, the instance is marked render dirty so static components send them too
 	void InstanceSetFlags(int InstanceIndex, EAllegroInstanceFlags Flags, bool bSet)
 	{
 		if(bSet)
 			EnumAddFlags(InstancesData.Flags[InstanceIndex], Flags);
 		else
 			EnumRemoveFlags(InstancesData.Flags[InstanceIndex], Flags);
+
+		InstancesData.MarkRenderDirty(InstanceIndex);
 	}
-	void InstanceAddFlags(int InstanceIndex, EAllegroInstanceFlags FlagsToAdd)			{ EnumAddFlags(InstancesData.Flags[InstanceIndex], FlagsToAdd); }
-	void InstanceRemoveFlags(int InstanceIndex, EAllegroInstanceFlags FlagsToRemove)		{ EnumRemoveFlags(InstancesData.Flags[InstanceIndex], FlagsToRemove); }
+	void InstanceAddFlags(int InstanceIndex, EAllegroInstanceFlags FlagsToAdd)			{ EnumAddFlags(InstancesData.Flags[InstanceIndex], FlagsToAdd); InstancesData.MarkRenderDirty(InstanceIndex); }
+	void InstanceRemoveFlags(int InstanceIndex, EAllegroInstanceFlags FlagsToRemove)		{ EnumRemoveFlags(InstancesData.Flags[InstanceIndex], FlagsToRemove); InstancesData.MarkRenderDirty(InstanceIndex); }
 	bool InstanceHasAnyFlag(int InstanceIndex, EAllegroInstanceFlags FlagsToTest) const	{ return EnumHasAnyFlags(InstancesData.Flags[InstanceIndex], FlagsToTest); }
 	bool InstanceHasAllFlag(int InstanceIndex, EAllegroInstanceFlags FlagsToTest) const	{ return EnumHasAllFlags(InstancesData.Flags[InstanceIndex], FlagsToTest); }
 	
@@ -839,6 +958,24 @@ public:
 	void QueryLocationOverlappingSphere(const FVector3f& Center, float Radius, TArray<int>& OutIndices) const;
 	//return indices of instances whose location are inside the specified box
 	void QueryLocationOverlappingBox(const FBox3f& Box, TArray<int>& OutIndices) const;
+	//return indices of up to @Count alive instances closest to @Center sorted by distance. @MaxDistance <= 0 means unlimited.
+	void QueryNearestInstances(const FVector3f& Center, int Count, float MaxDistance, TArray<int>& OutIndices, TFunctionRef<bool(int)> Filter = [](int) { return true; }) const;
+	//return the spatial index, rebuilt if needed. null if SpatialIndexCellSize is 0.
+	const FAllegroSpatialIndex* GetSpatialIndex() const;
+	//call @Proc for every alive instance that may be inside the box. coarse test, @Proc must do the precise one.
+	template<typename TProc> void ForEachInstanceNearBox(const FBox3f& Box, TProc Proc) const
+	{
+		if (const FAllegroSpatialIndex* Index = GetSpatialIndex())
+		{
+			Index->ForEachInRect(FVector2f(Box.Min.X, Box.Min.Y), FVector2f(Box.Max.X, Box.Max.Y), Proc);
+		}
+		else
+		{
+			for (int i = 0; i < GetInstanceCount(); i++)
+				if (IsInstanceAlive(i))
+					Proc(i);
+		}
+	}
 
 	#pragma region CustomDataFloat
 
@@ -847,6 +984,7 @@ public:
 	{
 		check(IsInstanceValid(InstanceIndex) && FloatIndex < NumCustomDataFloats);
 		InstancesData.RenderCustomData[InstanceIndex * NumCustomDataFloats + FloatIndex] = InValue;
+		InstancesData.bRenderCustomDataDirty = true;
 	}
 	UFUNCTION(BlueprintCallable, Category = "Allegro|Rendering")
 	float GetInstanceCustomData(int InstanceIndex, int FloatIndex) const
@@ -879,6 +1017,8 @@ public:
 		check(IsInstanceValid(InstanceIndex));
 		for (int i = 0; i < NumCustomDataFloats; i++)
 			InstancesData.RenderCustomData[InstanceIndex * NumCustomDataFloats + i] = 0;
+
+		InstancesData.bRenderCustomDataDirty = true;
 	}
 	//
 	template<typename TData /*float, FVector2f, ... */> void SetInstanceCustomData(int InstanceIndex, const TData& InValue)
@@ -894,7 +1034,12 @@ public:
 	}
 
 
-	float* GetInstanceCustomDataFloats(int InstanceIndex) { return &InstancesData.RenderCustomData[InstanceIndex * NumCustomDataFloats]; }
+	//#Note non const version marks custom data dirty, assumed it's taken for writing
+	float* GetInstanceCustomDataFloats(int InstanceIndex)
+	{
+		InstancesData.bRenderCustomDataDirty = true;
+		return &InstancesData.RenderCustomData[InstanceIndex * NumCustomDataFloats];
+	}
 	const float* GetInstanceCustomDataFloats(int InstanceIndex) const { return &InstancesData.RenderCustomData[InstanceIndex * NumCustomDataFloats]; }
 	
 	#pragma endregion CustomDataFloat
@@ -905,7 +1050,9 @@ public:
 	
 	FAllegroDynamicData* GenerateDynamicData_Internal();
 
-	void CalcInstancesBound(FBoxMinMaxFloat& OutCompBound, FBoxCenterExtentFloat* OutInstancesBounds);
+	//updates InstancesData.RenderBounds of render dirty instances and calculates the bound of all visible instances
+	//@OutNumVisible if not null receives the number of alive instances that aren't hidden
+	void CalcInstancesBound(FBoxMinMaxFloat& OutCompBound, uint32* OutNumVisible = nullptr);
 	void UpdateInstanceLocalBound(int InstanceIndex);
 	void UpdateLocalBounds();
 
@@ -1068,8 +1215,6 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Allegro")
 	int NumPreTask = 100;
 
-	void AddEvent(int InstanceIndex, const FAllegroAnimNotifyEvent& Notify);
-
 	UFUNCTION(BlueprintCallable, Category = "Allegro")
 	void SetInstanceStencil(int InstanceIndex, int32 Stencil);
 
@@ -1085,7 +1230,9 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Allegro")
 	bool UseGPUTransition = true;
 
-	TArray<FAllegroInstanceAnimState::TickDeferredEvent>  ThreadSafeTickTempEvent;
+	//pooled montage and blend space state of instances, created on first use
+	FAllegroAnimExtendPool* AnimExtendPool = nullptr;
+	FAllegroAnimExtendPool& GetAnimExtendPool();
 
 	bool IsAttachment = false;
 
@@ -1097,7 +1244,13 @@ public:
 	int  SpecialCustomDepthStencilValue = 0;
 private:
 	
-	TArray< TArray<FAllegroAnimNotifyEvent> > AnimationNotifyEventsTemp;
+	//one per animation tick task
+	TArray<FAllegroAnimTickEvents> AnimTickEvents;
+
+	//move events of all tasks to AnimationNotifyEvents/AnimationFinishEvents and release finished transitions
+	void DispatchAnimTickNotifies();
+	void DispatchAnimTickFinishes();
+	void FinishGPUTransition(int InstanceIndex);
 
 	
 	DECLARE_FUNCTION(execK2_GetInstanceCustomStruct);
@@ -1106,6 +1259,14 @@ private:
 
 	int AllocateBlendFrameIndex();
 	void FreeBlendFrameIndex(int index);
+	//@return false if animation tick LOD can't be used this frame
+	bool InitAnimTickLODContext(FAllegroAnimTickLODContext& Context) const;
+
+	void InvalidateSpatialIndex();
+	//rebuilds from the instance locations, SpatialIndexLock must be held
+	void RebuildSpatialIndex() const;
+	//game thread, rebuilds the spatial index if it was invalidated so queries don't have to
+	void UpdateSpatialIndex();
 
 	uint32 FrameCounter = 0;
 };
@@ -0,0 +1,99 @@
+// Copyright 2024 Lazy Marmot Games. All Rights Reserved.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+
+/*
+* incrementally maintained uniform hash grid over instance locations, used by game thread overlap / nearest queries.
+* grid is 2D (XY columns), crowds are mostly flat so Z is left to the precise test done by the caller.
+* cells are never freed until the next Rebuild, so moving instances don't churn the map.
+*/
+struct ALLEGRO_API FAllegroSpatialIndex
+{
+	static constexpr int32 INVALID_CELL = -1;
+
+	struct FCell
+	{
+		FIntPoint Coord;
+		TArray<int32> Instances;
+	};
+
+	//discard everything and prepare for @NumInstance instances. index becomes valid.
+	void Reset(float InCellSize, int32 NumInstance);
+	//mark as invalid, owner is responsible for rebuilding it before the next query
+	void Invalidate();
+	bool IsValid() const { return bValid; }
+	float GetCellSize() const { return CellSize; }
+	int32 GetNumIndexed() const { return NumIndexed; }
+
+	//insert or move the instance. does nothing if the index is invalid
+	void Update(int32 InstanceIndex, const FVector3f& Location);
+	//remove the instance if its indexed. does nothing if the index is invalid
+	void Remove(int32 InstanceIndex);
+
+	FIntPoint ToCellCoord(float X, float Y) const
+	{
+		const float Limit = 1 << 30;
+		return FIntPoint(FMath::FloorToInt(FMath::Clamp(X * InvCellSize, -Limit, Limit)), FMath::FloorToInt(FMath::Clamp(Y * InvCellSize, -Limit, Limit)));
+	}
+
+	//call @Proc for every indexed instance whose cell overlaps the XY rectangle. its a coarse test, caller must do the precise one.
+	template<typename TProc> void ForEachInRect(const FVector2f& Min, const FVector2f& Max, TProc Proc) const
+	{
+		check(bValid);
+		if (NumIndexed == 0)
+			return;
+
+		const FIntPoint CMin = ToCellCoord(Min.X, Min.Y).ComponentMax(OccupiedMin);
+		const FIntPoint CMax = ToCellCoord(Max.X, Max.Y).ComponentMin(OccupiedMax);
+		if (CMin.X > CMax.X || CMin.Y > CMax.Y)
+			return;
+
+		const int64 NumRectCell = int64(CMax.X - CMin.X + 1) * int64(CMax.Y - CMin.Y + 1);
+		if (NumRectCell > CellMap.Num()) //huge query, cheaper to walk the occupied cells
+		{
+			for (const TPair<FIntPoint, int32>& Pair : CellMap)
+			{
+				if (Pair.Key.X >= CMin.X && Pair.Key.X <= CMax.X && Pair.Key.Y >= CMin.Y && Pair.Key.Y <= CMax.Y)
+					for (int32 InstanceIndex : Cells[Pair.Value].Instances)
+						Proc(InstanceIndex);
+			}
+			return;
+		}
+
+		for (int32 Y = CMin.Y; Y <= CMax.Y; Y++)
+		{
+			for (int32 X = CMin.X; X <= CMax.X; X++)
+			{
+				if (const int32* CellIndex = CellMap.Find(FIntPoint(X, Y)))
+					for (int32 InstanceIndex : Cells[*CellIndex].Instances)
+						Proc(InstanceIndex);
+			}
+		}
+	}
+
+	/*
+	* find up to @K closest instances to @Center, sorted by distance (closest first).
+	* @Locations	instance locations the index was built from
+	* @Filter		return false to skip an instance
+	*/
+	void FindNearest(const FVector3f& Center, int32 K, float MaxDistance, const FVector3f* Locations, TFunctionRef<bool(int32)> Filter, TArray<int>& OutIndices) const;
+
+	SIZE_T GetAllocatedSize() const;
+
+private:
+	void Insert(int32 InstanceIndex, const FIntPoint& Coord);
+
+	TMap<FIntPoint, int32> CellMap; //cell coordinate -> index in Cells
+	TArray<FCell> Cells;
+	TArray<int32> InstanceCell; //per instance, index in Cells or INVALID_CELL
+	TArray<int32> InstanceSlot; //per instance, index in FCell::Instances
+	FIntPoint OccupiedMin = FIntPoint(MAX_int32, MAX_int32); //conservative bounds of cells ever used since last Reset
+	FIntPoint OccupiedMax = FIntPoint(MIN_int32, MIN_int32);
+	float CellSize = 0;
+	float InvCellSize = 0;
+	int32 NumIndexed = 0;
+	bool bValid = false;
+};
@@ -58,6 +58,17 @@ public:
 			Component->QueryLocationOverlappingSphere(FVector3f(Center), Radius, InstanceIndices);
 	}
 
+	/*
+	* return indices of up to @Count instances closest to @Center, sorted by distance
+	* @param MaxDistance	 <= 0 means unlimited
+	*/
+	UFUNCTION(BlueprintCallable, Category = "Allegro|Utility")
+	static void QueryNearestInstances(UAllegroComponent* Component, const FVector& Center, int Count, float MaxDistance, TArray<int>& InstanceIndices)
+	{
+		if(IsValid(Component))
+			Component->QueryNearestInstances(FVector3f(Center), Count, MaxDistance, InstanceIndices);
+	}
+
 
 
 
@@ -69,5 +80,8 @@ public:
 
 	UFUNCTION(BlueprintCallable, Category = "Allegro|Utility")
 	static void QueryLocationOverlappingComponentAdvanced(UAllegroComponent* Component, UPrimitiveComponent* ComponentToTest, UPARAM(meta = (Bitmask, BitmaskEnum = EInstanceUserFlags)) int32 FlagsToTest, bool bAllFlags, bool bInvert, TArray<int>& InstanceIndices);
+
+	UFUNCTION(BlueprintCallable, Category = "Allegro|Utility")
+	static void QueryNearestInstancesAdvanced(UAllegroComponent* Component, UPARAM(meta = (Bitmask, BitmaskEnum = EInstanceUserFlags)) int32 FlagsToTest, bool bAllFlags, bool bInvert, const FVector& Center, int Count, float MaxDistance, TArray<int>& InstanceIndices);
 };
 